@@ -40,6 +40,8 @@
 
 
 // Standard headers
+#include <map>
+#include <string>
 #include <vector>
 
 // Boost headers
@@ -50,6 +52,7 @@
 #include <xsi_matrix4.h>
 
 // Affogato headers
+#include "affogatoGlobals.hpp"
 #include "affogatoTokenValue.hpp"
 #include "affogatoRenderer.hpp"
 
@@ -80,7 +83,26 @@ namespace affogato {
 			virtual	unsigned		granularity() const; // get the number of parts the primtive consists of
 			virtual vector< float >	boundingBox() const;
 			virtual objectType  	type() const = 0;
+			/** Returns the numbers of each primitive variable, points
+			 *  included, by name, so motion samples can be compared.
+			 */
+			map< string, vector< float > > motionValues() const;
+			/** Sets the tolerance of the texture coordinates, colors, widths
+			 *  and points. Renderers that can store primitive variables with
+			 *  less precision, like the command stream, may then do so.
+			 */
+			void					quantizePrimvars( const globals::data::quantizeTolerances& tolerances );
 		protected:
+			/** Writes all grains in turn.
+			 *
+			 *  If delayed loading is on and there is more than one grain, each grain
+			 *  goes into an archive of its own that gets referenced with the grain's
+			 *  bounding box, so the renderer only loads the grains it actually needs.
+			 */
+			void					writeGrains() const;
+			virtual void			writeGrain( unsigned grain ) const; // write a single part
+			virtual vector< float >	grainBoundingBox( unsigned grain ) const; // get the bounding box of a single part
+			static void				quantizePrimvar( tokenValue& aTokenValue, const globals::data::quantizeTolerances& tolerances );
 			ueberMan::primitiveHandle identifier;
 			tokenValue::tokenValuePtrVector tokenValuePtrArray;
 			vector< float > bound;
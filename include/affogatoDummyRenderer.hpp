@@ -1,13 +1,60 @@
 #ifndef dummyRenderer_H
 #define dummyRenderer_H
-
-#include <vector>
+/** Statistics sink renderer.
+ *
+ *  Discards everything it is fed but keeps count of what it got: calls
+ *  per API entry point, primitives per type, primvar bytes per storage
+ *  class and motion blocks. Registered on its own, it allows to measure
+ *  the exporter's overhead in isolation, without any renderer side
+ *  serialization.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+
+// Standard headers
+#include <map>
 #include <string>
+#include <vector>
 
-#include "affogatoRenderer.h"
-#include "affogatoTokenValue.h"
+// Affogato headers
+#include "affogatoRenderer.hpp"
+#include "affogatoTokenValue.hpp"
 
-#define MAXMOTIONSAMPLES 16
 
 namespace ueberMan {
 
@@ -16,88 +63,191 @@ namespace ueberMan {
 
 	class ueberManDummyRenderer : public ueberMan {
 		public:
-								ueberManDummyRenderer() {}
+								ueberManDummyRenderer();
 							   ~ueberManDummyRenderer() {}
-			context	beginScene( const string &destination, bool useBinary = false, bool useCompression = false ) {}
-			void	switchScene( context ctx ) {}
-			void	endScene( context ctx ) {}
-
-			const	ueberManDummyRenderer& accessRenderer() { return *this; }
-
-			//static const	UeberManDummyRenderer*	accessRendererStatic() {}
-
-			void	input( const string &filename ) {}
-			void	input( const string &filename, const float *bound ) {}
-
-			void	world() {}
-			void	render( const cameraHandle &cameraname ) {}
-
-			void	camera( cameraHandle& cameraid ) {}
-			void	output( const string &name, const string &format,
-							const string &dataname, const cameraHandle& camerid ) {}
-
-			void	motion( const vector< float >& times ) {}
-
-			void	parameter( const std::vector< tokenValue > &tokenValueArray ) {}
-			void	parameter( const tokenValue &aTokenValue ) {}
-			void	parameter( const string &typedname, const string &value ) {}
-			void	parameter( const string &typedname, const float value ) {}
-			void	parameter( const string &typedname, const int value ) {}
-			void	parameter( const string &typedname, const bool value ) {}
 
-			void	attribute( const tokenValue &aTokenValue ) {}
-			void	attribute( const string &typedname, const string &value ) {}
-			void	attribute( const string &typedname, const float value ) {}
-			void	attribute( const string &typedname, const int value ) {}
-			void	attribute( const string &typedname, const bool value ) {}
+			static	const ueberManDummyRenderer& accessRenderer();
 
-			bool	getAttribute( const string &typedname, float &value ) {}
-			bool	getAttribute( const string &typedname, int &value ) {}
-			bool	getAttribute( const string &typedname, string &value ) {}
+			// Zeroes all counters
+			void	reset();
+			// Writes the counters to the log
+			void	printStatistics() const;
 
-			void	pushAttributes() {}
-			void	popAttributes() {}
+			context	beginScene( const string &destination, bool useBinary = false, bool useCompression = false );
+			void	switchScene( context ctx );
+			context	currentScene();
+			void	endScene( context ctx = contextUndefined );
 
-			void	option( const tokenValue &aTokenValue ) {}
-			void	option( const string &typedname, const string &value ) {}
-			void	option( const string &typedname, const float value ) {}
-			void	option( const string &typedname, const int value ) {}
-			void	option( const string &typedname, const bool value ) {}
+			void	input( const string &filename );
+			void	input( const string &filename, const float *bound );
 
-			void	pushSpace() {}
-			void	popSpace() {}
+			void	world();
+			void	render( const cameraHandle &cameraname );
 
-			void	space( const float *matrix ) {}
-			void	space( const spaceHandle& spacename ) {}
-			void	nameSpace( spaceHandle& spacename ) {}
-			void	appendSpace( const float *matrix ) {}
-
-			void	translate( const float x, const float y, const float z ) {}
-			void	rotate( const float angle, const float x, const float y, const float z ) {}
-			void	scale( const float x, const float y, const float z ) {}
-
-			void	shader( const string &shadertype, const string &shadername, shaderHandle& shaderid ) {}
-			void	light( const string &shadername, lightHandle& lightid ) {}
-			void	switchLight( const lightHandle &lightid, const bool on ) {}
-
-			void	beginLook( lookHandle& lookid ) {}
-			void	endLook() {}
-			void	look( const lookHandle& id ) {}
-			void	appendLook( const lookHandle& id ) {}
-
-			void	curves( const string& interp, const int ncurves, const int nvertspercurve, const bool closed, primitiveHandle &identifier ) {}
-			void	curves( const string& interp, const int ncurves, const int *nvertspercurve, const bool closed, primitiveHandle &identifier ) {}
-
-			void	patch( const string& interp, const int nu, const int nv, primitiveHandle &identifier ) {}
+			void	camera( cameraHandle& cameraid );
+			void	output( const string &name, const string &format,
+							const string &dataname, const cameraHandle& camerid );
+
+			void	motion( const vector< float >& times );
+
+			void	parameter( const vector< tokenValue > &tokenValueArray );
+			void	parameter( const tokenValue &aTokenValue );
+			void	parameter( const string &typedname, const string &value );
+			void	parameter( const string &typedname, const float value );
+			void	parameter( const string &typedname, const int value );
+			void	parameter( const string &typedname, const bool value );
+
+			void	variable( const vector< tokenValue > &tokenValueArray );
+			void	variable( const tokenValue &aTokenValue );
+			void	variable( const string &typedname, const string &value );
+			void	variable( const string &typedname, const float value );
+			void	variable( const string &typedname, const int value );
+			void	variable( const string &typedname, const bool value );
+
+			void	attribute( const tokenValue &aTokenValue );
+			void	attribute( const string &typedname, const string &value );
+			void	attribute( const string &typedname, const float value );
+			void	attribute( const string &typedname, const int value );
+			void	attribute( const string &typedname, const bool value );
+
+			bool	getAttribute( const string &typedname, float &value );
+			bool	getAttribute( const string &typedname, int &value );
+			bool	getAttribute( const string &typedname, string &value );
+
+			void	pushAttributes();
+			void	popAttributes();
+
+			void	option( const tokenValue &aTokenValue );
+			void	option( const string &typedname, const string &value );
+			void	option( const string &typedname, const float value );
+			void	option( const string &typedname, const int value );
+			void	option( const string &typedname, const bool value );
+
+			void	pushSpace();
+			void	popSpace();
+
+			void	space( const vector< float >& matrix );
+			void	space( const spaceHandle& spacename );
+			void	nameSpace( spaceHandle& spacename );
+			void	appendSpace( const vector< float >& matrix );
+
+			void	translate( const float x, const float y, const float z );
+			void	rotate( const float angle, const float x, const float y, const float z );
+			void	scale( const float x, const float y, const float z );
+
+			void	shaderTreeBegin( shaderHandle& treeid );
+			void	shaderTreeEnd();
+			void	shaderTree( const string& treeid );
+			void	connectShaders( const shaderHandle& srcId, const string& srcName, const shaderHandle& destId, const string& destName, shaderHandle& nodeid );
+
+			void	shader( const string &shadertype, const string &shadername, shaderHandle& shaderid );
+			void	light( const string &shadername, lightHandle& lightid );
+			void	switchLight( const lightHandle &lightid, const bool on = true );
+
+			void	beginLook( lookHandle& lookid );
+			void	endLook();
+			void	nameLook( lookHandle& lookid );
+			void	look( const lookHandle& id );
+			void	appendLook( const lookHandle& id );
+
+			void	beginObject( objectHandle& instanceid );
+			void	endObject();
+			void	loadObject( const objectHandle& instanceid );
+
+			void	points( const string& type, const int numPoints, primitiveHandle& identifier );
+
+			void	curves( const string& interp, const int ncurves, const int nvertspercurve, const bool closed, primitiveHandle &identifier );
+			void	curves( const string& interp, const int ncurves, const vector< int >& nvertspercurve, const bool closed, primitiveHandle &identifier );
+			void	curves( const int numCurves, const vector< int >& numVertsPerCurve, const vector< int >& order, const vector< float >& knot, const vector< float >& min, const vector< float >& max, primitiveHandle& identifier );
+
+			void	patch( const string& interp, const int nu, const int nv, primitiveHandle &identifier );
 			void	patch(	const int nu, const int uorder, const float *uknot,	const float umin, const float umax,
-							const int nv, const int vorder, const float *vknot,	const float vmin, const float vmax, primitiveHandle &identifier ) {}
-
-			void 	mesh( const string& interp, const int nfaces, const int *nverts, const int *verts, const bool interpolateBoundary, primitiveHandle &identifier ) {}
-
-			void	sphere(	const float radius, const float zmin, const float zmax, const float thetamax, primitiveHandle &identifier ) {}
-
+							const int nv, const int vorder, const float *vknot,	const float vmin, const float vmax, primitiveHandle &identifier );
+
+			void 	mesh( const string& interp, const int nfaces, const int *nverts, const int *verts, const bool interpolateBoundary, primitiveHandle &identifier );
+
+			void	sphere(	const float radius, const float zmin, const float zmax, const float thetamax, primitiveHandle &identifier );
+
+			void	blobby( const int numLeafs, const vector< int >& code, const vector< float >& floatData, const vector< string >& stringData, primitiveHandle& identifier );
+
+			void	makeMap( const string& type );
+
+			void	archiveRecord( const string& type, const string& record );
+
+		private:
+
+			typedef enum callType {
+				callBeginScene = 0,
+				callSwitchScene,
+				callEndScene,
+				callInput,
+				callWorld,
+				callRender,
+				callCamera,
+				callOutput,
+				callMotion,
+				callParameter,
+				callVariable,
+				callAttribute,
+				callGetAttribute,
+				callPushAttributes,
+				callPopAttributes,
+				callOption,
+				callPushSpace,
+				callPopSpace,
+				callSpace,
+				callNameSpace,
+				callAppendSpace,
+				callTranslate,
+				callRotate,
+				callScale,
+				callShaderTreeBegin,
+				callShaderTreeEnd,
+				callShaderTree,
+				callConnectShaders,
+				callShader,
+				callLight,
+				callSwitchLight,
+				callBeginLook,
+				callEndLook,
+				callNameLook,
+				callLook,
+				callAppendLook,
+				callBeginObject,
+				callEndObject,
+				callLoadObject,
+				callPoints,
+				callCurves,
+				callPatch,
+				callMesh,
+				callSphere,
+				callBlobby,
+				callMakeMap,
+				callArchiveRecord,
+				numCallTypes
+			} callType;
+
+			// Storage classes run from storageUndefined (-1) to storageFaceVertex (5)
+			static const int numStorageClasses = 7;
+
+			void	countPrimvar( const tokenValue& aTokenValue );
+			// Counts one motion sample and returns true for the first one
+			bool	countSample();
+			void	countPrimitive( const string& type );
+
+			unsigned long calls[ numCallTypes ];
+			unsigned long primvars[ numStorageClasses ];
+			unsigned long primvarBytes[ numStorageClasses ];
+			map< string, unsigned long > primitives;
+			unsigned long motionBlocks;
+			unsigned long motionSamples;
+			// Size of and samples left in the current motion block
+			unsigned short blockSamples;
+			unsigned short samplesLeft;
+
+			context contextCounter;
+			context currentContext;
 	};
 }
 
 #endif
-
@@ -135,6 +135,7 @@ namespace affogato {
 				bool geometryBlur;
 				bool geometryParameterBlur;
 				bool geometryVariableBlur;
+				bool velocityBlur;
 				bool cameraBlur;
 				bool lightBlur;
 				bool attributeBlur;
@@ -150,6 +151,13 @@ namespace affogato {
 				} shutterConfigurationType;
 				shutterConfigurationType shutterConfiguration;
 				float shutterOffset;
+				typedef enum sampleReductionType {
+					sampleReductionOff = 0,
+					sampleReductionStatic = 1,
+					sampleReductionLinear = 2
+				} sampleReductionType;
+				sampleReductionType sampleReduction;
+				float sampleReductionEpsilon;
 			} motionBlur;
 
 			struct name {
@@ -275,6 +283,13 @@ namespace affogato {
 				} previewDisplayType;
 				previewDisplayType previewDisplay;
 				bool stopWatch;
+				typedef enum statisticsType {
+					statisticsOff = 0,
+					statisticsCollect = 1,
+					statisticsOnly = 2
+				} statisticsType;
+				statisticsType statistics;
+				bool xmlDebug; // Also write each data file as XML, on a separate thread
 			} feedback;
 
 			struct defaultShaderGroup {
@@ -377,7 +392,17 @@ namespace affogato {
 				} shadow;
 				bool binary;
 				bool compress;
+				bool nativeWriter; // Write RIB ourselves instead of through the renderer library
 				bool delay;
+				unsigned meshChunkSize; // Split polygon meshes with more faces than this into spatial chunks (0 = never)
+				bool collapsePrimvars; // Write UVs & colors that have no seams per point instead of per face-vertex
+				bool commandStream; // Also record each data file as a binary command stream (.ums) that can be replayed later
+				struct quantizeTolerances { // Largest error allowed when storing primitive variables in command streams (0 = exact)
+					float textureCoordinates;
+					float colors;
+					float widths;
+					float points;
+				} quantize;
 				bool doHub;
 				boost::filesystem::path worldBlockName;
 				bool hierarchical; // Whether we scan the scene tree hierachical from the leaf node upwards for attributes & shaders
@@ -404,7 +429,13 @@ namespace affogato {
 			// Dodgy as hell: the global set of blobby groups :(
 			map< float, std::set< long > > blobbyGroupsMap;
 		private:
+			void			aquireParameters( const Property& affogatoGlobals );
 			void			scan( const string& xmlFile );
+			string			snapshotKey( const string& inputs );
+			bool			loadSnapshot( const string& key );
+			void			saveSnapshot( const string& key, const vector< string >& dependencies );
+			template< class archive >
+			void			transfer( archive& ar );
 			void			sanitize();
 			void			sanitizePaths();
 			bool			getBoolAttribute( XMLNode& xNode, const string& s, bool& value );
@@ -0,0 +1,118 @@
+#ifndef affogatoGzipStream_H
+#define affogatoGzipStream_H
+/** A std::streambuf that writes gzip compressed files through zlib.
+ *
+ *  Attach it to an ostream to get the usual stream interface:
+ *
+ *  gzipStreamBuffer buf( "scene.xml.gz" );
+ *  ostream out( &buf );
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+
+// Standard headers
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// zlib headers
+#include <zlib.h>
+
+
+namespace affogato {
+
+	using namespace std;
+
+	class gzipStreamBuffer : public streambuf {
+		public:
+			gzipStreamBuffer( const string& filename, int level = 6, size_t bufferSize = 256 * 1024 )
+			:	buffer( bufferSize )
+			{
+				char mode[ 4 ] = { 'w', 'b', ( char )( '0' + level ), 0 };
+				file = gzopen( filename.c_str(), mode );
+				setp( &buffer[ 0 ], &buffer[ 0 ] + buffer.size() );
+			}
+
+		   ~gzipStreamBuffer() {
+				close();
+			}
+
+			bool is_open() const {
+				return NULL != file;
+			}
+
+			void close() {
+				if( file ) {
+					sync();
+					gzclose( file );
+					file = NULL;
+				}
+			}
+
+		protected:
+			int overflow( int c ) {
+				if( -1 == sync() )
+					return traits_type::eof();
+				if( traits_type::eof() != c ) {
+					*pptr() = traits_type::to_char_type( c );
+					pbump( 1 );
+				}
+				return traits_type::not_eof( c );
+			}
+
+			int sync() {
+				int numBytes = ( int )( pptr() - pbase() );
+				if( numBytes ) {
+					if( !file || numBytes != gzwrite( file, pbase(), numBytes ) )
+						return -1;
+					setp( &buffer[ 0 ], &buffer[ 0 ] + buffer.size() );
+				}
+				return 0;
+			}
+
+		private:
+			// Not copyable
+			gzipStreamBuffer( const gzipStreamBuffer& );
+			gzipStreamBuffer& operator=( const gzipStreamBuffer& );
+
+			vector< char > buffer;
+			gzFile file;
+	};
+}
+
+#endif
@@ -77,6 +77,22 @@ namespace affogato {
 	vector< float >	getSequence( const string& seq );
 	vector< float > getMotionSamples( const unsigned short motionsamples );
 	vector< float > remapMotionSamples( const vector< float >& motionsamples );
+	/** Finds the motion samples that are actually needed to describe a motion.
+	 *
+	 *  Two samples are considered identical if none of their values differ by
+	 *  more than epsilon (relative to the magnitude of the value, so an epsilon
+	 *  of 0 means bitwise identical).
+	 *
+	 *  @param samples  The sampled values, one vector per motion sample.
+	 *  @param times    The time of each motion sample.
+	 *  @param epsilon  The tolerance used when comparing values.
+	 *  @param linear   If true, samples that lie on the line between the first
+	 *                  and the last sample are dropped as well.
+	 *  @return         The indices of the samples to keep. This is just the first
+	 *                  sample for a static motion, the first and last sample for a
+	 *                  linear one and all samples otherwise.
+	 */
+	vector< unsigned > reduceMotionSamples( const vector< vector< float > >& samples, const vector< float >& times, float epsilon, bool linear );
 	bool CStringToChar( const CString& theString, char *dest );
 	string CStringToString( const CString& theString );
 	CString charToCString( const char *theString );
@@ -88,8 +104,32 @@ namespace affogato {
 	}
 	const vector< float >& CMatrix4ToFloat( const MATH::CMatrix4& in );
 
-	void debugMessage( const CString& msg );
-	void message( const CString& msg, messageType level );
+	/** Returns true if a message of the given level would make it to
+	 *  the log at the current verbosity. Used by the message() and
+	 *  debugMessage() macros to skip building messages nobody sees.
+	 */
+	bool messageEnabled( messageType level );
+	void logDebugMessage( const CString& msg );
+	void logMessage( const CString& msg, messageType level );
+	/** Writes out all log lines still queued and stops the log thread.
+	 *  Call before the plugin gets unloaded.
+	 */
+	void flushLog();
+
+/* The message arguments are only evaluated if the message is going to be
+ * logged. Debug messages are compiled out completely unless DEBUG is set.
+ * Messages below MINMESSAGELEVEL (e.g. -DMINMESSAGELEVEL=messageWarning)
+ * are compiled out too; forced messages are always kept.
+ */
+#ifndef MINMESSAGELEVEL
+	#define MINMESSAGELEVEL messageInfo
+#endif
+#define message( msg, level ) do { if( ( ( affogato::messageForce == ( level ) ) || ( affogato::MINMESSAGELEVEL <= ( level ) ) ) && affogato::messageEnabled( level ) ) affogato::logMessage( msg, level ); } while( false )
+#ifdef DEBUG
+	#define debugMessage( msg ) do { if( affogato::messageEnabled( affogato::messageDebug ) ) affogato::logDebugMessage( msg ); } while( false )
+#else
+	#define debugMessage( msg ) do {} while( false )
+#endif
 
 
 	string getParameterTypeAsString( tokenValue::parameterType type );
@@ -98,6 +138,37 @@ namespace affogato {
 	CRefArray getAffogatoProperties( const X3DObject& obj );
 #endif
 
+	/** A string with global- & environment variables and frame number
+	 *  padding, split into literal text and variables once by the
+	 *  constructor and expanded by render() as often as needed.
+	 *  See parseString() for the syntax.
+	 */
+	class pathTemplate {
+		public:
+							pathTemplate() {};
+							pathTemplate( const string& inputString );
+			// The result stays valid until the next call
+			const string&	render( int frameNumber = -9999999 ) const;
+		private:
+			typedef enum segmentType {
+				segmentLiteral,
+				segmentFrame,		// $F
+				segmentPadding,		// #, ##, ...
+				segmentBaseDir,		// $PDIR
+				segmentDataDir,		// $DDIR, $RDIR
+				segmentEnvironment	// %NAME%
+			} segmentType;
+			struct segment {
+				segmentType type;
+				string text; // Literal or environment variable name
+				int padding;
+			};
+			void			addSegment( segmentType type, string& literal, const string& text = string(), int padding = 0 );
+
+			vector< segment > segments;
+			mutable string	buffer;
+	};
+
 	string parseString( const string& inputString, int frameNumber = -9999999 );
 	string checkEnvironmentForFile( string envName, string fileName );
 
@@ -114,11 +185,43 @@ namespace affogato {
 	bool createFullPath( const filesystem::path& createPath );
 	string cleanUpSearchPath( const string& path );
 
+#ifdef __XSI_PLUGIN
 	vector< float > getBoundingBox( const XSI::Primitive& prim, double atTime );
+#endif
 
 	string getEnvironment( const string& envVar );
 
+	/** A directory only the current user can write to, created if needed.
+	 *  Files that are loaded back or that restore commands run from are
+	 *  kept there instead of the shared temp directory.
+	 *  Returns an empty string if there is no such directory.
+	 */
+	string privateDirectory();
+	// Whether a file can be trusted: a plain file of ours nobody else can write to
+	bool isPrivateFile( const string& fileName );
+	/** Writes content to a file of our own first and moves that into place,
+	 *  so concurrent sessions never read a partially written file.
+	 */
+	bool writePrivateFile( const string& fileName, const string& content );
+
+	/** Incremental hash of arbitrary data. Two independent 32 bit
+	 *  hashes (FNV-1a & djb2) are combined, so different data
+	 *  practically never ends up with the same string.
+	 */
+	class contentHash {
+		public:
+			contentHash();
+			void	add( const void* data, size_t size );
+			void	add( const string& data );
+			void	add( float data );
+			string	str() const;
+		private:
+			unsigned fnv, djb;
+	};
+
+#ifdef __XSI_PLUGIN
 	Property updateGlobals( const Property& prop );
+#endif
 
 	class arrayDeleter // needed to free a shared_ptr to an array
 	{
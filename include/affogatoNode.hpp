@@ -119,6 +119,12 @@ namespace affogato {
 					void 	scanForAttributes( const Property& prop, map< string, shared_ptr< tokenValue > >& attribMap,
 								shared_ptr< shader >& surface, shared_ptr< shader >& displacement,  shared_ptr< shader >& volume );
 
+					/** Names the node's attribute and shader state after a hash of its contents
+					 *  and writes it to the looks block, unless a node with the same state
+					 *  did that already.
+					 */
+					void	shareLook();
+
 			enum nodeType {
 				nodeUndefined = 0,
 				nodeLight,
@@ -150,6 +156,7 @@ namespace affogato {
 
 			bool isStatic;
 			long staticFrame;
+			globals::data::quantizeTolerances quantize; // Per object tolerances of the primitive variables
 
 #ifdef RSP
 			unsigned hub, hdb;
@@ -161,8 +168,10 @@ namespace affogato {
 			vector< shared_ptr< CMatrix4 > > transformSamples;
 			vector< shared_ptr< data > > geometrySamples;
 			map< string, vector< shared_ptr< Property > > > lookVectorMap;
+			string objectLook; // Named look holding attributeMap & shaders, if any
 
 			static context lookContext;
+			static map< string, string > lookSignatures; // Signature of each look shareLook() wrote
 
 			// No support for motion blurred attributes as of now
 	};
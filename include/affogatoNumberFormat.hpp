@@ -0,0 +1,76 @@
+#ifndef affogatoNumberFormat_H
+#define affogatoNumberFormat_H
+/** Locale independent number formatting for the text based renderers.
+ *
+ *  iostreams and printf() honour the current locale and are slow when
+ *  called once per array element. These write straight into a caller
+ *  supplied character buffer instead.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+
+// Standard headers
+#include <string>
+
+
+namespace affogato {
+
+	using namespace std;
+
+	// Big enough for any float or int written by the functions below
+	static const size_t numberFormatSize = 32;
+
+	/** Writes the shortest decimal representation of value that reads
+	 *  back as the very same float. Returns the number of characters
+	 *  written (no terminating zero is written).
+	 */
+	size_t formatFloat( float value, char *dest );
+
+	size_t formatInt( int value, char *dest );
+
+	/** Appends values as a space separated list to dest.
+	 */
+	void formatFloats( const float *values, size_t size, string& dest );
+	void formatInts( const int *values, size_t size, string& dest );
+
+	/** Appends the base64 encoding of the given bytes to dest.
+	 */
+	void encodeBase64( const void *data, size_t numBytes, string& dest );
+}
+
+#endif
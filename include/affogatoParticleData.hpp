@@ -58,16 +58,25 @@ namespace affogato {
 		public:
 								particleData( const Primitive &particlePrim, double atTime, bool usePref = false, double atPrefTime = 0 );
 								~particleData();
+			/** Writes the particles.
+			 *
+			 *  Clouds with more than PARTICLE_DATA_CHUNK_SIZE particles are split into
+			 *  several primitives (see data::writeGrains()).
+			 */
 			void				write() const;
-			/*void				startGrain();
+			void				startGrain();
 			void				writeNextGrain();
-			unsigned			getGranularity() const;*/
+			unsigned			granularity() const;
 			objectType			type() const { return objectParticle; };
 			vector< float >		boundingBox() const;
 
 		private:
 			//void				splitById( tokenValue::tokenValuePtr blobbyIdMap );
+			void				writeGrain( unsigned grain ) const;
+			vector< float >		grainBoundingBox( unsigned grain ) const;
+			tokenValue::tokenValuePtr grainTokenValue( const tokenValue& aTokenValue, unsigned grain ) const;
 			vector< float >		bound;
+			unsigned			currentGrain;
 			unsigned			numParticles;
 			string				typeStr;
 			vector< int >		code;
@@ -72,6 +72,7 @@ namespace affogato {
 				increasing,
 				decreasing
 			} lineOrderType;
+									pass() {};
 									pass(	const Property& affogatoPass );
 									pass(	const boost::filesystem::path& theFileName,
 											const string& theName,
@@ -106,6 +107,25 @@ namespace affogato {
 			void					write();
 			string					getXML();
 			boost::filesystem::path	getFileName();
+			// Reads or writes all members through a globals snapshot archive
+			template< class archive >
+			void					transfer( archive& ar ) {
+										ar.value( fileName );
+										ar.value( name );
+										ar.value( format );
+										ar.enumeration( type );
+										ar.value( pixelFilter );
+										ar.value( filterWidth[ 0 ] );
+										ar.value( filterWidth[ 1 ] );
+										ar.enumeration( quantize );
+										ar.value( dither );
+										ar.value( computeAlpha );
+										ar.value( associateAlpha );
+										ar.value( exclusive );
+										ar.value( matte );
+										ar.value( autoCrop );
+										ar.enumeration( lineOrder );
+									}
 
 		private:
 			boost::filesystem::path	fileName;
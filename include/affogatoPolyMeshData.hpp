@@ -56,13 +56,52 @@ namespace affogato {
 	class polyMeshData : public data {
 
 		public:
-								polyMeshData( const Primitive &polyMeshPrim, double atTime, bool usePref = false, double atPrefTime = 0 );
+			/** Aquires a polygon mesh.
+			 *
+			 *  @param velocityDelta  If not 0, the points are evaluated a second time at
+			 *                        atTime + velocityDelta and a per-vertex velocity
+			 *                        (in units per frame) is derived from the difference.
+			 *                        It gets attached as the '__velocity' primvar and can be
+			 *                        used to extrapolate motion samples (see extrapolate()).
+			 */
+								polyMeshData( const Primitive &polyMeshPrim, double atTime, bool usePref = false, double atPrefTime = 0, double velocityDelta = 0 );
 								~polyMeshData();
 			void				write() const;
 			objectType			type() const { return objectMesh; };
 			vector< float >		boundingBox() const;
+			/** Creates a motion sample by moving the points along their velocity.
+			 *
+			 *  All other primitive variables are shared with this sample.
+			 *
+			 *  @param deltaTime  The time (in frames) to move the points by.
+			 *  @return           The new sample, or an empty pointer if this mesh has no velocity.
+			 */
+			boost::shared_ptr< polyMeshData > extrapolate( double deltaTime ) const;
+			/** Splits the mesh into chunks of at most meshChunkSize faces, if
+			 *  it has more than that and isn't a subdivision surface.
+			 *
+			 *  Only call this for one sample and share its chunks with the
+			 *  others; they are all built from the first sample's points.
+			 */
+			void				split();
+			// Writes the mesh in one piece again
+			void				unsplit();
+			/** Makes this sample use the chunks of another sample of the same mesh.
+			 *
+			 *  All samples inside a motion block must be split the same way.
+			 *
+			 *  @return  False if the topology differs. This sample is left
+			 *           unsplit then.
+			 */
+			bool				shareGrains( const polyMeshData& other );
+			void				startGrain();
+			void				writeNextGrain();
+			unsigned			granularity() const;
 
 		private:
+			void				buildGrains( unsigned maxFaces );
+			void				writeGrain( unsigned grain ) const;
+			vector< float >		grainBoundingBox( unsigned grain ) const;
 			int		numFaces;
 			int	 	numPoints;
 			boost::shared_ptr< int > nverts;
@@ -71,6 +110,16 @@ namespace affogato {
 
 			const float	*vertexParam;
 
+			boost::shared_ptr< float > velocity;
+
+			// Spatial chunks, as ranges into a list of face indices
+			int		numFaceVertices;
+			boost::shared_ptr< vector< unsigned > > faceOffset; // Index of each face's first vertex in verts
+			boost::shared_ptr< vector< int > > grainFaces;
+			boost::shared_ptr< vector< unsigned > > grainStart;
+			unsigned currentGrain;
+			mutable vector< int > localIndex; // Scratch space for remapping vertices
+
 			vector< float > bound;
 
 			typedef enum boundaryType{
@@ -0,0 +1,138 @@
+#ifndef affogatoPropertyIndex_H
+#define affogatoPropertyIndex_H
+/** Per frame lookup index of the properties of scene objects.
+ *
+ *  Many places look at the same object's properties by name or type
+ *  and lower case every parameter name they come across. The index
+ *  does that once per object and frame and everyone shares it.
+ *  The same goes for finding the group a property is applied to, which
+ *  is asked once for every member of the group otherwise, and for the
+ *  path templates of string parameters.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+
+// Standard headers
+#include <map>
+#include <string>
+#include <vector>
+
+// XSI headers
+#include <xsi_parameter.h>
+#include <xsi_property.h>
+#include <xsi_ref.h>
+#include <xsi_x3dobject.h>
+
+// Affogato headers
+#include "affogatoHelpers.hpp"
+
+namespace affogato {
+
+	using namespace XSI;
+	using namespace std;
+
+	class propertyIndex {
+		public:
+			struct parameterEntry {
+								parameterEntry() : compiled( false ) {}
+				/** Expands the variables in a value of this parameter (see
+				 *  parseString()). The template is only compiled again if the
+				 *  value differs from the last one. The result stays valid
+				 *  until the next call.
+				 */
+				const string&	expand( const string& value ) const;
+
+				string name; // Lower case
+				string originalName;
+				Parameter parameter;
+
+				private:
+					mutable bool			compiled;
+					mutable string			source;
+					mutable pathTemplate	valueTemplate;
+			};
+			typedef vector< parameterEntry > parameterVector;
+
+			/** Returns the index of an object, building it on first use in
+			 *  the current frame. Indices of older frames are thrown away.
+			 */
+			static const propertyIndex&	access( const X3DObject& obj );
+
+			/** Returns the parameters of a property with lower cased names,
+			 *  cached for the current frame.
+			 */
+			static const parameterVector& parameters( const Property& prop );
+
+			/** Returns the Affogato name of the group prop is applied to or
+			 *  an empty string if it sits on an object. Cached for the
+			 *  current frame.
+			 */
+			static const string&		group( const Property& prop );
+
+			/** Returns all visible spheres in the scene. The scene is
+			 *  only searched once per frame.
+			 */
+			static const CRefArray&		spheres();
+
+			/** Returns the visible spheres whose 'blobbyid' parameter is
+			 *  id, cached for the current frame.
+			 */
+			static const CRefArray&		blobbyMembers( long id );
+
+			/** Forgets all indices. Call before exporting, as properties
+			 *  may have been added, removed or edited since.
+			 */
+			static void					clear();
+
+			const CRefArray&			properties() const; // All properties of the object, in XSI's order
+			bool						isAffogato( unsigned i ) const; // Whether properties()[ i ] is an Affogato property
+			CRef						findType( const CString& type ) const; // The first property of that type or an invalid CRef
+			const Parameter*			findParameter( const string& name ) const; // The first Affogato parameter of that lower case name or NULL
+
+		private:
+										propertyIndex( const X3DObject& obj );
+			static void					checkFrame();
+
+			CRefArray					props;
+			vector< bool >				affogatoFlags;
+			map< string, CRef >			types;
+			map< string, Parameter >	affogatoParameters;
+	};
+}
+
+#endif
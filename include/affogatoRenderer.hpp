@@ -239,8 +239,15 @@ namespace ueberMan {
 		virtual void	blobby( const int numLeafs, const vector< int >& code, const vector< float >& floatData, const vector< string >& stringData, primitiveHandle& identifier ) {}
 
 		virtual void	makeMap( const string& type ) {}
+
+		// Records go straight into the output of renderers writing files.
+		// The type is one of "comment", "structure" (a '##' comment) or
+		// "verbatim" (raw text)
+		virtual void	archiveRecord( const string& type, const string& record ) {}
 	};
 
+	class ueberManQueue;
+
 
 	class ueberManInterface : ueberMan {
 
@@ -270,9 +277,15 @@ namespace ueberMan {
 			/**
 			 *  Adds a renderer to the uerberManInterface.
 			 *  Any API issued to the renderInterface call will be forwarded
-			 *  to the given renderer
+			 *  to the given renderer.
+			 *  If queued is true, calls are recorded into a queue that is
+			 *  consumed by a worker thread of the renderer's own instead.
+			 *  Only use this for renderers that nobody talks to behind
+			 *  ueberMan's back and that don't care which thread they're
+			 *  called from (the Ri renderer shares the renderer library's
+			 *  global state, so it has to stay synchronous).
 			 */
-			void 	registerRenderer( const ueberMan& theRenderer );
+			void 	registerRenderer( const ueberMan& theRenderer, bool queued = false );
 			void	unregisterRenderer( const ueberMan& theRenderer );
 
 			context beginScene( const string& destination, bool useBinary = false, bool useCompression = false );
@@ -350,7 +363,7 @@ namespace ueberMan {
 			void	nameLook( lookHandle& lookid );
 			void	look( const lookHandle& lookid );
 			void	appendLook( const lookHandle& lookid );
-			static	set< lookHandle > getLooks();
+			static	const set< lookHandle >& getLooks();
 
 			void	shader( const string& shadertype, const string& shadername, shaderHandle& shaderid );
 			void	light( const string& shadername, lightHandle& lightid );
@@ -376,9 +389,12 @@ namespace ueberMan {
 
 			void	makeMap( const string& type );
 
+			void	archiveRecord( const string& type, const string& record );
+
 		private:
 
 			static vector< ueberMan* > rendererList;
+			static vector< boost::shared_ptr< ueberManQueue > > queueList;
 
 			/*struct renderContext {
 				context renderingContext;
@@ -0,0 +1,243 @@
+#ifndef affogatoRendererQueue_H
+#define affogatoRendererQueue_H
+/** Asynchronous command queue for an ueberMan renderer.
+ *
+ *  Wraps a renderer so API calls issued through ueberManInterface
+ *  get recorded into a queue and consumed by a dedicated worker
+ *  thread. All arguments are copied when a call is recorded;
+ *  tokenValues share their data so this is cheap even for big
+ *  primvar arrays.
+ *  Calls are executed in the order they were issued. Contexts handed
+ *  out by beginScene() are mapped to the ones the wrapped renderer
+ *  returns on the worker thread, so switching scenes never blocks.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+
+// Standard headers
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+// Boost headers
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/shared_array.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+// Affogato headers
+#include "affogatoRenderer.hpp"
+
+
+namespace ueberMan {
+
+	using namespace std;
+	using namespace affogato;
+
+	class ueberManQueue : public ueberMan {
+
+		public:
+					ueberManQueue( const ueberMan& theRenderer );
+				   ~ueberManQueue();
+
+			/** The renderer this queue feeds.
+			 */
+			const ueberMan*	target() const;
+
+			/** Blocks until the worker thread has consumed every call
+			 *  recorded so far. Errors the renderer threw on the
+			 *  worker thread are reported here.
+			 *  Returns false if the renderer threw since the last flush.
+			 */
+			bool	flush();
+
+			context	beginScene( const string& destination, bool useBinary = false, bool useCompression = false );
+			void	switchScene( context ctx );
+			context	currentScene();
+			void	endScene( context ctx = contextUndefined );
+
+			void	input( const string& filename );
+			void	input( const string& filename, const float *bound );
+
+			void	camera( cameraHandle& cameraid );
+			void	output( const string& name, const string& format,
+							const string& dataname, const cameraHandle& cameraid );
+
+			void	world();
+			void	render( const cameraHandle& cameraid );
+
+			void	motion( const vector< float >& times );
+
+			void	parameter( const vector< tokenValue > &tokenValueArray );
+			void	parameter( const tokenValue &aTokenValue );
+			void	parameter( const string& typedname, const string& value );
+			void	parameter( const string& typedname, const float value );
+			void	parameter( const string& typedname, const int value );
+			void	parameter( const string& typedname, const bool value );
+
+			void	variable( const vector< tokenValue > &tokenValueArray );
+			void	variable( const tokenValue &aTokenValue );
+			void	variable( const string& typedname, const string& value );
+			void	variable( const string& typedname, const float value );
+			void	variable( const string& typedname, const int value );
+			void	variable( const string& typedname, const bool value );
+
+			void	attribute( const tokenValue &aTokenValue );
+			void	attribute( const string& typedname, const string& value );
+			void	attribute( const string& typedname, const float value );
+			void	attribute( const string& typedname, const int value );
+			void	attribute( const string& typedname, const bool value );
+
+			// These need an answer, so they wait for the queue to drain
+			bool	getAttribute( const string& typedname, float &value );
+			bool	getAttribute( const string& typedname, int &value );
+			bool	getAttribute( const string& typedname, string& value );
+
+			void	pushAttributes();
+			void	popAttributes();
+
+			void	option( const tokenValue &aTokenValue );
+			void	option( const string& typedname, const string& value );
+			void	option( const string& typedname, const float value );
+			void	option( const string& typedname, const int value );
+			void	option( const string& typedname, const bool value );
+
+			void	pushSpace();
+			void	popSpace();
+
+			void	space( const vector< float >& matrix );
+			void	space( const spaceHandle &spacename );
+			void	nameSpace( spaceHandle& spacename );
+			void	appendSpace( const vector< float >& matrix );
+
+			void	translate( const float x, const float y, const float z );
+			void	rotate( const float angle, const float x, const float y, const float z );
+			void	scale( const float x, const float y, const float z );
+
+			void	shaderTreeBegin( shaderHandle& treeid );
+			void	shaderTreeEnd();
+			void	shaderTree( const string& treeid );
+			void	connectShaders( const shaderHandle& srcId, const string& srcName, const shaderHandle& destId, const string& destName, shaderHandle& nodeid );
+
+			void	shader( const string& shadertype, const string& shadername, shaderHandle &shaderid );
+			void	light( const string& shadername, lightHandle& lightid );
+			void	switchLight( const lightHandle& lightid, const bool on = true );
+
+			void	beginLook( lookHandle& lookid );
+			void	endLook();
+			void	nameLook( lookHandle& lookid );
+			void	look( const lookHandle& lookid );
+			void	appendLook( const lookHandle& lookid );
+
+			void	beginObject( objectHandle& instanceid );
+			void	endObject();
+			void	loadObject( const objectHandle& instanceid );
+
+			void	points( const string& type, const int numPoints, primitiveHandle& identifier );
+
+			void	curves( const string& interp, const int numCurves, const int numVertsPerCurve, const bool closed, primitiveHandle& identifier );
+			void	curves( const string& interp, const int numCurves, const vector< int >& numVertsPerCurve, const bool closed, primitiveHandle& identifier );
+			void	curves( const int numCurves, const vector< int >& numVertsPerCurve, const vector< int >& order, const vector< float >& knot, const vector< float >& min, const vector< float >& max, primitiveHandle& identifier );
+
+			void	patch( const string& interp, const int nu, const int nv, primitiveHandle& identifier );
+			void	patch(	const int nu, const int uorder, const float *uknot, const float umin, const float umax,
+							const int nv, const int vorder, const float *vknot, const float vmin, const float vmax, primitiveHandle& identifier );
+
+			void	mesh( const string& interp, const int nfaces, const int *nverts, const int *verts, const bool interpolateBoundary, primitiveHandle& identifier );
+
+			void	sphere( const float radius, const float zmin, const float zmax, const float thetamax, primitiveHandle& identifier );
+			void	sphere( const float radius, primitiveHandle& identifier );
+
+			void	blobby( const int numLeafs, const vector< int >& code, const vector< float >& floatData, const vector< string >& stringData, primitiveHandle& identifier );
+
+			void	makeMap( const string& type );
+
+			void	archiveRecord( const string& type, const string& text );
+
+		private:
+
+			typedef boost::function0< void > command;
+
+			// Arguments of a NURBS patch; too many to bind directly
+			struct nuPatchData {
+				int nu, uorder, nv, vorder;
+				float umin, umax, vmin, vmax;
+				vector< float > uknot, vknot;
+			};
+
+			void	record( const command& cmd );
+			void	run();
+
+			// These run on the worker thread
+			void	doBeginScene( context ctx, const string& destination, bool useBinary, bool useCompression );
+			void	doSwitchScene( context ctx );
+			void	doEndScene( context ctx );
+			void	doInput( const string& filename, boost::shared_array< float > bound );
+			void	doPatch( boost::shared_ptr< nuPatchData > data, primitiveHandle identifier );
+			void	doMesh( const string& interp, const int nfaces, boost::shared_ptr< vector< int > > nverts, boost::shared_ptr< vector< int > > verts, const bool interpolateBoundary, primitiveHandle identifier );
+
+			// Upper bound of pending calls before record() blocks
+			static const size_t maxPending = 65536;
+
+			ueberMan *renderer;
+
+			// Producer side (calling thread)
+			context contextCounter;
+			context currentContext;
+
+			// Consumer side (worker thread), maps our contexts to the renderer's
+			map< context, context > contextMap;
+
+			deque< command > pending;
+			bool busy;
+			bool quit;
+			string lastError;
+
+			boost::mutex mutex;
+			boost::condition workAvailable;
+			boost::condition spaceAvailable;
+			boost::condition drained;
+
+			boost::shared_ptr< boost::thread > worker;
+	};
+}
+
+#endif
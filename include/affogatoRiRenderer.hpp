@@ -148,6 +148,8 @@ namespace ueberMan {
 
 			void	makeMap( const string& type );
 
+			void	archiveRecord( const string& type, const string& record );
+
 		private:
 
 			bool dso;
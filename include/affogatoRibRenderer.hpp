@@ -0,0 +1,254 @@
+#ifndef affogatoRibRenderer_H
+#define affogatoRibRenderer_H
+/** Native RIB stream writer.
+ *
+ *  Writes ASCII or binary RIB directly, without going through a
+ *  renderer library's Ri* entry points. Output is buffered, optionally
+ *  gzipped, and floats are written with the shortest representation
+ *  that reads back exactly. Large ASCII arrays are formatted in chunks
+ *  on several threads.
+ *  The calls are translated the same way ueberManRiRenderer does it,
+ *  so the resulting RIB should match what the renderer library writes.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+
+// Standard headers
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Boost headers
+#include <boost/shared_ptr.hpp>
+
+// Affogato headers
+#include "affogatoGzipStream.hpp"
+#include "affogatoRenderer.hpp"
+#include "affogatoTokenValue.hpp"
+
+
+namespace ueberMan {
+
+	using namespace std;
+	using namespace affogato;
+
+	class ueberManRibRenderer : public ueberMan {
+		public:
+								ueberManRibRenderer();
+							   ~ueberManRibRenderer();
+			context	beginScene( const string& destination, bool useBinary = false, bool useCompression = false );
+			void	switchScene( context ctx );
+			context	currentScene();
+			void	endScene( context ctx );
+
+			static	const	ueberManRibRenderer& accessRenderer();
+
+			void	input( const string& filename );
+			void	input( const string& filename, const float *bound );
+
+			void	world();
+			void	render( const cameraHandle &cameraname );
+
+			void	camera( cameraHandle& cameraid );
+			void	output( const string& name, const string& format,
+							const string& dataname, const cameraHandle& camerid );
+
+			void	motion( const vector< float >& times );
+
+			void	parameter( const std::vector< tokenValue >& tokenValueArray );
+			void	parameter( const tokenValue &aTokenValue );
+			void	parameter( const string& typedname, const string& value );
+			void	parameter( const string& typedname, const float value );
+			void	parameter( const string& typedname, const int value );
+			void	parameter( const string& typedname, const bool value );
+
+			void	attribute( const tokenValue &aTokenValue );
+			void	attribute( const string& typedname, const string& value );
+			void	attribute( const string& typedname, const float value );
+			void	attribute( const string& typedname, const int value );
+			void	attribute( const string& typedname, const bool value );
+
+			bool	getAttribute( const string& typedname, float &value );
+			bool	getAttribute( const string& typedname, int &value );
+			bool	getAttribute( const string& typedname, string& value );
+
+			void	pushAttributes();
+			void	popAttributes();
+
+			void	option( const tokenValue &aTokenValue );
+			void	option( const string& typedname, const string& value );
+			void	option( const string& typedname, const float value );
+			/** Understands "rib:threads", the number of threads used to
+			 *  format large ASCII arrays, and "rib:parallelthreshold",
+			 *  the number of array elements above which they kick in.
+			 */
+			void	option( const string& typedname, const int value );
+			void	option( const string& typedname, const bool value );
+
+			void	pushSpace();
+			void	popSpace();
+
+			void	space( const vector< float >& matrix );
+			void	space( const spaceHandle& spacename );
+			void	nameSpace( spaceHandle& spacename );
+			void	appendSpace( const vector< float >& matrix );
+
+			void	translate( const float x, const float y, const float z );
+			void	rotate( const float angle, const float x, const float y, const float z );
+			void	scale( const float x, const float y, const float z );
+
+			void	shader( const string& shadertype, const string& shadername, shaderHandle& );
+			void	light( const string& shadername, lightHandle& lightid );
+			void	switchLight( const lightHandle &lightid, const bool on );
+
+			void	beginLook( lookHandle& lookid );
+			void	endLook();
+			void	look( const lookHandle& id );
+			void	appendLook( const lookHandle& id );
+
+			void	points( const string& type, const int numPoints, primitiveHandle& );
+
+			void	curves( const string& interp, const int ncurves, const int numVertsPerCurve, const bool, primitiveHandle& );
+			void	curves( const string& interp, const int ncurves, const vector< int >& numVertsPerCurve, const bool, primitiveHandle& );
+			void	curves( const int, const vector< int >&, const vector< int >&, const vector< float >&, const vector< float >&, const vector< float >&, primitiveHandle& identifier );
+
+			void	patch( const string& interp, const int nu, const int nv, primitiveHandle&identifier );
+			void	patch(	const int nu, const int uorder, const float *uknot,	const float umin, const float umax,
+							const int nv, const int vorder, const float *vknot,	const float vmin, const float vmax, primitiveHandle& );
+
+			void 	mesh( const string& interp, const int nfaces, const int *nverts, const int *verts, const bool interpolateBoundary, primitiveHandle& );
+
+			void	sphere(	const float, const float, const float, const float, primitiveHandle& );
+
+			void	blobby( const int numLeafs, const vector< int >& code, const vector< float >& floatData, const vector< string >& stringData, primitiveHandle& identifier );
+
+			void	makeMap( const string& type );
+
+			void	archiveRecord( const string& type, const string& record );
+
+		private:
+
+			/** Encodes RIB requests and their arguments into one file.
+			 *  Every request starts with request(), followed by its
+			 *  arguments.
+			 */
+			class ribStream {
+				public:
+							ribStream( const string& filename, bool useBinary, bool useCompression, unsigned numThreads, size_t parallelThreshold );
+						   ~ribStream();
+
+					bool	is_open() const;
+					void	close();
+
+					void	request( const char *name );
+					void	comment( const string& text, bool structure );
+					void	verbatim( const string& text );
+
+					void	put( const int value );
+					void	put( const float value );
+					void	put( const string& value );
+					void	put( const char *value );
+					void	put( const float *values, size_t size );
+					void	put( const int *values, size_t size );
+					void	put( const vector< float >& values );
+					void	put( const vector< int >& values );
+					void	put( const vector< string >& values );
+					/** Writes the given token with the value of aTokenValue.
+					 */
+					void	put( const string& token, const tokenValue& aTokenValue );
+
+				private:
+					// Not copyable
+							ribStream( const ribStream& );
+					ribStream& operator=( const ribStream& );
+
+					void	separate();
+					void	putBinaryInt( int value );
+					void	putBinaryLength( unsigned char code, size_t length );
+					template< class T > void putAscii( const T *values, size_t size );
+
+					// Output goes through a big buffer and optionally through zlib
+					static const size_t outBufferSize = 1024 * 1024;
+					vector< char > outBuffer;
+					filebuf fileBuffer;
+					boost::shared_ptr< gzipStreamBuffer > gzipBuffer;
+					streambuf *out;
+
+					bool binary;
+					bool lineStart;
+					unsigned threads;
+					size_t threshold;
+					// Binary RIB request codes defined so far
+					map< string, unsigned char > requestCodes;
+					// Scratch space for formatting, reused to avoid allocations
+					string formatBuffer;
+			};
+
+			struct  state {
+				state();
+
+				string		getTokenAsString( const tokenValue& aTokenValue );
+				string		getTokenAsClassifiedString( const tokenValue& aTokenValue );
+				void		putPrimitiveParameters();
+				void		putShaderParameters();
+				void		checkStartMotion();
+				void		checkEndMotion();
+
+				vector< tokenValue::tokenValuePtr > tokenValueCache;
+				short sampleCount;
+				unsigned short numSamples;
+				bool inWorldBlock;
+				bool secondaryDisplay;
+				vector< float > motionSamples;
+				boost::shared_ptr< ribStream > out;
+			};
+
+			void	typedRequest( const char *request, const string& typedname, const string& typeName );
+			void	putBasis( const string& interp );
+
+			map< context, boost::shared_ptr< state > > stateMachine;
+			state* currentState;
+			context currentContext;
+			context contextCounter;
+			unsigned numThreads;
+			size_t parallelThreshold;
+	};
+}
+
+#endif
@@ -88,9 +88,18 @@ namespace affogato {
 			void addParameter( const tokenValue &aTokenValue );
 			bool isValid() const;
 			shaderType getType() const;
+			/** Returns the type, name, displacement bound and the
+			 *  signatures of all parameters. Shaders that differ in
+			 *  any of these get different signatures.
+			 */
+			string signature() const;
 			void write( const string &lightHandle = "" );
 			static bool isShader( const Property &aShader );
 			static shaderType getType( const Property &aShader );
+			/** Forgets the scene state lazily generated maps were checked
+			 *  against. Call before exporting, as the scene may have changed.
+			 */
+			static void clearMapDependencies();
 		private:
 			string					name;
 			shaderType				type;
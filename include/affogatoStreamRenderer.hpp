@@ -0,0 +1,324 @@
+#ifndef affogatoStreamRenderer_H
+#define affogatoStreamRenderer_H
+/** Binary command stream renderer.
+ *
+ *  Records every ueberMan call, including its tokenValue payloads,
+ *  into a compact binary command stream. replay() feeds such a stream
+ *  into any other ueberMan renderer. This allows caching the evaluated
+ *  description of a frame once and re-emitting it in whatever format
+ *  without touching the XSI scene again.
+ *
+ *  The stream is written in native byte order. It starts with the
+ *  magic 'UMCS' and a version number, followed by opcodes that each
+ *  carry the arguments of one call. Longs & bools are written with a
+ *  fixed width of 4 resp. 1 byte.
+ *
+ *  Each scene goes to a file of its own, <destination>.ums, holding
+ *  only the calls made while that scene was the current one. Replaying
+ *  it recreates exactly that data file.
+ *
+ *  Float tokenValues with a tolerance (see tokenValue::setTolerance())
+ *  are stored in the smallest of these encodings that keeps every
+ *  value within the tolerance:
+ *  - 8 or 16 bit fixed point, scaled & offset to the value range.
+ *  - For 'P' inside a motion block: 8 or 16 bit fixed point deltas
+ *    to the previous sample's points.
+ *  All other data is stored as is.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+
+// Standard headers
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Boost headers
+#include <boost/shared_ptr.hpp>
+
+// Affogato headers
+#include "affogatoRenderer.hpp"
+#include "affogatoTokenValue.hpp"
+
+
+namespace ueberMan {
+
+	using namespace std;
+	using namespace affogato;
+	using boost::shared_ptr;
+
+	class ueberManStreamRenderer : public ueberMan {
+
+		public:
+					ueberManStreamRenderer();
+				   ~ueberManStreamRenderer();
+
+			static	const ueberManStreamRenderer& accessRenderer();
+
+			/** Reads a stream written by this renderer and issues all
+			 *  calls in it on the given renderer.
+			 *  Throws a runtime_error if the file can't be read or is
+			 *  not a (compatible) command stream.
+			 */
+			static	void replay( const string& filename, ueberMan& target );
+
+			context	beginScene( const string& destination, bool useBinary = false, bool useCompression = false );
+			void	switchScene( context ctx );
+			context	currentScene();
+			void	endScene( context ctx = contextUndefined );
+
+			void	input( const string& filename );
+			void	input( const string& filename, const float *bound );
+
+			void	camera( cameraHandle& cameraid );
+			void	output( const string& name, const string& format,
+							const string& dataname, const cameraHandle& cameraid );
+
+			void	world();
+			void	render( const cameraHandle& cameraid );
+
+			void	motion( const vector< float >& times );
+
+			void	parameter( const vector< tokenValue > &tokenValueArray );
+			void	parameter( const tokenValue &aTokenValue );
+			void	parameter( const string& typedname, const string& value );
+			void	parameter( const string& typedname, const float value );
+			void	parameter( const string& typedname, const int value );
+			void	parameter( const string& typedname, const bool value );
+
+			void	variable( const vector< tokenValue > &tokenValueArray );
+			void	variable( const tokenValue &aTokenValue );
+			void	variable( const string& typedname, const string& value );
+			void	variable( const string& typedname, const float value );
+			void	variable( const string& typedname, const int value );
+			void	variable( const string& typedname, const bool value );
+
+			void	attribute( const tokenValue &aTokenValue );
+			void	attribute( const string& typedname, const string& value );
+			void	attribute( const string& typedname, const float value );
+			void	attribute( const string& typedname, const int value );
+			void	attribute( const string& typedname, const bool value );
+
+			// A recording has no graphics state to query
+			bool	getAttribute( const string& typedname, float &value ) { return false; }
+			bool	getAttribute( const string& typedname, int &value ) { return false; }
+			bool	getAttribute( const string& typedname, string& value ) { return false; }
+
+			void	pushAttributes();
+			void	popAttributes();
+
+			void	option( const tokenValue &aTokenValue );
+			void	option( const string& typedname, const string& value );
+			void	option( const string& typedname, const float value );
+			void	option( const string& typedname, const int value );
+			void	option( const string& typedname, const bool value );
+
+			void	pushSpace();
+			void	popSpace();
+
+			void	space( const vector< float >& matrix );
+			void	space( const spaceHandle &spacename );
+			void	nameSpace( spaceHandle& spacename );
+			void	appendSpace( const vector< float >& matrix );
+
+			void	translate( const float x, const float y, const float z );
+			void	rotate( const float angle, const float x, const float y, const float z );
+			void	scale( const float x, const float y, const float z );
+
+			void	shaderTreeBegin( shaderHandle& treeid );
+			void	shaderTreeEnd();
+			void	shaderTree( const string& treeid );
+			void	connectShaders( const shaderHandle& srcId, const string& srcName, const shaderHandle& destId, const string& destName, shaderHandle& nodeid );
+
+			void	shader( const string& shadertype, const string& shadername, shaderHandle &shaderid );
+			void	light( const string& shadername, lightHandle& lightid );
+			void	switchLight( const lightHandle& lightid, const bool on = true );
+
+			void	beginLook( lookHandle& lookid );
+			void	endLook();
+			void	nameLook( lookHandle& lookid );
+			void	look( const lookHandle& lookid );
+			void	appendLook( const lookHandle& lookid );
+
+			void	beginObject( objectHandle& instanceid );
+			void	endObject();
+			void	loadObject( const objectHandle& instanceid );
+
+			void	points( const string& type, const int numPoints, primitiveHandle& identifier );
+
+			void	curves( const string& interp, const int numCurves, const int numVertsPerCurve, const bool closed, primitiveHandle& identifier );
+			void	curves( const string& interp, const int numCurves, const vector< int >& numVertsPerCurve, const bool closed, primitiveHandle& identifier );
+			void	curves( const int numCurves, const vector< int >& numVertsPerCurve, const vector< int >& order, const vector< float >& knot, const vector< float >& min, const vector< float >& max, primitiveHandle& identifier );
+
+			void	patch( const string& interp, const int nu, const int nv, primitiveHandle& identifier );
+			void	patch(	const int nu, const int uorder, const float *uknot, const float umin, const float umax,
+							const int nv, const int vorder, const float *vknot, const float vmin, const float vmax, primitiveHandle& identifier );
+
+			void	mesh( const string& interp, const int nfaces, const int *nverts, const int *verts, const bool interpolateBoundary, primitiveHandle& identifier );
+
+			void	sphere( const float radius, const float zmin, const float zmax, const float thetamax, primitiveHandle& identifier );
+			void	sphere( const float radius, primitiveHandle& identifier );
+
+			void	blobby( const int numLeafs, const vector< int >& code, const vector< float >& floatData, const vector< string >& stringData, primitiveHandle& identifier );
+
+			void	makeMap( const string& type );
+
+			void	archiveRecord( const string& type, const string& record );
+
+		private:
+
+			typedef enum opCode {
+				opBeginScene = 1,
+				opSwitchScene,
+				opEndScene,
+				opInput,
+				opInputBound,
+				opCamera,
+				opOutput,
+				opWorld,
+				opRender,
+				opMotion,
+				opParameterArray,
+				opParameter,
+				opParameterString,
+				opParameterFloat,
+				opParameterInt,
+				opParameterBool,
+				opVariableArray,
+				opVariable,
+				opVariableString,
+				opVariableFloat,
+				opVariableInt,
+				opVariableBool,
+				opAttribute,
+				opAttributeString,
+				opAttributeFloat,
+				opAttributeInt,
+				opAttributeBool,
+				opPushAttributes,
+				opPopAttributes,
+				opOption,
+				opOptionString,
+				opOptionFloat,
+				opOptionInt,
+				opOptionBool,
+				opPushSpace,
+				opPopSpace,
+				opSpace,
+				opSpaceNamed,
+				opNameSpace,
+				opAppendSpace,
+				opTranslate,
+				opRotate,
+				opScale,
+				opShaderTreeBegin,
+				opShaderTreeEnd,
+				opShaderTree,
+				opConnectShaders,
+				opShader,
+				opLight,
+				opSwitchLight,
+				opBeginLook,
+				opEndLook,
+				opNameLook,
+				opLook,
+				opAppendLook,
+				opBeginObject,
+				opEndObject,
+				opLoadObject,
+				opPoints,
+				opCurves,
+				opCurvesArray,
+				opNuCurves,
+				opPatch,
+				opNuPatch,
+				opMesh,
+				opSphere,
+				opBlobby,
+				opMakeMap,
+				opArchiveRecord
+			} opCode;
+
+			typedef enum encodingType {
+				encodingRaw = 0,
+				encodingFixed,
+				encodingDelta // Fixed point, relative to the last 'P'
+			} encodingType;
+
+			// Stream encoding
+			void	put( opCode op );
+			void	put( encodingType encoding );
+			void	put( const int value );
+			void	put( const context value );
+			void	put( const float value );
+			void	put( const bool value );
+			void	put( const string& value );
+			void	put( const float *values, unsigned size );
+			void	put( const int *values, unsigned size );
+			void	put( const vector< float >& values );
+			void	put( const vector< int >& values );
+			void	put( const vector< string >& values );
+			void	put( const tokenValue& aTokenValue );
+			void	put( const vector< tokenValue >& tokenValueArray );
+			bool	putFixed( encodingType encoding, const float *values, unsigned size, const float *reference,
+							float tolerance, unsigned char bytes, vector< float >& decoded );
+			void	endPrimitive();
+
+			// A buffer is written to disk before it would grow bigger than this
+			static const size_t flushSize = 4 * 1024 * 1024;
+			void	append( const void* data, size_t size );
+			void	flush();
+
+			class reader;
+
+			struct sceneStream {
+				vector< char > buffer;
+				ofstream outStream;
+			};
+
+			map< context, shared_ptr< sceneStream > > scenes; // Open ones
+			shared_ptr< sceneStream > current;
+			context contextCounter;
+			context currentContext;
+			unsigned motionSamples; // Primitives left in the current motion block
+			vector< float > motionPoints; // Points of the last sample, as replay() will see them
+	};
+}
+
+#endif
@@ -199,6 +199,11 @@ namespace affogato {
 			void setName( const string& theName );
 			void setClass( const storageClass theClass );
 			void setType( const parameterType theType );
+			/** Sets the largest error allowed when storing the data
+			 *  in a lossy encoding. 0 (the default) keeps it exact.
+			 *  Only renderers that have such encodings look at this.
+			 */
+			void setTolerance( const float theTolerance );
 #ifdef __XSI_PLUGIN
 			void setData( const CFloatArray& floats );
 			void setData( const CDoubleArray& doubles );
@@ -223,9 +228,16 @@ namespace affogato {
 			string name() const;
 			storageClass storage() const;
 			parameterType type() const;
+			float tolerance() const;
 			string typeAsString() const;
 			const void* data() const;
 			string dataAsString() const;
+			/** Returns the name, type, storage class and size followed by
+			 *  the raw bytes of the data. Unlike dataAsString(), which is
+			 *  meant for reading, two tokenValues only have the same
+			 *  signature if they hold exactly the same data.
+			 */
+			string signature() const;
 			size_t size() const;
 			size_t byteSize() const;
 			bool valid() const;
@@ -237,6 +249,7 @@ namespace affogato {
 			size_t			_size;
 			storageClass    _storClass;
 			parameterType   _type;
+			float			_tolerance;
 			shared_ptr< void > _data;
 	};
 }
@@ -42,8 +42,10 @@
 
 
 // Standard headers
+#include <map>
 #include <stack>
 #include <string>
+#include <utility>
 
 // Boost headers
 #include <boost/filesystem/path.hpp>
@@ -77,6 +79,8 @@ namespace affogato {
 					worker();
 			void	work( const string& globalsString = string(), const CRefArray& objectList = CRefArray(), const string& destination = string() );
 			void	archive( const CRefArray& objectList, const string& dest );
+			// Turns a command stream recorded during an earlier export back into RIB
+			void	replay( const string& streamFile );
 
 		private:
 
@@ -91,6 +95,18 @@ namespace affogato {
 			void	nulls( const CRefArray& objectList, const string& dest = string() );
 			void	geometry( const CRefArray& objectList, const string& dest = "" );
 
+			// The renderer RIB goes through, depending on the globals
+			const	ueberMan::ueberMan& getRibRenderer();
+
+			// Scene traversal results. The scene graph doesn't change while
+			// we export, so these are only looked up once per export.
+			void	clearTraversalCache();
+			const	CRefArray& findChildren( const CString& name, const CString& type );
+			const	CRefArray& filter( const CRefArray& objectList, const CString& type );
+			const	CRefArray& geometryObjects( const CRefArray& objectList );
+			map< pair< string, string >, CRefArray > childrenCache;
+			map< pair< const CRefArray*, string >, CRefArray > filterCache;
+
 			//void	doWork( const string& globalsString, bool selectedOnly, void ( worker::*callfunc )( const bool ) );
 
 			filesystem::path worldBlockName;
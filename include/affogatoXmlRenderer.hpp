@@ -52,6 +52,7 @@
 #include <boost/shared_ptr.hpp>
 
 // Affogato headers
+#include "affogatoGzipStream.hpp"
 #include "affogatoIndentHelper.hpp"
 #include "affogatoRenderer.hpp"
 #include "affogatoTokenValue.hpp"
@@ -66,7 +67,11 @@ namespace ueberMan {
 	class ueberManXmlRenderer : public ueberMan {
 		public:
 								ueberManXmlRenderer();
-							   ~ueberManXmlRenderer() {};
+							   ~ueberManXmlRenderer();
+			/** Starts a new XML scene.
+			 *  useBinary makes numeric arrays above the array threshold
+			 *  go out base64 encoded, useCompression gzips the file.
+			 */
 			context	beginScene( const string &destination, bool useBinary = false, bool useCompression = false );
 			void	switchScene( context ctx );
 			context currentScene();
@@ -83,7 +88,7 @@ namespace ueberMan {
 			void	output( const string &name, const string &format,
 							const string &dataname, const cameraHandle& camerid );
 
-			void	motion( int ntimes, const float *times );
+			void	motion( const vector< float >& times );
 
 			void	parameter( const std::vector< tokenValue > &tokenValueArray );
 			void	parameter( const tokenValue &aTokenValue );
@@ -108,8 +113,12 @@ namespace ueberMan {
 			//void	option( const tokenValue &aTokenValue );
 			//void	option( const string &typedname, const string &value );
 			//void	option( const string &typedname, float value );
-			//void	option( const string &typedname, int value );
-			//void	option( const string &typedname, bool value );
+			/** Understands "xml:arraythreshold", the number of elements
+			 *  above which numeric arrays get encoded, and "xml:blobs",
+			 *  which writes such arrays raw to a side file instead.
+			 */
+			void	option( const string &typedname, const int value );
+			void	option( const string &typedname, const bool value );
 
 			void	pushSpace();
 			void	popSpace();
@@ -151,7 +160,23 @@ namespace ueberMan {
 			indentHelper indent;
 			vector< boost::shared_ptr< tokenValue > > tokenValueCache;
 
-			ofstream outStream;
+			// Output goes through a big buffer and optionally through zlib
+			static const size_t outBufferSize = 1024 * 1024;
+			vector< char > outBuffer;
+			filebuf fileBuffer;
+			boost::shared_ptr< gzipStreamBuffer > gzipBuffer;
+			ostream outStream;
+
+			// Large numeric array handling
+			static const unsigned defaultArrayThreshold = 16;
+			unsigned arrayThreshold;
+			bool useBase64;
+			bool useBlobs;
+			string blobName;
+			ofstream blobStream;
+			size_t blobOffset;
+			// Scratch space for formatting arrays, reused to avoid allocations
+			string formatBuffer;
 
 			short sampleCount;
 			unsigned short numSamples;
@@ -160,6 +185,8 @@ namespace ueberMan {
 
 			string	getTokenAsString( const tokenValue &aTokenValue );
 			string	getTokenAsClassifiedString( const tokenValue &aTokenValue );
+			void	writeData( const tokenValue &aTokenValue );
+			void	writeArrayData( const void *data, size_t numValues, bool isFloat );
 			void	dumpShaderTokenValues();
 			void	dumpAttributeTokenValues();
 
@@ -129,6 +129,7 @@ XSIPLUGINCALLBACK CStatus XSILoadPlugin( PluginRegistrar &inRegistrar ) {
 	inRegistrar.RegisterCommand( L"Affogato Render Selected", L"AffogatoRenderSelected" );
 	//inRegistrar.RegisterCommand( L"Affogato Write Passes XML", L"AffogatoWritePassesXML" );
 	inRegistrar.RegisterCommand( L"Affogato Export Archive", L"AffogatoExportArchive" );
+	inRegistrar.RegisterCommand( L"Affogato Replay Stream", L"AffogatoReplayStream" );
 	inRegistrar.RegisterCommand( L"Affogato Create Shader", L"AffogatoCreateShader" );
 	inRegistrar.RegisterCommand( L"Affogato Open Globals", L"AffogatoOpenGlobals" );
 	inRegistrar.RegisterCommand( L"Affogato Update All Globals", L"AffogatoUpdateAllGlobals" );
@@ -191,6 +192,9 @@ XSIPLUGINCALLBACK CStatus XSIUnloadPlugin( const XSI::PluginRegistrar &inRegistr
 
 	debugMessage( L"Unloaded Affogato" + stringToCString( AFFOGATOVERSION ) );
 
+	// The log thread must not run on once our code is gone
+	flushLog();
+
 	return XSI::CStatus::OK;
 }
 
@@ -480,6 +484,37 @@ XSIPLUGINCALLBACK CStatus AffogatoExportArchive_Execute( const CRef &inContext)
 
 
 
+XSIPLUGINCALLBACK CStatus AffogatoReplayStream_Init( const CRef &inContext) {
+	Context ctxt( inContext);
+	Command cmd( ctxt.GetSource() );
+
+	Application app;
+	app.LogMessage( L"Initalizing '" + cmd.GetName() + L"' command" );
+
+	ArgumentArray args = cmd.GetArguments();
+	args.Add( L"Stream File Name", CValue() );
+
+	return CStatus::OK;
+}
+
+XSIPLUGINCALLBACK CStatus AffogatoReplayStream_Execute( const CRef &inContext) {
+	Application app;
+
+	Context ctxt( inContext);
+	CValueArray args = ctxt.GetAttribute( L"Arguments" );
+
+	if( CValue() != args[ 0 ] ) {
+		app.LogMessage( L"Affogato: Replaying Command Stream" );
+		affogato::worker hardWorker;
+		hardWorker.replay( CString( args[ 0 ] ).GetAsciiString() );
+	} else {
+		app.LogMessage( L"Affogato: Not enough arguments", siErrorMsg );
+		return CStatus::Fail;
+	}
+
+	return CStatus::OK;
+}
+
 XSIPLUGINCALLBACK CStatus AffogatoHelp_Init( const CRef &inContext ) {
 	Context ctxt = inContext;
 	Menu menu = ctxt.GetSource();
@@ -46,6 +46,9 @@
 
 // Affogato headers
 #include "affogatoData.hpp"
+#include "affogatoGlobals.hpp"
+#include "affogatoHelpers.hpp"
+#include "affogatoRenderer.hpp"
 #include "affogatoTokenValue.hpp"
 
 
@@ -61,13 +64,69 @@ namespace affogato {
 		// Nothing to destruct
 	}
 
-	data::data( const data &cpy ) {
+	data::data( const data &cpy ) : identifier( cpy.identifier ), bound( cpy.bound ) {
 		data *tmp = const_cast< data* >( &cpy );
 		for( vector< boost::shared_ptr< tokenValue > >::iterator it = tmp->tokenValuePtrArray.begin(); it < tmp->tokenValuePtrArray.end(); it++ ) {
 			tokenValuePtrArray.push_back( boost::shared_ptr< tokenValue >( new tokenValue( *( *it ) ) ) );
 		}
 	}
 
+	map< string, vector< float > > data::motionValues() const {
+		map< string, vector< float > > valuesMap;
+		for( tokenValue::tokenValuePtrVector::const_iterator it = tokenValuePtrArray.begin(); it < tokenValuePtrArray.end(); it++ ) {
+			const tokenValue& aTokenValue( **it );
+			if( !aTokenValue.valid() )
+				continue;
+			vector< float >& values( valuesMap[ aTokenValue.name() ] );
+			switch( aTokenValue.type() ) {
+				case tokenValue::typeFloat:
+				case tokenValue::typeColor:
+				case tokenValue::typePoint:
+				case tokenValue::typeHomogenousPoint:
+				case tokenValue::typeVector:
+				case tokenValue::typeNormal:
+				case tokenValue::typeMatrix: {
+					const float *first( ( const float* )aTokenValue.data() );
+					values.insert( values.end(), first, first + aTokenValue.byteSize() / sizeof( float ) );
+					break;
+				}
+				case tokenValue::typeInteger:
+				case tokenValue::typeBoolean: {
+					const int *first( ( const int* )aTokenValue.data() );
+					values.insert( values.end(), first, first + aTokenValue.byteSize() / sizeof( int ) );
+					break;
+				}
+				default:
+					break;
+			}
+		}
+		return valuesMap;
+	}
+
+	void data::quantizePrimvars( const globals::data::quantizeTolerances& tolerances ) {
+		for( vector< boost::shared_ptr< tokenValue > >::iterator it = tokenValuePtrArray.begin(); it < tokenValuePtrArray.end(); it++ )
+			quantizePrimvar( **it, tolerances );
+	}
+
+	void data::quantizePrimvar( tokenValue& aTokenValue, const globals::data::quantizeTolerances& tolerances ) {
+		const string name( aTokenValue.name() );
+
+		if( "P" == name ) {
+			aTokenValue.setTolerance( tolerances.points );
+		} else
+		if( tokenValue::typeColor == aTokenValue.type() ) {
+			aTokenValue.setTolerance( tolerances.colors );
+		} else
+		if( ( "width" == name ) || ( "constantwidth" == name ) ) {
+			aTokenValue.setTolerance( tolerances.widths );
+		} else
+		if( ( tokenValue::typeFloat == aTokenValue.type() ) &&
+			( ( "s" == name ) || ( "t" == name ) || ( "st" == name ) || ( ( 3 < name.length() ) && ( "[2]" == name.substr( name.length() - 3 ) ) ) ) ) {
+			// UV sets are float[2]
+			aTokenValue.setTolerance( tolerances.textureCoordinates );
+		}
+	}
+
 	inline void	data::startGrain() {
 	}
 
@@ -79,6 +138,40 @@ namespace affogato {
 		return 1;
 	}
 
+	void data::writeGrain( unsigned grain ) const {
+		write();
+	}
+
+	vector< float > data::grainBoundingBox( unsigned grain ) const {
+		return boundingBox();
+	}
+
+	void data::writeGrains() const {
+		using namespace ueberMan;
+		ueberManInterface theRenderer;
+		const globals& g( globals::access() );
+
+		const unsigned grains( granularity() );
+
+		if( ( 1 < grains ) && g.data.delay ) {
+			for( unsigned grain( 0 ); grain < grains; grain++ ) {
+				boost::filesystem::path fileName( g.directories.object / ( g.name.baseName + "." + identifier + ".chunk" + toString( grain ) + "." + g.name.currentFrame ) );
+
+				context savedContext( theRenderer.currentScene() );
+				context chunkContext( theRenderer.beginScene( getCacheFilePath( fileName, g.directories.caching.dataWrite ).native_file_string(), g.data.binary, g.data.compress ) );
+				writeGrain( grain );
+				theRenderer.endScene( chunkContext );
+				theRenderer.switchScene( savedContext );
+
+				vector< float > grainBound( grainBoundingBox( grain ) );
+				theRenderer.input( getCacheFilePath( fileName, g.directories.caching.dataSource ).native_file_string(), &( grainBound[ 0 ] ) );
+			}
+		} else {
+			for( unsigned grain( 0 ); grain < grains; grain++ )
+				writeGrain( grain );
+		}
+	}
+
 	vector< float > data::boundingBox() const {
 		vector< float > bound( 6 );
 		bound[ 5 ] = bound[ 3 ] = bound[ 1 ] = numeric_limits< float >::min();
@@ -0,0 +1,546 @@
+/** Statistics sink renderer.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+// Standard headers
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Boost headers
+#include <boost/format.hpp>
+
+// XSI headers
+#ifdef __XSI_PLUGIN
+	#include <xsi_application.h>
+#endif
+
+// Affogato headers
+#include "affogatoDummyRenderer.hpp"
+#ifdef __XSI_PLUGIN
+#include "affogatoHelpers.hpp"
+#endif
+
+
+namespace ueberMan {
+
+	using namespace std;
+	using namespace affogato;
+	using boost::format;
+
+	static const char *callNames[] = {
+		"beginScene",
+		"switchScene",
+		"endScene",
+		"input",
+		"world",
+		"render",
+		"camera",
+		"output",
+		"motion",
+		"parameter",
+		"variable",
+		"attribute",
+		"getAttribute",
+		"pushAttributes",
+		"popAttributes",
+		"option",
+		"pushSpace",
+		"popSpace",
+		"space",
+		"nameSpace",
+		"appendSpace",
+		"translate",
+		"rotate",
+		"scale",
+		"shaderTreeBegin",
+		"shaderTreeEnd",
+		"shaderTree",
+		"connectShaders",
+		"shader",
+		"light",
+		"switchLight",
+		"beginLook",
+		"endLook",
+		"nameLook",
+		"look",
+		"appendLook",
+		"beginObject",
+		"endObject",
+		"loadObject",
+		"points",
+		"curves",
+		"patch",
+		"mesh",
+		"sphere",
+		"blobby",
+		"makeMap",
+		"archiveRecord"
+	};
+
+	static const char *storageNames[] = {
+		"undefined",
+		"constant",
+		"uniform",
+		"varying",
+		"vertex",
+		"facevarying",
+		"facevertex"
+	};
+
+
+	// Public methods ---------------------------------------------------------
+
+
+	ueberManDummyRenderer::ueberManDummyRenderer() {
+		reset();
+	}
+
+	const ueberManDummyRenderer& ueberManDummyRenderer::accessRenderer() {
+		// Singleton instance of the renderer
+		static ueberManDummyRenderer theRenderer;
+		return theRenderer;
+	}
+
+	void ueberManDummyRenderer::reset() {
+		for( int i = 0; i < numCallTypes; i++ )
+			calls[ i ] = 0;
+		for( int i = 0; i < numStorageClasses; i++ ) {
+			primvars[ i ] = 0;
+			primvarBytes[ i ] = 0;
+		}
+		primitives.clear();
+		motionBlocks = 0;
+		motionSamples = 0;
+		blockSamples = 0;
+		samplesLeft = 0;
+		contextCounter = 0;
+		currentContext = contextUndefined;
+	}
+
+	void ueberManDummyRenderer::printStatistics() const {
+		vector< string > lines;
+
+		lines.push_back( "Renderer Statistics:" );
+		lines.push_back( "  Calls:" );
+		for( int i = 0; i < numCallTypes; i++ ) {
+			if( calls[ i ] )
+				lines.push_back( ( format( "    %-16s %10lu" ) % ( string( callNames[ i ] ) + ":" ) % calls[ i ] ).str() );
+		}
+
+		lines.push_back( "  Primitives:" );
+		for( map< string, unsigned long >::const_iterator it = primitives.begin(); it != primitives.end(); it++ )
+			lines.push_back( ( format( "    %-16s %10lu" ) % ( it->first + ":" ) % it->second ).str() );
+
+		lines.push_back( "  Primvars:" );
+		unsigned long totalBytes = 0;
+		for( int i = 0; i < numStorageClasses; i++ ) {
+			if( primvars[ i ] )
+				lines.push_back( ( format( "    %-16s %10lu %12.2f MB" ) % ( string( storageNames[ i ] ) + ":" ) % primvars[ i ] % ( primvarBytes[ i ] / ( 1024.0f * 1024.0f ) ) ).str() );
+			totalBytes += primvarBytes[ i ];
+		}
+		lines.push_back( ( format( "    %-16s %10s %12.2f MB" ) % "Total:" % "" % ( totalBytes / ( 1024.0f * 1024.0f ) ) ).str() );
+
+		lines.push_back( ( format( "  Motion blocks:     %10lu (%lu samples)" ) % motionBlocks % motionSamples ).str() );
+
+		for( vector< string >::const_iterator it = lines.begin(); it < lines.end(); it++ ) {
+#ifdef __XSI_PLUGIN
+			message( stringToCString( *it ), messageInfo );
+#else
+			fprintf( stderr, "%s\n", it->c_str() );
+#endif
+		}
+	}
+
+	context ueberManDummyRenderer::beginScene( const string &destination, bool useBinary, bool useCompression ) {
+		++calls[ callBeginScene ];
+		currentContext = ++contextCounter;
+		return currentContext;
+	}
+
+	void ueberManDummyRenderer::switchScene( context ctx ) {
+		++calls[ callSwitchScene ];
+		currentContext = ctx;
+	}
+
+	context ueberManDummyRenderer::currentScene() {
+		return currentContext;
+	}
+
+	void ueberManDummyRenderer::endScene( context ctx ) {
+		++calls[ callEndScene ];
+	}
+
+	void ueberManDummyRenderer::input( const string &filename ) {
+		++calls[ callInput ];
+	}
+
+	void ueberManDummyRenderer::input( const string &filename, const float *bound ) {
+		++calls[ callInput ];
+	}
+
+	void ueberManDummyRenderer::world() {
+		++calls[ callWorld ];
+	}
+
+	void ueberManDummyRenderer::render( const cameraHandle &cameraname ) {
+		++calls[ callRender ];
+	}
+
+	void ueberManDummyRenderer::camera( cameraHandle& cameraid ) {
+		++calls[ callCamera ];
+	}
+
+	void ueberManDummyRenderer::output( const string &name, const string &format, const string &dataname, const cameraHandle& camerid ) {
+		++calls[ callOutput ];
+	}
+
+	void ueberManDummyRenderer::motion( const vector< float >& times ) {
+		++calls[ callMotion ];
+		++motionBlocks;
+		blockSamples = samplesLeft = ( unsigned short )times.size();
+	}
+
+	void ueberManDummyRenderer::parameter( const vector< tokenValue > &tokenValueArray ) {
+		++calls[ callParameter ];
+		for( vector< tokenValue >::const_iterator it = tokenValueArray.begin(); it < tokenValueArray.end(); it++ )
+			countPrimvar( *it );
+	}
+
+	void ueberManDummyRenderer::parameter( const tokenValue &aTokenValue ) {
+		++calls[ callParameter ];
+		countPrimvar( aTokenValue );
+	}
+
+	void ueberManDummyRenderer::parameter( const string &typedname, const string &value ) {
+		++calls[ callParameter ];
+		++primvars[ tokenValue::storageConstant + 1 ];
+		primvarBytes[ tokenValue::storageConstant + 1 ] += value.length() + 1;
+	}
+
+	void ueberManDummyRenderer::parameter( const string &typedname, const float value ) {
+		++calls[ callParameter ];
+		++primvars[ tokenValue::storageConstant + 1 ];
+		primvarBytes[ tokenValue::storageConstant + 1 ] += sizeof( float );
+	}
+
+	void ueberManDummyRenderer::parameter( const string &typedname, const int value ) {
+		++calls[ callParameter ];
+		++primvars[ tokenValue::storageConstant + 1 ];
+		primvarBytes[ tokenValue::storageConstant + 1 ] += sizeof( int );
+	}
+
+	void ueberManDummyRenderer::parameter( const string &typedname, const bool value ) {
+		++calls[ callParameter ];
+		++primvars[ tokenValue::storageConstant + 1 ];
+		primvarBytes[ tokenValue::storageConstant + 1 ] += sizeof( int );
+	}
+
+	void ueberManDummyRenderer::variable( const vector< tokenValue > &tokenValueArray ) {
+		++calls[ callVariable ];
+		for( vector< tokenValue >::const_iterator it = tokenValueArray.begin(); it < tokenValueArray.end(); it++ )
+			countPrimvar( *it );
+	}
+
+	void ueberManDummyRenderer::variable( const tokenValue &aTokenValue ) {
+		++calls[ callVariable ];
+		countPrimvar( aTokenValue );
+	}
+
+	void ueberManDummyRenderer::variable( const string &typedname, const string &value ) {
+		++calls[ callVariable ];
+	}
+
+	void ueberManDummyRenderer::variable( const string &typedname, const float value ) {
+		++calls[ callVariable ];
+	}
+
+	void ueberManDummyRenderer::variable( const string &typedname, const int value ) {
+		++calls[ callVariable ];
+	}
+
+	void ueberManDummyRenderer::variable( const string &typedname, const bool value ) {
+		++calls[ callVariable ];
+	}
+
+	void ueberManDummyRenderer::attribute( const tokenValue &aTokenValue ) {
+		++calls[ callAttribute ];
+	}
+
+	void ueberManDummyRenderer::attribute( const string &typedname, const string &value ) {
+		++calls[ callAttribute ];
+	}
+
+	void ueberManDummyRenderer::attribute( const string &typedname, const float value ) {
+		++calls[ callAttribute ];
+	}
+
+	void ueberManDummyRenderer::attribute( const string &typedname, const int value ) {
+		++calls[ callAttribute ];
+	}
+
+	void ueberManDummyRenderer::attribute( const string &typedname, const bool value ) {
+		++calls[ callAttribute ];
+	}
+
+	bool ueberManDummyRenderer::getAttribute( const string &typedname, float &value ) {
+		++calls[ callGetAttribute ];
+		return false;
+	}
+
+	bool ueberManDummyRenderer::getAttribute( const string &typedname, int &value ) {
+		++calls[ callGetAttribute ];
+		return false;
+	}
+
+	bool ueberManDummyRenderer::getAttribute( const string &typedname, string &value ) {
+		++calls[ callGetAttribute ];
+		return false;
+	}
+
+	void ueberManDummyRenderer::pushAttributes() {
+		++calls[ callPushAttributes ];
+	}
+
+	void ueberManDummyRenderer::popAttributes() {
+		++calls[ callPopAttributes ];
+	}
+
+	void ueberManDummyRenderer::option( const tokenValue &aTokenValue ) {
+		++calls[ callOption ];
+	}
+
+	void ueberManDummyRenderer::option( const string &typedname, const string &value ) {
+		++calls[ callOption ];
+	}
+
+	void ueberManDummyRenderer::option( const string &typedname, const float value ) {
+		++calls[ callOption ];
+	}
+
+	void ueberManDummyRenderer::option( const string &typedname, const int value ) {
+		++calls[ callOption ];
+	}
+
+	void ueberManDummyRenderer::option( const string &typedname, const bool value ) {
+		++calls[ callOption ];
+	}
+
+	void ueberManDummyRenderer::pushSpace() {
+		++calls[ callPushSpace ];
+	}
+
+	void ueberManDummyRenderer::popSpace() {
+		++calls[ callPopSpace ];
+	}
+
+	void ueberManDummyRenderer::space( const vector< float >& matrix ) {
+		++calls[ callSpace ];
+		countSample();
+	}
+
+	void ueberManDummyRenderer::space( const spaceHandle& spacename ) {
+		++calls[ callSpace ];
+		countSample();
+	}
+
+	void ueberManDummyRenderer::nameSpace( spaceHandle& spacename ) {
+		++calls[ callNameSpace ];
+	}
+
+	void ueberManDummyRenderer::appendSpace( const vector< float >& matrix ) {
+		++calls[ callAppendSpace ];
+		countSample();
+	}
+
+	void ueberManDummyRenderer::translate( const float x, const float y, const float z ) {
+		++calls[ callTranslate ];
+		countSample();
+	}
+
+	void ueberManDummyRenderer::rotate( const float angle, const float x, const float y, const float z ) {
+		++calls[ callRotate ];
+		countSample();
+	}
+
+	void ueberManDummyRenderer::scale( const float x, const float y, const float z ) {
+		++calls[ callScale ];
+		countSample();
+	}
+
+	void ueberManDummyRenderer::shaderTreeBegin( shaderHandle& treeid ) {
+		++calls[ callShaderTreeBegin ];
+	}
+
+	void ueberManDummyRenderer::shaderTreeEnd() {
+		++calls[ callShaderTreeEnd ];
+	}
+
+	void ueberManDummyRenderer::shaderTree( const string& treeid ) {
+		++calls[ callShaderTree ];
+	}
+
+	void ueberManDummyRenderer::connectShaders( const shaderHandle& srcId, const string& srcName, const shaderHandle& destId, const string& destName, shaderHandle& nodeid ) {
+		++calls[ callConnectShaders ];
+	}
+
+	void ueberManDummyRenderer::shader( const string &shadertype, const string &shadername, shaderHandle& shaderid ) {
+		++calls[ callShader ];
+	}
+
+	void ueberManDummyRenderer::light( const string &shadername, lightHandle& lightid ) {
+		++calls[ callLight ];
+	}
+
+	void ueberManDummyRenderer::switchLight( const lightHandle &lightid, const bool on ) {
+		++calls[ callSwitchLight ];
+	}
+
+	void ueberManDummyRenderer::beginLook( lookHandle& lookid ) {
+		++calls[ callBeginLook ];
+	}
+
+	void ueberManDummyRenderer::endLook() {
+		++calls[ callEndLook ];
+	}
+
+	void ueberManDummyRenderer::nameLook( lookHandle& lookid ) {
+		++calls[ callNameLook ];
+	}
+
+	void ueberManDummyRenderer::look( const lookHandle& id ) {
+		++calls[ callLook ];
+	}
+
+	void ueberManDummyRenderer::appendLook( const lookHandle& id ) {
+		++calls[ callAppendLook ];
+	}
+
+	void ueberManDummyRenderer::beginObject( objectHandle& instanceid ) {
+		++calls[ callBeginObject ];
+	}
+
+	void ueberManDummyRenderer::endObject() {
+		++calls[ callEndObject ];
+	}
+
+	void ueberManDummyRenderer::loadObject( const objectHandle& instanceid ) {
+		++calls[ callLoadObject ];
+	}
+
+	void ueberManDummyRenderer::points( const string& type, const int numPoints, primitiveHandle& identifier ) {
+		++calls[ callPoints ];
+		countPrimitive( "points" );
+	}
+
+	void ueberManDummyRenderer::curves( const string& interp, const int ncurves, const int nvertspercurve, const bool closed, primitiveHandle &identifier ) {
+		++calls[ callCurves ];
+		countPrimitive( interp + " curves" );
+	}
+
+	void ueberManDummyRenderer::curves( const string& interp, const int ncurves, const vector< int >& nvertspercurve, const bool closed, primitiveHandle &identifier ) {
+		++calls[ callCurves ];
+		countPrimitive( interp + " curves" );
+	}
+
+	void ueberManDummyRenderer::curves( const int numCurves, const vector< int >& numVertsPerCurve, const vector< int >& order, const vector< float >& knot, const vector< float >& min, const vector< float >& max, primitiveHandle& identifier ) {
+		++calls[ callCurves ];
+		countPrimitive( "nurb curves" );
+	}
+
+	void ueberManDummyRenderer::patch( const string& interp, const int nu, const int nv, primitiveHandle &identifier ) {
+		++calls[ callPatch ];
+		countPrimitive( interp + " patch" );
+	}
+
+	void ueberManDummyRenderer::patch(	const int nu, const int uorder, const float *uknot,	const float umin, const float umax,
+										const int nv, const int vorder, const float *vknot,	const float vmin, const float vmax, primitiveHandle &identifier ) {
+		++calls[ callPatch ];
+		countPrimitive( "nurb patch" );
+	}
+
+	void ueberManDummyRenderer::mesh( const string& interp, const int nfaces, const int *nverts, const int *verts, const bool interpolateBoundary, primitiveHandle &identifier ) {
+		++calls[ callMesh ];
+		countPrimitive( "linear" == interp ? "polygon mesh" : "subdivision mesh" );
+	}
+
+	void ueberManDummyRenderer::sphere(	const float radius, const float zmin, const float zmax, const float thetamax, primitiveHandle &identifier ) {
+		++calls[ callSphere ];
+		countPrimitive( "sphere" );
+	}
+
+	void ueberManDummyRenderer::blobby( const int numLeafs, const vector< int >& code, const vector< float >& floatData, const vector< string >& stringData, primitiveHandle& identifier ) {
+		++calls[ callBlobby ];
+		countPrimitive( "blobby" );
+	}
+
+	void ueberManDummyRenderer::makeMap( const string& type ) {
+		++calls[ callMakeMap ];
+	}
+
+	void ueberManDummyRenderer::archiveRecord( const string& type, const string& record ) {
+		++calls[ callArchiveRecord ];
+	}
+
+
+	// Private methods --------------------------------------------------------
+
+
+	void ueberManDummyRenderer::countPrimvar( const tokenValue& aTokenValue ) {
+		int storage = aTokenValue.storage() + 1;
+		if( 0 > storage || numStorageClasses <= storage )
+			storage = 0;
+		++primvars[ storage ];
+		if( aTokenValue.valid() )
+			primvarBytes[ storage ] += aTokenValue.byteSize();
+	}
+
+	bool ueberManDummyRenderer::countSample() {
+		if( !samplesLeft )
+			return true;
+
+		++motionSamples;
+		return blockSamples == samplesLeft--;
+	}
+
+	void ueberManDummyRenderer::countPrimitive( const string& type ) {
+		// Primitives inside a motion block are only counted once
+		if( countSample() )
+			++primitives[ type ];
+	}
+}
@@ -51,7 +51,9 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string.h>
 #include <sys/stat.h>
+#include <vector>
 #ifdef _WIN32
 #include <direct.h>
 #else
@@ -126,6 +128,430 @@ namespace affogato {
 			return false;
 	}
 
+	/* Globals snapshots.
+	 *
+	 * Batch jobs spend a good part of their startup parsing the globals
+	 * XML file & reading every parameter of the globals property. The
+	 * state resulting from either is saved to a binary snapshot in the
+	 * system's temp folder. The next job that sees the same inputs loads
+	 * that instead. The snapshot's file name is a hash of the inputs and
+	 * the globals' state before they were applied. Files the state was
+	 * read from are listed with their content hash and are checked on
+	 * load, so editing the XML (or anything it includes) regenerates the
+	 * snapshot.
+	 *
+	 * Members are written as they are in memory, so a snapshot is only
+	 * valid for the build that wrote it -- the Affogato version is part
+	 * of every key.
+	 */
+	static const string snapshotMagic( "AffogatoGlobalsSnapshot" );
+
+	// XML files read by the current scan(), for the snapshot's dependencies
+	static vector< string > scannedFiles;
+
+	class snapshotWriter {
+		public:
+			template< class T >
+			void	value( const T& v ) {
+						buffer.append( reinterpret_cast< const char* >( &v ), sizeof( T ) );
+					}
+			void	value( const string& s ) {
+						value( ( unsigned long )s.size() );
+						buffer.append( s );
+					}
+			void	value( const filesystem::path& p ) {
+						value( p.string() );
+					}
+			void	value( const vector< float >& v ) {
+						value( ( unsigned long )v.size() );
+						if( !v.empty() )
+							buffer.append( reinterpret_cast< const char* >( &v[ 0 ] ), v.size() * sizeof( float ) );
+					}
+			template< class E >
+			void	enumeration( const E& e ) {
+						value( ( long )e );
+					}
+			bool	reading() const {
+						return false;
+					}
+
+			string	buffer;
+	};
+
+	class snapshotReader {
+		public:
+					snapshotReader( const string& theBuffer ) : buffer( theBuffer ), position( 0 ) {};
+			template< class T >
+			void	value( T& v ) {
+						read( &v, sizeof( T ) );
+					}
+			void	value( string& s ) {
+						unsigned long size;
+						value( size );
+						check( size );
+						s.assign( buffer, position, size );
+						position += size;
+					}
+			void	value( filesystem::path& p ) {
+						string s;
+						value( s );
+						p = filesystem::path( s );
+					}
+			void	value( vector< float >& v ) {
+						unsigned long size;
+						value( size );
+						check( size );
+						v.resize( size );
+						if( size )
+							read( &v[ 0 ], size * sizeof( float ) );
+					}
+			template< class E >
+			void	enumeration( E& e ) {
+						long v;
+						value( v );
+						e = static_cast< E >( v );
+					}
+			bool	reading() const {
+						return true;
+					}
+			bool	atEnd() const {
+						return buffer.size() == position;
+					}
+
+		private:
+			void	check( size_t size ) const {
+						if( buffer.size() - position < size )
+							throw( runtime_error( "Truncated globals snapshot" ) );
+					}
+			void	read( void* data, size_t size ) {
+						check( size );
+						memcpy( data, buffer.data() + position, size );
+						position += size;
+					}
+
+			const string& buffer;
+			size_t	position;
+	};
+
+	static string snapshotFile( const string& key ) {
+		const string dir( privateDirectory() );
+		if( dir.empty() )
+			return string();
+		return dir + "/affogatoGlobals." + key + ".snapshot";
+	}
+
+	static string fileHash( const string& file ) {
+		ifstream in( file.c_str(), ios::binary );
+		if( !in )
+			return string();
+		ostringstream content;
+		content << in.rdbuf();
+		contentHash hash;
+		hash.add( content.str() );
+		return hash.str();
+	}
+
+	template< class archive >
+	void globals::transfer( archive& ar ) {
+		ar.value( initialized );
+
+		ar.value( camera.cameraName );
+		ar.value( camera.depthOfField );
+		ar.value( camera.hypeOverscan );
+		ar.value( camera.fieldOfView );
+		ar.value( camera.fStop );
+		ar.value( camera.focalDistance );
+		ar.value( camera.nearClip );
+		ar.value( camera.farClip );
+		ar.value( camera.aspect );
+		ar.value( camera.useAspect );
+		ar.value( camera.frontPlane );
+		ar.value( camera.backPlane );
+		ar.value( camera.freezeScale );
+		ar.enumeration( camera.rotoViewStyle );
+
+		ar.value( resolution.x );
+		ar.value( resolution.y );
+		ar.value( resolution.pixelAspect );
+		ar.value( resolution.multiplier );
+
+		ar.value( animation.time );
+		ar.value( animation.times );
+
+		ar.value( motionBlur.deformMotionSamples );
+		ar.value( motionBlur.transformMotionSamples );
+		ar.value( motionBlur.geometryBlur );
+		ar.value( motionBlur.geometryParameterBlur );
+		ar.value( motionBlur.geometryVariableBlur );
+		ar.value( motionBlur.velocityBlur );
+		ar.value( motionBlur.cameraBlur );
+		ar.value( motionBlur.lightBlur );
+		ar.value( motionBlur.attributeBlur );
+		ar.value( motionBlur.shaderBlur );
+		ar.value( motionBlur.shadowMapBlur );
+		ar.value( motionBlur.subFrame );
+		ar.value( motionBlur.shutterOpen );
+		ar.value( motionBlur.shutterClose );
+		ar.value( motionBlur.shutterEfficiency );
+		ar.enumeration( motionBlur.shutterConfiguration );
+		ar.value( motionBlur.shutterOffset );
+		ar.enumeration( motionBlur.sampleReduction );
+		ar.value( motionBlur.sampleReductionEpsilon );
+
+		ar.value( name.baseName );
+		ar.value( name.blockName );
+		ar.value( name.currentFrame );
+
+		ar.value( directories.affogatoHome );
+		ar.value( directories.base );
+		ar.value( directories.image );
+		ar.value( directories.map );
+		ar.value( directories.data );
+		ar.value( directories.object );
+		ar.value( directories.attribute );
+		ar.value( directories.temp );
+		ar.value( directories.hub );
+		ar.value( directories.cache );
+		ar.value( directories.relativePaths );
+		ar.value( directories.createMissing );
+		ar.value( directories.caching.dataWrite );
+		ar.value( directories.caching.dataSource );
+		ar.value( directories.caching.dataCopy );
+		ar.value( directories.caching.mapWrite );
+		ar.value( directories.caching.mapSource );
+		ar.value( directories.caching.mapCopy );
+		ar.value( directories.caching.imageWrite );
+		ar.value( directories.caching.imageCopy );
+		ar.value( directories.caching.size );
+
+		ar.value( searchPath.shader );
+		ar.value( searchPath.texture );
+		ar.value( searchPath.archive );
+		ar.value( searchPath.procedural );
+		ar.value( searchPath.shaderPaths );
+
+		ar.value( sampling.x );
+		ar.value( sampling.y );
+
+		ar.value( shading.rate );
+		ar.value( shading.smooth );
+		ar.value( shading.hair );
+		ar.value( shading.shadowRate );
+
+		ar.value( filtering.x );
+		ar.value( filtering.y );
+		ar.value( filtering.filter );
+
+		ar.value( image.displayDriver );
+		ar.enumeration( image.displayQuantization );
+		ar.value( image.associateAlpha );
+		ar.value( image.gain );
+		ar.value( image.gamma );
+
+		ar.value( reyes.bucketSize.x );
+		ar.value( reyes.bucketSize.y );
+		ar.value( reyes.gridSize );
+		ar.value( reyes.textureMemory );
+		ar.value( reyes.bucketorder );
+		ar.value( reyes.jitter );
+		ar.value( reyes.sampleMotion );
+		ar.value( reyes.opacityThreshold );
+		ar.value( reyes.motionFactor );
+		ar.value( reyes.focusFactor );
+		ar.value( reyes.extremeMotionDepthOfField );
+		ar.value( reyes.eyeSplits );
+
+		ar.value( rays.enable );
+		ar.value( rays.trace.depth );
+		ar.value( rays.trace.bias );
+		ar.value( rays.trace.motion );
+		ar.value( rays.trace.displacements );
+		ar.value( rays.irradiance.samples );
+		ar.value( rays.irradiance.shadingRate );
+		ar.value( rays.subSurface.rate );
+
+		ar.enumeration( feedback.verbosity );
+		ar.enumeration( feedback.previewDisplay );
+		ar.value( feedback.stopWatch );
+		ar.enumeration( feedback.statistics );
+		ar.value( feedback.xmlDebug );
+
+		ar.value( defaultShader.surface );
+		ar.value( defaultShader.displacement );
+		ar.value( defaultShader.volume );
+		ar.value( defaultShader.overrideAll );
+
+		ar.value( baking.bake );
+
+		ar.value( geometry.normalizeNurbKnotVector );
+		ar.value( geometry.nonRationalNurbSurface );
+		ar.value( geometry.nonRationalNurbCurve );
+		ar.value( geometry.defaultNurbCurveWidth );
+
+		ar.value( renderer.version );
+		ar.value( renderer.command );
+
+		ar.enumeration( jobGlobal.launch );
+		ar.value( jobGlobal.launchSub );
+		ar.enumeration( jobGlobal.jobScript.type );
+		ar.value( jobGlobal.jobScript.interpreter );
+		ar.value( jobGlobal.jobScript.chunkSize );
+		ar.value( jobGlobal.preJobCommand );
+		ar.value( jobGlobal.preFrameCommand );
+		ar.value( jobGlobal.postFrameCommand );
+		ar.value( jobGlobal.postJobCommand );
+		ar.value( jobGlobal.numCPUs );
+		ar.value( jobGlobal.hosts );
+		ar.value( jobGlobal.useRemoteSSH );
+		ar.enumeration( jobGlobal.cache );
+		ar.value( jobGlobal.cacheDir );
+		ar.value( jobGlobal.cacheSize );
+
+		ar.value( data.directToRenderer );
+		ar.enumeration( data.granularity );
+		ar.enumeration( data.attributeDataType );
+		ar.value( data.subSectionParentTransforms );
+		ar.value( data.relativeTransforms );
+		ar.value( data.frame );
+		ar.value( data.sections.options );
+		ar.value( data.sections.camera );
+		ar.value( data.sections.world );
+		ar.value( data.sections.spaces );
+		ar.value( data.sections.lights );
+		ar.value( data.sections.looks );
+		ar.value( data.sections.geometry );
+		ar.value( data.sections.attributes );
+		ar.value( data.sections.shaderParameters );
+		ar.value( data.sections.shaderNumericParameters );
+		ar.value( data.shadow.shadow );
+		ar.enumeration( data.shadow.granularity );
+		ar.value( data.binary );
+		ar.value( data.compress );
+		ar.value( data.nativeWriter );
+		ar.value( data.delay );
+		ar.value( data.meshChunkSize );
+		ar.value( data.collapsePrimvars );
+		ar.value( data.commandStream );
+		ar.value( data.quantize.textureCoordinates );
+		ar.value( data.quantize.colors );
+		ar.value( data.quantize.widths );
+		ar.value( data.quantize.points );
+		ar.value( data.doHub );
+		ar.value( data.worldBlockName );
+		ar.value( data.hierarchical );
+		ar.enumeration( data.attributeScanningOrder );
+		ar.enumeration( data.attributeMode );
+
+		ar.value( writeAttributeTypes );
+
+		ar.value( system.tempDir );
+
+		ar.value( time.doAnimation );
+		ar.enumeration( time.frameOutput );
+		ar.value( time.sequence );
+		ar.value( time.startFrame );
+		ar.value( time.endFrame );
+		ar.value( time.frameStep );
+		ar.value( time.timeIndex );
+
+		unsigned long numPasses( ( unsigned long )passPtrArray.size() );
+		ar.value( numPasses );
+		if( ar.reading() ) {
+			passPtrArray.clear();
+			for( unsigned long i = 0; i < numPasses; i++ )
+				passPtrArray.push_back( shared_ptr< pass >( new pass() ) );
+		}
+		for( vector< shared_ptr< pass > >::iterator it = passPtrArray.begin(); it < passPtrArray.end(); it++ )
+			( *it )->transfer( ar );
+
+		// blobbyGroupsMap is only filled during an export
+	}
+
+	string globals::snapshotKey( const string& inputs ) {
+		snapshotWriter state;
+		transfer( state );
+
+		contentHash hash;
+		hash.add( AFFOGATOVERSION );
+		hash.add( state.buffer );
+		hash.add( inputs );
+		return hash.str();
+	}
+
+	bool globals::loadSnapshot( const string& key ) {
+		const string fileName( snapshotFile( key ) );
+		if( fileName.empty() || !isPrivateFile( fileName ) )
+			return false;
+
+		ifstream in( fileName.c_str(), ios::binary );
+		if( !in )
+			return false;
+
+		// Read the whole snapshot with one call and decode it from memory
+		in.seekg( 0, ios::end );
+		string buffer( ( size_t )in.tellg(), '\0' );
+		in.seekg( 0, ios::beg );
+		if( buffer.empty() || !in.read( &buffer[ 0 ], ( streamsize )buffer.size() ) )
+			return false;
+
+		try {
+			snapshotReader ar( buffer );
+
+			string magic, version, storedKey;
+			ar.value( magic );
+			ar.value( version );
+			ar.value( storedKey );
+			if( ( snapshotMagic != magic ) || ( AFFOGATOVERSION != version ) || ( key != storedKey ) )
+				return false;
+
+			unsigned long numDependencies;
+			ar.value( numDependencies );
+			for( unsigned long i = 0; i < numDependencies; i++ ) {
+				string file, hash;
+				ar.value( file );
+				ar.value( hash );
+				if( fileHash( file ) != hash ) {
+					debugMessage( stringToCString( "Globals snapshot '" + fileName + "' is out of date ('" + file + "' changed)" ) );
+					return false;
+				}
+			}
+
+			// Decode into a copy so a broken snapshot leaves us untouched
+			globals snapshot( *this );
+			snapshot.transfer( ar );
+			if( !ar.atEnd() )
+				throw( runtime_error( "Trailing data in globals snapshot" ) );
+			*this = snapshot;
+		} catch( runtime_error ) {
+			message( stringToCString( "Globals snapshot '" + fileName + "' is ill-formed and will be regenerated." ), messageWarning );
+			return false;
+		}
+
+		debugMessage( stringToCString( "Loaded globals snapshot '" + fileName + "'" ) );
+		return true;
+	}
+
+	void globals::saveSnapshot( const string& key, const vector< string >& dependencies ) {
+		snapshotWriter ar;
+		ar.value( snapshotMagic );
+		ar.value( string( AFFOGATOVERSION ) );
+		ar.value( key );
+		ar.value( ( unsigned long )dependencies.size() );
+		for( vector< string >::const_iterator it = dependencies.begin(); it < dependencies.end(); it++ ) {
+			ar.value( *it );
+			ar.value( fileHash( *it ) );
+		}
+		transfer( ar );
+
+		// Concurrent jobs never load a partially written snapshot. If
+		// another job is using or replacing it, theirs will do.
+		const string fileName( snapshotFile( key ) );
+		if( fileName.empty() )
+			return;
+		if( writePrivateFile( fileName, ar.buffer ) )
+			debugMessage( stringToCString( "Saved globals snapshot '" + fileName + "'" ) );
+	}
+
 	globals::globals( const string &xmlFile ) {
 		set( xmlFile );
 	}
@@ -145,6 +571,8 @@ namespace affogato {
 		else
 			throw( runtime_error( "File: '" + xmlFile + "' does not exist" ) );
 
+		scannedFiles.push_back( filesystem::complete( filesystem::path( xmlFile ) ).string() );
+
 		debugMessage( L"Start Scanning");
 
 		string tempString;
@@ -597,7 +1025,18 @@ namespace affogato {
 
 		g.passPtrArray.clear();
 
-		scan( xmlFile );
+		// Batch jobs reuse the state a previous job scanned from the same
+		// file(s)
+		string key;
+		if( !app.IsInteractive() )
+			key = g.snapshotKey( filesystem::complete( filesystem::path( xmlFile ) ).string() );
+
+		if( key.empty() || !g.loadSnapshot( key ) ) {
+			scannedFiles.clear();
+			scan( xmlFile );
+			if( !key.empty() )
+				g.saveSnapshot( key, scannedFiles );
+		}
 
 		sanitize();
 	}
@@ -640,6 +1079,34 @@ namespace affogato {
 			message( stringToCString( "Globals where created with a different Affogato version (" + version + ")" ), messageWarning );
 		}
 
+		// Batch jobs reuse the state a previous job aquired from the same
+		// parameter values. Walking the parameters once is a lot cheaper
+		// than looking up each by name & converting it.
+		Application app;
+		string key;
+		if( !app.IsInteractive() ) {
+			contentHash inputs;
+			CParameterRefArray params( affogatoGlobals.GetParameters() );
+			for( unsigned i = 0; i < ( unsigned )params.GetCount(); i++ ) {
+				Parameter param( params[ i ] );
+				inputs.add( CStringToString( param.GetScriptName() ) );
+				inputs.add( CStringToString( param.GetValue().GetAsText() ) );
+			}
+			key = g.snapshotKey( inputs.str() );
+			if( g.loadSnapshot( key ) )
+				return;
+		}
+
+		g.aquireParameters( affogatoGlobals );
+
+		if( !key.empty() )
+			g.saveSnapshot( key, vector< string >() );
+	}
+
+	void globals::aquireParameters( const Property &affogatoGlobals ) {
+
+		globals& g( const_cast< globals& >( access() ) );
+
 		// Camera
 		g.camera.cameraName					= CStringToString( affogatoGlobals.GetParameterValue( L"CameraName" ) );
 		g.camera.depthOfField				= ( bool )affogatoGlobals.GetParameterValue( L"DepthOfField" );
@@ -705,10 +1172,13 @@ namespace affogato {
 
 		g.motionBlur.transformMotionSamples = ( unsigned long )affogatoGlobals.GetParameterValue( L"TransformationMotionSegments" ) + 1;
 		g.motionBlur.deformMotionSamples	= ( unsigned long )affogatoGlobals.GetParameterValue( L"DeformationMotionSegments" ) + 1;
+		g.motionBlur.sampleReduction		= static_cast< motionBlur::sampleReductionType >( ( unsigned long )affogatoGlobals.GetParameterValue( L"MotionSampleReduction", CValue::siUInt1 ) );
+		g.motionBlur.sampleReductionEpsilon	= ( float )affogatoGlobals.GetParameterValue( L"MotionSampleEpsilon" );
 
 		g.motionBlur.geometryBlur			= ( bool )affogatoGlobals.GetParameterValue( L"GeometryMotionBlur" );
 		g.motionBlur.geometryParameterBlur	= ( bool )affogatoGlobals.GetParameterValue( L"GeometryParameterMotionBlur" );
 		g.motionBlur.geometryVariableBlur	= ( bool )affogatoGlobals.GetParameterValue( L"GeometryVariableMotionBlur" );
+		g.motionBlur.velocityBlur			= ( bool )affogatoGlobals.GetParameterValue( L"VelocityMotionBlur" );
 		g.motionBlur.cameraBlur				= ( bool )affogatoGlobals.GetParameterValue( L"CameraMotionBlur" );
 		g.motionBlur.lightBlur				= ( bool )affogatoGlobals.GetParameterValue( L"LightMotionBlur" );
 		g.motionBlur.attributeBlur			= ( bool )affogatoGlobals.GetParameterValue( L"AttributeMotionBlur" );
@@ -850,7 +1320,15 @@ namespace affogato {
 		g.data.relativeTransforms			= ( bool )affogatoGlobals.GetParameterValue( L"RelativeTransforms" );
 		g.data.binary						= ( bool )affogatoGlobals.GetParameterValue( L"WriteBinaryData" );
 		g.data.compress						= ( bool )affogatoGlobals.GetParameterValue( L"CompressData" );
+		g.data.nativeWriter					= ( bool )affogatoGlobals.GetParameterValue( L"NativeRIBWriter" );
 		g.data.delay						= ( bool )affogatoGlobals.GetParameterValue( L"DelayData" );
+		g.data.meshChunkSize				= ( unsigned long )affogatoGlobals.GetParameterValue( L"MeshChunkSize" );
+		g.data.collapsePrimvars				= ( bool )affogatoGlobals.GetParameterValue( L"CollapsePrimvars" );
+		g.data.commandStream				= ( bool )affogatoGlobals.GetParameterValue( L"CommandStream" );
+		g.data.quantize.textureCoordinates	= ( float )affogatoGlobals.GetParameterValue( L"QuantizeTextureCoordinates" );
+		g.data.quantize.colors				= ( float )affogatoGlobals.GetParameterValue( L"QuantizeColors" );
+		g.data.quantize.widths				= ( float )affogatoGlobals.GetParameterValue( L"QuantizeWidths" );
+		g.data.quantize.points				= ( float )affogatoGlobals.GetParameterValue( L"QuantizePoints" );
 		g.data.doHub						= ( bool )affogatoGlobals.GetParameterValue( L"HubSupport" );
 		g.data.sections.options				= ( bool )affogatoGlobals.GetParameterValue( L"OptionsData" );
 		g.data.sections.camera				= ( bool )affogatoGlobals.GetParameterValue( L"CameraData" );
@@ -864,12 +1342,15 @@ namespace affogato {
 		g.data.sections.shaderNumericParameters	= ( bool )affogatoGlobals.GetParameterValue( L"ShaderNumericParameterData" );
 		g.data.hierarchical					= ( bool )affogatoGlobals.GetParameterValue( L"HierarchicalDataScanning" );
 		g.data.attributeScanningOrder		= static_cast< data::scanningOrderType >( ( unsigned long )affogatoGlobals.GetParameterValue( L"AttributeDataScanningOrder" ) );
+		g.data.attributeMode				= static_cast< data::attributeModeType >( ( unsigned long )affogatoGlobals.GetParameterValue( L"AttributeMode" ) );
 
 		g.data.shadow.shadow				= ( bool )affogatoGlobals.GetParameterValue( L"ShadowData" );
 
 		g.feedback.previewDisplay			= static_cast< feedback::previewDisplayType >( ( unsigned long )affogatoGlobals.GetParameterValue( L"PreviewDisplay" ) );
 		g.feedback.verbosity				= static_cast< feedback::verbosityType >( ( unsigned long )affogatoGlobals.GetParameterValue( L"VerbosityLevel" ) );
 		g.feedback.stopWatch				= ( bool )affogatoGlobals.GetParameterValue( L"Stopwatch" );
+		g.feedback.statistics				= static_cast< feedback::statisticsType >( ( unsigned long )affogatoGlobals.GetParameterValue( L"RendererStatistics" ) );
+		g.feedback.xmlDebug					= ( bool )affogatoGlobals.GetParameterValue( L"XMLDebugOutput" );
 
 		g.defaultShader.surface				= CStringToString( affogatoGlobals.GetParameterValue( L"DefaultSurfaceShader" ) );
 		g.defaultShader.displacement		= CStringToString( affogatoGlobals.GetParameterValue( L"DefaultDisplacementShader" ) );
@@ -60,6 +60,7 @@
 // Affogato headers
 #include "affogatoGlobals.hpp"
 #include "affogatoHairData.hpp"
+#include "affogatoPropertyIndex.hpp"
 #include "affogatoRenderer.hpp"
 #include "affogatoTokenValue.hpp"
 #include "affogatoHelpers.hpp"
@@ -115,23 +116,13 @@ namespace affogato {
 		double startTime = floor( theTime );
 		numHairs = ( long )( numHairs * ( ( double )hairPrim.GetParameterValue( L"RenderPercentage", startTime ) / 100.0 ) );
 
-		CRefArray affogatoProps( getAffogatoProperties( hairPrim.GetParent() ) );
-		for( int i = 0; i < affogatoProps.GetCount(); i++ ) {
-			Property prop( affogatoProps[ i ] );
-
-			CParameterRefArray params( prop.GetParameters() );
-
-			for( int p = 0; p < params.GetCount(); p++ ) {
-				Parameter param( params[ p ] );
-				string paramName = CStringToString( param.GetName() );
-				if( "hairpercentage" == paramName ) {
-					numHairs = ( numHairs * 10 * ( long )param.GetValue( startTime ) + 5 ) / 1000;
-				} else
-				if( "hairwidthscale" == paramName ) {
-					widthScale = ( float )param.GetValue( atTime );
-				}
-			}
-		}
+		const propertyIndex& index( propertyIndex::access( hairPrim.GetParent() ) );
+		const Parameter *hairPercentage( index.findParameter( "hairpercentage" ) );
+		if( hairPercentage )
+			numHairs = ( numHairs * 10 * ( long )hairPercentage->GetValue( startTime ) + 5 ) / 1000;
+		const Parameter *hairWidthScale( index.findParameter( "hairwidthscale" ) );
+		if( hairWidthScale )
+			widthScale = ( float )hairWidthScale->GetValue( atTime );
 
 		Application app;
 		message( L"Aquiring " + CValue( numHairs ).GetAsText() + L" hairs" + ( numHairs < 3333 ? L"" : L" -- remember that patience is a virtue..." ), messageInfo );
@@ -202,8 +193,6 @@ namespace affogato {
 		using namespace ueberMan;
 		ueberManInterface theRenderer;
 
-		message( L"Writing Chunks!", messageInfo );
-
 		tokenValuePtrArray.clear();
 
 		bool finished = false;
@@ -408,10 +397,12 @@ namespace affogato {
 		radVals.Clear();
 
 		debugMessage( L"Pushing hair widths" );
+		tokenValue::tokenValuePtr widthValues( new tokenValue( widths, widthsize, "width", tokenValue::storageVarying, tokenValue::typeFloat ) );
+		quantizePrimvar( *widthValues, globals::access().data.quantize );
 		if( caching ) {
-			tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( widths, widthsize, "width", tokenValue::storageVarying, tokenValue::typeFloat ) ) );
+			tokenValuePtrArray.push_back( widthValues );
 		} else {
-			theRenderer.parameter( tokenValue( widths, widthsize, "width", tokenValue::storageVarying, tokenValue::typeFloat ) );
+			theRenderer.parameter( *widthValues );
 			widths.reset();
 		}
 
@@ -441,10 +432,12 @@ namespace affogato {
 
 				debugMessage( L"Pushing" );
 
+				tokenValue::tokenValuePtr uvValues( new tokenValue( uvs, ncurves * 2, setname + "[2]", tokenValue::storageUniform, tokenValue::typeFloat ) );
+				quantizePrimvar( *uvValues, globals::access().data.quantize );
 				if( caching )
-					tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( uvs, ncurves * 2, setname + "[2]", tokenValue::storageUniform, tokenValue::typeFloat ) ) );
+					tokenValuePtrArray.push_back( uvValues );
 				else
-					theRenderer.parameter( tokenValue( uvs, ncurves * 2, setname + "[2]", tokenValue::storageUniform, tokenValue::typeFloat ) );
+					theRenderer.parameter( *uvValues );
 
 				debugMessage( L"Done Pushing" );
 			}
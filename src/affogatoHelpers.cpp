@@ -39,11 +39,20 @@
 
 // Standard headers
 #include <fstream>
+#include <map>
 #include <math.h>
 #include <memory>
 #include <string>
 #include <sstream>
+#include <stdio.h>
+#include <sys/stat.h>
 #include <wchar.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 
 // Boost headers
 #include <boost/format.hpp>
@@ -53,6 +62,12 @@
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/filesystem/exception.hpp>
 #include <boost/filesystem/operations.hpp>
+#ifndef _WIN32
+	#include <boost/bind.hpp>
+	#include <boost/thread/condition.hpp>
+	#include <boost/thread/mutex.hpp>
+	#include <boost/thread/thread.hpp>
+#endif
 
 // XSI headers
 #ifdef __XSI_PLUGIN
@@ -67,6 +82,7 @@
 #include "affogato.hpp"
 #include "affogatoGlobals.hpp"
 #include "affogatoHelpers.hpp"
+#include "affogatoPropertyIndex.hpp"
 #include "affogatoTokenValue.hpp"
 
 
@@ -79,10 +95,9 @@ namespace affogato {
 	using namespace XSI;
 
 	bool isVisible( const X3DObject& obj ) {
-		CRefArray props( obj.GetProperties() );
-		props.Filter( L"visibility", CStringArray(), CString(), props );
+		Property visibility( propertyIndex::access( obj ).findType( L"visibility" ) );
 
-		return ( bool )Property( props[ 0 ] ).GetParameterValue( L"rendvis", const_cast< globals& >( globals::access() ).animation.time );
+		return ( bool )visibility.GetParameterValue( L"rendvis", const_cast< globals& >( globals::access() ).animation.time );
 	}
 
 	/** Returns a frame sequence from a string object.
@@ -171,6 +186,50 @@ namespace affogato {
 		return sampletimes;
 	}
 
+	static inline bool withinEpsilon( float a, float b, float epsilon ) {
+		return fabs( a - b ) <= epsilon * max( 1.0f, ( float )fabs( a ) );
+	}
+
+	vector< unsigned > reduceMotionSamples( const vector< vector< float > >& samples, const vector< float >& times, float epsilon, bool linear ) {
+		vector< unsigned > keep;
+		if( samples.empty() )
+			return keep;
+
+		const unsigned last( samples.size() - 1 );
+		const vector< float >& first( samples[ 0 ] );
+		for( unsigned s( 1 ); s <= last; s++ ) {
+			if( samples[ s ].size() != first.size() ) {
+				// Topology changes -- we can't drop anything
+				for( unsigned i( 0 ); i <= last; i++ )
+					keep.push_back( i );
+				return keep;
+			}
+		}
+
+		bool isStatic( true ), isLinear( linear && ( 1 < last ) && ( times[ last ] != times[ 0 ] ) );
+		for( unsigned s( 1 ); ( isStatic || isLinear ) && ( s <= last ); s++ ) {
+			const vector< float >& sample( samples[ s ] );
+			const float t( isLinear ? ( times[ s ] - times[ 0 ] ) / ( times[ last ] - times[ 0 ] ) : 0 );
+			for( unsigned i( 0 ); ( isStatic || isLinear ) && ( i < first.size() ); i++ ) {
+				if( isStatic && !withinEpsilon( first[ i ], sample[ i ], epsilon ) )
+					isStatic = false;
+				if( isLinear && !withinEpsilon( first[ i ] + t * ( samples[ last ][ i ] - first[ i ] ), sample[ i ], epsilon ) )
+					isLinear = false;
+			}
+		}
+
+		keep.push_back( 0 );
+		if( !isStatic ) {
+			if( isLinear ) {
+				keep.push_back( last );
+			} else {
+				for( unsigned i( 1 ); i <= last; i++ )
+					keep.push_back( i );
+			}
+		}
+		return keep;
+	}
+
 	bool CStringToChar( const CString &theString, char *dest ) {
 		const wchar_t* buffer( theString.GetWideString() );
 		wcstombs( dest, buffer, theString.Length() + 1 );
@@ -220,77 +279,200 @@ namespace affogato {
 	}
 
 
-	void debugMessage( const CString &msg ) {
 #ifndef _WIN32
-		FILE *f( fopen( "/tmp/affogato.log", "a" ) );
-		fprintf( f, "  #DEBUG: %s\n", CStringToString( msg ).c_str() );
-		fflush( f );
-		fclose( f );
-//#else
-//		FILE *f( fopen( "c:\tmp\affogato.log", "a" ) );
-//		fprintf( f, "  #DEBUG: %s\n", CStringToString( msg ).c_str() );
-//		fflush( f );
-//		fclose( f );
+	/** Appends lines to /tmp/affogato.log from a background thread.
+	 *
+	 *  Callers only move their line into a fixed ring of slots; the
+	 *  thread keeps the file open and writes out everything that has
+	 *  piled up in one go. If the ring is full, callers wait for the
+	 *  thread instead of dropping lines.
+	 *  Synchronous lines are written by the caller, after everything
+	 *  queued before them, so they are on disk should we crash next.
+	 */
+	class logSink {
+		public:
+			static logSink& access() {
+				// Never destroyed; the thread may be waiting on it at exit
+				static logSink *theSink( new logSink );
+				return *theSink;
+			}
+
+			void write( const string& prefix, const string& line, bool synchronous = false ) {
+				boost::mutex::scoped_lock lock( ringMutex );
+
+				if( synchronous || stopped ) {
+					vector< string > batch;
+					takeRing( batch );
+					batch.push_back( prefix + line );
+					// The thread may still be writing what it took before us
+					boost::mutex::scoped_lock fileLock( fileMutex );
+					lock.unlock();
+					writeBatch( batch );
+					return;
+				}
+
+				while( size == ringSize )
+					notFull.wait( lock );
+				string& slot( ring[ ( first + size ) % ringSize ] );
+				slot = prefix;
+				slot += line;
+				++size;
+				notEmpty.notify_one();
+			}
+
+			/** Writes out all queued lines and stops the thread, which must
+			 *  not outlive the plugin's code. Lines after this are written
+			 *  synchronously.
+			 */
+			void stop() {
+				{
+					boost::mutex::scoped_lock lock( ringMutex );
+					if( stopped )
+						return;
+					stopped = true;
+					notEmpty.notify_one();
+				}
+				theThread->join();
+				theThread.reset();
+			}
+
+		private:
+			enum { ringSize = 1024 };
+
+			logSink() : first( 0 ), size( 0 ), stopped( false ), logFile( fopen( "/tmp/affogato.log", "a" ) ) {
+				theThread = boost::shared_ptr< boost::thread >( new boost::thread( boost::bind( &logSink::run, this ) ) );
+			}
+
+			void run() {
+				vector< string > batch;
+				for( ;; ) {
+					boost::mutex::scoped_lock lock( ringMutex );
+					while( !size && !stopped )
+						notEmpty.wait( lock );
+					if( !size ) // Stopped & all written
+						return;
+					takeRing( batch );
+					boost::mutex::scoped_lock fileLock( fileMutex );
+					lock.unlock();
+					writeBatch( batch );
+				}
+			}
+
+			// Needs ringMutex
+			void takeRing( vector< string >& batch ) {
+				batch.resize( size );
+				for( unsigned i( 0 ); i < batch.size(); i++ )
+					batch[ i ].swap( ring[ ( first + i ) % ringSize ] );
+				first = ( first + size ) % ringSize;
+				size = 0;
+				notFull.notify_all();
+			}
+
+			// Needs fileMutex
+			void writeBatch( const vector< string >& batch ) {
+				if( logFile ) {
+					for( vector< string >::const_iterator it( batch.begin() ); it < batch.end(); it++ )
+						fprintf( logFile, "%s\n", it->c_str() );
+					fflush( logFile );
+				}
+			}
+
+			string ring[ ringSize ];
+			unsigned first;
+			unsigned size;
+			bool stopped;
+			FILE *logFile;
+			boost::mutex ringMutex;
+			boost::mutex fileMutex; // Keeps batches in order; taken while holding ringMutex
+			boost::condition notEmpty;
+			boost::condition notFull;
+			boost::shared_ptr< boost::thread > theThread;
+	};
+#endif
+
+
+	void flushLog() {
+#ifndef _WIN32
+		logSink::access().stop();
+#endif
+	}
+
+
+	bool messageEnabled( messageType level ) {
+		if( messageForce == level )
+			return true;
+#ifdef DEBUG
+		// Everything goes to the log file in debug builds
+		return true;
+#else
+		const globals::feedback::verbosityType verbosity( globals::access().feedback.verbosity );
+		switch( level ) {
+			case messageInfo:
+				return globals::feedback::verbosityAll <= verbosity;
+			case messageWarning:
+				return globals::feedback::verbosityWarningsAndErrors <= verbosity;
+			case messageError:
+				return globals::feedback::verbosityErrors <= verbosity;
+			default:
+				return false;
+		}
+#endif
+	}
+
+
+	void logDebugMessage( const CString &msg ) {
+#ifndef _WIN32
+		logSink::access().write( "  #DEBUG: ", CStringToString( msg ) );
 #endif
 		Application app;
 		app.LogMessage( msg, siVerboseMsg );
 	}
 
 
-	void message( const CString &msg, messageType level ) {
+	void logMessage( const CString &msg, messageType level ) {
 #ifdef DEBUG
 #ifndef _WIN32
-		//extern ofstream debugStream;
-		FILE *f;
-		f = fopen( "/tmp/affogato.log", "a" );
-
 		switch( level ) {
 			case messageInfo:
-				//debugStream << "   #INFO: ";
-				fprintf( f, "   #INFO: %s\n", CStringToString( msg ).c_str() );
+				logSink::access().write( "   #INFO: ", CStringToString( msg ) );
 				break;
 			case messageWarning:
-				//debugStream << "#WARNING: ";
-				fprintf( f, "#WARNING: %s\n", CStringToString( msg ).c_str() );
+				logSink::access().write( "#WARNING: ", CStringToString( msg ) );
 				break;
 			case messageError:
-				//debugStream << "! #ERROR: ";
-				fprintf( f, "! #ERROR: %s\n", CStringToString( msg ).c_str() );
+				logSink::access().write( "! #ERROR: ", CStringToString( msg ), true );
 				break;
 			case messageForce:
-				//debugStream << " #FORCED: ";
-				fprintf( f, " #FORCED: %s\n", CStringToString( msg ).c_str() );
+				logSink::access().write( " #FORCED: ", CStringToString( msg ), true );
 				break;
 			case messageDebug:
 			default:
-				//debugStream << "  #DEBUG: ";
-				fprintf( f, "  #DEBUG: %s\n", CStringToString( msg ).c_str() );
+				logSink::access().write( "  #DEBUG: ", CStringToString( msg ) );
 		}
-		fflush( f );
-		fclose( f );
-		//debugStream << CStringToString( msg ) << endl;
-		//debugStream.flush();
 #endif
 #endif
 
 		const globals& g( globals::access() );
 		static Application app;
 
-		CString message( CString( L"Affogato: " ) + msg );
+		CString text( CString( L"Affogato: " ) + msg );
 
 		if( messageForce == level ) {
-			app.LogMessage( message );
+			app.LogMessage( text );
 		} else {
 			switch( g.feedback.verbosity ) {
+				case globals::feedback::verbosityDebug:
 				case globals::feedback::verbosityAll:
 					if( messageInfo == level )
-						app.LogMessage( message, siInfoMsg );
+						app.LogMessage( text, siInfoMsg );
 				case globals::feedback::verbosityWarningsAndErrors:
 					if( messageWarning == level )
-						app.LogMessage( message, siWarningMsg );
+						app.LogMessage( text, siWarningMsg );
 				case globals::feedback::verbosityErrors:
 					if( messageError == level )
-						app.LogMessage( message, siErrorMsg );
+						app.LogMessage( text, siErrorMsg );
+				default:
+					break;
 			}
 		}
 	}
@@ -410,11 +592,7 @@ namespace affogato {
 		return success;
 	}
 
-	/** Parses a string and substitutes global- & environment variables.
-	 */
-	string parseString( const string &inputString, int frameNumber ) {
-
-		const globals& g( globals::access() );
+	pathTemplate::pathTemplate( const string &inputString ) {
 
 		size_t start( inputString.find_first_not_of( " \t\n\r" ) );
 		if( string::npos == start )
@@ -425,58 +603,32 @@ namespace affogato {
 
 		end -= start - 1;
 
-		string trimmedInputString = inputString.substr( start, end );
+		const string trimmedInputString( inputString.substr( start, end ) );
+		const unsigned sLength( trimmedInputString.length() );
 
-		string constructedString;
-		string tokenString;
-		bool inToken( false );
-		int sLength( trimmedInputString.length() );
-
-		int frame;
-		if( frameNumber == -9999999 ) {
-			frame = ( int )floor( g.animation.time );
-		} else {
-			frame = frameNumber;
-		}
+		string literal;
 
 		for( unsigned i = 0; i < sLength; i++ ) {
 			bool escaped( i ? trimmedInputString[ i - 1 ] == '\\' : false );
 			if( trimmedInputString[ i ] == '$' ) {
-				tokenString.clear();
-				inToken = true;
-			} else if ( inToken ) {
-				tokenString += trimmedInputString[ i ];
-				if ( tokenString == "F" ) {
-					constructedString += frame;
-					inToken = false;
-					tokenString.clear();
+				if( !trimmedInputString.compare( i + 1, 4, "PDIR" ) ) {
+					addSegment( segmentBaseDir, literal );
+					i += 4;
 				} else
-				/*if( tokenString == "SCN" ) {
-					constructedString += liqglo_sceneName;
-					inToken = false;
-					tokenString.clear();
+				if( !trimmedInputString.compare( i + 1, 4, "DDIR" ) || !trimmedInputString.compare( i + 1, 4, "RDIR" ) ) {
+					addSegment( segmentDataDir, literal );
+					i += 4;
 				} else
-				if( tokenString == "IMG" ) {
-					constructedString += liqglo_DDimageName[0];
-					inToken = false;
-					tokenString.clear();
-				} else */
-				if( tokenString == "PDIR" ) {
-					constructedString += g.directories.base.string();
-					inToken = false;
-					tokenString.clear();
+				if( !trimmedInputString.compare( i + 1, 1, "F" ) ) {
+					addSegment( segmentFrame, literal );
+					i++;
 				} else
-				if( ( tokenString == "DDIR" ) || ( tokenString == "RDIR" ) ) {
-					constructedString += g.directories.data.string();
-					inToken = false;
-					tokenString.clear();
-				}
-				else {
-					constructedString += '$';
-					constructedString += tokenString;
-					tokenString.clear();
-					inToken = false;
+				if( ( i + 1 < sLength ) && ( trimmedInputString[ i + 1 ] != '$' ) ) {
+					// Unknown variable: keep it, including the character following the '$'
+					literal += '$';
+					literal += trimmedInputString[ ++i ];
 				}
+				// A '$' followed by another one or at the end is dropped
 			} else if( !escaped && ( trimmedInputString[ i ] == '#' ) ) {
 				int paddingSize( 0 );
 				while( i < sLength && trimmedInputString[ i ] == '#' ) {
@@ -490,13 +642,9 @@ namespace affogato {
 				if( paddingSize > 20 ) {
 					paddingSize = 20;
 				}
-				char paddedFrame[ 21 ];
-
-				sprintf( paddedFrame, "%0*ld", paddingSize, frame );
-				constructedString += paddedFrame;
+				addSegment( segmentPadding, literal, string(), paddingSize );
 			} else if( !escaped && ( trimmedInputString[ i ] == '%' ) ) {
 				string	envString;
-				char*	envVal = NULL;
 
 				i++;
 				// loop through the string looking for the closing %
@@ -506,22 +654,88 @@ namespace affogato {
 						i++;
 					}
 
-					constructedString += getEnvironment( envString );
-					// else environment variable doesn't exist.. do nothing
+					addSegment( segmentEnvironment, literal, envString );
 				}
 			// else early exit: % was the last character in the string.. do nothing
 			} else if( escaped && ( trimmedInputString[ i ] == 'n' ) ) {
-				constructedString += "\n";
+				literal += "\n";
 				i++;
 			} else if( escaped && ( trimmedInputString[ i ] == 't' ) ) {
-				constructedString += "\t";
+				literal += "\t";
 				i++;
 			} else {
-				constructedString += trimmedInputString[ i ];
+				literal += trimmedInputString[ i ];
+			}
+		}
+
+		if( !literal.empty() )
+			addSegment( segmentLiteral, literal );
+	}
+
+	void pathTemplate::addSegment( segmentType type, string& literal, const string& text, int padding ) {
+		if( !literal.empty() && ( segmentLiteral != type ) ) {
+			segment lit = { segmentLiteral, literal, 0 };
+			segments.push_back( lit );
+		}
+		segment seg = { type, ( segmentLiteral == type ) ? literal : text, padding };
+		segments.push_back( seg );
+		literal.clear();
+	}
+
+	const string& pathTemplate::render( int frameNumber ) const {
+		const globals& g( globals::access() );
+
+		int frame;
+		if( frameNumber == -9999999 ) {
+			frame = ( int )floor( g.animation.time );
+		} else {
+			frame = frameNumber;
+		}
+
+		buffer.clear();
+		for( vector< segment >::const_iterator it = segments.begin(); it < segments.end(); it++ ) {
+			switch( it->type ) {
+				case segmentLiteral:
+					buffer += it->text;
+					break;
+				case segmentFrame: {
+					char frameStr[ 32 ];
+					sprintf( frameStr, "%d", frame );
+					buffer += frameStr;
+					break;
+				}
+				case segmentPadding: {
+					char paddedFrame[ 32 ];
+					sprintf( paddedFrame, "%0*d", it->padding, frame );
+					buffer += paddedFrame;
+					break;
+				}
+				case segmentBaseDir:
+					buffer += g.directories.base.string();
+					break;
+				case segmentDataDir:
+					buffer += g.directories.data.string();
+					break;
+				case segmentEnvironment:
+					buffer += getEnvironment( it->text );
+					break;
 			}
 		}
+		return buffer;
+	}
 
-		return constructedString;
+	/** Parses a string and substitutes global- & environment variables:
+	 *  $F (frame), $PDIR (base directory), $DDIR & $RDIR (data
+	 *  directory), #s (frame padded to four or as many digits as there
+	 *  are #s) and %NAME% (environment variable). '\n' & '\t' are
+	 *  replaced by newline & tab.
+	 *
+	 *  Compiles the string every time. Code that expands the same
+	 *  string over and over should keep a pathTemplate instead (see
+	 *  propertyIndex::parameterEntry::expand() for parameter values).
+	 */
+	string parseString( const string &inputString, int frameNumber ) {
+		return pathTemplate( inputString ).render( frameNumber );
 	}
 
 	string checkEnvironmentForFile( string envName, string fileName ) {
@@ -727,6 +941,107 @@ namespace affogato {
 		return ret;
 	}
 
+	string privateDirectory() {
+#ifndef _WIN32
+		const string home( getEnvironment( "HOME" ) );
+		if( home.empty() )
+			return string();
+		const string dir( home + "/.affogato" );
+		mkdir( dir.c_str(), 0700 );
+		struct stat st;
+		if( stat( dir.c_str(), &st ) || !S_ISDIR( st.st_mode ) || ( st.st_uid != geteuid() ) || ( st.st_mode & ( S_IWGRP | S_IWOTH ) ) )
+			return string();
+		return dir;
+#else
+		string profile( getEnvironment( "LOCALAPPDATA" ) );
+		if( profile.empty() ) {
+			profile = getEnvironment( "APPDATA" );
+			if( profile.empty() )
+				return string();
+		}
+		const string dir( profile + "/Affogato" );
+		_mkdir( dir.c_str() );
+		struct _stat st;
+		if( _stat( dir.c_str(), &st ) || !( st.st_mode & _S_IFDIR ) )
+			return string();
+		return dir;
+#endif
+	}
+
+	bool isPrivateFile( const string& fileName ) {
+#ifndef _WIN32
+		struct stat st;
+		return !stat( fileName.c_str(), &st ) && S_ISREG( st.st_mode ) && ( st.st_uid == geteuid() ) && !( st.st_mode & ( S_IWGRP | S_IWOTH ) );
+#else
+		// The per user application data directory is protected by its ACL
+		struct _stat st;
+		return !_stat( fileName.c_str(), &st ) && ( st.st_mode & _S_IFREG );
+#endif
+	}
+
+	bool writePrivateFile( const string& fileName, const string& content ) {
+		ostringstream tempName;
+#ifdef _WIN32
+		tempName << fileName << "." << _getpid();
+#else
+		tempName << fileName << "." << getpid();
+#endif
+		{
+			ofstream out( tempName.str().c_str(), ios::binary | ios::trunc );
+			out.write( content.data(), ( streamsize )content.size() );
+			if( !out ) {
+				out.close();
+				remove( tempName.str().c_str() );
+				return false;
+			}
+		}
+#ifndef _WIN32
+		// Independent of the umask, or isPrivateFile() won't trust it
+		chmod( tempName.str().c_str(), 0600 );
+#endif
+
+		try {
+			if( filesystem::exists( fileName ) )
+				filesystem::remove( fileName );
+			filesystem::rename( tempName.str(), fileName );
+		} catch( filesystem::filesystem_error ) {
+			try {
+				filesystem::remove( tempName.str() );
+			} catch( filesystem::filesystem_error ) {
+			}
+			return false;
+		}
+		return true;
+	}
+
+
+	contentHash::contentHash()
+	:	fnv( 2166136261u ),
+		djb( 5381u )
+	{}
+
+	void contentHash::add( const void* data, size_t size ) {
+		const unsigned char *bytes( ( const unsigned char* )data );
+		for( size_t i = 0; i < size; i++ ) {
+			fnv = ( fnv ^ bytes[ i ] ) * 16777619u;
+			djb = djb * 33u + bytes[ i ];
+		}
+	}
+
+	void contentHash::add( const string& data ) {
+		add( data.c_str(), data.length() + 1 ); // With the terminator, so "ab" + "c" != "a" + "bc"
+	}
+
+	void contentHash::add( float data ) {
+		add( &data, sizeof( float ) );
+	}
+
+	string contentHash::str() const {
+		char s[ 17 ];
+		sprintf( s, "%08x%08x", fnv, djb );
+		return string( s );
+	}
+
 
 	Property updateGlobals( const Property& prop ) {
 		map< string, CValue > paramsMap;
@@ -55,9 +55,12 @@
 #include <xsi_material.h>
 #include <xsi_model.h>
 #include <xsi_parameter.h>
+#include <xsi_point.h>
+#include <xsi_primitive.h>
 #include <xsi_shader.h>
 #include <xsi_string.h>
 #include <xsi_value.h>
+#include <xsi_vector3.h>
 #include <xsi_x3dobject.h>
 
 // Affohato headers
@@ -72,13 +75,11 @@
 #include "affogatoNurbMeshData.hpp"
 #include "affogatoParticleData.hpp"
 #include "affogatoPolyMeshData.hpp"
+#include "affogatoPropertyIndex.hpp"
 #include "affogatoRenderer.hpp"
 #include "affogatoShader.hpp"
 
 
-// RenderMan headers
-#include <ri.h> // For RiArchiveRecord() :(
-
 namespace affogato {
 
 	using namespace XSI;
@@ -87,9 +88,91 @@ namespace affogato {
 	using namespace boost;
 
 	context node::lookContext;
+	map< string, string > node::lookSignatures;
+
+	/** Samples the point positions of a primitive at a given time.
+	 *  Returns an empty vector for primitives whose deformation can't be
+	 *  judged from their points alone (hair, particles, spheres).
+	 */
+	static vector< float > getPointPositions( const Primitive& prim, siClassID primID, double atTime ) {
+		vector< float > positions;
+		switch( primID ) {
+			case siPolygonMeshID:
+			case siNurbsSurfaceMeshID:
+			case siNurbsCurveListID: {
+				CVector3Array points( Geometry( prim.GetGeometry( atTime ) ).GetPoints().GetPositionArray() );
+				positions.reserve( 3 * points.GetCount() );
+				for( long i( 0 ); i < points.GetCount(); i++ ) {
+					positions.push_back( ( float )points[ i ].GetX() );
+					positions.push_back( ( float )points[ i ].GetY() );
+					positions.push_back( ( float )points[ i ].GetZ() );
+				}
+				break;
+			}
+		}
+		return positions;
+	}
 
 	void node::setLookContext( const context& ctx ) {
 		lookContext = ctx;
+		lookSignatures.clear();
+	}
+
+	static void appendSignature( string& signature, const string& part ) {
+		const size_t size( part.size() );
+		signature.append( ( const char* )&size, sizeof( size ) );
+		signature += part;
+	}
+
+	void node::shareLook() {
+		// Exact form of everything writeAttributes() would put inline.
+		// attributeMap is sorted by name already. Each part is prefixed
+		// with its length, so the parts can't run into each other.
+		string signature;
+		for( map< string, tokenValue::tokenValuePtr >::const_iterator it = attributeMap.begin(); it != attributeMap.end(); it++ )
+			appendSignature( signature, it->first + '\0' + it->second->signature() );
+		appendSignature( signature, surface ? surface->signature() : string() );
+		appendSignature( signature, displacement ? displacement->signature() : string() );
+		appendSignature( signature, volume ? volume->signature() : string() );
+
+		contentHash hash;
+		hash.add( signature );
+		objectLook = "__state" + hash.str();
+
+		ueberManInterface theRenderer;
+
+		const set< string >& looks( theRenderer.getLooks() );
+		if( looks.end() != looks.find( objectLook ) ) {
+			// Only share a look we know was written from the same state,
+			// otherwise two states that happen to hash alike would mix
+			map< string, string >::const_iterator known( lookSignatures.find( objectLook ) );
+			if( ( lookSignatures.end() == known ) || ( known->second != signature ) )
+				objectLook.clear();
+		} else {
+			lookSignatures[ objectLook ] = signature;
+
+			context savedContext( theRenderer.currentScene() );
+			theRenderer.switchScene( lookContext );
+
+			lookHandle lookId( objectLook );
+			theRenderer.beginLook( lookId );
+
+			for( map< string, tokenValue::tokenValuePtr >::const_iterator it = attributeMap.begin(); it != attributeMap.end(); it++ )
+				theRenderer.attribute( *( it->second ) );
+
+			if( surface )
+				surface->write();
+
+			if( displacement )
+				displacement->write();
+
+			if( volume )
+				volume->write();
+
+			theRenderer.endLook();
+
+			theRenderer.switchScene( savedContext );
+		}
 	}
 
 	void node::scanForAttributes( const Property& prop, map< string, tokenValue::tokenValuePtr >& attribMap, shared_ptr< shader >& surface, shared_ptr< shader >& displacement, shared_ptr< shader >& volume ) {
@@ -119,15 +202,14 @@ namespace affogato {
 			}
 		} else {
 
-			CParameterRefArray params = prop.GetParameters();
+			const propertyIndex::parameterVector& params( propertyIndex::parameters( prop ) );
 
-			for( unsigned p( 0 ); p < ( unsigned )params.GetCount(); p++ ) {
-				Parameter param( params[ p ] );
-				string paramName( CStringToString( param.GetName() ) );
+			for( propertyIndex::parameterVector::const_iterator it( params.begin() ); it < params.end(); it++ ) {
+				Parameter param( it->parameter );
+				string paramName( it->name );
 
-				string userParamName( paramName );
+				string userParamName( it->originalName );
 				replace_first( paramName, string( "_" ), string( ":" ) );
-				to_lower( paramName );
 
 				debugMessage( L"Scanning for special parameters" );
 
@@ -190,7 +272,7 @@ namespace affogato {
 						param = prop.GetParameter( L"archive" );
 						if( param.GetValue( g.animation.time ).m_t == CValue::siString ) {
 							string value = CStringToString( param.GetValue( g.animation.time ) );
-							value = parseString( value );
+							value = it->expand( value );
 							if( !value.empty() ) {
 #ifdef RSP
 								if( value.substr( value.length() - 4, 4 ) == ".hub" )
@@ -204,8 +286,7 @@ namespace affogato {
 					}
 				} else
 				if( "databox" == paramName ) {
-					databox = CStringToString( param.GetValue( g.animation.time ) ) + "\n";
-					databox = parseString( databox );
+					databox = it->expand( CStringToString( param.GetValue( g.animation.time ) ) + "\n" );
 				} else
 				if( "preftime" == paramName ) {
 					if( !usePref ) {
@@ -220,9 +301,25 @@ namespace affogato {
 						staticFrame = ( long )param.GetValue( g.animation.time );
 					}
 				} else
+				if( "quantize:st" == paramName ) {
+					if( quantize.textureCoordinates == g.data.quantize.textureCoordinates )
+						quantize.textureCoordinates = ( float )param.GetValue( g.animation.time );
+				} else
+				if( "quantize:color" == paramName ) {
+					if( quantize.colors == g.data.quantize.colors )
+						quantize.colors = ( float )param.GetValue( g.animation.time );
+				} else
+				if( "quantize:width" == paramName ) {
+					if( quantize.widths == g.data.quantize.widths )
+						quantize.widths = ( float )param.GetValue( g.animation.time );
+				} else
+				if( "quantize:p" == paramName ) {
+					if( quantize.points == g.data.quantize.points )
+						quantize.points = ( float )param.GetValue( g.animation.time );
+				} else
 				if( "grouping:membership" == paramName ) {
 
-					groupName += ',' + getAffogatoName( parseString ( CStringToString( param.GetValue( g.animation.time ) ) ) );
+					groupName += ',' + getAffogatoName( it->expand( CStringToString( param.GetValue( g.animation.time ) ) ) );
 				}
 				else {
 					debugMessage( L"Found other parameter " + stringToCString( userParamName ) );
@@ -274,7 +371,7 @@ namespace affogato {
 							case CValue::siWStr:
 								debugMessage( L"Adding: string " + stringToCString( userParamName ) );
 								replace_first( userParamName, string( "_" ), string( ":" ) );
-								attribMap[ userParamName ] = tokenValue::tokenValuePtr( new tokenValue( parseString( CStringToString( value ) ), userParamName ) );
+								attribMap[ userParamName ] = tokenValue::tokenValuePtr( new tokenValue( it->expand( CStringToString( value ) ), userParamName ) );
 								break;
 							// Todo: Array support!!!
 						}
@@ -326,6 +423,7 @@ namespace affogato {
 
 		transformMotionSamples = g.motionBlur.transformMotionSamples;
 		deformMotionSamples = g.motionBlur.deformMotionSamples;
+		quantize = g.data.quantize;
 
 		if( g.data.sections.attributes ) {
 
@@ -334,18 +432,17 @@ namespace affogato {
 
 			do {
 				scanObj = test;
-				CRefArray props( scanObj.GetProperties() );
+				const propertyIndex& index( propertyIndex::access( scanObj ) );
+				const CRefArray& props( index.properties() );
 				// Collect all looks. Each look lists all (affogato) properties that make up this look
 
 				for( int i = 0; i < props.GetCount(); i++ ) {
 					Property prop( props[ i ] );
 
-					if( isAffogatoProperty( prop ) || ( !g.defaultShader.overrideAll && shader::isShader( prop ) ) ) {
-						CRefArray owners( prop.GetOwners() );
-						CRefArray groups;
-						owners.Filter( siGroup, CStringArray(), CString(), groups );
-						if( groups.GetCount() )
-							lookVectorMap[ getAffogatoName( CStringToString( Group( groups[ 0 ] ).GetFullName() ) ) ].push_back( shared_ptr< Property >( new Property( prop ) ) );
+					if( index.isAffogato( i ) || ( !g.defaultShader.overrideAll && shader::isShader( prop ) ) ) {
+						const string& group( propertyIndex::group( prop ) );
+						if( !group.empty() )
+							lookVectorMap[ group ].push_back( shared_ptr< Property >( new Property( prop ) ) );
 						else // This is not on a group
 							scanForAttributes( prop, attributeMap, surface, volume, displacement );
 					} else {
@@ -410,7 +507,7 @@ namespace affogato {
 			if( g.data.sections.looks ) {
 				ueberManInterface theRenderer;
 
-				set< string > looks( theRenderer.getLooks() );
+				const set< string >& looks( theRenderer.getLooks() );
 				for( map< string, vector< shared_ptr< Property > > >::iterator it = lookVectorMap.begin(); it != lookVectorMap.end(); it++ ) {
 					debugMessage( L"Group: " + stringToCString( it->first ) );
 
@@ -424,8 +521,8 @@ namespace affogato {
 						for( vector< shared_ptr< Property > >::iterator vit = it->second.begin(); vit != it->second.end(); vit++ ) {
 							scanForAttributes( **vit, lookAttributeMap, lookSurface, lookDisplacement, lookVolume );
 
-							if( !databox.empty() ) // Add ueberMan callback for this!!!
-								RiArchiveRecord( RI_VERBATIM, const_cast< RtString >( databox.c_str() ) );
+							if( !databox.empty() )
+								theRenderer.archiveRecord( "verbatim", databox );
 						}
 
 						lookAttributeMap[ "grouping:membership" ] = tokenValue::tokenValuePtr( new tokenValue( groupName, "grouping:membership" ) );
@@ -478,6 +575,9 @@ namespace affogato {
 						theRenderer.switchScene( savedContext );
 					}
 				}
+
+				if( g.data.sections.attributes && ( globals::data::attributeModeLook == g.data.attributeMode ) )
+					shareLook();
 			}
 		}
 
@@ -491,6 +591,33 @@ namespace affogato {
 				for( unsigned short motion = 0; motion < transformMotionSamples; motion++ ) {
 					transformSamples.push_back( shared_ptr< CMatrix4 >( new CMatrix4( obj.GetKinematics().GetGlobal().GetTransform( transformSampleTimes[ motion ] ).GetMatrix4() ) ) );
 				}
+
+				if( ( globals::motionBlur::sampleReductionOff != g.motionBlur.sampleReduction ) && ( 1 < transformSamples.size() ) ) {
+					vector< vector< float > > matrices;
+					vector< vector< float > > rotations;
+					for( vector< shared_ptr< CMatrix4 > >::const_iterator it( transformSamples.begin() ); it < transformSamples.end(); it++ ) {
+						matrices.push_back( CMatrix4ToFloat( *( *it ) ) );
+						rotations.push_back( vector< float >( matrices.back().begin(), matrices.back().begin() + 12 ) );
+					}
+					// Renderers don't interpolate matrices linearly, so we only drop
+					// inbetween samples if the upper 3x3 part doesn't change at all
+					bool linear( globals::motionBlur::sampleReductionLinear == g.motionBlur.sampleReduction );
+					if( linear )
+						linear = ( 1 == reduceMotionSamples( rotations, transformSampleTimes, g.motionBlur.sampleReductionEpsilon, false ).size() );
+
+					vector< unsigned > keep( reduceMotionSamples( matrices, transformSampleTimes, g.motionBlur.sampleReductionEpsilon, linear ) );
+					if( keep.size() < transformSamples.size() ) {
+						vector< shared_ptr< CMatrix4 > > keptSamples;
+						vector< float > keptTimes;
+						for( vector< unsigned >::const_iterator it( keep.begin() ); it < keep.end(); it++ ) {
+							keptSamples.push_back( transformSamples[ *it ] );
+							keptTimes.push_back( transformSampleTimes[ *it ] );
+						}
+						transformSamples.swap( keptSamples );
+						transformSampleTimes.swap( keptTimes );
+						transformMotionSamples = transformSamples.size();
+					}
+				}
 			} else {
 				transformSamples.push_back( shared_ptr< CMatrix4 >( new CMatrix4( obj.GetKinematics().GetGlobal().GetTransform( g.animation.time ).GetMatrix4() ) ) );
 			}
@@ -525,6 +652,48 @@ namespace affogato {
 
 				if( g.motionBlur.geometryBlur ) {
 					deformSampleTimes = getMotionSamples( deformMotionSamples );
+
+					const bool reduceSamples( ( globals::motionBlur::sampleReductionOff != g.motionBlur.sampleReduction ) && ( 1 < deformMotionSamples ) );
+					// With motion blurred primitive variables, the points don't tell
+					// whether a sample can be dropped
+					const bool blurredPrimvars( g.motionBlur.geometryParameterBlur || g.motionBlur.geometryVariableBlur );
+					const bool velocitySamples( g.motionBlur.velocityBlur && ( siPolygonMeshID == primID ) );
+
+					if( reduceSamples && !blurredPrimvars && !velocitySamples ) {
+						// Compare the points before doing the (expensive) full geometry export for each sample
+						vector< vector< float > > positions;
+						for( unsigned short motion = 0; motion < deformMotionSamples; motion++ )
+							positions.push_back( getPointPositions( prim, primID, deformSampleTimes[ motion ] ) );
+
+						if( !positions[ 0 ].empty() ) {
+							vector< unsigned > keep( reduceMotionSamples( positions, deformSampleTimes, g.motionBlur.sampleReductionEpsilon,
+								globals::motionBlur::sampleReductionLinear == g.motionBlur.sampleReduction ) );
+							vector< float > keptTimes;
+							for( vector< unsigned >::const_iterator it( keep.begin() ); it < keep.end(); it++ )
+								keptTimes.push_back( deformSampleTimes[ *it ] );
+							deformSampleTimes.swap( keptTimes );
+							deformMotionSamples = deformSampleTimes.size();
+						}
+					}
+
+					if( velocitySamples && ( 1 < deformMotionSamples ) ) {
+						// Evaluate the mesh once, derive the velocity from the points at the last
+						// sample and extrapolate the closing sample from it. This matches the
+						// points at both ends of the shutter; motion inbetween becomes linear.
+						// Sample reduction doesn't apply as only two samples are left anyway.
+						shared_ptr< polyMeshData > openSample( new polyMeshData( prim, deformSampleTimes[ 0 ], usePref, prefTime, deformSampleTimes.back() - deformSampleTimes[ 0 ] ) );
+						shared_ptr< polyMeshData > closeSample( openSample->extrapolate( deformSampleTimes.back() - deformSampleTimes[ 0 ] ) );
+						geometrySamples.push_back( openSample );
+						if( closeSample ) {
+							geometrySamples.push_back( closeSample );
+							deformSampleTimes[ 1 ] = deformSampleTimes.back();
+							deformSampleTimes.resize( 2 );
+						} else {
+							deformSampleTimes.resize( 1 );
+						}
+						deformMotionSamples = deformSampleTimes.size();
+						type = nodeMesh;
+					} else
 					for( unsigned short motion = 0; motion < deformMotionSamples; motion++ ) {
 						switch( primID ) {
 							case siPolygonMeshID:
@@ -560,6 +729,39 @@ namespace affogato {
 								break;
 						}
 					}
+
+					if( reduceSamples && blurredPrimvars && !velocitySamples && ( geometrySamples.size() == deformSampleTimes.size() )
+						&& ( ( nodeMesh == type ) || ( nodeNurb == type ) || ( nodeCurves == type ) ) ) {
+						// Compare the fully exported samples. Only the primitive variables that are motion
+						// blurred are in all of them, the rest is only written with the current sample.
+						vector< map< string, vector< float > > > samplesValues;
+						for( unsigned i( 0 ); i < geometrySamples.size(); i++ )
+							samplesValues.push_back( geometrySamples[ i ]->motionValues() );
+						vector< vector< float > > values( geometrySamples.size() );
+						for( map< string, vector< float > >::const_iterator it = samplesValues[ 0 ].begin(); it != samplesValues[ 0 ].end(); it++ ) {
+							bool inAllSamples( true );
+							for( unsigned i( 1 ); inAllSamples && ( i < samplesValues.size() ); i++ )
+								inAllSamples = ( samplesValues[ i ].end() != samplesValues[ i ].find( it->first ) );
+							if( inAllSamples ) {
+								for( unsigned i( 0 ); i < samplesValues.size(); i++ ) {
+									const vector< float >& sampleValues( samplesValues[ i ][ it->first ] );
+									values[ i ].insert( values[ i ].end(), sampleValues.begin(), sampleValues.end() );
+								}
+							}
+						}
+
+						vector< unsigned > keep( reduceMotionSamples( values, deformSampleTimes, g.motionBlur.sampleReductionEpsilon,
+							globals::motionBlur::sampleReductionLinear == g.motionBlur.sampleReduction ) );
+						vector< shared_ptr< data > > keptSamples;
+						vector< float > keptTimes;
+						for( vector< unsigned >::const_iterator it( keep.begin() ); it < keep.end(); it++ ) {
+							keptSamples.push_back( geometrySamples[ *it ] );
+							keptTimes.push_back( deformSampleTimes[ *it ] );
+						}
+						geometrySamples.swap( keptSamples );
+						deformSampleTimes.swap( keptTimes );
+						deformMotionSamples = deformSampleTimes.size();
+					}
 				} else {
 					switch( primID ) {
 						case siPolygonMeshID:
@@ -588,6 +790,24 @@ namespace affogato {
 							break;
 					}
 				}
+
+				// All samples of a mesh must be split into the same chunks. These are
+				// only built for the first one. If the topology changes over the shutter,
+				// every sample gets written in one piece.
+				if( nodeMesh == type ) {
+					polyMeshData& firstSample( *static_pointer_cast< polyMeshData >( geometrySamples[ 0 ] ) );
+					firstSample.split();
+					bool sameChunks( true );
+					for( unsigned i( 1 ); sameChunks && ( i < geometrySamples.size() ); i++ )
+						sameChunks = static_pointer_cast< polyMeshData >( geometrySamples[ i ] )->shareGrains( firstSample );
+					if( !sameChunks ) {
+						for( unsigned i( 0 ); i < geometrySamples.size(); i++ )
+							static_pointer_cast< polyMeshData >( geometrySamples[ i ] )->unsplit();
+					}
+				}
+
+				for( vector< shared_ptr< data > >::iterator it( geometrySamples.begin() ); it < geometrySamples.end(); it++ )
+					( *it )->quantizePrimvars( quantize );
 			} else {
 				if( siNullID == primID )
 					type = nodeNull;
@@ -644,23 +864,27 @@ namespace affogato {
 
 						switch( g.data.attributeScanningOrder ) {
 							case globals::data::scanningOrderGroups: {
-								for( map< string, tokenValue::tokenValuePtr >::const_iterator it = attributeMap.begin();it != attributeMap.end(); it++ )
-									theRenderer.attribute( *( it->second ) );
+								if( !objectLook.empty() ) {
+									theRenderer.appendLook( objectLook );
+								} else {
+									for( map< string, tokenValue::tokenValuePtr >::const_iterator it = attributeMap.begin();it != attributeMap.end(); it++ )
+										theRenderer.attribute( *( it->second ) );
 
-								if( surface )
-									surface->write();
+									if( surface )
+										surface->write();
 
-								if( displacement )
-									displacement->write();
+									if( displacement )
+										displacement->write();
 
-								if( volume )
-									volume->write();
+									if( volume )
+										volume->write();
+								}
 
 								for( map< string, vector< shared_ptr< Property > > >::const_iterator it = lookVectorMap.begin(); it != lookVectorMap.end(); it++ )
 									theRenderer.appendLook( it->first );
 
-								if( !databox.empty() ) // Add ueberMan callback for this!!!
-									RiArchiveRecord( RI_VERBATIM, const_cast< RtString >( databox.c_str() ) );
+								if( !databox.empty() )
+									theRenderer.archiveRecord( "verbatim", databox );
 
 								break;
 							}
@@ -668,20 +892,24 @@ namespace affogato {
 								for( map< string, vector< shared_ptr< Property > > >::const_iterator it = lookVectorMap.begin(); it != lookVectorMap.end(); it++ )
 									theRenderer.appendLook( it->first );
 
-								for( map< string, tokenValue::tokenValuePtr >::const_iterator it = attributeMap.begin();it != attributeMap.end(); it++ )
-									theRenderer.attribute( *( it->second ) );
+								if( !objectLook.empty() ) {
+									theRenderer.appendLook( objectLook );
+								} else {
+									for( map< string, tokenValue::tokenValuePtr >::const_iterator it = attributeMap.begin();it != attributeMap.end(); it++ )
+										theRenderer.attribute( *( it->second ) );
 
-								if( surface )
-									surface->write();
+									if( surface )
+										surface->write();
 
-								if( displacement )
-									displacement->write();
+									if( displacement )
+										displacement->write();
 
-								if( volume )
-									volume->write();
+									if( volume )
+										volume->write();
+								}
 
-								if( !databox.empty() ) // Add ueberMan callback for this!!!
-									RiArchiveRecord( RI_VERBATIM, const_cast< RtString >( databox.c_str() ) );
+								if( !databox.empty() )
+									theRenderer.archiveRecord( "verbatim", databox );
 
 								break;
 							}
@@ -803,6 +1031,8 @@ namespace affogato {
 					if( !geometrySamples.empty() ) {
 						debugMessage( L"Writing real geo" );
 						if( 1 < geometrySamples.size() ) {
+							for( vector< shared_ptr< data > >::const_iterator it( geometrySamples.begin() ); it < geometrySamples.end(); it++ )
+								( *it )->startGrain();
 							// Iterate over all grains
 							for( unsigned i( 0 ); i < geometrySamples[ 0 ]->granularity(); i++ ) {
 								theRenderer.motion( remapMotionSamples( deformSampleTimes ) );
@@ -0,0 +1,238 @@
+/** Locale independent number formatting for the text based renderers.
+ *
+ *  formatFloat() tries increasing precisions until the printed value
+ *  converts back to the original float. Nine significant digits are
+ *  always enough for single precision so the loop is bounded.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+// Standard headers
+#include <cmath>
+#include <string>
+
+// Affogato headers
+#include "affogatoNumberFormat.hpp"
+
+
+namespace affogato {
+
+	using namespace std;
+
+	// Powers of ten up to 1e22 are exact in double precision
+	static const double powersOfTen[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	static inline double powerOfTen( int exponent ) {
+		if( 0 <= exponent && 22 >= exponent )
+			return powersOfTen[ exponent ];
+		return pow( 10.0, exponent );
+	}
+
+	size_t formatInt( int value, char *dest ) {
+		char tmp[ numberFormatSize ];
+		size_t len = 0;
+
+		unsigned int u = ( 0 > value ) ? 0u - ( unsigned int )value : ( unsigned int )value;
+		do {
+			tmp[ len++ ] = ( char )( '0' + u % 10 );
+			u /= 10;
+		} while( u );
+
+		size_t pos = 0;
+		if( 0 > value )
+			dest[ pos++ ] = '-';
+		while( len )
+			dest[ pos++ ] = tmp[ --len ];
+		return pos;
+	}
+
+	size_t formatFloat( float value, char *dest ) {
+		size_t pos = 0;
+
+		if( value != value ) {
+			dest[ 0 ] = 'n'; dest[ 1 ] = 'a'; dest[ 2 ] = 'n';
+			return 3;
+		}
+
+		if( 0 > value || ( 0 == value && 0 > 1.0f / value ) ) {
+			dest[ pos++ ] = '-';
+			value = -value;
+		}
+
+		if( 0 == value ) {
+			dest[ pos++ ] = '0';
+			return pos;
+		}
+
+		if( value > 3.402823466e+38f ) {
+			dest[ pos++ ] = 'i'; dest[ pos++ ] = 'n'; dest[ pos++ ] = 'f';
+			return pos;
+		}
+
+		// Integers that fit a float mantissa exactly are the common case
+		if( 16777216.0f > value && ( float )( int )value == value )
+			return pos + formatInt( ( int )value, dest + pos );
+
+		const double d = value;
+		const int decade = ( int )floor( log10( d ) );
+
+		// Find the shortest digit string that reads back as value
+		unsigned long digits = 0;
+		int exponent = decade;
+		int precision;
+		for( precision = 1; precision <= 9; precision++ ) {
+			// A carry from a previous attempt must not leak into this one
+			exponent = decade;
+			int shift = precision - 1 - exponent;
+			double scaled = 0 <= shift ? d * powerOfTen( shift ) : d / powerOfTen( -shift );
+			digits = ( unsigned long )floor( scaled + 0.5 );
+			if( digits >= ( unsigned long )powerOfTen( precision ) ) {
+				// Rounding carried over into the next decade
+				digits /= 10;
+				++exponent;
+				--shift;
+			}
+			double back = 0 <= shift ? digits / powerOfTen( shift ) : digits * powerOfTen( -shift );
+			if( ( float )back == value )
+				break;
+		}
+		if( 9 < precision )
+			precision = 9;
+
+		// Strip trailing zeros
+		char mantissa[ 16 ];
+		int numDigits = 0;
+		{
+			char tmp[ 16 ];
+			int len = 0;
+			do {
+				tmp[ len++ ] = ( char )( '0' + digits % 10 );
+				digits /= 10;
+			} while( digits );
+			while( len < precision )
+				tmp[ len++ ] = '0';
+			int first = 0;
+			while( first < len - 1 && '0' == tmp[ first ] )
+				++first;
+			for( int i = len - 1; i >= first; i-- )
+				mantissa[ numDigits++ ] = tmp[ i ];
+		}
+
+		if( -5 <= exponent && 9 > exponent ) {
+			// Plain notation
+			if( 0 > exponent ) {
+				dest[ pos++ ] = '0';
+				dest[ pos++ ] = '.';
+				for( int i = -1; i > exponent; i-- )
+					dest[ pos++ ] = '0';
+				for( int i = 0; i < numDigits; i++ )
+					dest[ pos++ ] = mantissa[ i ];
+			} else {
+				for( int i = 0; i <= exponent; i++ )
+					dest[ pos++ ] = i < numDigits ? mantissa[ i ] : '0';
+				if( numDigits > exponent + 1 ) {
+					dest[ pos++ ] = '.';
+					for( int i = exponent + 1; i < numDigits; i++ )
+						dest[ pos++ ] = mantissa[ i ];
+				}
+			}
+		} else {
+			// Scientific notation
+			dest[ pos++ ] = mantissa[ 0 ];
+			if( 1 < numDigits ) {
+				dest[ pos++ ] = '.';
+				for( int i = 1; i < numDigits; i++ )
+					dest[ pos++ ] = mantissa[ i ];
+			}
+			dest[ pos++ ] = 'e';
+			pos += formatInt( exponent, dest + pos );
+		}
+
+		return pos;
+	}
+
+	void formatFloats( const float *values, size_t size, string& dest ) {
+		char tmp[ numberFormatSize ];
+		dest.reserve( dest.size() + size * 10 );
+		for( size_t i = 0; i < size; i++ ) {
+			if( i )
+				dest += ' ';
+			dest.append( tmp, formatFloat( values[ i ], tmp ) );
+		}
+	}
+
+	void formatInts( const int *values, size_t size, string& dest ) {
+		char tmp[ numberFormatSize ];
+		dest.reserve( dest.size() + size * 6 );
+		for( size_t i = 0; i < size; i++ ) {
+			if( i )
+				dest += ' ';
+			dest.append( tmp, formatInt( values[ i ], tmp ) );
+		}
+	}
+
+	void encodeBase64( const void *data, size_t numBytes, string& dest ) {
+		static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+		const unsigned char *in = ( const unsigned char* )data;
+		size_t start = dest.size();
+		dest.resize( start + ( ( numBytes + 2 ) / 3 ) * 4 );
+		char *out = &dest[ start ];
+
+		size_t i = 0;
+		for( ; i + 2 < numBytes; i += 3 ) {
+			unsigned int triple = ( in[ i ] << 16 ) | ( in[ i + 1 ] << 8 ) | in[ i + 2 ];
+			*out++ = alphabet[ ( triple >> 18 ) & 0x3f ];
+			*out++ = alphabet[ ( triple >> 12 ) & 0x3f ];
+			*out++ = alphabet[ ( triple >> 6  ) & 0x3f ];
+			*out++ = alphabet[   triple         & 0x3f ];
+		}
+
+		if( i < numBytes ) {
+			unsigned int triple = in[ i ] << 16;
+			if( i + 1 < numBytes )
+				triple |= in[ i + 1 ] << 8;
+			*out++ = alphabet[ ( triple >> 18 ) & 0x3f ];
+			*out++ = alphabet[ ( triple >> 12 ) & 0x3f ];
+			*out++ = ( i + 1 < numBytes ) ? alphabet[ ( triple >> 6 ) & 0x3f ] : '=';
+			*out++ = '=';
+		}
+	}
+}
@@ -61,6 +61,7 @@
 #include "affogatoGlobals.hpp"
 #include "affogatoNurbCurveData.hpp"
 #include "affogatoHelpers.hpp"
+#include "affogatoPropertyIndex.hpp"
 #include "affogatoRenderer.hpp"
 
 using namespace XSI;
@@ -162,19 +163,20 @@ namespace affogato {
 		float tipWidth( 0.0f );
 		float width( 0.0f );
 
-		CRefArray props( getAffogatoProperties( parent ) );
+		const propertyIndex& index( propertyIndex::access( parent ) );
+		const CRefArray& props( index.properties() );
 		for( int i = 0; i < props.GetCount(); i++ ) {
-			Property prop( props[ i ] );
-			CParameterRefArray params( prop.GetParameters() );
+			if( !index.isAffogato( i ) )
+				continue;
 
-			for( int p = 0; p < params.GetCount(); p++ ) {
-				Parameter param( params[ p ] );
-				string paramName = CStringToString( param.GetName() );
+			const propertyIndex::parameterVector& params( propertyIndex::parameters( props[ i ] ) );
+
+			for( propertyIndex::parameterVector::const_iterator it( params.begin() ); it < params.end(); it++ ) {
+				const Parameter& param( it->parameter );
+				string paramName( it->name );
 
 				replace_first( paramName, string( "_" ), string( ":" ) );
 				//replace_first( paramName, string( "-" ), string( ":" ) );
-				string userParamName = paramName;
-				to_lower( paramName );
 
 				if( "curverwidth" == paramName ) {
 					if( 0 == width )
@@ -38,8 +38,10 @@
  */
 
 // Standard headers
+#include <algorithm>
 #include <limits>
 #include <math.h>
+#include <string.h>
 
 // Boost headers
 #include <boost/algorithm/string/replace.hpp>
@@ -60,10 +62,13 @@
 #include "affogatoGlobals.hpp"
 #include "affogatoHelpers.hpp"
 #include "affogatoParticleData.hpp"
+#include "affogatoPropertyIndex.hpp"
 #include "affogatoRenderer.hpp"
 #include "affogatoTokenValue.hpp"
 
 
+#define PARTICLE_DATA_CHUNK_SIZE 65536
+
 namespace affogato {
 
 	using namespace XSI;
@@ -71,6 +76,78 @@ namespace affogato {
 	using namespace std;
 	using namespace boost;
 
+	/** Structure-of-arrays buffer for per particle user attributes.
+	 *
+	 *  XSI hands out user attributes one value at a time. They are gathered
+	 *  into one contiguous column per attribute and converted to the
+	 *  renderer's float or int data in a single tight loop per column.
+	 */
+	class particleAttributeColumns {
+		public:
+			particleAttributeColumns( unsigned numParticles ) : numParticles( numParticles ) {}
+
+			/** Adds a column of zeros and returns its index.
+			 */
+			unsigned add( const string& name, tokenValue::parameterType type ) {
+				columns.push_back( attributeColumn() );
+				attributeColumn& c( columns.back() );
+				c.name = name;
+				c.type = type;
+				switch( type ) {
+					case tokenValue::typePoint:
+						c.components = 3;
+						break;
+					case tokenValue::typeHomogenousPoint:
+						c.components = 4;
+						break;
+					default:
+						c.components = 1;
+				}
+				c.values.resize( c.components * numParticles, 0.0 );
+				return columns.size() - 1;
+			}
+
+			double* column( unsigned index ) {
+				return &( columns[ index ].values[ 0 ] );
+			}
+
+			tokenValue::parameterType type( unsigned index ) const {
+				return columns[ index ].type;
+			}
+
+			/** Converts all columns to varying tokenValues, in the order they were added.
+			 */
+			void convert( vector< tokenValue::tokenValuePtr >& attributeArray ) const {
+				for( vector< attributeColumn >::const_iterator it( columns.begin() ); it < columns.end(); it++ ) {
+					const size_t size( it->values.size() );
+					const double *in( size ? &( it->values[ 0 ] ) : NULL );
+					if( tokenValue::typeInteger == it->type ) {
+						shared_ptr< int > values( new int[ size ], arrayDeleter() );
+						int *out( values.get() );
+						for( size_t i = 0; i < size; i++ )
+							out[ i ] = ( int )in[ i ];
+						attributeArray.push_back( tokenValue::tokenValuePtr( new tokenValue( values, size, it->name, tokenValue::storageVarying ) ) );
+					} else {
+						shared_ptr< float > values( new float[ size ], arrayDeleter() );
+						float *out( values.get() );
+						for( size_t i = 0; i < size; i++ )
+							out[ i ] = ( float )in[ i ];
+						attributeArray.push_back( tokenValue::tokenValuePtr( new tokenValue( values, size, it->name, tokenValue::storageVarying, it->type ) ) );
+					}
+				}
+			}
+
+		private:
+			struct attributeColumn {
+				string name;
+				tokenValue::parameterType type;
+				unsigned components;
+				vector< double > values;
+			};
+			vector< attributeColumn > columns;
+			unsigned numParticles;
+	};
+
 	particleData::~particleData() {
 		// Nothing to destruct
 	}
@@ -80,37 +157,27 @@ namespace affogato {
 
 		isMultiGroupBlob = false;
 		typeStr = "particle";
-
-		CRefArray affogatoProps( getAffogatoProperties( particlePrim.GetParent() ) );
-
-		for( unsigned i( 0 ); i < affogatoProps.GetCount(); i++ ) {
-			Property prop( affogatoProps[ i ] );
-
-			CParameterRefArray params( prop.GetParameters() );
-
-			for( unsigned p( 0 ); p < params.GetCount(); p++ ) {
-				Parameter param( params[ p ] );
-				string paramName = CStringToString( param.GetName() );
-				if( "particle_type" == paramName ) {
-					switch( ( long )param.GetValue() ) {
-						default:
-						case 0: // points
-							typeStr = "particle";
-							break;
-						case 1: // discs
-							typeStr = "disc";
-							break;
-						case 2: // spheres
-							typeStr = "sphere";
-							break;
-						case 3: // blobbies
-							typeStr = "blobby";
-							break;
-						case 4: // sprites
-							typeStr = "patch";
-							break;
-					}
-				}
+		currentGrain = 0;
+
+		const Parameter *particleType( propertyIndex::access( particlePrim.GetParent() ).findParameter( "particle_type" ) );
+		if( particleType ) {
+			switch( ( long )particleType->GetValue() ) {
+				default:
+				case 0: // points
+					typeStr = "particle";
+					break;
+				case 1: // discs
+					typeStr = "disc";
+					break;
+				case 2: // spheres
+					typeStr = "sphere";
+					break;
+				case 3: // blobbies
+					typeStr = "blobby";
+					break;
+				case 4: // sprites
+					typeStr = "patch";
+					break;
 			}
 		}
 
@@ -174,8 +241,9 @@ namespace affogato {
 
 		if( g.motionBlur.geometryParameterBlur || ( g.animation.time == atTime ) || blobbyIdSplitting ) {
 
-			// Temporary array
-			vector< tokenValue::tokenValuePtr > attributeArray;
+			// Per particle user attributes get gathered into columns first
+			// and are converted to tokenValues one whole column at a time
+			particleAttributeColumns columns( numParticles );
 
 			// Clusters
 			CRefArray clusters;
@@ -191,6 +259,8 @@ namespace affogato {
 						CustomProperty userDataTemplate( userDataMap.GetTemplate() );
 						CParameterRefArray parms( userDataTemplate.GetParameters() );
 
+						vector< Parameter > columnParms;
+						vector< unsigned > columnIndices;
 						for( unsigned p( 0 ); p < ( unsigned )parms.GetCount(); p++ ) {
 							Parameter aParm( parms[ p ] );
 							string name( CStringToString( aParm.GetName() ) );
@@ -199,7 +269,8 @@ namespace affogato {
 									case siEmpty:
 									case siFloat:
 									case siDouble:
-										attributeArray.push_back( tokenValue::tokenValuePtr( new tokenValue( numParticles, tokenValue::typeFloat ) ) );
+										columnIndices.push_back( columns.add( name, tokenValue::typeFloat ) );
+										columnParms.push_back( aParm );
 										break;
 									//case siInt1:
 									case siInt2:
@@ -208,58 +279,33 @@ namespace affogato {
 									case siUInt2:
 									case siUInt4:
 									case siBool:
-										attributeArray.push_back( tokenValue::tokenValuePtr( new tokenValue( numParticles, tokenValue::typeInteger ) ) );
+										columnIndices.push_back( columns.add( name, tokenValue::typeInteger ) );
+										columnParms.push_back( aParm );
 										break;
 								}
-								attributeArray.back()->setName( name );
-								attributeArray.back()->setClass( tokenValue::storageVarying );
 							}
 						}
 
-						for( unsigned p( 0 ); p < ( unsigned )parms.GetCount(); p++ ) {
-							Parameter aParm( parms[ p ] );
-							string name( CStringToString( aParm.GetName() ) );
-							if( !name.empty() ) {
-								unsigned xsiIndex = 0, dataIndex = 0;
-
-								Parameter aParm( parms[ p ] );
-								for( unsigned particle = 0; particle < ( unsigned )numParticles; particle++, dataIndex++ ) {
-									long cindex;
-									cluster.FindIndex( xsiIndex++, cindex );
-
-									if( -1 < cindex ) {
-										const unsigned char *cpData;
-										unsigned int cntData;
-										userDataMap.GetItemValue( cindex, cpData, cntData );
-										userDataTemplate.PutBinaryData( cpData, cntData );
-
-										switch( attributeArray[ p ]->type() ) {
-											case tokenValue::typeFloat: {
-												CValue out( aParm.GetValue() );
-												*( ( float* )( *( attributeArray[ p ].get() ) )[ dataIndex ] ) = float( out );
-												break;
-											}
-											case tokenValue::typeInteger: {
-												CValue out( aParm.GetValue() );
-												*( ( int* )( *( attributeArray[ p ].get() ) )[ dataIndex ] ) = ( int )long( out );
-												break;
-											}
-										}
-									} else {
-										switch( attributeArray[ p ]->type() ) {
-											case tokenValue::typeFloat: {
-												CValue out( aParm.GetValue() );
-												*( ( float* )( *( attributeArray[ p ].get() ) )[ dataIndex ] ) = 0.0f;
-												break;
-											}
-											case tokenValue::typeInteger: {
-												CValue out( aParm.GetValue() );
-												*( ( int* )( *( attributeArray[ p ].get() ) )[ dataIndex ] ) = 0l;
-												break;
-											}
-										}
-									}
-								}
+						if( columnParms.empty() )
+							continue;
+
+						// Look up the cluster indices of all particles at once
+						CLongArray particleIndices( numParticles );
+						for( unsigned particle( 0 ); particle < numParticles; particle++ )
+							particleIndices[ particle ] = particle;
+						CLongArray clusterIndices;
+						cluster.FindIndices( particleIndices, clusterIndices );
+
+						// Unpack the user data of each particle once and read all parameters from it.
+						// Particles that are not in the cluster keep the column's default of 0.
+						for( unsigned particle( 0 ); particle < numParticles; particle++ ) {
+							if( -1 < clusterIndices[ particle ] ) {
+								const unsigned char *cpData;
+								unsigned int cntData;
+								userDataMap.GetItemValue( clusterIndices[ particle ], cpData, cntData );
+								userDataTemplate.PutBinaryData( cpData, cntData );
+								for( unsigned c( 0 ); c < columnParms.size(); c++ )
+									columns.column( columnIndices[ c ] )[ particle ] = ( double )columnParms[ c ].GetValue();
 							}
 						}
 					}
@@ -267,78 +313,78 @@ namespace affogato {
 			}
 
 			// PP attributes
-			Particle p0( particles.GetParticle( 0 ) );
-			CRefArray p0Attributes( p0.GetAttributes() );
-			unsigned numAttributes( p0.GetAttributes().GetCount() );
-			for( unsigned a( 0 ); a < numAttributes; a++ ) {
-				string name( CStringToString( ParticleAttribute( p0Attributes[ a ] ).GetName() ) );
-				if( !name.empty() ) {
-					switch( ParticleAttribute( p0Attributes[ a ] ).GetAttributeType() ) {
-						case siPAUndefined:
-						case siPAFloat:
-							attributeArray.push_back( tokenValue::tokenValuePtr( new tokenValue( numParticles, tokenValue::typeFloat ) ) );
-							break;
-						case siPAInt:
-						case siPAULong:
-						case siPAUShort:
-						case siPABool:
-							attributeArray.push_back( tokenValue::tokenValuePtr( new tokenValue( numParticles, tokenValue::typeInteger ) ) );
-							break;
-						case siPAVector3:
-							attributeArray.push_back( tokenValue::tokenValuePtr( new tokenValue( numParticles, tokenValue::typePoint ) ) );
-							break;
-						case siPAVector4:
-							attributeArray.push_back( tokenValue::tokenValuePtr( new tokenValue( numParticles, tokenValue::typeHomogenousPoint ) ) );
-							break;
+			if( numParticles ) {
+				Particle p0( particles.GetParticle( 0 ) );
+				CRefArray p0Attributes( p0.GetAttributes() );
+				unsigned numAttributes( p0Attributes.GetCount() );
+
+				const unsigned noColumn( numeric_limits< unsigned >::max() );
+				vector< unsigned > columnIndices( numAttributes, noColumn );
+				for( unsigned a( 0 ); a < numAttributes; a++ ) {
+					ParticleAttribute attribute( p0Attributes[ a ] );
+					string name( CStringToString( attribute.GetName() ) );
+					if( !name.empty() ) {
+						switch( attribute.GetAttributeType() ) {
+							case siPAUndefined:
+							case siPAFloat:
+								columnIndices[ a ] = columns.add( name, tokenValue::typeFloat );
+								break;
+							case siPAInt:
+							case siPAULong:
+							case siPAUShort:
+							case siPABool:
+								columnIndices[ a ] = columns.add( name, tokenValue::typeInteger );
+								break;
+							case siPAVector3:
+								columnIndices[ a ] = columns.add( name, tokenValue::typePoint );
+								break;
+							case siPAVector4:
+								columnIndices[ a ] = columns.add( name, tokenValue::typeHomogenousPoint );
+								break;
+						}
 					}
-					attributeArray.back()->setName( name );
-					attributeArray.back()->setClass( tokenValue::storageVarying );
 				}
-			}
 
-			// Aquire PP data from XSI
-			for( unsigned a( 0 ); a < numAttributes; a++ ) {
-				string name( CStringToString( ParticleAttribute( p0Attributes[ a ] ).GetName() ) );
-				if( !name.empty() ) {
-					for( unsigned i( 0 ); i < numParticles; i++ ) {
-						Particle particle( particles.GetParticle( i ) );
-						CRefArray attributes( particle.GetAttributes() );
+				// Aquire PP data from XSI -- one pass over the particles, reading all attributes of each
+				for( unsigned i( 0 ); i < numParticles; i++ ) {
+					Particle particle( particles.GetParticle( i ) );
+					CRefArray attributes( particle.GetAttributes() );
+					for( unsigned a( 0 ); a < numAttributes; a++ ) {
+						if( noColumn == columnIndices[ a ] )
+							continue;
 						ParticleAttribute attribute( attributes[ a ] );
-						switch( attributeArray[ a ]->type() ) {
-							case tokenValue::typeFloat: {
-								CValue out;
-								attribute.GetValue( out );
-								*( ( float* )( *( attributeArray[ a ].get() ) )[ i ] ) = float( out );
-								break;
-							}
-							case tokenValue::typeInteger: {
-								CValue out;
-								attribute.GetValue( out );
-								*( ( int* )( *( attributeArray[ a ].get() ) )[ i ] ) = ( int )long( out );
-								break;
-							}
+						double *column( columns.column( columnIndices[ a ] ) );
+						switch( columns.type( columnIndices[ a ] ) ) {
 							case tokenValue::typePoint: {
 								CVector3 out;
 								attribute.GetValue( out );
-								*( ( float* )( *( attributeArray[ a ].get() ) )[ 3 * i     ] ) = ( float )( out.GetX() );
-								*( ( float* )( *( attributeArray[ a ].get() ) )[ 3 * i + 1 ] ) = ( float )( out.GetY() );
-								*( ( float* )( *( attributeArray[ a ].get() ) )[ 3 * i + 2 ] ) = ( float )( out.GetZ() );
+								column[ 3 * i     ] = out.GetX();
+								column[ 3 * i + 1 ] = out.GetY();
+								column[ 3 * i + 2 ] = out.GetZ();
 								break;
 							}
 							case tokenValue::typeHomogenousPoint: {
 								CVector4 out;
 								attribute.GetValue( out );
-								*( ( float* )( *( attributeArray[ a ].get() ) )[ 3 * i     ] ) = ( float )( out.GetX() );
-								*( ( float* )( *( attributeArray[ a ].get() ) )[ 3 * i + 1 ] ) = ( float )( out.GetY() );
-								*( ( float* )( *( attributeArray[ a ].get() ) )[ 3 * i + 2 ] ) = ( float )( out.GetZ() );
-								*( ( float* )( *( attributeArray[ a ].get() ) )[ 3 * i + 3 ] ) = ( float )( out.GetW() );
+								column[ 4 * i     ] = out.GetX();
+								column[ 4 * i + 1 ] = out.GetY();
+								column[ 4 * i + 2 ] = out.GetZ();
+								column[ 4 * i + 3 ] = out.GetW();
 								break;
 							}
+							default: {
+								CValue out;
+								attribute.GetValue( out );
+								column[ i ] = ( double )out;
+							}
 						}
 					}
 				}
 			}
 
+			vector< tokenValue::tokenValuePtr > attributeArray;
+			columns.convert( attributeArray );
+
 			tokenValue::tokenValuePtr blobbyIdMap;
 			for( vector< tokenValue::tokenValuePtr >::iterator it = attributeArray.begin(); it < attributeArray.end(); it++ ) {
 				if( ( "blobby" == typeStr ) && ( "blobbyid" == ( *it )->name() ) ) {
@@ -417,57 +463,82 @@ namespace affogato {
 				}
 
 				if( P ) {
-					int index( 0 );
-					map< int, vector< int > > idGroups;
-					ppos.reserve( numParticles * 16 );
-					for( unsigned i( 0 ); i < numParticles; i++ ) {
+					const int *blobIds( ( const int* )blobbyIdMap->data() );
+					const float *Pdata( ( const float* )P->data() );
+					const float *widthData( widths ? ( const float* )widths->data() : NULL );
+
+					// One ellipsoid per particle
+					code.reserve( 3 * numParticles + 2 );
+					ppos.resize( numParticles * 16, 0.0f );
+					for( unsigned i( 0 ), index( 0 ); i < numParticles; i++, index += 16 ) {
 						code.push_back( 1001 );
 						code.push_back( index );
 
-						float theWidth;
-						if( widths )
-							theWidth = *( float* )( ( *widths )[ i ] );
-						else
-							theWidth = width;
-
-						ppos.push_back( theWidth );
-						ppos.push_back( 0 );
-						ppos.push_back( 0 );
-						ppos.push_back( 0 );
-
-						ppos.push_back( 0 );
-						ppos.push_back( theWidth );
-						ppos.push_back( 0 );
-						ppos.push_back( 0 );
-
-						ppos.push_back( 0 );
-						ppos.push_back( 0 );
-						ppos.push_back( theWidth );
-						ppos.push_back( 0 );
-
-						ppos.push_back( *( float* )( *P )[ i * 3     ] );
-						ppos.push_back( *( float* )( *P )[ i * 3 + 1 ] );
-						ppos.push_back( *( float* )( *P )[ i * 3 + 2 ] );
-						ppos.push_back( 1 );
-
-						index += 16;
-
-						// Find which particles are in which group
-						int blobId( *( ( int* )( *blobbyIdMap.get() )[ i ] ) );
-						idGroups[ blobId ].push_back( i );
+						const float theWidth( widthData ? widthData[ i ] : width );
+						float *m( &ppos[ index ] );
+						m[ 0 ] = m[ 5 ] = m[ 10 ] = theWidth;
+						m[ 12 ] = Pdata[ i * 3     ];
+						m[ 13 ] = Pdata[ i * 3 + 1 ];
+						m[ 14 ] = Pdata[ i * 3 + 2 ];
+						m[ 15 ] = 1;
 					}
 
-					for( map< int, vector< int > >::const_iterator it = idGroups.begin(); it != idGroups.end(); it++ ) {
-						code.push_back( 0 ); // Sum
-						code.push_back( it->second.size() ); // Number of operands
-						for( vector< int >::const_iterator jt = it->second.begin(); jt < it->second.end(); jt++ ) {
-							code.push_back( *jt ); // Operand
+					// Partition the particles by blobby id with a counting sort.
+					// Groups are ordered by ascending id and keep their particles in order.
+					vector< int > groupOf( numParticles );
+					vector< unsigned > groupStart;
+					if( numParticles ) {
+						const int minId( *min_element( blobIds, blobIds + numParticles ) );
+						const int maxId( *max_element( blobIds, blobIds + numParticles ) );
+						const double range( ( double )maxId - minId + 1 );
+
+						if( range <= 4.0 * numParticles + 1024 ) {
+							// Dense ids: bucket directly by id
+							vector< unsigned > counts( ( unsigned )range, 0 );
+							for( unsigned i( 0 ); i < numParticles; i++ )
+								counts[ blobIds[ i ] - minId ]++;
+							vector< int > groupIndex( counts.size(), -1 );
+							for( unsigned id( 0 ); id < counts.size(); id++ ) {
+								if( counts[ id ] ) {
+									groupIndex[ id ] = groupStart.size();
+									groupStart.push_back( 0 );
+								}
+							}
+							for( unsigned i( 0 ); i < numParticles; i++ )
+								groupOf[ i ] = groupIndex[ blobIds[ i ] - minId ];
+						} else {
+							// Sparse ids: rank them through a sorted list of the unique ids
+							vector< int > ids( blobIds, blobIds + numParticles );
+							sort( ids.begin(), ids.end() );
+							ids.erase( unique( ids.begin(), ids.end() ), ids.end() );
+							groupStart.resize( ids.size(), 0 );
+							for( unsigned i( 0 ); i < numParticles; i++ )
+								groupOf[ i ] = lower_bound( ids.begin(), ids.end(), blobIds[ i ] ) - ids.begin();
 						}
 					}
 
+					const unsigned numGroups( groupStart.size() );
+					vector< unsigned > groupSize( numGroups, 0 );
+					for( unsigned i( 0 ); i < numParticles; i++ )
+						groupSize[ groupOf[ i ] ]++;
+					for( unsigned group( 1 ); group < numGroups; group++ )
+						groupStart[ group ] = groupStart[ group - 1 ] + groupSize[ group - 1 ];
+
+					// Gather
+					vector< int > members( numParticles );
+					vector< unsigned > fill( groupStart );
+					for( unsigned i( 0 ); i < numParticles; i++ )
+						members[ fill[ groupOf[ i ] ]++ ] = i;
+
+					for( unsigned group( 0 ); group < numGroups; group++ ) {
+						code.push_back( 0 ); // Sum
+						code.push_back( groupSize[ group ] ); // Number of operands
+						code.insert( code.end(), members.begin() + groupStart[ group ], members.begin() + groupStart[ group ] + groupSize[ group ] ); // Operands
+					}
+
 					code.push_back( 2 ); // Maximum
-					code.push_back( idGroups.size() ); // Number of operands
-					for( unsigned i = 0; i < ( unsigned )idGroups.size(); i++ ) {
+					code.push_back( numGroups ); // Number of operands
+					for( unsigned i = 0; i < numGroups; i++ ) {
 						code.push_back( numParticles + i ); // Operand
 					}
 				}
@@ -543,57 +614,111 @@ namespace affogato {
 	}*/
 
 	void particleData::write() const {
-		using namespace ueberMan;
-		ueberManInterface theRenderer;
-
-		for( tokenValue::tokenValuePtrVector::const_iterator it = tokenValuePtrArray.begin(); it < tokenValuePtrArray.end(); it++ )
-			theRenderer.parameter( **it );
-
-		if( numParticles ) {
-			if( isMultiGroupBlob ) {
-				vector< string > str;
-				theRenderer.blobby( numParticles, code, ppos, str, const_cast< string& >( identifier ) );
-			} else {
-				theRenderer.points( typeStr, numParticles, const_cast< string& >( identifier ) );
-			}
-		} else {
-			theRenderer.translate( .0f, .0f, .0f );
-		}
+		writeGrains();
 	}
 
-/*
 	void particleData::startGrain() {
-		numParticlesIt	= numParticlesMap.begin();
-		tokenValueIt	= tokenValuePtrArrayMap.begin();
+		currentGrain = 0;
 	}
 
-	unsigned particleData::granularity() const {
-		return numParticlesMap.size();
+	void particleData::writeNextGrain() {
+		if( currentGrain < granularity() )
+			writeGrain( currentGrain++ );
 	}
 
-	void particleData::writeNextGrain() {
-		if( numParticlesIt != numParticlesMap.end() ) {
+	unsigned particleData::granularity() const {
+		// Multi group blobbies need to see all particles at once to build their groups
+		if( isMultiGroupBlob || ( numParticles <= PARTICLE_DATA_CHUNK_SIZE ) )
+			return 1;
+		return ( numParticles + PARTICLE_DATA_CHUNK_SIZE - 1 ) / PARTICLE_DATA_CHUNK_SIZE;
+	}
 
-			using namespace ueberMan;
-			ueberManInterface theRenderer;
+	void particleData::writeGrain( unsigned grain ) const {
+		using namespace ueberMan;
+		ueberManInterface theRenderer;
 
-			for( vector< tokenValue::tokenValuePtr >::const_iterator it = tokenValueIt->second.begin(); it < tokenValueIt->second.end(); it++ ) {
+		if( 1 == granularity() ) {
+			for( tokenValue::tokenValuePtrVector::const_iterator it = tokenValuePtrArray.begin(); it < tokenValuePtrArray.end(); it++ )
 				theRenderer.parameter( **it );
-				message( stringToCString( ( *it )->name() ), messageError );
-				message( CValue( ( long )( *it )->size() ).GetAsText(), messageError );
+
+			if( numParticles ) {
+				if( isMultiGroupBlob ) {
+					vector< string > str;
+					theRenderer.blobby( numParticles, code, ppos, str, const_cast< string& >( identifier ) );
+				} else {
+					theRenderer.points( typeStr, numParticles, const_cast< string& >( identifier ) );
+				}
+			} else {
+				theRenderer.translate( .0f, .0f, .0f );
 			}
+		} else {
+			for( tokenValue::tokenValuePtrVector::const_iterator it = tokenValuePtrArray.begin(); it < tokenValuePtrArray.end(); it++ )
+				theRenderer.parameter( *grainTokenValue( **it, grain ) );
 
-			theRenderer.points( "blobby", numParticlesIt->second, const_cast< string& >( identifier ) );
+			const unsigned first( grain * PARTICLE_DATA_CHUNK_SIZE );
+			string grainIdentifier( identifier + ".chunk" + toString( grain ) );
+			theRenderer.points( typeStr, min( numParticles - first, ( unsigned )PARTICLE_DATA_CHUNK_SIZE ), grainIdentifier );
+		}
+	}
 
-			theRenderer.translate( 0, 0, 0 );
+	tokenValue::tokenValuePtr particleData::grainTokenValue( const tokenValue& aTokenValue, unsigned grain ) const {
+		// Only per particle data gets split -- everything else is the same for all chunks
+		if( ( ( tokenValue::storageVarying != aTokenValue.storage() ) && ( tokenValue::storageVertex != aTokenValue.storage() ) ) ||
+			( tokenValue::typeString == aTokenValue.type() ) )
+			return tokenValue::tokenValuePtr( new tokenValue( aTokenValue ) );
+
+		// Float and int are both four bytes so we can copy words regardless of the type
+		const unsigned wordsPerParticle( aTokenValue.byteSize() / ( sizeof( float ) * numParticles ) );
+		const unsigned first( grain * PARTICLE_DATA_CHUNK_SIZE );
+		const unsigned count( min( numParticles - first, ( unsigned )PARTICLE_DATA_CHUNK_SIZE ) );
+		const size_t size( count * wordsPerParticle );
+
+		if( tokenValue::typeInteger == aTokenValue.type() ) {
+			shared_ptr< int > values( new int[ size ], arrayDeleter() );
+			memcpy( values.get(), ( const int* )aTokenValue.data() + first * wordsPerParticle, size * sizeof( int ) );
+			return tokenValue::tokenValuePtr( new tokenValue( values, size, aTokenValue.name(), aTokenValue.storage() ) );
+		} else {
+			shared_ptr< float > values( new float[ size ], arrayDeleter() );
+			memcpy( values.get(), ( const float* )aTokenValue.data() + first * wordsPerParticle, size * sizeof( float ) );
+			return tokenValue::tokenValuePtr( new tokenValue( values, size, aTokenValue.name(), aTokenValue.storage(), aTokenValue.type() ) );
+		}
+	}
 
-			message( CValue( ( long )tokenValuePtrArrayMap.size() ).GetAsText(), messageError );
-			message( CValue( ( long )numParticlesMap.size() ).GetAsText(), messageError );
+	vector< float > particleData::grainBoundingBox( unsigned grain ) const {
+		vector< float > grainBound( 6 );
+		grainBound[ 0 ] = grainBound[ 2 ] = grainBound[ 4 ] = numeric_limits< float >::max();
+		grainBound[ 1 ] = grainBound[ 3 ] = grainBound[ 5 ] = -numeric_limits< float >::max();
+
+		const float *P( NULL ), *width( NULL );
+		float constantWidth( 1.0f );
+		for( tokenValue::tokenValuePtrVector::const_iterator it = tokenValuePtrArray.begin(); it < tokenValuePtrArray.end(); it++ ) {
+			if( "P" == ( *it )->name() ) {
+				P = ( const float* )( *it )->data();
+			} else
+			if( ( "width" == ( *it )->name() ) && ( tokenValue::typeFloat == ( *it )->type() ) ) {
+				if( ( tokenValue::storageVarying == ( *it )->storage() ) || ( tokenValue::storageVertex == ( *it )->storage() ) )
+					width = ( const float* )( *it )->data();
+				else
+					constantWidth = *( const float* )( *it )->data();
+			}
+		}
 
-			++numParticlesIt;
-			//++tokenValueIt++;
+		if( !P )
+			return bound;
+
+		const unsigned first( grain * PARTICLE_DATA_CHUNK_SIZE );
+		const unsigned last( min( numParticles, first + PARTICLE_DATA_CHUNK_SIZE ) );
+		for( unsigned i( first ); i < last; i++ ) {
+			// Pad by the particle's radius
+			const float radius( 0.5f * ( width ? width[ i ] : constantWidth ) );
+			for( unsigned axis( 0 ); axis < 3; axis++ ) {
+				grainBound[ 2 * axis ]		= min( grainBound[ 2 * axis ], P[ 3 * i + axis ] - radius );
+				grainBound[ 2 * axis + 1 ]	= max( grainBound[ 2 * axis + 1 ], P[ 3 * i + axis ] + radius );
+			}
 		}
-	}*/
+
+		return grainBound;
+	}
 
 	vector< float > particleData::boundingBox() const {
 		return bound;
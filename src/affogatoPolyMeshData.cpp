@@ -38,7 +38,10 @@
 
 
 // Standard headers
+#include <algorithm>
 #include <limits>
+#include <map>
+#include <string.h>
 
 // Boost headers
 #include <boost/algorithm/string/replace.hpp>
@@ -53,6 +56,7 @@
 #include <xsi_polygonnode.h>
 #include <xsi_polygonmesh.h>
 #include <xsi_primitive.h>
+#include <xsi_vector3.h>
 #include <xsi_vertex.h>
 #include <xsi_x3dobject.h>
 
@@ -60,6 +64,7 @@
 #include "affogatoGlobals.hpp"
 #include "affogatoHelpers.hpp"
 #include "affogatoPolyMeshData.hpp"
+#include "affogatoPropertyIndex.hpp"
 #include "affogatoRenderer.hpp"
 
 
@@ -69,11 +74,116 @@ namespace affogato {
 	using namespace MATH;
 	using namespace std;
 
+	/** Merges creased edges into chains.
+	 *
+	 *  Edges with the same sharpness that meet at a vertex no other edge of
+	 *  that sharpness touches get joined into one multi-vertex crease.
+	 *
+	 *  @param edgeVertices  Two vertex indices per creased edge.
+	 *  @param edgeValues    The sharpness of each creased edge.
+	 *  @param lengths       Receives the number of vertices of each chain.
+	 *  @param indices       Receives the vertex indices of all chains.
+	 *  @param values        Receives the sharpness of each chain.
+	 */
+	static void buildCreaseChains( const vector< int >& edgeVertices, const vector< float >& edgeValues,
+		vector< int >& lengths, vector< int >& indices, vector< float >& values ) {
+
+		// Group the edges by sharpness
+		map< float, vector< unsigned > > groups;
+		for( unsigned edge = 0; edge < edgeValues.size(); edge++ )
+			groups[ edgeValues[ edge ] ].push_back( edge );
+
+		for( map< float, vector< unsigned > >::const_iterator group = groups.begin(); group != groups.end(); group++ ) {
+			const vector< unsigned >& edges( group->second );
+
+			// Vertex -> edges adjacency of this group
+			map< int, vector< unsigned > > adjacency;
+			for( unsigned i = 0; i < edges.size(); i++ ) {
+				adjacency[ edgeVertices[ 2 * edges[ i ] ] ].push_back( i );
+				adjacency[ edgeVertices[ 2 * edges[ i ] + 1 ] ].push_back( i );
+			}
+
+			vector< bool > used( edges.size(), false );
+
+			// Walks from a vertex along unused edges for as long as the chain doesn't fork
+			for( unsigned pass = 0; pass < 2; pass++ ) {
+				for( map< int, vector< unsigned > >::const_iterator start = adjacency.begin(); start != adjacency.end(); start++ ) {
+					// First pass: start at chain ends and forks, second pass: whatever is left are closed loops
+					if( !pass && ( 2 == start->second.size() ) )
+						continue;
+
+					for( unsigned s = 0; s < start->second.size(); s++ ) {
+						if( used[ start->second[ s ] ] )
+							continue;
+
+						unsigned length( 1 );
+						int vertex( start->first );
+						indices.push_back( vertex );
+						unsigned edge( start->second[ s ] );
+						for( ;; ) {
+							used[ edge ] = true;
+							const int *ends( &edgeVertices[ 2 * edges[ edge ] ] );
+							vertex = ( ends[ 0 ] == vertex ) ? ends[ 1 ] : ends[ 0 ];
+							indices.push_back( vertex );
+							length++;
+
+							const vector< unsigned >& next( adjacency[ vertex ] );
+							if( 2 != next.size() )
+								break;
+							edge = used[ next[ 0 ] ] ? next[ 1 ] : next[ 0 ];
+							if( used[ edge ] )
+								break;
+						}
+						lengths.push_back( length );
+						values.push_back( group->first );
+					}
+				}
+			}
+		}
+	}
+
+	/** Turns a per face-vertex primitive variable into a per point one.
+	 *
+	 *  @param values           components values per face-vertex.
+	 *  @param verts            The point index of each face-vertex.
+	 *  @return                 components values per point or an empty
+	 *                          pointer if the variable is not continuous,
+	 *                          i.e. if any point has different values on
+	 *                          different faces.
+	 */
+	static boost::shared_ptr< float > collapseFaceVarying( const float *values, unsigned components, const int *verts, unsigned numFaceVertices, unsigned numPoints ) {
+		boost::shared_ptr< float > collapsed( new float[ components * numPoints ], arrayDeleter() );
+		float *out( collapsed.get() );
+		vector< bool > seen( numPoints, false );
+		for( unsigned i = 0; i < numFaceVertices; i++ ) {
+			const unsigned point( verts[ i ] );
+			const float *in( values + components * i );
+			float *p( out + components * point );
+			if( seen[ point ] ) {
+				for( unsigned c = 0; c < components; c++ ) {
+					if( p[ c ] != in[ c ] )
+						return boost::shared_ptr< float >();
+				}
+			} else {
+				memcpy( p, in, components * sizeof( float ) );
+				seen[ point ] = true;
+			}
+		}
+
+		// Points no face uses
+		for( unsigned point = 0; point < numPoints; point++ ) {
+			if( !seen[ point ] )
+				fill( out + components * point, out + components * ( point + 1 ), 0.0f );
+		}
+
+		return collapsed;
+	}
+
 	polyMeshData::~polyMeshData() {
 		// Nothing to destruct
 	}
 
-	polyMeshData::polyMeshData( const Primitive &polyMeshPrim, double atTime, bool usePref, double atPrefTime ) {
+	polyMeshData::polyMeshData( const Primitive &polyMeshPrim, double atTime, bool usePref, double atPrefTime, double velocityDelta ) {
 		const globals& g( globals::access() );
 
 		identifier = getAffogatoName( X3DObject( polyMeshPrim.GetParent() ).GetFullName().GetAsciiString() );
@@ -83,32 +193,17 @@ namespace affogato {
 
 		debugMessage( L"Aquiring polyMesh primitive" );
 
-		CRefArray props( X3DObject( polyMeshPrim.GetParent() ).GetProperties() );
-		subDivScheme = 1;
+		const propertyIndex& index( propertyIndex::access( X3DObject( polyMeshPrim.GetParent() ) ) );
+
 		boundary = boundarySharp;
-		unsigned exitLoop = 0;
-		for( unsigned i = 0; i < ( unsigned )props.GetCount(); i++ ) {
-			Property prop( props[ i ] );
-
-			if( isAffogatoProperty( prop ) ) {
-				CParameterRefArray params = prop.GetParameters();
-				for( unsigned p = 0; p < ( unsigned )params.GetCount(); p++ ) {
-					Parameter param( params[ p ] );
-					string paramName( param.GetName().GetAsciiString() );
-					boost::to_lower( paramName );
-					if( "boundarytype" == paramName ) {
-						boundary = static_cast< boundaryType >( ( unsigned short )param.GetValue( g.animation.time ) );
-						exitLoop++;
-						break;
-					}
-				}
-			} else if( CString( siGeomApproxType ) == prop.GetType() ) {
-				subDivScheme = ( short int )prop.GetParameterValue( L"gapproxmordrsl" );
-				exitLoop++;
-			}
-			if( 1 < exitLoop )
-				break;
-		}
+		const Parameter *boundaryParam( index.findParameter( "boundarytype" ) );
+		if( boundaryParam )
+			boundary = static_cast< boundaryType >( ( unsigned short )boundaryParam->GetValue( g.animation.time ) );
+
+		subDivScheme = 1;
+		CRef geomApprox( index.findType( siGeomApproxType ) );
+		if( geomApprox.IsValid() )
+			subDivScheme = ( short int )Property( geomApprox ).GetParameterValue( L"gapproxmordrsl" );
 
 		debugMessage( L"Getting vertices and faces" );
 
@@ -138,49 +233,80 @@ namespace affogato {
 
 		unsigned numVertices( vertices.GetCount() );
 		unsigned numVerticesForAllFaces( vertexIndex );
+		numPoints = numVertices;
+		numFaceVertices = vertexIndex;
+		currentGrain = 0;
 
 		tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( vertices, "P", tokenValue::storageVertex, tokenValue::typePoint ) ) );
 
+		if( velocityDelta ) {
+			debugMessage( L"Doing velocity" );
+			// Only the points get evaluated a second time, not the whole mesh
+			CVector3Array current( vertices.GetPositionArray() );
+			CVector3Array next( Geometry( polyMeshPrim.GetGeometry( atTime + velocityDelta ) ).GetPoints().GetPositionArray() );
+			// No velocity if the topology changes
+			if( next.GetCount() == current.GetCount() ) {
+				velocity = boost::shared_ptr< float >( new float[ 3 * numVertices ], arrayDeleter() );
+				float *v( velocity.get() );
+				const double scale( 1.0 / velocityDelta );
+				for( unsigned i = 0; i < numVertices; i++ ) {
+					v[ 3 * i ]		= ( float )( ( next[ i ].GetX() - current[ i ].GetX() ) * scale );
+					v[ 3 * i + 1 ]	= ( float )( ( next[ i ].GetY() - current[ i ].GetY() ) * scale );
+					v[ 3 * i + 2 ]	= ( float )( ( next[ i ].GetZ() - current[ i ].GetZ() ) * scale );
+				}
+				tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( velocity, 3 * numVertices, "__velocity", tokenValue::storageVertex, tokenValue::typeVector ) ) );
+			}
+		}
+
 		if( subDivScheme ) {
 			// Creases
 			debugMessage( L"Doing creases" );
 
+			// All creases go out as three arrays: one sharpness and one vertex
+			// count per crease and the vertex indices of all creases
 			CEdgeRefArray edges( mesh.GetEdges() );
-			if( edges.GetCreaseArray().GetCount() ) {
-				for( unsigned i = 0; i < ( unsigned )edges.GetCount(); i++ ) {
+			CDoubleArray edgeCreases( edges.GetCreaseArray() );
+			vector< int > edgeVertices;
+			vector< float > edgeValues;
+			for( unsigned i = 0; i < ( unsigned )edgeCreases.GetCount(); i++ ) {
+				if( edgeCreases[ i ] ) {
 					Edge e( edges.GetItem( i ) );
-					float creaseVal( ( float )e.GetCrease() );
-					if( creaseVal ) {
-						if( e.GetIsHard() )
-							creaseVal = 1e38f;
-
-						CVertexRefArray verts( e.GetVertices() );
-						unsigned count( ( unsigned )verts.GetCount() );
-						boost::shared_ptr< int > creases( new int[ count ] );
-						for( unsigned j = 0; j < count; j++ ) {
-							Vertex v( verts.GetItem( j ) );
-							creases.get()[ j ] = v.GetIndex();
-						}
-						tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( creaseVal, "creasevalue" ) ) );
-						tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( creases, count, "crease", tokenValue::storageUniform ) ) );
-					}
+					edgeValues.push_back( e.GetIsHard() ? 1e38f : ( float )edgeCreases[ i ] );
+
+					CVertexRefArray verts( e.GetVertices() );
+					edgeVertices.push_back( Vertex( verts.GetItem( 0 ) ).GetIndex() );
+					edgeVertices.push_back( Vertex( verts.GetItem( 1 ) ).GetIndex() );
 				}
 			}
 
+			if( !edgeValues.empty() ) {
+				vector< int > creaseLengths, creaseIndices;
+				vector< float > creaseValues;
+				buildCreaseChains( edgeVertices, edgeValues, creaseLengths, creaseIndices, creaseValues );
+
+				tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( &creaseValues[ 0 ], creaseValues.size(), "creasevalue", tokenValue::storageConstant ) ) );
+				tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( &creaseLengths[ 0 ], creaseLengths.size(), "creaselength", tokenValue::storageConstant ) ) );
+				tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( &creaseIndices[ 0 ], creaseIndices.size(), "crease", tokenValue::storageConstant ) ) );
+			}
+
 			// Corners
 			debugMessage( L"Doing corners" );
 
 			CVertexRefArray verts( mesh.GetVertices() );
-			if( verts.GetCreaseArray().GetCount() ) {
-				for( unsigned i = 0; i < ( unsigned )verts.GetCount(); i++ ) {
-					Vertex v( verts.GetItem( i ) );
-					float creaseVal( ( float )v.GetCrease() );
-					if( creaseVal ) {
-						tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( creaseVal, "cornervalue" ) ) );
-						tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( ( int )v.GetIndex(), "corner" ) ) );
-					}
+			CDoubleArray vertexCreases( verts.GetCreaseArray() );
+			vector< int > cornerIndices;
+			vector< float > cornerValues;
+			for( unsigned i = 0; i < ( unsigned )vertexCreases.GetCount(); i++ ) {
+				if( vertexCreases[ i ] ) {
+					cornerIndices.push_back( i );
+					cornerValues.push_back( ( float )vertexCreases[ i ] );
 				}
 			}
+
+			if( !cornerIndices.empty() ) {
+				tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( &cornerValues[ 0 ], cornerValues.size(), "cornervalue", tokenValue::storageConstant ) ) );
+				tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( &cornerIndices[ 0 ], cornerIndices.size(), "corner", tokenValue::storageConstant ) ) );
+			}
 		}
 
 		debugMessage( L"Doing parameters" );
@@ -219,8 +345,6 @@ namespace affogato {
 					Cluster cluster( clusters[ i ] );
 
 					//UVs
-					boost::shared_ptr< float > uvCoordinates( new float[ 2 * numVerticesForAllFaces ], arrayDeleter() );
-
 					CRefArray uvProperties;
 					cluster.GetProperties().Filter( siClsUVSpaceTxtType, CStringArray(), CString(), uvProperties );
 
@@ -229,6 +353,8 @@ namespace affogato {
 					cluster.FindIndices( completeNodeIndices, clusterOffsetIndices );
 
 					for( unsigned uvprops = 0; uvprops < ( unsigned )uvProperties.GetCount(); uvprops++ ) {
+						boost::shared_ptr< float > uvCoordinates( new float[ 2 * numVerticesForAllFaces ], arrayDeleter() );
+
 						CRef uvNow = ClusterProperty( uvProperties[ uvprops ] ).EvaluateAt( atTime );
 						ClusterProperty prop( uvNow );
 
@@ -261,20 +387,26 @@ namespace affogato {
 
 						setname += "[2]";
 
+						// UVs without seams can go out once per point instead of once per face-vertex
+						boost::shared_ptr< float > collapsed;
+						if( g.data.collapsePrimvars )
+							collapsed = collapseFaceVarying( uvCoordinates.get(), 2, verts.get(), numVerticesForAllFaces, numVertices );
+
 						tokenValue::storageClass interpolationClass;
 						if( subDivScheme )
-							interpolationClass = tokenValue::storageFaceVertex; // Subdivs get facevertex
+							interpolationClass = collapsed ? tokenValue::storageVertex : tokenValue::storageFaceVertex; // Subdivs get vertex or facevertex
 						else
-							interpolationClass = tokenValue::storageFaceVarying; // Polys get facevarying
+							interpolationClass = collapsed ? tokenValue::storageVarying : tokenValue::storageFaceVarying; // Polys get varying or facevarying
 
-						tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( uvCoordinates, 2 * vertexIndex, setname, interpolationClass, tokenValue::typeFloat ) ) );
+						if( collapsed )
+							tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( collapsed, 2 * numVertices, setname, interpolationClass, tokenValue::typeFloat ) ) );
+						else
+							tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( uvCoordinates, 2 * vertexIndex, setname, interpolationClass, tokenValue::typeFloat ) ) );
 					}
 
 					// Vertex colors
 					debugMessage( L"Doing vertex colors" );
 
-					boost::shared_ptr< float > vertexColors( new float[ 3 * numVerticesForAllFaces ], arrayDeleter() );
-
 					CRefArray colorProperties;
 					cluster.GetProperties().Filter( L"vertexColor", CStringArray(), CString(), colorProperties );
 
@@ -282,6 +414,8 @@ namespace affogato {
 					cluster.FindIndices( completeNodeIndices, clusterOffsetIndices );
 
 					for( unsigned colorProp( 0 ); colorProp < ( unsigned )colorProperties.GetCount(); colorProp++ ) {
+						boost::shared_ptr< float > vertexColors( new float[ 3 * numVerticesForAllFaces ], arrayDeleter() );
+
 						CRef colorNow = ClusterProperty( colorProperties[ colorProp ] ).EvaluateAt( atTime );
 						ClusterProperty prop( colorNow );
 
@@ -312,13 +446,20 @@ namespace affogato {
 						if( "Vertex_Color" == setname ) // The default name gets translated to the RMan default name
 							setname = "Cs";
 
+						boost::shared_ptr< float > collapsed;
+						if( g.data.collapsePrimvars )
+							collapsed = collapseFaceVarying( vertexColors.get(), 3, verts.get(), numVerticesForAllFaces, numVertices );
+
 						tokenValue::storageClass interpolationClass;
 						if( subDivScheme )
-							interpolationClass = tokenValue::storageFaceVertex; // Subdivs get facevertex
+							interpolationClass = collapsed ? tokenValue::storageVertex : tokenValue::storageFaceVertex; // Subdivs get vertex or facevertex
 						else
-							interpolationClass = tokenValue::storageFaceVarying; // Polys get facevarying
+							interpolationClass = collapsed ? tokenValue::storageVarying : tokenValue::storageFaceVarying; // Polys get varying or facevarying
 
-						tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( vertexColors, 3 * vertexIndex, setname, interpolationClass, tokenValue::typeColor ) ) );
+						if( collapsed )
+							tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( collapsed, 3 * numVertices, setname, interpolationClass, tokenValue::typeColor ) ) );
+						else
+							tokenValuePtrArray.push_back( tokenValue::tokenValuePtr( new tokenValue( vertexColors, 3 * vertexIndex, setname, interpolationClass, tokenValue::typeColor ) ) );
 					}
 				}
 			}
@@ -375,13 +516,284 @@ namespace affogato {
 		return bound;
 	}
 
+	boost::shared_ptr< polyMeshData > polyMeshData::extrapolate( double deltaTime ) const {
+		boost::shared_ptr< polyMeshData > sample;
+		if( !velocity )
+			return sample;
+
+		sample = boost::shared_ptr< polyMeshData >( new polyMeshData( *this ) );
+
+		for( vector< boost::shared_ptr< tokenValue > >::iterator it = sample->tokenValuePtrArray.begin(); it < sample->tokenValuePtrArray.end(); it++ ) {
+			if( "P" == ( *it )->name() ) {
+				const float *P( ( const float* )( *it )->data() );
+				const float *v( velocity.get() );
+				const float dt( ( float )deltaTime );
+				boost::shared_ptr< float > moved( new float[ 3 * numPoints ], arrayDeleter() );
+				float *Pmoved( moved.get() );
+				for( unsigned i = 0; i < 3 * ( unsigned )numPoints; i++ )
+					Pmoved[ i ] = P[ i ] + v[ i ] * dt;
+				( *it )->setData( moved, 3 * numPoints );
+
+				// The moved points may leave the box of the original sample
+				if( 6 == sample->bound.size() ) {
+					for( unsigned i = 0; i < 3 * ( unsigned )numPoints; i++ ) {
+						const unsigned axis( i % 3 );
+						sample->bound[ 2 * axis ]		= min( sample->bound[ 2 * axis ], Pmoved[ i ] );
+						sample->bound[ 2 * axis + 1 ]	= max( sample->bound[ 2 * axis + 1 ], Pmoved[ i ] );
+					}
+				}
+				break;
+			}
+		}
+
+		return sample;
+	}
+
 	void polyMeshData::write() const {
+		writeGrains();
+	}
+
+	void polyMeshData::split() {
+		const globals& g( globals::access() );
+		// Subdivision surfaces would crack along the seams, so only polygons get split
+		if( g.data.meshChunkSize && !subDivScheme && ( ( unsigned )numFaces > g.data.meshChunkSize ) ) {
+			debugMessage( L"Splitting mesh into chunks" );
+			buildGrains( g.data.meshChunkSize );
+		}
+	}
+
+	void polyMeshData::unsplit() {
+		faceOffset.reset();
+		grainFaces.reset();
+		grainStart.reset();
+	}
+
+	bool polyMeshData::shareGrains( const polyMeshData& other ) {
+		if( ( numFaces != other.numFaces ) || ( numFaceVertices != other.numFaceVertices ) ) {
+			unsplit();
+			return false;
+		}
+		faceOffset	= other.faceOffset;
+		grainFaces	= other.grainFaces;
+		grainStart	= other.grainStart;
+		return true;
+	}
+
+	void polyMeshData::startGrain() {
+		currentGrain = 0;
+	}
+
+	void polyMeshData::writeNextGrain() {
+		if( currentGrain < granularity() )
+			writeGrain( currentGrain++ );
+	}
+
+	unsigned polyMeshData::granularity() const {
+		return grainStart ? grainStart->size() - 1 : 1;
+	}
+
+	// Orders faces by the position of their centroid along one axis
+	class centroidLess {
+		public:
+			centroidLess( const vector< float >& centroids, unsigned axis ) : centroids( centroids ), axis( axis ) {}
+			bool operator()( int a, int b ) const {
+				return centroids[ 3 * a + axis ] < centroids[ 3 * b + axis ];
+			}
+		private:
+			const vector< float >& centroids;
+			unsigned axis;
+	};
+
+	void polyMeshData::buildGrains( unsigned maxFaces ) {
+		const float *P( NULL );
+		for( vector< boost::shared_ptr< tokenValue > >::const_iterator it = tokenValuePtrArray.begin(); it < tokenValuePtrArray.end(); it++ ) {
+			if( "P" == ( *it )->name() ) {
+				P = ( const float* )( *it )->data();
+				break;
+			}
+		}
+		if( !P )
+			return;
+
+		const int *nv( nverts.get() );
+		const int *v( verts.get() );
+
+		faceOffset = boost::shared_ptr< vector< unsigned > >( new vector< unsigned >( numFaces ) );
+		vector< float > centroids( 3 * numFaces, 0.0f );
+		for( unsigned face = 0, offset = 0; face < ( unsigned )numFaces; offset += nv[ face ], face++ ) {
+			( *faceOffset )[ face ] = offset;
+			for( int vertex = 0; vertex < nv[ face ]; vertex++ ) {
+				const float *p( P + 3 * v[ offset + vertex ] );
+				centroids[ 3 * face     ] += p[ 0 ];
+				centroids[ 3 * face + 1 ] += p[ 1 ];
+				centroids[ 3 * face + 2 ] += p[ 2 ];
+			}
+			if( nv[ face ] ) {
+				const float scale( 1.0f / nv[ face ] );
+				centroids[ 3 * face     ] *= scale;
+				centroids[ 3 * face + 1 ] *= scale;
+				centroids[ 3 * face + 2 ] *= scale;
+			}
+		}
+
+		grainFaces = boost::shared_ptr< vector< int > >( new vector< int >( numFaces ) );
+		vector< int >& faces( *grainFaces );
+		for( int face = 0; face < numFaces; face++ )
+			faces[ face ] = face;
+
+		// Split at the median of the longest axis until all chunks are small enough.
+		// The lower half is always split first so the chunks end up in order.
+		grainStart = boost::shared_ptr< vector< unsigned > >( new vector< unsigned > );
+		vector< pair< unsigned, unsigned > > ranges( 1, make_pair( 0u, ( unsigned )numFaces ) );
+		while( !ranges.empty() ) {
+			const unsigned begin( ranges.back().first );
+			const unsigned end( ranges.back().second );
+			ranges.pop_back();
+
+			if( end - begin <= maxFaces ) {
+				grainStart->push_back( begin );
+				continue;
+			}
+
+			float lo[ 3 ], hi[ 3 ];
+			lo[ 0 ] = lo[ 1 ] = lo[ 2 ] = numeric_limits< float >::max();
+			hi[ 0 ] = hi[ 1 ] = hi[ 2 ] = -numeric_limits< float >::max();
+			for( unsigned i = begin; i < end; i++ ) {
+				for( unsigned axis = 0; axis < 3; axis++ ) {
+					lo[ axis ] = min( lo[ axis ], centroids[ 3 * faces[ i ] + axis ] );
+					hi[ axis ] = max( hi[ axis ], centroids[ 3 * faces[ i ] + axis ] );
+				}
+			}
+			unsigned axis( 0 );
+			if( hi[ 1 ] - lo[ 1 ] > hi[ axis ] - lo[ axis ] )
+				axis = 1;
+			if( hi[ 2 ] - lo[ 2 ] > hi[ axis ] - lo[ axis ] )
+				axis = 2;
+
+			const unsigned middle( begin + ( end - begin ) / 2 );
+			nth_element( faces.begin() + begin, faces.begin() + middle, faces.begin() + end, centroidLess( centroids, axis ) );
+
+			ranges.push_back( make_pair( middle, end ) );
+			ranges.push_back( make_pair( begin, middle ) );
+		}
+		grainStart->push_back( numFaces );
+	}
+
+	// Copies the elements listed in indices out of a primitive variable with numElements elements
+	static tokenValue::tokenValuePtr gatherTokenValue( const tokenValue& aTokenValue, const vector< int >& indices, unsigned numElements ) {
+		// Float and int are both four bytes so we can copy words regardless of the type
+		const unsigned wordsPerElement( aTokenValue.byteSize() / ( sizeof( float ) * numElements ) );
+		const size_t size( indices.size() * wordsPerElement );
+
+		if( tokenValue::typeInteger == aTokenValue.type() ) {
+			const int *in( ( const int* )aTokenValue.data() );
+			boost::shared_ptr< int > values( new int[ size ], arrayDeleter() );
+			int *out( values.get() );
+			for( unsigned i = 0; i < indices.size(); i++, out += wordsPerElement )
+				memcpy( out, in + indices[ i ] * wordsPerElement, wordsPerElement * sizeof( int ) );
+			return tokenValue::tokenValuePtr( new tokenValue( values, size, aTokenValue.name(), aTokenValue.storage() ) );
+		} else {
+			const float *in( ( const float* )aTokenValue.data() );
+			boost::shared_ptr< float > values( new float[ size ], arrayDeleter() );
+			float *out( values.get() );
+			for( unsigned i = 0; i < indices.size(); i++, out += wordsPerElement )
+				memcpy( out, in + indices[ i ] * wordsPerElement, wordsPerElement * sizeof( float ) );
+			return tokenValue::tokenValuePtr( new tokenValue( values, size, aTokenValue.name(), aTokenValue.storage(), aTokenValue.type() ) );
+		}
+	}
+
+	void polyMeshData::writeGrain( unsigned grain ) const {
 		using namespace ueberMan;
 		ueberManInterface theRenderer;
 
+		if( !grainStart ) {
+			for( vector< boost::shared_ptr< tokenValue > >::const_iterator it = tokenValuePtrArray.begin(); it < tokenValuePtrArray.end(); it++ ) {
+				theRenderer.parameter( **it );
+			}
+			theRenderer.mesh( subDivScheme ? "catmull-clark" : "linear", numFaces, nverts.get(), verts.get(), boundary == boundarySharp, const_cast< string& >( identifier ) );
+			return;
+		}
+
+		const vector< int >& faces( *grainFaces );
+		const unsigned first( ( *grainStart )[ grain ] );
+		const unsigned last( ( *grainStart )[ grain + 1 ] );
+
+		// Renumber the vertices used by this chunk. Vertices on the border to
+		// other chunks get duplicated with the same values, so the seams match.
+		if( localIndex.size() != ( unsigned )numPoints )
+			localIndex.assign( numPoints, -1 );
+
+		vector< int > chunkFaces( faces.begin() + first, faces.begin() + last );
+		vector< int > chunkNverts, chunkVerts, chunkVertices, chunkFaceVertices;
+		chunkNverts.reserve( last - first );
+		for( unsigned i = first; i < last; i++ ) {
+			const int face( faces[ i ] );
+			const int n( nverts.get()[ face ] );
+			chunkNverts.push_back( n );
+			for( int vertex = 0; vertex < n; vertex++ ) {
+				const unsigned faceVertex( ( *faceOffset )[ face ] + vertex );
+				const int point( verts.get()[ faceVertex ] );
+				if( 0 > localIndex[ point ] ) {
+					localIndex[ point ] = chunkVertices.size();
+					chunkVertices.push_back( point );
+				}
+				chunkVerts.push_back( localIndex[ point ] );
+				chunkFaceVertices.push_back( faceVertex );
+			}
+		}
+		for( vector< int >::const_iterator it = chunkVertices.begin(); it < chunkVertices.end(); it++ )
+			localIndex[ *it ] = -1;
+
 		for( vector< boost::shared_ptr< tokenValue > >::const_iterator it = tokenValuePtrArray.begin(); it < tokenValuePtrArray.end(); it++ ) {
-			theRenderer.parameter( **it );
+			switch( ( *it )->storage() ) {
+				case tokenValue::storageVertex:
+				case tokenValue::storageVarying:
+					theRenderer.parameter( *gatherTokenValue( **it, chunkVertices, numPoints ) );
+					break;
+				case tokenValue::storageFaceVarying:
+				case tokenValue::storageFaceVertex:
+					theRenderer.parameter( *gatherTokenValue( **it, chunkFaceVertices, numFaceVertices ) );
+					break;
+				case tokenValue::storageUniform:
+					theRenderer.parameter( *gatherTokenValue( **it, chunkFaces, numFaces ) );
+					break;
+				default:
+					theRenderer.parameter( **it );
+			}
+		}
+
+		string grainIdentifier( identifier + ".chunk" + toString( grain ) );
+		theRenderer.mesh( "linear", chunkNverts.size(), &( chunkNverts[ 0 ] ), &( chunkVerts[ 0 ] ), boundary == boundarySharp, grainIdentifier );
+	}
+
+	vector< float > polyMeshData::grainBoundingBox( unsigned grain ) const {
+		if( !grainStart )
+			return bound;
+
+		const float *P( NULL );
+		for( vector< boost::shared_ptr< tokenValue > >::const_iterator it = tokenValuePtrArray.begin(); it < tokenValuePtrArray.end(); it++ ) {
+			if( "P" == ( *it )->name() ) {
+				P = ( const float* )( *it )->data();
+				break;
+			}
 		}
-		theRenderer.mesh( subDivScheme ? "catmull-clark" : "linear", numFaces, nverts.get(), verts.get(), boundary == boundarySharp, const_cast< string& >( identifier ) );
+
+		vector< float > grainBound( 6 );
+		grainBound[ 0 ] = grainBound[ 2 ] = grainBound[ 4 ] = numeric_limits< float >::max();
+		grainBound[ 1 ] = grainBound[ 3 ] = grainBound[ 5 ] = -numeric_limits< float >::max();
+
+		const vector< int >& faces( *grainFaces );
+		for( unsigned i = ( *grainStart )[ grain ]; i < ( *grainStart )[ grain + 1 ]; i++ ) {
+			const int face( faces[ i ] );
+			for( int vertex = 0; vertex < nverts.get()[ face ]; vertex++ ) {
+				const float *p( P + 3 * verts.get()[ ( *faceOffset )[ face ] + vertex ] );
+				for( unsigned axis = 0; axis < 3; axis++ ) {
+					grainBound[ 2 * axis ]		= min( grainBound[ 2 * axis ], p[ axis ] );
+					grainBound[ 2 * axis + 1 ]	= max( grainBound[ 2 * axis + 1 ], p[ axis ] );
+				}
+			}
+		}
+
+		return grainBound;
 	}
 }
@@ -295,6 +295,10 @@ XSIPLUGINCALLBACK CStatus AffogatoEnvironmentMapGenerator_Define( const CRef& in
 						L"Far Clip", CValue(),
 						32768.0f, 0.0f, 1.0e38f, 0.0f, 100000.0f, param );
 
+	prop.AddParameter(	L"ReuseUnchanged", CValue::siBool, caps,
+						L"Reuse Unchanged Maps", CValue(),
+						false, param );
+
 	return CStatus::OK;
 }
 
@@ -433,6 +437,14 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_Define( const CRef& inContext ) {
 						L"Deformation Motion Segments", CValue(),
 						1l, 0l, 15l, 0l, 15l, param );
 
+	prop.AddParameter(	L"MotionSampleReduction", CValue::siUInt1, caps,
+						L"Motion Sample Reduction", CValue(),
+						1l, 0l, 2l, 0l, 2l, param );
+
+	prop.AddParameter(	L"MotionSampleEpsilon", CValue::siFloat, caps,
+						L"Motion Sample Epsilon", CValue(),
+						0.0, 0.0, 1.0, 0.0, 0.001, param );
+
 	prop.AddParameter(	L"MotionFactor", CValue::siFloat, caps,
 						L"Motion Factor", CValue(),
 						2.0, 0.0, 1024.0, 0.0, 32.0, param );
@@ -469,6 +481,10 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_Define( const CRef& inContext ) {
 						L"Geometry Variable Motion Blur", CValue(),
 						false, param );
 
+	prop.AddParameter(	L"VelocityMotionBlur", CValue::siBool, caps,
+						L"Velocity Motion Blur", CValue(),
+						false, param );
+
 	prop.AddParameter(	L"CameraMotionBlur", CValue::siBool, caps,
 						L"Camera Motion Blur", CValue(),
 						true, param );
@@ -782,6 +798,34 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_Define( const CRef& inContext ) {
 						L"Delay Data", CValue(),
 						true, param );
 
+	prop.AddParameter(	L"MeshChunkSize", CValue::siUInt4, caps,
+						L"Mesh Chunk Size", CValue(),
+						0l, 0l, 16777216l, 0l, 1048576l, param );
+
+	prop.AddParameter(	L"CollapsePrimvars", CValue::siBool, caps,
+						L"Collapse Primvars", CValue(),
+						false, param );
+
+	prop.AddParameter(	L"CommandStream", CValue::siBool, caps,
+						L"Command Stream", CValue(),
+						false, param );
+
+	prop.AddParameter(	L"QuantizeTextureCoordinates", CValue::siFloat, caps,
+						L"Quantize Texture Coordinates", CValue(),
+						0.0, 0.0, 1.0, 0.0, 0.001, param );
+
+	prop.AddParameter(	L"QuantizeColors", CValue::siFloat, caps,
+						L"Quantize Colors", CValue(),
+						0.0, 0.0, 1.0, 0.0, 0.01, param );
+
+	prop.AddParameter(	L"QuantizeWidths", CValue::siFloat, caps,
+						L"Quantize Widths", CValue(),
+						0.0, 0.0, 1.0, 0.0, 0.001, param );
+
+	prop.AddParameter(	L"QuantizePoints", CValue::siFloat, caps,
+						L"Quantize Points", CValue(),
+						0.0, 0.0, 1.0, 0.0, 0.001, param );
+
 	prop.AddParameter(	L"AttributeDataType", CValue::siUInt1, caps,
 						L"Attribute Data Type", CValue(),
 						0l, 0l, 1l, 0l, 1l, param );
@@ -794,6 +838,10 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_Define( const CRef& inContext ) {
 						L"Compress Data", CValue(),
 						false, param );
 
+	prop.AddParameter(	L"NativeRIBWriter", CValue::siBool, caps,
+						L"Native RIB Writer", CValue(),
+						false, param );
+
 #ifdef RSP
 	prop.AddParameter(	L"HubSupport", CValue::siBool, caps,
 						L"HUB Support", CValue(),
@@ -808,6 +856,10 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_Define( const CRef& inContext ) {
 						L"Attribute Data Scanning Order", CValue(),
 						0l, 0l, 1l, 0l, 1l, param );
 
+	prop.AddParameter(	L"AttributeMode", CValue::siUInt1, caps,
+						L"Attribute Mode", CValue(),
+						1l, 0l, 1l, 0l, 1l, param );
+
 	prop.AddParameter(	L"FrameData", CValue::siBool, caps,
 						L"Output Frame Data", CValue(),
 						true, param );
@@ -910,6 +962,14 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_Define( const CRef& inContext ) {
 						L"Stopwatch", CValue(),
 						false, param );
 
+	prop.AddParameter(	L"RendererStatistics", CValue::siUInt1, caps,
+						L"Renderer Statistics", CValue(),
+						0l, 0l, 2l, 0l, 2l, param );
+
+	prop.AddParameter(	L"XMLDebugOutput", CValue::siBool, caps,
+						L"XML Debug Output", CValue(),
+						false, param );
+
 	// Default Shader
 	prop.AddParameter(	L"DefaultSurfaceShader", CValue::siString, caps,
 						L"Default Surface Shader", CValue(),
@@ -1486,6 +1546,8 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_PPGEvent( const CRef& inContext ) {
 								item.PutLabelMinPixels( LABEL_WIDTH );
 								item = layout.AddItem( L"GeometryVariableMotionBlur", L"Geometry Variables" );
 								item.PutLabelMinPixels( LABEL_WIDTH );
+								item = layout.AddItem( L"VelocityMotionBlur", L"Mesh Velocity" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
 								item = layout.AddItem( L"CameraMotionBlur", L"Camera" );
 								item.PutLabelMinPixels( LABEL_WIDTH );
 								item = layout.AddItem( L"ShadowMapMotionBlur", L"Shadow Maps" );
@@ -1535,6 +1597,17 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_PPGEvent( const CRef& inContext ) {
 								item.PutLabelMinPixels( LABEL_WIDTH );
 								item = layout.AddItem( L"DeformationMotionSegments", L"Deformation" );
 								item.PutLabelMinPixels( LABEL_WIDTH );
+								tmpArray.Clear();
+								tmpArray.Add( L"Off" );
+								tmpArray.Add( 0l );
+								tmpArray.Add( L"Drop Static Samples" );
+								tmpArray.Add( 1l );
+								tmpArray.Add( L"Drop Static & Linear Samples" );
+								tmpArray.Add( 2l );
+								item = layout.AddEnumControl( L"MotionSampleReduction", tmpArray, L"Reduction", L"Combo" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
+								item = layout.AddItem( L"MotionSampleEpsilon", L"Epsilon" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
 							layout.EndGroup();
 
 						layout.EndGroup();
@@ -1783,6 +1856,20 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_PPGEvent( const CRef& inContext ) {
 								item.PutLabelMinPixels( LABEL_WIDTH );
 								item = layout.AddItem( L"DelayData", L"Delayed Archives" );
 								item.PutLabelMinPixels( LABEL_WIDTH );
+								item = layout.AddItem( L"MeshChunkSize", L"Split Meshes Above (Faces)" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
+								item = layout.AddItem( L"CollapsePrimvars", L"Per Point Seamless UVs/Colors" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
+								item = layout.AddItem( L"CommandStream", L"Record Command Stream" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
+								item = layout.AddItem( L"QuantizeTextureCoordinates", L"UV Tolerance" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
+								item = layout.AddItem( L"QuantizeColors", L"Color Tolerance" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
+								item = layout.AddItem( L"QuantizeWidths", L"Width Tolerance" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
+								item = layout.AddItem( L"QuantizePoints", L"Point Tolerance" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
 
 								tmpArray.Clear();
 								tmpArray.Add( L"Renderer" );
@@ -1796,6 +1883,8 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_PPGEvent( const CRef& inContext ) {
 								item.PutLabelMinPixels( LABEL_WIDTH );
 								item = layout.AddItem( L"CompressData", L"Compressed" );
 								item.PutLabelMinPixels( LABEL_WIDTH );
+								item = layout.AddItem( L"NativeRIBWriter", L"Native Writer" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
 #ifdef RSP
 								item = layout.AddItem( L"HubSupport" );
 								item.PutLabelMinPixels( LABEL_WIDTH );
@@ -1814,6 +1903,13 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_PPGEvent( const CRef& inContext ) {
 								tmpArray.Add( 1l );
 								item = layout.AddEnumControl( L"AttributeDataScanningOrder", tmpArray, L"Final Attributes From", L"Combo" );
 								item.PutLabelMinPixels( LABEL_WIDTH );
+								tmpArray.Clear();
+								tmpArray.Add( L"Shared Looks" );
+								tmpArray.Add( 0l );
+								tmpArray.Add( L"Inline" );
+								tmpArray.Add( 1l );
+								item = layout.AddEnumControl( L"AttributeMode", tmpArray, L"Object Attributes", L"Combo" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
 
 							layout.EndGroup();
 
@@ -1835,6 +1931,17 @@ XSIPLUGINCALLBACK CStatus AffogatoGlobals_PPGEvent( const CRef& inContext ) {
 								item.PutLabelMinPixels( LABEL_WIDTH );
 								item = layout.AddItem( L"Stopwatch" );
 								item.PutLabelMinPixels( LABEL_WIDTH );
+								tmpArray.Clear();
+								tmpArray.Add( L"Off" );
+								tmpArray.Add( 0l );
+								tmpArray.Add( L"Collect" );
+								tmpArray.Add( 1l );
+								tmpArray.Add( L"Collect Only (No Output)" );
+								tmpArray.Add( 2l );
+								item = layout.AddEnumControl( L"RendererStatistics", tmpArray, L"Renderer Statistics", L"Combo" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
+								item = layout.AddItem( L"XMLDebugOutput", L"XML Debug Output" );
+								item.PutLabelMinPixels( LABEL_WIDTH );
 								item = layout.AddItem( L"ShaderDebugging" );
 								item.PutLabelMinPixels( LABEL_WIDTH );
 							layout.EndGroup();
@@ -0,0 +1,230 @@
+/** Per frame lookup index of the properties of scene objects.
+ *
+ *  The indices are keyed by the full name of the object resp. property
+ *  and dropped as soon as the frame time in the globals changes.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+// Standard headers
+#include <map>
+#include <string>
+
+// Boost headers
+#include <boost/algorithm/string/case_conv.hpp>
+
+// XSI headers
+#include <xsi_application.h>
+#include <xsi_group.h>
+#include <xsi_model.h>
+#include <xsi_parameter.h>
+#include <xsi_property.h>
+#include <xsi_x3dobject.h>
+
+// Affogato headers
+#include "affogatoGlobals.hpp"
+#include "affogatoHelpers.hpp"
+#include "affogatoPropertyIndex.hpp"
+
+
+namespace affogato {
+
+	using namespace XSI;
+	using namespace std;
+
+	static map< string, propertyIndex > objectIndices;
+	static map< string, propertyIndex::parameterVector > propertyParameters;
+	static map< string, string > propertyGroups;
+	static CRefArray visibleSpheres;
+	static bool spheresValid( false );
+	static map< long, CRefArray > blobbies;
+	static bool blobbiesValid( false );
+	static double indexTime( 0 );
+	static bool indexValid( false );
+
+	void propertyIndex::checkFrame() {
+		const double time( globals::access().animation.time );
+		if( !indexValid || ( time != indexTime ) ) {
+			clear();
+			indexTime = time;
+			indexValid = true;
+		}
+	}
+
+	void propertyIndex::clear() {
+		objectIndices.clear();
+		propertyParameters.clear();
+		propertyGroups.clear();
+		visibleSpheres.Clear();
+		spheresValid = false;
+		blobbies.clear();
+		blobbiesValid = false;
+		indexValid = false;
+	}
+
+	const propertyIndex& propertyIndex::access( const X3DObject& obj ) {
+		checkFrame();
+
+		const string name( CStringToString( obj.GetFullName() ) );
+		map< string, propertyIndex >::iterator it( objectIndices.find( name ) );
+		if( objectIndices.end() == it )
+			it = objectIndices.insert( make_pair( name, propertyIndex( obj ) ) ).first;
+
+		return it->second;
+	}
+
+	const propertyIndex::parameterVector& propertyIndex::parameters( const Property& prop ) {
+		checkFrame();
+
+		const string name( CStringToString( prop.GetFullName() ) );
+		map< string, parameterVector >::iterator it( propertyParameters.find( name ) );
+		if( propertyParameters.end() == it ) {
+			it = propertyParameters.insert( make_pair( name, parameterVector() ) ).first;
+
+			CParameterRefArray params( prop.GetParameters() );
+			it->second.resize( params.GetCount() );
+			for( unsigned p = 0; p < ( unsigned )params.GetCount(); p++ ) {
+				parameterEntry& entry( it->second[ p ] );
+				entry.parameter = params[ p ];
+				entry.originalName = CStringToString( entry.parameter.GetName() );
+				entry.name = boost::to_lower_copy( entry.originalName );
+			}
+		}
+
+		return it->second;
+	}
+
+	const string& propertyIndex::parameterEntry::expand( const string& value ) const {
+		if( !compiled || ( value != source ) ) {
+			valueTemplate = pathTemplate( value );
+			source = value;
+			compiled = true;
+		}
+		return valueTemplate.render();
+	}
+
+	const string& propertyIndex::group( const Property& prop ) {
+		checkFrame();
+
+		const string name( CStringToString( prop.GetFullName() ) );
+		map< string, string >::iterator it( propertyGroups.find( name ) );
+		if( propertyGroups.end() == it ) {
+			it = propertyGroups.insert( make_pair( name, string() ) ).first;
+
+			CRefArray owners( prop.GetOwners() );
+			CRefArray groups;
+			owners.Filter( siGroup, CStringArray(), CString(), groups );
+			if( groups.GetCount() )
+				it->second = getAffogatoName( CStringToString( Group( groups[ 0 ] ).GetFullName() ) );
+		}
+
+		return it->second;
+	}
+
+	const CRefArray& propertyIndex::spheres() {
+		checkFrame();
+
+		if( !spheresValid ) {
+			Application app;
+			Model sceneRoot( app.GetActiveSceneRoot() );
+			CRefArray objects( sceneRoot.FindChildren( CString(), siSpherePrimType, CStringArray() ) );
+			for( unsigned i = 0; i < ( unsigned )objects.GetCount(); i++ ) {
+				if( isVisible( X3DObject( objects[ i ] ) ) )
+					visibleSpheres.Add( objects[ i ] );
+			}
+			spheresValid = true;
+		}
+
+		return visibleSpheres;
+	}
+
+	const CRefArray& propertyIndex::blobbyMembers( long id ) {
+		checkFrame();
+
+		// Sort all spheres into their blobbies in one go
+		if( !blobbiesValid ) {
+			const CRefArray& objects( spheres() );
+			for( unsigned i = 0; i < ( unsigned )objects.GetCount(); i++ ) {
+				const Parameter *blobbyId( access( X3DObject( objects[ i ] ) ).findParameter( "blobbyid" ) );
+				if( blobbyId )
+					blobbies[ ( long )blobbyId->GetValue() ].Add( objects[ i ] );
+			}
+			blobbiesValid = true;
+		}
+
+		return blobbies[ id ];
+	}
+
+	propertyIndex::propertyIndex( const X3DObject& obj ) : props( obj.GetProperties() ) {
+		affogatoFlags.resize( props.GetCount() );
+		for( unsigned i = 0; i < ( unsigned )props.GetCount(); i++ ) {
+			Property prop( props[ i ] );
+
+			// First one of each type wins, just like a linear search would
+			const string type( CStringToString( prop.GetType() ) );
+			if( types.end() == types.find( type ) )
+				types[ type ] = props[ i ];
+
+			affogatoFlags[ i ] = isAffogatoProperty( prop );
+			if( affogatoFlags[ i ] ) {
+				const parameterVector& params( parameters( prop ) );
+				for( parameterVector::const_iterator it = params.begin(); it < params.end(); it++ ) {
+					if( affogatoParameters.end() == affogatoParameters.find( it->name ) )
+						affogatoParameters[ it->name ] = it->parameter;
+				}
+			}
+		}
+	}
+
+	const CRefArray& propertyIndex::properties() const {
+		return props;
+	}
+
+	bool propertyIndex::isAffogato( unsigned i ) const {
+		return affogatoFlags[ i ];
+	}
+
+	CRef propertyIndex::findType( const CString& type ) const {
+		map< string, CRef >::const_iterator it( types.find( CStringToString( type ) ) );
+		return ( types.end() == it ) ? CRef() : it->second;
+	}
+
+	const Parameter* propertyIndex::findParameter( const string& name ) const {
+		map< string, Parameter >::const_iterator it( affogatoParameters.find( name ) );
+		return ( affogatoParameters.end() == it ) ? NULL : &it->second;
+	}
+}
@@ -62,6 +62,7 @@
 // Affogato headers
 #include "affogatoHelpers.hpp"
 #include "affogatoRenderer.hpp"
+#include "affogatoRendererQueue.hpp"
 #include "affogatoTokenValue.hpp"
 
 #define ueberManInterfaceCallAll(x) { for( vector< ueberMan* >::iterator it = rendererList.begin(); it < rendererList.end(); it++ ) \
@@ -92,21 +93,32 @@ namespace ueberMan {
 		debugMessage( L"Constructing ueberManInterface" );
 	}
 
-	void ueberManInterface::registerRenderer( const ueberMan& theRenderer ) {
+	void ueberManInterface::registerRenderer( const ueberMan& theRenderer, bool queued ) {
 
 		// Check renderer list here to make sure the renderer doesn't exist already
-		for( vector< ueberMan* >::iterator it = rendererList.begin(); it < rendererList.end(); it++ ) {
-			if( &theRenderer == *it ) {
+		bool registered = false;
+		for( vector< ueberMan* >::iterator it = rendererList.begin(); it < rendererList.end(); it++ )
+			registered |= ( &theRenderer == *it );
+		for( vector< boost::shared_ptr< ueberManQueue > >::iterator it = queueList.begin(); it < queueList.end(); it++ )
+			registered |= ( &theRenderer == ( *it )->target() );
+
+		if( registered ) {
 
-				debugMessage( L"UeberMan: Ignored attempt to register renderer twice" );
+			debugMessage( L"UeberMan: Ignored attempt to register renderer twice" );
 #ifndef __XSI_PLUGIN
-				fprintf( stderr, "Ignored attempt to register renderer twice" );
-				fflush( stderr );
+			fprintf( stderr, "Ignored attempt to register renderer twice" );
+			fflush( stderr );
 #endif
-				return;
-			}
+			return;
+		}
+
+		if( queued ) {
+			boost::shared_ptr< ueberManQueue > queue( new ueberManQueue( theRenderer ) );
+			queueList.push_back( queue );
+			rendererList.push_back( queue.get() );
+		} else {
+			rendererList.push_back( const_cast< ueberMan* >( &theRenderer ) );
 		}
-		rendererList.push_back( const_cast< ueberMan* >( &theRenderer ) );
 
 		debugMessage( L"UeberMan: Registered Renderer No. " + CValue( (long) rendererList.size() ).GetAsText() );
 #ifndef __XSI_PLUGIN
@@ -116,12 +128,30 @@ namespace ueberMan {
 	}
 
 	void ueberManInterface::unregisterRenderer( const ueberMan& theRenderer ) {
+		const ueberMan* entry = &theRenderer;
+
+		for( vector< boost::shared_ptr< ueberManQueue > >::iterator it = queueList.begin(); it < queueList.end(); it++ ) {
+			if( &theRenderer == ( *it )->target() ) {
+				( *it )->flush();
+				entry = it->get();
+				break;
+			}
+		}
+
 		for( vector< ueberMan* >::iterator it = rendererList.begin(); it < rendererList.end(); it++ ) {
-			if( &theRenderer == *it ) {
+			if( entry == *it ) {
 				rendererList.erase( it );
 				break;
 			}
 		}
+
+		// Destroying the queue joins its worker thread
+		for( vector< boost::shared_ptr< ueberManQueue > >::iterator it = queueList.begin(); it < queueList.end(); it++ ) {
+			if( entry == it->get() ) {
+				queueList.erase( it );
+				break;
+			}
+		}
 	}
 
 	context ueberManInterface::beginScene( const string& destination, bool useBinary, bool useCompression ) {
@@ -429,7 +459,7 @@ namespace ueberMan {
 		ueberManInterfaceCallAll( appendLook( lookId ) );
 	}
 
-	set< lookHandle > ueberManInterface::getLooks() {
+	const set< lookHandle >& ueberManInterface::getLooks() {
 		return lookSet;
 	}
 
@@ -500,6 +530,10 @@ namespace ueberMan {
 		ueberManInterfaceCallAll( makeMap( type ) );
 	}
 
+	void ueberManInterface::archiveRecord( const string& type, const string& record ) {
+		ueberManInterfaceCallAll( archiveRecord( type, record ) );
+	}
+
 	string getHandle( const string& type, int number ) {
 		stringstream ss;
 		ss << "__ueberMan" << type << "Handle" << number;
@@ -556,6 +590,7 @@ namespace ueberMan {
 
 
 	vector< ueberMan* >ueberManInterface::rendererList;
+	vector< boost::shared_ptr< ueberManQueue > >ueberManInterface::queueList;
 	map< context, boost::shared_ptr< vector< context > > >ueberManInterface::contextArrayMap;
 	ueberManInterface ueberManInterface::theUeberManInterface;
 	context ueberManInterface::contextCounter = 0;
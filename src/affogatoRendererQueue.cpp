@@ -0,0 +1,532 @@
+/** Asynchronous command queue for an ueberMan renderer.
+ *
+ *  Every call is bound together with copies of its arguments and
+ *  appended to a queue. A worker thread swaps the whole queue out
+ *  under the lock and executes the batch without holding it, so the
+ *  calling thread only ever contends for the time of a push_back().
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+// Standard headers
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Boost headers
+#include <boost/bind.hpp>
+
+// XSI headers
+#ifdef __XSI_PLUGIN
+	#include <xsi_application.h>
+#else
+	#include <stdio.h>
+#endif
+
+// Affogato headers
+#include "affogatoHelpers.hpp"
+#include "affogatoRendererQueue.hpp"
+
+
+namespace ueberMan {
+
+#ifdef __XSI_PLUGIN
+	using namespace XSI;
+#endif
+	using namespace std;
+	using namespace affogato;
+
+	// Overloaded virtuals need an explicit member pointer type to be bound
+	typedef void ( ueberMan::*inputFunc )( const string& );
+	typedef void ( ueberMan::*tokenValueArrayFunc )( const vector< tokenValue >& );
+	typedef void ( ueberMan::*tokenValueFunc )( const tokenValue& );
+	typedef void ( ueberMan::*stringValueFunc )( const string&, const string& );
+	typedef void ( ueberMan::*floatValueFunc )( const string&, const float );
+	typedef void ( ueberMan::*intValueFunc )( const string&, const int );
+	typedef void ( ueberMan::*boolValueFunc )( const string&, const bool );
+	typedef void ( ueberMan::*matrixFunc )( const vector< float >& );
+	typedef void ( ueberMan::*spaceFunc )( const spaceHandle& );
+	typedef void ( ueberMan::*curvesFunc )( const string&, const int, const int, const bool, primitiveHandle& );
+	typedef void ( ueberMan::*curvesArrayFunc )( const string&, const int, const vector< int >&, const bool, primitiveHandle& );
+	typedef void ( ueberMan::*nuCurvesFunc )( const int, const vector< int >&, const vector< int >&, const vector< float >&, const vector< float >&, const vector< float >&, primitiveHandle& );
+	typedef void ( ueberMan::*patchFunc )( const string&, const int, const int, primitiveHandle& );
+	typedef void ( ueberMan::*sphereFunc )( const float, const float, const float, const float, primitiveHandle& );
+
+	ueberManQueue::ueberManQueue( const ueberMan& theRenderer )
+	:	renderer( const_cast< ueberMan* >( &theRenderer ) ),
+		contextCounter( 0 ),
+		currentContext( contextUndefined ),
+		busy( false ),
+		quit( false )
+	{
+		worker = boost::shared_ptr< boost::thread >( new boost::thread( boost::bind( &ueberManQueue::run, this ) ) );
+	}
+
+	ueberManQueue::~ueberManQueue() {
+		{
+			boost::mutex::scoped_lock lock( mutex );
+			quit = true;
+			workAvailable.notify_one();
+		}
+		worker->join();
+	}
+
+	const ueberMan* ueberManQueue::target() const {
+		return renderer;
+	}
+
+	void ueberManQueue::record( const command& cmd ) {
+		boost::mutex::scoped_lock lock( mutex );
+		while( maxPending <= pending.size() )
+			spaceAvailable.wait( lock );
+		pending.push_back( cmd );
+		workAvailable.notify_one();
+	}
+
+	void ueberManQueue::run() {
+		deque< command > batch;
+		for( ;; ) {
+			{
+				boost::mutex::scoped_lock lock( mutex );
+				busy = false;
+				while( pending.empty() ) {
+					drained.notify_all();
+					if( quit )
+						return;
+					workAvailable.wait( lock );
+				}
+				batch.swap( pending );
+				busy = true;
+				spaceAvailable.notify_all();
+			}
+
+			for( deque< command >::iterator it = batch.begin(); it < batch.end(); it++ ) {
+				try {
+					( *it )();
+				}
+				catch( std::exception& err ) {
+					boost::mutex::scoped_lock lock( mutex );
+					lastError = err.what();
+				}
+				catch( ... ) {
+					boost::mutex::scoped_lock lock( mutex );
+					lastError = "Unknown exception";
+				}
+			}
+			batch.clear();
+		}
+	}
+
+	bool ueberManQueue::flush() {
+		string error;
+		{
+			boost::mutex::scoped_lock lock( mutex );
+			while( busy || !pending.empty() )
+				drained.wait( lock );
+			error.swap( lastError );
+		}
+
+		if( !error.empty() ) {
+#ifdef __XSI_PLUGIN
+			message( L"UeberMan: Queued renderer failed: " + stringToCString( error ), messageError );
+#else
+			fprintf( stderr, "UeberMan: Queued renderer failed: %s\n", error.c_str() );
+			fflush( stderr );
+#endif
+			return false;
+		}
+
+		return true;
+	}
+
+	void ueberManQueue::doBeginScene( context ctx, const string& destination, bool useBinary, bool useCompression ) {
+		contextMap[ ctx ] = renderer->beginScene( destination, useBinary, useCompression );
+	}
+
+	void ueberManQueue::doSwitchScene( context ctx ) {
+		map< context, context >::iterator it = contextMap.find( ctx );
+		if( contextMap.end() != it )
+			renderer->switchScene( it->second );
+	}
+
+	void ueberManQueue::doEndScene( context ctx ) {
+		map< context, context >::iterator it = contextMap.find( ctx );
+		if( contextMap.end() != it ) {
+			renderer->endScene( it->second );
+			contextMap.erase( it );
+		}
+	}
+
+	void ueberManQueue::doInput( const string& filename, boost::shared_array< float > bound ) {
+		renderer->input( filename, bound.get() );
+	}
+
+	void ueberManQueue::doPatch( boost::shared_ptr< nuPatchData > data, primitiveHandle identifier ) {
+		renderer->patch( data->nu, data->uorder, &data->uknot[ 0 ], data->umin, data->umax,
+						 data->nv, data->vorder, &data->vknot[ 0 ], data->vmin, data->vmax, identifier );
+	}
+
+	void ueberManQueue::doMesh( const string& interp, const int nfaces, boost::shared_ptr< vector< int > > nverts, boost::shared_ptr< vector< int > > verts, const bool interpolateBoundary, primitiveHandle identifier ) {
+		if( !nverts->empty() )
+			renderer->mesh( interp, nfaces, &( *nverts )[ 0 ], verts->empty() ? NULL : &( *verts )[ 0 ], interpolateBoundary, identifier );
+	}
+
+	context ueberManQueue::beginScene( const string& destination, bool useBinary, bool useCompression ) {
+		currentContext = ++contextCounter;
+		record( boost::bind( &ueberManQueue::doBeginScene, this, currentContext, destination, useBinary, useCompression ) );
+		return currentContext;
+	}
+
+	void ueberManQueue::switchScene( context ctx ) {
+		currentContext = ctx;
+		record( boost::bind( &ueberManQueue::doSwitchScene, this, ctx ) );
+	}
+
+	context ueberManQueue::currentScene() {
+		return currentContext;
+	}
+
+	void ueberManQueue::endScene( context ctx ) {
+		record( boost::bind( &ueberManQueue::doEndScene, this, contextUndefined == ctx ? currentContext : ctx ) );
+	}
+
+	void ueberManQueue::input( const string& filename ) {
+		record( boost::bind( ( inputFunc )&ueberMan::input, renderer, filename ) );
+	}
+
+	void ueberManQueue::input( const string& filename, const float *bound ) {
+		boost::shared_array< float > boundCopy( new float[ 6 ] );
+		copy( bound, bound + 6, boundCopy.get() );
+		record( boost::bind( &ueberManQueue::doInput, this, filename, boundCopy ) );
+	}
+
+	void ueberManQueue::camera( cameraHandle& cameraid ) {
+		record( boost::bind( &ueberMan::camera, renderer, cameraid ) );
+	}
+
+	void ueberManQueue::output( const string& name, const string& format, const string& dataname, const cameraHandle& cameraid ) {
+		record( boost::bind( &ueberMan::output, renderer, name, format, dataname, cameraid ) );
+	}
+
+	void ueberManQueue::world() {
+		record( boost::bind( &ueberMan::world, renderer ) );
+	}
+
+	void ueberManQueue::render( const cameraHandle& cameraid ) {
+		record( boost::bind( &ueberMan::render, renderer, cameraid ) );
+		// Anything run after a render (jobs, post frame commands) may
+		// depend on the output being complete
+		flush();
+		contextMap.clear();
+	}
+
+	void ueberManQueue::motion( const vector< float >& times ) {
+		record( boost::bind( &ueberMan::motion, renderer, times ) );
+	}
+
+	void ueberManQueue::parameter( const vector< tokenValue > &tokenValueArray ) {
+		record( boost::bind( ( tokenValueArrayFunc )&ueberMan::parameter, renderer, tokenValueArray ) );
+	}
+
+	void ueberManQueue::parameter( const tokenValue &aTokenValue ) {
+		record( boost::bind( ( tokenValueFunc )&ueberMan::parameter, renderer, aTokenValue ) );
+	}
+
+	void ueberManQueue::parameter( const string& typedname, const string& value ) {
+		record( boost::bind( ( stringValueFunc )&ueberMan::parameter, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::parameter( const string& typedname, const float value ) {
+		record( boost::bind( ( floatValueFunc )&ueberMan::parameter, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::parameter( const string& typedname, const int value ) {
+		record( boost::bind( ( intValueFunc )&ueberMan::parameter, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::parameter( const string& typedname, const bool value ) {
+		record( boost::bind( ( boolValueFunc )&ueberMan::parameter, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::variable( const vector< tokenValue > &tokenValueArray ) {
+		record( boost::bind( ( tokenValueArrayFunc )&ueberMan::variable, renderer, tokenValueArray ) );
+	}
+
+	void ueberManQueue::variable( const tokenValue &aTokenValue ) {
+		record( boost::bind( ( tokenValueFunc )&ueberMan::variable, renderer, aTokenValue ) );
+	}
+
+	void ueberManQueue::variable( const string& typedname, const string& value ) {
+		record( boost::bind( ( stringValueFunc )&ueberMan::variable, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::variable( const string& typedname, const float value ) {
+		record( boost::bind( ( floatValueFunc )&ueberMan::variable, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::variable( const string& typedname, const int value ) {
+		record( boost::bind( ( intValueFunc )&ueberMan::variable, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::variable( const string& typedname, const bool value ) {
+		record( boost::bind( ( boolValueFunc )&ueberMan::variable, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::attribute( const tokenValue &aTokenValue ) {
+		record( boost::bind( ( tokenValueFunc )&ueberMan::attribute, renderer, aTokenValue ) );
+	}
+
+	void ueberManQueue::attribute( const string& typedname, const string& value ) {
+		record( boost::bind( ( stringValueFunc )&ueberMan::attribute, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::attribute( const string& typedname, const float value ) {
+		record( boost::bind( ( floatValueFunc )&ueberMan::attribute, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::attribute( const string& typedname, const int value ) {
+		record( boost::bind( ( intValueFunc )&ueberMan::attribute, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::attribute( const string& typedname, const bool value ) {
+		record( boost::bind( ( boolValueFunc )&ueberMan::attribute, renderer, typedname, value ) );
+	}
+
+	bool ueberManQueue::getAttribute( const string& typedname, float &value ) {
+		flush();
+		return renderer->getAttribute( typedname, value );
+	}
+
+	bool ueberManQueue::getAttribute( const string& typedname, int &value ) {
+		flush();
+		return renderer->getAttribute( typedname, value );
+	}
+
+	bool ueberManQueue::getAttribute( const string& typedname, string& value ) {
+		flush();
+		return renderer->getAttribute( typedname, value );
+	}
+
+	void ueberManQueue::pushAttributes() {
+		record( boost::bind( &ueberMan::pushAttributes, renderer ) );
+	}
+
+	void ueberManQueue::popAttributes() {
+		record( boost::bind( &ueberMan::popAttributes, renderer ) );
+	}
+
+	void ueberManQueue::option( const tokenValue &aTokenValue ) {
+		record( boost::bind( ( tokenValueFunc )&ueberMan::option, renderer, aTokenValue ) );
+	}
+
+	void ueberManQueue::option( const string& typedname, const string& value ) {
+		record( boost::bind( ( stringValueFunc )&ueberMan::option, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::option( const string& typedname, const float value ) {
+		record( boost::bind( ( floatValueFunc )&ueberMan::option, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::option( const string& typedname, const int value ) {
+		record( boost::bind( ( intValueFunc )&ueberMan::option, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::option( const string& typedname, const bool value ) {
+		record( boost::bind( ( boolValueFunc )&ueberMan::option, renderer, typedname, value ) );
+	}
+
+	void ueberManQueue::pushSpace() {
+		record( boost::bind( &ueberMan::pushSpace, renderer ) );
+	}
+
+	void ueberManQueue::popSpace() {
+		record( boost::bind( &ueberMan::popSpace, renderer ) );
+	}
+
+	void ueberManQueue::space( const vector< float >& matrix ) {
+		record( boost::bind( ( matrixFunc )&ueberMan::space, renderer, matrix ) );
+	}
+
+	void ueberManQueue::space( const spaceHandle &spacename ) {
+		record( boost::bind( ( spaceFunc )&ueberMan::space, renderer, spacename ) );
+	}
+
+	void ueberManQueue::nameSpace( spaceHandle& spacename ) {
+		record( boost::bind( &ueberMan::nameSpace, renderer, spacename ) );
+	}
+
+	void ueberManQueue::appendSpace( const vector< float >& matrix ) {
+		record( boost::bind( &ueberMan::appendSpace, renderer, matrix ) );
+	}
+
+	void ueberManQueue::translate( const float x, const float y, const float z ) {
+		record( boost::bind( &ueberMan::translate, renderer, x, y, z ) );
+	}
+
+	void ueberManQueue::rotate( const float angle, const float x, const float y, const float z ) {
+		record( boost::bind( &ueberMan::rotate, renderer, angle, x, y, z ) );
+	}
+
+	void ueberManQueue::scale( const float x, const float y, const float z ) {
+		record( boost::bind( &ueberMan::scale, renderer, x, y, z ) );
+	}
+
+	void ueberManQueue::shaderTreeBegin( shaderHandle& treeid ) {
+		record( boost::bind( &ueberMan::shaderTreeBegin, renderer, treeid ) );
+	}
+
+	void ueberManQueue::shaderTreeEnd() {
+		record( boost::bind( &ueberMan::shaderTreeEnd, renderer ) );
+	}
+
+	void ueberManQueue::shaderTree( const string& treeid ) {
+		record( boost::bind( &ueberMan::shaderTree, renderer, treeid ) );
+	}
+
+	void ueberManQueue::connectShaders( const shaderHandle& srcId, const string& srcName, const shaderHandle& destId, const string& destName, shaderHandle& nodeid ) {
+		record( boost::bind( &ueberMan::connectShaders, renderer, srcId, srcName, destId, destName, nodeid ) );
+	}
+
+	void ueberManQueue::shader( const string& shadertype, const string& shadername, shaderHandle &shaderid ) {
+		record( boost::bind( &ueberMan::shader, renderer, shadertype, shadername, shaderid ) );
+	}
+
+	void ueberManQueue::light( const string& shadername, lightHandle& lightid ) {
+		record( boost::bind( &ueberMan::light, renderer, shadername, lightid ) );
+	}
+
+	void ueberManQueue::switchLight( const lightHandle& lightid, const bool on ) {
+		record( boost::bind( &ueberMan::switchLight, renderer, lightid, on ) );
+	}
+
+	void ueberManQueue::beginLook( lookHandle& lookid ) {
+		record( boost::bind( &ueberMan::beginLook, renderer, lookid ) );
+	}
+
+	void ueberManQueue::endLook() {
+		record( boost::bind( &ueberMan::endLook, renderer ) );
+	}
+
+	void ueberManQueue::nameLook( lookHandle& lookid ) {
+		record( boost::bind( &ueberMan::nameLook, renderer, lookid ) );
+	}
+
+	void ueberManQueue::look( const lookHandle& lookid ) {
+		record( boost::bind( &ueberMan::look, renderer, lookid ) );
+	}
+
+	void ueberManQueue::appendLook( const lookHandle& lookid ) {
+		record( boost::bind( &ueberMan::appendLook, renderer, lookid ) );
+	}
+
+	void ueberManQueue::beginObject( objectHandle& instanceid ) {
+		record( boost::bind( &ueberMan::beginObject, renderer, instanceid ) );
+	}
+
+	void ueberManQueue::endObject() {
+		record( boost::bind( &ueberMan::endObject, renderer ) );
+	}
+
+	void ueberManQueue::loadObject( const objectHandle& instanceid ) {
+		record( boost::bind( &ueberMan::loadObject, renderer, instanceid ) );
+	}
+
+	void ueberManQueue::points( const string& type, const int numPoints, primitiveHandle& identifier ) {
+		record( boost::bind( &ueberMan::points, renderer, type, numPoints, identifier ) );
+	}
+
+	void ueberManQueue::curves( const string& interp, const int numCurves, const int numVertsPerCurve, const bool closed, primitiveHandle& identifier ) {
+		record( boost::bind( ( curvesFunc )&ueberMan::curves, renderer, interp, numCurves, numVertsPerCurve, closed, identifier ) );
+	}
+
+	void ueberManQueue::curves( const string& interp, const int numCurves, const vector< int >& numVertsPerCurve, const bool closed, primitiveHandle& identifier ) {
+		record( boost::bind( ( curvesArrayFunc )&ueberMan::curves, renderer, interp, numCurves, numVertsPerCurve, closed, identifier ) );
+	}
+
+	void ueberManQueue::curves( const int numCurves, const vector< int >& numVertsPerCurve, const vector< int >& order, const vector< float >& knot, const vector< float >& min, const vector< float >& max, primitiveHandle& identifier ) {
+		record( boost::bind( ( nuCurvesFunc )&ueberMan::curves, renderer, numCurves, numVertsPerCurve, order, knot, min, max, identifier ) );
+	}
+
+	void ueberManQueue::patch( const string& interp, const int nu, const int nv, primitiveHandle& identifier ) {
+		record( boost::bind( ( patchFunc )&ueberMan::patch, renderer, interp, nu, nv, identifier ) );
+	}
+
+	void ueberManQueue::patch(	const int nu, const int uorder, const float *uknot, const float umin, const float umax,
+								const int nv, const int vorder, const float *vknot, const float vmin, const float vmax, primitiveHandle& identifier ) {
+		boost::shared_ptr< nuPatchData > data( new nuPatchData );
+		data->nu		= nu;
+		data->uorder	= uorder;
+		data->umin		= umin;
+		data->umax		= umax;
+		data->nv		= nv;
+		data->vorder	= vorder;
+		data->vmin		= vmin;
+		data->vmax		= vmax;
+		data->uknot.assign( uknot, uknot + nu + uorder );
+		data->vknot.assign( vknot, vknot + nv + vorder );
+		record( boost::bind( &ueberManQueue::doPatch, this, data, identifier ) );
+	}
+
+	void ueberManQueue::mesh( const string& interp, const int nfaces, const int *nverts, const int *verts, const bool interpolateBoundary, primitiveHandle& identifier ) {
+		boost::shared_ptr< vector< int > > nvertsCopy( new vector< int >( nverts, nverts + nfaces ) );
+		size_t numVerts = 0;
+		for( int i = 0; i < nfaces; i++ )
+			numVerts += nverts[ i ];
+		boost::shared_ptr< vector< int > > vertsCopy( new vector< int >( verts, verts + numVerts ) );
+		record( boost::bind( &ueberManQueue::doMesh, this, interp, nfaces, nvertsCopy, vertsCopy, interpolateBoundary, identifier ) );
+	}
+
+	void ueberManQueue::sphere( const float radius, const float zmin, const float zmax, const float thetamax, primitiveHandle& identifier ) {
+		record( boost::bind( ( sphereFunc )&ueberMan::sphere, renderer, radius, zmin, zmax, thetamax, identifier ) );
+	}
+
+	void ueberManQueue::sphere( const float radius, primitiveHandle& identifier ) {
+		sphere( radius, -radius, radius, 360, identifier );
+	}
+
+	void ueberManQueue::blobby( const int numLeafs, const vector< int >& code, const vector< float >& floatData, const vector< string >& stringData, primitiveHandle& identifier ) {
+		record( boost::bind( &ueberMan::blobby, renderer, numLeafs, code, floatData, stringData, identifier ) );
+	}
+
+	void ueberManQueue::makeMap( const string& type ) {
+		record( boost::bind( &ueberMan::makeMap, renderer, type ) );
+	}
+
+	void ueberManQueue::archiveRecord( const string& type, const string& text ) {
+		record( boost::bind( &ueberMan::archiveRecord, renderer, type, text ) );
+	}
+}
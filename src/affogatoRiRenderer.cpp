@@ -39,6 +39,7 @@
 
 
 // Standard headers
+#include <algorithm>
 #include <string>
 
 // Boost headers
@@ -1458,33 +1459,61 @@ namespace ueberMan {
 			vector< RtFloat > floatargs;
 
 			vector< tokenValue::tokenValuePtr > newParamArray;
-			float currentCreaseValue( RI_INFINITY );
-			float currentCornerValue( RI_INFINITY );
+			// Creases come as one sharpness and one vertex count per crease plus
+			// the indices of all creases. Without a "creaselength" the whole
+			// "crease" token is a single crease using the first sharpness.
+			const float *creaseValues( NULL );
+			unsigned numCreaseValues( 0 );
+			const int *creaseLengths( NULL );
+			unsigned numCreaseLengths( 0 );
+			const float *cornerValues( NULL );
+			unsigned numCornerValues( 0 );
 			for( vector< tokenValue::tokenValuePtr >::const_iterator it( currentState->tokenValueCache.begin() ); it != currentState->tokenValueCache.end(); it++ ) {
 				if( !( *it )->empty() ) {
 					string name( ( *it )->name() );
 					if( "creasevalue" == name ) {
-						currentCreaseValue = ( ( float* )( *it )->data() )[ 0 ];
+						creaseValues = ( const float* )( *it )->data();
+						numCreaseValues = ( *it )->size();
+					} else
+					if( "creaselength" == name ) {
+						creaseLengths = ( const int* )( *it )->data();
+						numCreaseLengths = ( *it )->size();
 					} else
 					if( "crease" == name ) {
-						tags.push_back( "crease" );
-						RtInt size( ( *it )->size() );
-						nargs.push_back( size ); // n vertex indices
-						nargs.push_back( 1 ); // one crease value
-						for( unsigned i( 0 ); i < size; i++ ) {
-							intargs.push_back( ( ( int* )( *it )->data() )[ i ] );
+						const int *indices( ( const int* )( *it )->data() );
+						const unsigned size( ( *it )->size() );
+						const unsigned numCreases( creaseLengths ? numCreaseLengths : 1 );
+						for( unsigned c( 0 ), offset( 0 ); c < numCreases; c++ ) {
+							const unsigned length( creaseLengths ? creaseLengths[ c ] : size );
+							if( offset + length > size )
+								break;
+							tags.push_back( "crease" );
+							nargs.push_back( length ); // n vertex indices
+							nargs.push_back( 1 ); // one crease value
+							intargs.insert( intargs.end(), indices + offset, indices + offset + length );
+							floatargs.push_back( numCreaseValues ? creaseValues[ min( c, numCreaseValues - 1 ) ] : RI_INFINITY );
+							offset += length;
 						}
-						floatargs.push_back( currentCreaseValue );
+						creaseLengths = NULL;
 					} else
 					if( "cornervalue" == name ) {
-						currentCornerValue = ( ( float* )( *it )->data() )[ 0 ];
+						cornerValues = ( const float* )( *it )->data();
+						numCornerValues = ( *it )->size();
 					} else
 					if( "corner" == name ) {
+						// All corners go into one tag, with one value each or one value for all
+						const int *indices( ( const int* )( *it )->data() );
+						const unsigned size( ( *it )->size() );
 						tags.push_back( "corner" );
-						nargs.push_back( 1 ); // One vertex index
-						nargs.push_back( 1 ); // one crease value
-						intargs.push_back( ( ( int* )( *it )->data() )[ 0 ] );
-						floatargs.push_back( currentCreaseValue );
+						nargs.push_back( size ); // n vertex indices
+						intargs.insert( intargs.end(), indices, indices + size );
+						if( numCornerValues >= size ) {
+							nargs.push_back( size ); // n crease values
+							floatargs.insert( floatargs.end(), cornerValues, cornerValues + size );
+						} else {
+							nargs.push_back( 1 ); // one crease value
+							floatargs.push_back( numCornerValues ? cornerValues[ 0 ] : RI_INFINITY );
+						}
 					} else {
 						newParamArray.push_back( *it );
 					}
@@ -1668,6 +1697,18 @@ namespace ueberMan {
 		currentState->tokenValueCache.clear();
 	}
 
+	void ueberManRiRenderer::archiveRecord( const string& type, const string& record ) {
+		RtToken recordType = RI_COMMENT;
+		if( "structure" == type )
+			recordType = RI_STRUCTURE;
+		else
+		if( "verbatim" == type )
+			recordType = RI_VERBATIM;
+
+		// Never pass the record as the format, it may contain '%'
+		RiArchiveRecord( recordType, "%s", record.c_str() );
+	}
+
 	// Define static class members --------------------------------------------
 
 	// Singleton instance of the renderer
@@ -0,0 +1,1881 @@
+/** Native RIB stream writer.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+// Standard headers
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// Boost headers
+#include <boost/algorithm/string/erase.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+// XSI headers
+#ifdef __XSI_PLUGIN
+	#include <xsi_application.h>
+#else
+	#include <stdio.h>
+#endif
+
+// Affogato headers
+#include "affogatoNumberFormat.hpp"
+#include "affogatoRibRenderer.hpp"
+#ifdef __XSI_PLUGIN
+#include "affogatoHelpers.hpp"
+#endif
+
+
+#ifndef __XSI_PLUGIN
+#define debugMessage(a)
+#endif
+
+// Plain numbers so we don't need the renderer library's headers
+#define RIB_INFINITY 1.0e38f
+
+
+namespace ueberMan {
+
+	using namespace std;
+	using namespace affogato;
+
+	// Binary RIB encoding, see the RenderMan Interface Specification,
+	// Appendix C
+	static const unsigned char ribInteger			= 0200;	// + bytes - 1
+	static const unsigned char ribShortString		= 0220;	// + length
+	static const unsigned char ribString			= 0240;	// + length bytes - 1
+	static const unsigned char ribFloat				= 0244;
+	static const unsigned char ribRequest			= 0246;
+	static const unsigned char ribFloatArray		= 0310;	// + length bytes - 1
+	static const unsigned char ribDefineRequest		= 0314;
+
+	// Values per block when formatting or swapping arrays serially
+	static const size_t ribBlockSize = 4096;
+
+	static inline void formatValues( const float *values, size_t size, string& dest ) {
+		formatFloats( values, size, dest );
+	}
+
+	static inline void formatValues( const int *values, size_t size, string& dest ) {
+		formatInts( values, size, dest );
+	}
+
+	template< class T > static void formatChunk( const T *values, size_t size, string *dest ) {
+		formatValues( values, size, *dest );
+	}
+
+	static inline unsigned char numBytes( unsigned value ) {
+		if( value < 0x100 )
+			return 1;
+		if( value < 0x10000 )
+			return 2;
+		if( value < 0x1000000 )
+			return 3;
+		return 4;
+	}
+
+	static inline void putBigEndian( streambuf *out, unsigned value, unsigned char bytes ) {
+		for( int shift = ( bytes - 1 ) * 8; 0 <= shift; shift -= 8 )
+			out->sputc( ( char )( ( value >> shift ) & 0xff ) );
+	}
+
+	static inline unsigned floatBits( float value ) {
+		union {
+			float f;
+			unsigned i;
+		} bits;
+		bits.f = value;
+		return bits.i;
+	}
+
+	// Translates the filter names we get into RIB filter names
+	static const char *ribFilterName( const string& filter ) {
+		if( ( "box" == filter ) || ( "triangle" == filter ) || ( "catmull-rom" == filter ) || ( "sinc" == filter ) ||
+			( "gaussian" == filter ) || ( "mitchell" == filter ) || ( "bessel" == filter ) )
+			return filter.c_str();
+		if( "blackmann-harris" == filter )
+			return "blackman-harris";
+		return NULL;
+	}
+
+
+	// Public methods ---------------------------------------------------------
+
+
+	ueberManRibRenderer::ueberManRibRenderer()
+	:	currentState( NULL ),
+		currentContext( 0 ),
+		contextCounter( 0 ),
+		numThreads( 2 ),
+		parallelThreshold( 65536 )
+	{
+		debugMessage( L"Constructing RibRenderer" );
+	}
+
+	ueberManRibRenderer::~ueberManRibRenderer() {
+		debugMessage( L"Destructing RibRenderer" );
+	}
+
+	/**
+	 * Starts a new scene.
+	 * Every scene goes into its own RIB file, which stays open until the
+	 * scene is ended. Switching scenes just switches the stream the calls
+	 * are written to.
+	 */
+	context ueberManRibRenderer::beginScene( const string& destination, bool useBinary, bool useCompression ) {
+		if( ( "direct" == destination ) || ( "dynamicload" == destination ) )
+			throw( runtime_error( "UeberManRib: Can only write RIB files, use the Ri renderer to render directly" ) );
+
+		debugMessage( L"UeberManRib: BeginScene " + stringToCString( destination ) );
+
+		boost::shared_ptr< state > newState( new state );
+		newState->out = boost::shared_ptr< ribStream >( new ribStream( destination + ".rib", useBinary, useCompression, numThreads, parallelThreshold ) );
+		if( !newState->out->is_open() )
+			throw( runtime_error( "UeberManRib: Can't open '" + destination + ".rib' for writing" ) );
+
+		++contextCounter;
+		currentContext = contextCounter;
+		stateMachine[ currentContext ] = newState;
+		currentState = newState.get();
+		return currentContext;
+	}
+
+	void ueberManRibRenderer::switchScene( context ctx ) {
+		debugMessage( L"UeberManRib: SwitchScene" );
+		map< context, boost::shared_ptr< state > >::iterator it = stateMachine.find( ctx );
+		if( stateMachine.end() != it ) {
+			currentContext = ctx;
+			currentState = it->second.get();
+		}
+	}
+
+	context ueberManRibRenderer::currentScene() {
+		return currentContext;
+	}
+
+	void ueberManRibRenderer::endScene( context ctx ) {
+		map< context, boost::shared_ptr< state > >::iterator it = stateMachine.find( ctx );
+		if( stateMachine.end() == it )
+			return;
+
+		if( it->second->inWorldBlock ) {
+			it->second->inWorldBlock = false;
+			debugMessage( L"UeberManRib: WorldEnd" );
+			it->second->out->request( "WorldEnd" );
+		}
+		it->second->out->close();
+
+		stateMachine.erase( it );
+		if( !stateMachine.empty() ) {
+			currentContext = stateMachine.rbegin()->first;
+			currentState = stateMachine.rbegin()->second.get();
+		} else {
+			currentContext = 0;
+			currentState = NULL;
+		}
+	}
+
+	const ueberManRibRenderer& ueberManRibRenderer::accessRenderer() {
+		debugMessage( L"UeberManRib: accessRenderer" );
+		static ueberManRibRenderer theRenderer;
+		return theRenderer;
+	}
+
+	void ueberManRibRenderer::input( const string& filename ) {
+		debugMessage( L"UeberManRib: Input" );
+
+		string::size_type pos = filename.find( " " );
+		if( pos == string::npos ) {
+			currentState->out->request( "ReadArchive" );
+			currentState->out->put( filename + ".rib" );
+		} else {
+			vector< string > args( 2 );
+			args[ 0 ] = filename.substr( 0, pos );
+			args[ 1 ] = filename.substr( pos + 1 );
+			float bound[] = { -1e38f, 1e38f, -1e38f, 1e38f, -1e38f, 1e38f };
+			currentState->out->request( "Procedural" );
+			currentState->out->put( "DynamicLoad" );
+			currentState->out->put( args );
+			currentState->out->put( bound, 6 );
+		}
+	}
+
+	void ueberManRibRenderer::input( const string& filename, const float bound[ 6 ] ) {
+		debugMessage( L"UeberManRib: Input [bounded]" );
+
+		vector< string > args;
+		string::size_type pos = filename.find( " " );
+		currentState->out->request( "Procedural" );
+		if( pos == string::npos ) {
+			args.push_back( filename + ".rib" );
+			currentState->out->put( "DelayedReadArchive" );
+		} else {
+			args.push_back( filename.substr( 0, pos ) );
+			args.push_back( filename.substr( pos + 1 ) );
+			currentState->out->put( "DynamicLoad" );
+		}
+		currentState->out->put( args );
+		currentState->out->put( bound, 6 );
+	}
+
+	void ueberManRibRenderer::camera( cameraHandle& cameraid ) {
+		debugMessage( L"UeberManRib: Camera" );
+
+		string projection( "perspective" );
+		float fov = 90.0f;
+		float screen[ 4 ] = { 0, 0, 0, 0 };
+		float near = 0.1f;
+		float far  = 1e6f;
+		int resolution[ 2 ] = { 640, 480 };
+		float pixelaspect = 1.0f;
+		float crop[ 4 ] = { 0.0f, 1.0f, 0.0f, 1.0f };
+		float shutter[ 2 ] = { 0.0f, 0.0f };
+		float shutterOffset = 0.0f;
+		float shutterEfficiency[ 2 ] = { 1.0f, 1.0f };
+		float fstop = RIB_INFINITY;
+		float focallength = 0.0f;
+		float focaldistance = 0.0f;
+		float pixelsamples[ 2 ] = { 3.0, 3.0 };
+		string bucketorder;
+		int bucketsize[ 2 ] = { 16, 16 };
+		int gridsize = 256;
+		int texturememory = 8192;
+		string hider;
+		int sampleMotion = 0;
+		int hiderjitter = 1;
+		int extremeMotionDof = 0;
+#ifdef DELIGHT
+		int eyeSplits = 6;
+#else
+		int eyeSplits = 10;
+#endif
+		string hiderdepthfilter;
+
+		for( vector< tokenValue::tokenValuePtr >::iterator it = currentState->tokenValueCache.begin(); it < currentState->tokenValueCache.end(); it++ ) {
+			string name( ( *it )->name() );
+			boost::erase_all( name, " " );
+			const float *floats = ( const float* )( *it )->data();
+			const int *ints = ( const int* )( *it )->data();
+			if( "projection" == name ) {
+				projection = ( const char* )( *it )->data();
+			} else if( "fov" == name ) {
+				fov = floats[ 0 ];
+			} else if( "screen" == name ) {
+				copy( floats, floats + 4, screen );
+			} else if( "near" == name ) {
+				near = floats[ 0 ];
+			} else if( "far" == name ) {
+				far = floats[ 0 ];
+			} else if( "resolution" == name ) {
+				copy( ints, ints + 2, resolution );
+			} else if( "pixelaspect" == name ) {
+				pixelaspect = floats[ 0 ];
+			} else if( "crop" == name ) {
+				copy( floats, floats + 4, crop );
+			} else if( "shutter" == name ) {
+				copy( floats, floats + 2, shutter );
+			} else if( "shutteroffset" == name ) {
+				shutterOffset = floats[ 0 ];
+			} else if( "shutterefficiency" == name ) {
+				copy( floats, floats + 2, shutterEfficiency );
+			} else if( "fstop" == name ) {
+				fstop = floats[ 0 ];
+			} else if( "focallength" == name ) {
+				focallength = floats[ 0 ];
+			} else if( "focaldistance" == name ) {
+				focaldistance = floats[ 0 ];
+			} else if( "pixelsamples" == name ) {
+				copy( floats, floats + 2, pixelsamples );
+			} else if( "bucketorder" == name ) {
+				bucketorder = ( const char* )( *it )->data();
+			} else if( name.find( "bucketsize" ) != string::npos ) {
+				copy( ints, ints + 2, bucketsize );
+			} else if( "gridsize" == name ) {
+				gridsize = ints[ 0 ];
+			} else if( "texturememory" == name ) {
+				texturememory = ints[ 0 ];
+			} else if( "hider" == name ) {
+				hider = ( const char* )( *it )->data();
+			} else if( "samplemotion" == name ) {
+				sampleMotion = ints[ 0 ];
+			} else if( "jitter" == name ) {
+				hiderjitter = ints[ 0 ];
+			} else if( "depthfilter" == name ) {
+				hiderdepthfilter = ( const char* )( *it )->data();
+			} else if( "extrememotiondof" == name ) {
+				extremeMotionDof = ints[ 0 ];
+			} else if( "eyesplits" == name ) {
+				eyeSplits = ints[ 0 ];
+			}
+		}
+
+		ribStream& out( *currentState->out );
+
+		if( !projection.empty() ) {
+			out.request( "Projection" );
+			out.put( projection );
+			if( fov != 90 ) {
+				out.put( "fov" );
+				out.put( &fov, 1 );
+			}
+		}
+
+		out.request( "PixelSamples" );
+		out.put( pixelsamples[ 0 ] );
+		out.put( pixelsamples[ 1 ] );
+
+		if( screen[ 0 ] || screen[ 1 ] || screen[ 2 ] || screen[ 3 ] ) {
+			out.request( "ScreenWindow" );
+			for( unsigned i = 0; i < 4; i++ )
+				out.put( screen[ i ] );
+		}
+
+		if( ( 0.1f != near ) || ( 1e6f != far ) ) {
+			out.request( "Clipping" );
+			out.put( near );
+			out.put( far );
+		}
+
+		if( ( 640 != resolution[ 0 ] ) || ( 480 != resolution[ 1 ] ) || ( 1 != pixelaspect ) ) {
+			out.request( "Format" );
+			out.put( resolution[ 0 ] );
+			out.put( resolution[ 1 ] );
+			out.put( pixelaspect );
+		}
+
+		if( ( 0 != crop[ 0 ] ) || ( 1 != crop[ 1 ] ) || ( 0 != crop[ 2 ] ) || ( 1 != crop[ 3 ] ) ) {
+			out.request( "CropWindow" );
+			for( unsigned i = 0; i < 4; i++ )
+				out.put( crop[ i ] );
+		}
+
+		if( ( 0 != shutter[ 1 ] ) || ( 0 != shutter[ 0 ] ) ) {
+			out.request( "Shutter" );
+			out.put( shutter[ 0 ] );
+			out.put( shutter[ 1 ] );
+		}
+
+		if( 0 != shutterOffset ) {
+			out.request( "Option" );
+			out.put( "shutter" );
+			out.put( "offset" );
+			out.put( &shutterOffset, 1 );
+		}
+
+		if( ( 1 != shutterEfficiency[ 1 ] ) || ( 1 != shutterEfficiency[ 0 ] ) ) {
+			out.request( "Option" );
+			out.put( "shutter" );
+			out.put( "efficiency" );
+			out.put( shutterEfficiency, 2 );
+		}
+
+		if( RIB_INFINITY != fstop ) {
+			out.request( "DepthOfField" );
+			out.put( fstop );
+			out.put( focallength );
+			out.put( focaldistance );
+		}
+
+		if( !bucketorder.empty() ) {
+			out.request( "Option" );
+			out.put( "render" );
+			out.put( "bucketorder" );
+			out.put( vector< string >( 1, bucketorder ) );
+		}
+
+		if( ( 16 != bucketsize[ 0 ] ) || ( 16 != bucketsize[ 1 ] ) ) {
+			out.request( "Option" );
+			out.put( "limits" );
+			out.put( "bucketsize" );
+			out.put( bucketsize, 2 );
+		}
+
+		if( 256 != gridsize ) {
+			out.request( "Option" );
+			out.put( "limits" );
+			out.put( "gridsize" );
+			out.put( &gridsize, 1 );
+		}
+
+		if( 8192 != texturememory ) {
+			out.request( "Option" );
+			out.put( "limits" );
+			out.put( "texturememory" );
+			out.put( &texturememory, 1 );
+		}
+
+#ifdef DELIGHT
+		if( 6 != eyeSplits )
+#else
+		if( 10 != eyeSplits )
+#endif
+		{
+			out.request( "Option" );
+			out.put( "limits" );
+			out.put( "eyesplits" );
+			out.put( &eyeSplits, 1 );
+		}
+
+		out.request( "Hider" );
+		out.put( hider.empty() ? string( "hidden" ) : hider );
+		out.put( "jitter" );
+		out.put( &hiderjitter, 1 );
+		out.put( "samplemotion" );
+		out.put( &sampleMotion, 1 );
+		out.put( "extrememotiondof" );
+		out.put( &extremeMotionDof, 1 );
+		if( !hiderdepthfilter.empty() ) {
+			out.put( "depthfilter" );
+			out.put( vector< string >( 1, hiderdepthfilter ) );
+		}
+
+		currentState->tokenValueCache.clear();
+	}
+
+	void ueberManRibRenderer::output( const string& name, const string& format, const string& dataname, const cameraHandle& cameraid ) {
+		debugMessage( L"UeberManRib: Output" );
+
+		float exposure[ 2 ] = { 1, 1 };
+		float filterwidth[ 2 ] = { 2, 2 };
+		int quantize[ 3 ] = { 0, 0, 0 }; // one, min, max
+		float dither = 0;
+		string filter( "box" );
+
+		vector< tokenValue::tokenValuePtr > displayParameters;
+
+		// convert gain + gamma to RMan "exposure"
+		for( vector< tokenValue::tokenValuePtr >::iterator it = currentState->tokenValueCache.begin(); it < currentState->tokenValueCache.end(); it++ ) {
+			string name = ( *it )->name();
+			if( name.find( "gain" ) != string::npos ) {
+				exposure[ 0 ] = *( ( float* )( *it )->data() );
+				continue;
+			}
+			if( name.find( "gamma" ) != string::npos ) {
+				exposure[ 1 ] = *( ( float* )( *it )->data() );
+				continue;
+			}
+			if( !currentState->secondaryDisplay ) {
+				if( name.find( "filterwidth[2]" ) != string::npos ) {
+					float* tmp = ( float* )( *it )->data();
+					filterwidth[ 0 ] = tmp[ 0 ];
+					filterwidth[ 1 ] = tmp[ 1 ];
+					continue;
+				} else
+				if( name.find( "filter" ) != string::npos ) {
+					filter = ( char* )( *it )->data();
+					continue;
+				} else
+				if( name.find( "quantize[4]" ) != string::npos ) {
+					float* tmp = ( float* )( *it )->data();
+					quantize[ 0 ] = ( int )tmp[ 1 ];
+					quantize[ 1 ] = ( int )tmp[ 2 ];
+					quantize[ 2 ] = ( int )tmp[ 3 ];
+					continue;
+				} else
+				if( name.find( "dither" ) != string::npos ) {
+					dither = *( ( float* )( *it )->data() );
+					continue;
+				}
+			}
+		}
+
+		if( ( 1 != exposure[ 0 ] ) || ( 1 != exposure[ 1 ] ) )
+			currentState->tokenValueCache.push_back( tokenValue::tokenValuePtr( new tokenValue( exposure, 2, "exposure", tokenValue::storageUniform, tokenValue::typeFloat ) ) );
+
+		ribStream& out( *currentState->out );
+
+		string displayName;
+		if( currentState->secondaryDisplay ) {
+			displayName = '+' + name;
+		} else {
+			displayName = name;
+
+			const char *ribFilter = ribFilterName( filter );
+			if( ribFilter ) {
+				out.request( "PixelFilter" );
+				out.put( ribFilter );
+				out.put( filterwidth[ 0 ] );
+				out.put( filterwidth[ 1 ] );
+			}
+
+			out.request( "Quantize" );
+			out.put( dataname );
+			out.put( quantize[ 0 ] );
+			out.put( quantize[ 1 ] );
+			out.put( quantize[ 2 ] );
+			out.put( dither );
+		}
+
+		out.request( "Display" );
+		out.put( displayName );
+		out.put( format );
+		out.put( dataname );
+		currentState->putShaderParameters();
+
+		currentState->secondaryDisplay = true;
+
+		currentState->tokenValueCache.clear();
+	}
+
+	void ueberManRibRenderer::world() {
+		debugMessage( L"UeberManRib: World" );
+
+		currentState->inWorldBlock = true;
+		ribStream& out( *currentState->out );
+		out.request( "WorldBegin" );
+		out.request( "Resource" );
+		out.put( "__zero" );
+		out.put( "attributes" );
+		out.put( "string operation" );
+		out.put( vector< string >( 1, "save" ) );
+		out.put( "string subset" );
+		out.put( vector< string >( 1, "shading,geometrymodification,geometrydefinition" ) );
+	}
+
+	void ueberManRibRenderer::render( const string& cameraname ) {
+		debugMessage( L"UeberManRib: Render" );
+		stateMachine.clear();
+		currentState = NULL;
+		currentContext = 0;
+	}
+
+	void ueberManRibRenderer::motion( const vector< float >& times ) {
+		debugMessage( L"UeberManRib: Motion" );
+
+		currentState->sampleCount	=
+		currentState->numSamples	= times.size();
+		currentState->motionSamples = times;
+	}
+
+	void ueberManRibRenderer::parameter( const vector< tokenValue >& tokenValueArray ) {
+		for( vector< tokenValue >::const_iterator it( tokenValueArray.begin() ); it != tokenValueArray.end(); it++ )
+			currentState->tokenValueCache.push_back( tokenValue::tokenValuePtr( new tokenValue( *it  ) ) );
+	}
+
+	void ueberManRibRenderer::parameter( const tokenValue& aTokenValue ) {
+		currentState->tokenValueCache.push_back( tokenValue::tokenValuePtr( new tokenValue( aTokenValue ) ) );
+	}
+
+	void ueberManRibRenderer::parameter( const string& typedname, const string& value ) {
+		string::size_type pos = typedname.find( " " );
+		if( string::npos != pos ) {
+			string type = typedname.substr( 0, pos );
+			string name = typedname.substr( pos + 1 );
+			if( "input" == type ) // this should be formatted as a RIB file name
+				currentState->tokenValueCache.push_back( tokenValue::tokenValuePtr( new tokenValue( value + ".rib", name ) ) );
+		} else
+			currentState->tokenValueCache.push_back( tokenValue::tokenValuePtr( new tokenValue( value, typedname ) ) );
+	}
+
+	void ueberManRibRenderer::parameter( const string& typedname, const float value ) {
+		currentState->tokenValueCache.push_back( tokenValue::tokenValuePtr( new tokenValue( value, typedname ) ) );
+	}
+
+	void ueberManRibRenderer::parameter( const string& typedname, const int value ) {
+		currentState->tokenValueCache.push_back( tokenValue::tokenValuePtr( new tokenValue( value, typedname ) ) );
+	}
+
+	void ueberManRibRenderer::parameter( const string& typedname, const bool value ) {
+		parameter( typedname, ( int )value );
+	}
+
+	void ueberManRibRenderer::attribute( const tokenValue& aTokenValue ) {
+		currentState->checkStartMotion();
+
+		string typedname = aTokenValue.name();
+		string type, name;
+
+		string::size_type pos = typedname.find( ":" );
+		if( string::npos == pos ) {
+			name = typedname;
+			type = "user";
+		}
+		else {
+			type = typedname.substr( 0,  pos );
+			name = typedname.substr( pos + 1 );
+		}
+
+		ribStream& out( *currentState->out );
+		const float *floats = ( const float* )aTokenValue.data();
+		const int *ints = ( const int* )aTokenValue.data();
+
+		if( "shading" == type ) {
+			if( "rate" == name ) {
+				out.request( "ShadingRate" );
+				out.put( floats[ 0 ] );
+			} else
+			if( "quality" == name ) {
+				out.request( "ShadingRate" );
+				out.put( 1.0f / ( floats[ 0 ] * floats[ 0 ] ) );
+			} else
+			if( "color" == name ) {
+				out.request( "Color" );
+				out.put( floats, 3 );
+			} else
+			if( "opacity" == name ) {
+				out.request( "Opacity" );
+				out.put( floats, 3 );
+			} else
+			if( "motionfactor" == name ) {
+				out.request( "GeometricApproximation" );
+				out.put( "motionfactor" );
+				out.put( floats[ 0 ] );
+			} else
+			if( "focusfactor" == name ) {
+				out.request( "GeometricApproximation" );
+				out.put( "focusfactor" );
+				out.put( floats[ 0 ] );
+			} else
+			if( "backfacing" == name ) {
+				out.request( "Sides" );
+				out.put( ints[ 0 ] ? 2 : 1 );
+			} else
+			if( "matte" == name ) {
+				out.request( "Matte" );
+				out.put( ints[ 0 ] );
+			} else
+			if( "interpolation" == name ) {
+				out.request( "ShadingInterpolation" );
+				out.put( ( const char* )aTokenValue.data() );
+			} else {
+				out.request( "Attribute" );
+				out.put( type );
+				out.put( aTokenValue.typeAsString() + " " + name, aTokenValue );
+			}
+		} else {
+			if( "dicing" == type )
+				type = "dice";
+			out.request( "Attribute" );
+			out.put( type );
+			out.put( aTokenValue.typeAsString() + " " + name, aTokenValue );
+		}
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::attribute( const string& typedname, const string& value ) {
+		currentState->checkStartMotion();
+
+		ribStream& out( *currentState->out );
+		string::size_type pos = typedname.find( ":" );
+		if( pos != string::npos ) {
+			string type( typedname.substr( 0,  pos ) );
+			string name( typedname.substr( pos + 1 ) );
+			if( ( "interpolation" == name ) && ( "shading" == type ) ) {
+				out.request( "ShadingInterpolation" );
+				out.put( value );
+			}
+		}
+		typedRequest( "Attribute", typedname, "string" );
+		out.put( vector< string >( 1, value ) );
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::attribute( const string& typedname, const float value ) {
+		currentState->checkStartMotion();
+
+		ribStream& out( *currentState->out );
+		string::size_type pos = typedname.find( ":" );
+		string type, name;
+		if( string::npos != pos ) {
+			type = typedname.substr( 0,  pos );
+			name = typedname.substr( pos + 1 );
+		}
+
+		if( "shading" == type ) {
+			if( "rate" == name ) {
+				out.request( "ShadingRate" );
+				out.put( value );
+			} else
+			if( "quality" == name ) {
+				out.request( "ShadingRate" );
+				out.put( 1.0f / value );
+			} else
+			if( "color" == name ) {
+				float color[ 3 ] = { value, value, value };
+				out.request( "Color" );
+				out.put( color, 3 );
+			} else
+			if( "opacity" == name ) {
+				float opacity[ 3 ] = { value, value, value };
+				out.request( "Opacity" );
+				out.put( opacity, 3 );
+			} else
+			if( ( "motionfactor" == name ) || ( "focusfactor" == name ) ) {
+				out.request( "GeometricApproximation" );
+				out.put( name );
+				out.put( value );
+			} else {
+				typedRequest( "Attribute", typedname, "float" );
+				out.put( &value, 1 );
+			}
+		} else {
+			typedRequest( "Attribute", typedname, "float" );
+			out.put( &value, 1 );
+		}
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::attribute( const string& typedname, const bool value ) {
+		attribute( typedname, ( int )value );
+	}
+
+	void ueberManRibRenderer::attribute( const string& typedname, const int value ) {
+		currentState->checkStartMotion();
+
+		ribStream& out( *currentState->out );
+		string::size_type pos = typedname.find( ":" );
+		string type, name;
+		if( string::npos != pos ) {
+			type = typedname.substr( 0,  pos );
+			name = typedname.substr( pos + 1 );
+		}
+
+		if( ( "shading" == type ) && ( "matte" == name ) ) {
+			out.request( "Matte" );
+			out.put( value );
+		} else
+		if( ( "shading" == type ) && ( "backfacing" == name ) ) {
+			out.request( "Sides" );
+			out.put( value ? 2 : 1 );
+		} else {
+			typedRequest( "Attribute", typedname, "int" );
+			out.put( &value, 1 );
+		}
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::option( const tokenValue &aTokenValue ) {
+		currentState->checkStartMotion();
+
+		string typedname = aTokenValue.name();
+		string type, name;
+
+		string::size_type pos = typedname.find( ":" );
+		if( string::npos == pos ) {
+			name = typedname;
+			type = "user";
+		}
+		else {
+			type = typedname.substr( 0,  pos );
+			name = typedname.substr( pos + 1 );
+		}
+
+		currentState->out->request( "Option" );
+		currentState->out->put( type );
+		currentState->out->put( aTokenValue.typeAsString() + " " + name, aTokenValue );
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::option( const string& typedname, const string& value ) {
+		currentState->checkStartMotion();
+
+		typedRequest( "Option", typedname, "string" );
+		currentState->out->put( vector< string >( 1, value ) );
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::option( const string& typedname, const float value ) {
+		currentState->checkStartMotion();
+
+		typedRequest( "Option", typedname, "float" );
+		currentState->out->put( &value, 1 );
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::option( const string& typedname, const bool value ) {
+		option( typedname, ( int )value );
+	}
+
+	void ueberManRibRenderer::option( const string& typedname, const int value ) {
+		if( "rib:threads" == typedname ) {
+			numThreads = 0 < value ? value : 1;
+			return;
+		}
+		if( "rib:parallelthreshold" == typedname ) {
+			parallelThreshold = 0 < value ? value : 1;
+			return;
+		}
+
+		currentState->checkStartMotion();
+
+		typedRequest( "Option", typedname, "int" );
+		currentState->out->put( &value, 1 );
+
+		currentState->checkEndMotion();
+	}
+
+	// There is no renderer to ask, we only write a file
+	bool ueberManRibRenderer::getAttribute( const string& typedname, float& value ) {
+		return false;
+	}
+
+	bool ueberManRibRenderer::getAttribute( const string& typedname, int& value ) {
+		return false;
+	}
+
+	bool ueberManRibRenderer::getAttribute( const string& typedname, string& value ) {
+		return false;
+	}
+
+	void ueberManRibRenderer::pushAttributes() {
+		currentState->out->request( "AttributeBegin" );
+	}
+
+	void ueberManRibRenderer::popAttributes() {
+		currentState->out->request( "AttributeEnd" );
+	}
+
+	void ueberManRibRenderer::pushSpace() {
+		currentState->out->request( "TransformBegin" );
+	}
+
+	void ueberManRibRenderer::popSpace() {
+		currentState->out->request( "TransformEnd" );
+	}
+
+	void ueberManRibRenderer::space( const vector< float >& matrix ) {
+		currentState->checkStartMotion();
+
+		currentState->out->request( "Transform" );
+		currentState->out->put( &matrix[ 0 ], 16 );
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::space( const spaceHandle& spacename ) {
+		currentState->checkStartMotion();
+
+		if( "identity" == spacename ) {
+			currentState->out->request( "Identity" );
+		} else {
+			currentState->out->request( "CoordSysTransform" );
+			currentState->out->put( spacename );
+		}
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::nameSpace( spaceHandle& spacename ) {
+		if( "identity" != spacename ) {
+			currentState->checkStartMotion();
+
+			currentState->out->request( "CoordinateSystem" );
+			currentState->out->put( spacename );
+
+			currentState->checkEndMotion();
+		}
+	}
+
+	void ueberManRibRenderer::appendSpace( const vector< float >& matrix ) {
+		currentState->checkStartMotion();
+
+		currentState->out->request( "ConcatTransform" );
+		currentState->out->put( &matrix[ 0 ], 16 );
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::translate( const float x, const float y, const float z ) {
+		currentState->checkStartMotion();
+
+		currentState->out->request( "Translate" );
+		currentState->out->put( x );
+		currentState->out->put( y );
+		currentState->out->put( z );
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::rotate( const float angle, const float x, const float y, const float z ) {
+		currentState->checkStartMotion();
+
+		currentState->out->request( "Rotate" );
+		currentState->out->put( angle );
+		currentState->out->put( x );
+		currentState->out->put( y );
+		currentState->out->put( z );
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::scale( const float x, const float y, const float z ) {
+		currentState->checkStartMotion();
+
+		currentState->out->request( "Scale" );
+		currentState->out->put( x );
+		currentState->out->put( y );
+		currentState->out->put( z );
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::shader( const string& shadertype, const string& shadername, shaderHandle& shaderid ) {
+		debugMessage( L"UeberManRib: Shader" );
+
+		const char *request = NULL;
+		if( "surface" == shadertype )
+			request = "Surface";
+		else
+		if( "displacement" == shadertype )
+			request = "Displacement";
+		else
+		if( "volume" == shadertype )
+			request = "Atmosphere";
+		else
+		if( !currentState->inWorldBlock && ( "imager" == shadertype ) )
+			request = "Imager";
+
+		if( request ) {
+			currentState->out->request( request );
+			currentState->out->put( shadername );
+			currentState->putShaderParameters();
+		}
+
+		currentState->tokenValueCache.clear();
+	}
+
+	void ueberManRibRenderer::light( const string& shadername, lightHandle& lightid ) {
+		debugMessage( L"UeberManRib: Light" );
+
+		// The handle is part of the request in RIB, no need for __handleid
+		currentState->out->request( "LightSource" );
+		currentState->out->put( shadername );
+		currentState->out->put( lightid );
+		currentState->putShaderParameters();
+
+		currentState->tokenValueCache.clear();
+	}
+
+	void ueberManRibRenderer::switchLight( const lightHandle& lightid, const bool on ) {
+		currentState->checkStartMotion();
+
+		currentState->out->request( "Illuminate" );
+		currentState->out->put( lightid );
+		currentState->out->put( on ? 1 : 0 );
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::beginLook( lookHandle& id ) {
+		currentState->out->request( "ArchiveBegin" );
+		currentState->out->put( id + ".look" );
+	}
+
+	void ueberManRibRenderer::endLook() {
+		currentState->out->request( "ArchiveEnd" );
+	}
+
+	void ueberManRibRenderer::look( const lookHandle& id ) {
+		ribStream& out( *currentState->out );
+		// Unroll the entire graphics state to WorldBegin state, then instance the look
+		out.request( "Resource" );
+		out.put( "__zero" );
+		out.put( "attributes" );
+		out.put( "string operation" );
+		out.put( vector< string >( 1, "restore" ) );
+		out.put( "string subset" );
+		out.put( vector< string >( 1, "shading,geometrymodification,geometrydefinition" ) );
+		out.request( "ReadArchive" );
+		out.put( id + ".look" );
+	}
+
+	void ueberManRibRenderer::appendLook( const lookHandle& id ) {
+		currentState->out->request( "ReadArchive" );
+		currentState->out->put( id + ".look" );
+	}
+
+	void ueberManRibRenderer::points( const string& type, const int numPoints, primitiveHandle &identifier ) {
+
+		currentState->checkStartMotion();
+
+		if( !type.empty() ) {
+			ribStream& out( *currentState->out );
+			// Below abtraction allows one to be rather lazy and specify "blobby"-type particles
+			if( "blobby" == type ) {
+				const float* widths( NULL );
+				const float* positions( NULL );
+				float width( 1 );
+
+				vector< tokenValue::tokenValuePtr > rest;
+				for( vector< tokenValue::tokenValuePtr >::const_iterator it = currentState->tokenValueCache.begin(); it < currentState->tokenValueCache.end(); it++ ) {
+					string name( ( *it )->name() );
+					if( "width" == name ) {
+						if( tokenValue::typeFloat == ( *it )->type() ) {
+							switch( ( *it )->storage() ) {
+								case tokenValue::storageConstant:
+								case tokenValue::storageUniform:
+									width = *( const float* )( *it )->data();
+									break;
+								case tokenValue::storageVarying:
+								case tokenValue::storageVertex:
+									widths = ( const float* )( *it )->data();
+									break;
+								default:
+									break;
+							}
+						}
+					} else
+					if( "P" == name ) {
+						if( tokenValue::typePoint == ( *it )->type() ) {
+							switch( ( *it )->storage() ) {
+								case tokenValue::storageVarying:
+								case tokenValue::storageVertex:
+									positions = ( const float* )( *it )->data();
+									break;
+								default:
+									break;
+							}
+						}
+					} else {
+						rest.push_back( *it );
+					}
+				}
+
+				vector< string > strings( 1, "" );
+
+				out.request( "Blobby" );
+				if( positions ) {
+					vector< int > code;
+					code.reserve( numPoints * 3 + 2 );
+					vector< float > pos;
+					pos.reserve( numPoints * 16 );
+					int index = 0;
+					for( int i = 0; i < numPoints; i++ ) {
+						code.push_back( 1001 );
+						code.push_back( index );
+
+						float theWidth = widths ? widths[ i ] : width;
+						float ellipsoid[ 16 ] = {	theWidth, 0, 0, 0,
+													0, theWidth, 0, 0,
+													0, 0, theWidth, 0,
+													positions[ i * 3 ], positions[ i * 3 + 1 ], positions[ i * 3 + 2 ], 1 };
+						pos.insert( pos.end(), ellipsoid, ellipsoid + 16 );
+
+						index += 16;
+					}
+					code.push_back( 0 );
+					code.push_back( numPoints );
+					for( int i = 0; i < numPoints; i++ )
+						code.push_back( i );
+
+					out.put( numPoints );
+					out.put( code );
+					out.put( pos );
+					out.put( strings );
+					currentState->tokenValueCache = rest;
+					currentState->putPrimitiveParameters();
+				} else { // no positions -> write an empty blob
+					out.put( 0 );
+					out.put( vector< int >() );
+					out.put( vector< float >() );
+					out.put( strings );
+				}
+			} else {
+				currentState->tokenValueCache.push_back( tokenValue::tokenValuePtr( new tokenValue( type, "type" ) ) );
+
+				out.request( "Points" );
+				currentState->putPrimitiveParameters();
+			}
+		}
+
+		currentState->tokenValueCache.clear();
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::curves( const string& interp, const int ncurves, const int numVertsPerCurve, const bool closed, primitiveHandle &identifier ) {
+		// RenderMan needs nverts per curve
+		vector< int > nverts( ncurves, numVertsPerCurve );
+		curves( interp, ncurves, nverts, closed, identifier );
+	}
+
+	void ueberManRibRenderer::curves( const string& interp, const int ncurves, const vector< int >& numVertsPerCurve, const bool closed, primitiveHandle &identifier ) {
+
+		// If we need to set the basis, make sure we're not overwriting the current one
+		if( "linear" != interp ) {
+			// Check if we're about to start a motion block
+			if( ( 0 > currentState->sampleCount ) || ( currentState->sampleCount == currentState->numSamples ) ) {
+				currentState->out->request( "AttributeBegin" );
+				putBasis( interp );
+			}
+		}
+
+		// We check for starting a motion block here, after we (may) have set the basis
+		currentState->checkStartMotion();
+
+		currentState->out->request( "Curves" );
+		currentState->out->put( "linear" != interp ? "cubic" : "linear" );
+		currentState->out->put( &numVertsPerCurve[ 0 ], ncurves );
+		currentState->out->put( closed ? "periodic" : "nonperiodic" );
+		currentState->putPrimitiveParameters();
+
+		currentState->tokenValueCache.clear();
+
+		currentState->checkEndMotion();
+
+		// Close the basis attribute block if we're ending a motion block
+		if( ( "linear" != interp ) && ( ( !currentState->sampleCount ) || ( 0 > currentState->sampleCount ) ) )
+			currentState->out->request( "AttributeEnd" );
+	}
+
+	void ueberManRibRenderer::curves( const int numCurves, const vector< int >& numVertsPerCurve, const vector< int >& order, const vector< float >& knot, const vector< float >& min, const vector< float >& max, primitiveHandle& identifier ) {
+
+		currentState->checkStartMotion();
+
+		ribStream& out( *currentState->out );
+		out.request( "NuCurves" );
+		out.put( &numVertsPerCurve[ 0 ], numCurves );
+		out.put( &order[ 0 ], numCurves );
+		out.put( knot );
+		out.put( &min[ 0 ], numCurves );
+		out.put( &max[ 0 ], numCurves );
+		currentState->putPrimitiveParameters();
+
+		currentState->tokenValueCache.clear();
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::patch( const string& interp, int nu, int nv, primitiveHandle &identifier ) {
+
+		// If we need to set the basis, make sure we're not overwriting the current one
+		if( "linear" != interp ) {
+			// Check if we're about to start a motion block
+			if( ( 0 > currentState->sampleCount ) || ( currentState->sampleCount == currentState->numSamples ) ) {
+				currentState->out->request( "AttributeBegin" );
+				putBasis( interp );
+			}
+		}
+
+		currentState->checkStartMotion();
+
+		ribStream& out( *currentState->out );
+		out.request( "PatchMesh" );
+		out.put( "linear" != interp ? "bicubic" : "bilinear" );
+		out.put( nu );
+		out.put( "nonperiodic" );
+		out.put( nv );
+		out.put( "nonperiodic" );
+		currentState->putPrimitiveParameters();
+
+		currentState->tokenValueCache.clear();
+
+		currentState->checkEndMotion();
+
+		if( ( "linear" != interp ) && ( ( !currentState->sampleCount ) || ( 0 > currentState->sampleCount ) ) )
+			currentState->out->request( "AttributeEnd" );
+	}
+
+	void ueberManRibRenderer::patch( const int nu, const int uorder, const float *uknot, const float umin, const float umax, const int nv, const int vorder, const float *vknot, const float vmin, const float vmax, primitiveHandle &identifier ) {
+		currentState->checkStartMotion();
+
+		ribStream& out( *currentState->out );
+		out.request( "NuPatch" );
+		out.put( nu );
+		out.put( uorder );
+		out.put( uknot, nu + uorder );
+		out.put( umin );
+		out.put( umax );
+		out.put( nv );
+		out.put( vorder );
+		out.put( vknot, nv + vorder );
+		out.put( vmin );
+		out.put( vmax );
+		currentState->putPrimitiveParameters();
+
+		currentState->tokenValueCache.clear();
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::mesh( const string& interp, const int nfaces, const int *nverts, const int *verts, const bool interpolateBoundary, primitiveHandle &identifier ) {
+		debugMessage( L"UeberManRib: Mesh" );
+
+		currentState->checkStartMotion();
+
+		ribStream& out( *currentState->out );
+
+		size_t numVerts = 0;
+		for( int i = 0; i < nfaces; i++ )
+			numVerts += nverts[ i ];
+
+		if( "linear" == interp ) {
+			out.request( "PointsPolygons" );
+			out.put( nverts, nfaces );
+			out.put( verts, numVerts );
+			currentState->putPrimitiveParameters();
+		} else {
+			// We take the crease/corner values from the parameter stack
+			vector< string > tags;
+			vector< int > nargs;
+			vector< int > intargs;
+			vector< float > floatargs;
+
+			vector< tokenValue::tokenValuePtr > newParamArray;
+			// Creases come as one sharpness and one vertex count per crease plus
+			// the indices of all creases. Without a "creaselength" the whole
+			// "crease" token is a single crease using the first sharpness.
+			const float *creaseValues( NULL );
+			unsigned numCreaseValues( 0 );
+			const int *creaseLengths( NULL );
+			unsigned numCreaseLengths( 0 );
+			const float *cornerValues( NULL );
+			unsigned numCornerValues( 0 );
+			for( vector< tokenValue::tokenValuePtr >::const_iterator it( currentState->tokenValueCache.begin() ); it != currentState->tokenValueCache.end(); it++ ) {
+				if( !( *it )->empty() ) {
+					string name( ( *it )->name() );
+					if( "creasevalue" == name ) {
+						creaseValues = ( const float* )( *it )->data();
+						numCreaseValues = ( *it )->size();
+					} else
+					if( "creaselength" == name ) {
+						creaseLengths = ( const int* )( *it )->data();
+						numCreaseLengths = ( *it )->size();
+					} else
+					if( "crease" == name ) {
+						const int *indices( ( const int* )( *it )->data() );
+						const unsigned size( ( *it )->size() );
+						const unsigned numCreases( creaseLengths ? numCreaseLengths : 1 );
+						for( unsigned c( 0 ), offset( 0 ); c < numCreases; c++ ) {
+							const unsigned length( creaseLengths ? creaseLengths[ c ] : size );
+							if( offset + length > size )
+								break;
+							tags.push_back( "crease" );
+							nargs.push_back( length ); // n vertex indices
+							nargs.push_back( 1 ); // one crease value
+							intargs.insert( intargs.end(), indices + offset, indices + offset + length );
+							floatargs.push_back( numCreaseValues ? creaseValues[ min( c, numCreaseValues - 1 ) ] : RIB_INFINITY );
+							offset += length;
+						}
+						creaseLengths = NULL;
+					} else
+					if( "cornervalue" == name ) {
+						cornerValues = ( const float* )( *it )->data();
+						numCornerValues = ( *it )->size();
+					} else
+					if( "corner" == name ) {
+						// All corners go into one tag, with one value each or one value for all
+						const int *indices( ( const int* )( *it )->data() );
+						const unsigned size( ( *it )->size() );
+						tags.push_back( "corner" );
+						nargs.push_back( size ); // n vertex indices
+						intargs.insert( intargs.end(), indices, indices + size );
+						if( numCornerValues >= size ) {
+							nargs.push_back( size ); // n crease values
+							floatargs.insert( floatargs.end(), cornerValues, cornerValues + size );
+						} else {
+							nargs.push_back( 1 ); // one crease value
+							floatargs.push_back( numCornerValues ? cornerValues[ 0 ] : RIB_INFINITY );
+						}
+					} else {
+						newParamArray.push_back( *it );
+					}
+				}
+			}
+
+			if( interpolateBoundary ) {
+				tags.push_back( "interpolateboundary" );
+				nargs.push_back( 0 );
+				nargs.push_back( 0 );
+			}
+
+			currentState->tokenValueCache = newParamArray;
+
+			out.request( "SubdivisionMesh" );
+			out.put( interp );
+			out.put( nverts, nfaces );
+			out.put( verts, numVerts );
+			out.put( tags );
+			out.put( nargs );
+			out.put( intargs );
+			out.put( floatargs );
+			currentState->putPrimitiveParameters();
+		}
+
+		currentState->tokenValueCache.clear();
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::sphere( const float radius, const float zmin, const float zmax, const float thetamax, primitiveHandle &identifier ) {
+		currentState->checkStartMotion();
+
+		ribStream& out( *currentState->out );
+		out.request( "Sphere" );
+		out.put( radius );
+		out.put( zmin );
+		out.put( zmax );
+		out.put( thetamax );
+		currentState->putPrimitiveParameters();
+
+		currentState->tokenValueCache.clear();
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::blobby( const int numLeafs, const vector< int >& code, const vector< float >& floatData, const vector< string >& stringData, primitiveHandle& identifier ) {
+		currentState->checkStartMotion();
+
+		ribStream& out( *currentState->out );
+		out.request( "Blobby" );
+		out.put( numLeafs );
+		out.put( code );
+		out.put( floatData );
+		out.put( stringData.empty() ? vector< string >( 1, "" ) : stringData );
+		currentState->putPrimitiveParameters();
+
+		currentState->tokenValueCache.clear();
+
+		currentState->checkEndMotion();
+	}
+
+	void ueberManRibRenderer::makeMap( const string& type ) {
+
+		if( "environment" == type ) {
+			string face[ 6 ] = { "nomap", "nomap", "nomap", "nomap", "nomap", "nomap" };
+			static const char *faceNames[ 6 ] = { "px", "nx", "py", "ny", "pz", "nz" };
+			string mapname( "nomap" );
+			string filter( "gaussian" );
+			float fov = 90.0f;
+			float swidth = 2.5f;
+			float twidth = 2.5f;
+
+			for( vector< tokenValue::tokenValuePtr >::const_iterator it( currentState->tokenValueCache.begin() ); it != currentState->tokenValueCache.end(); it++ ) {
+				if( !( *it )->empty() ) {
+					string name( ( *it )->name() );
+
+					if( tokenValue::typeString == ( *it )->type() ) {
+						const char *value = ( const char* )( *it )->data();
+						for( unsigned i = 0; i < 6; i++ )
+							if( faceNames[ i ] == name )
+								face[ i ] = value;
+
+						if( "mapname" == name )
+							mapname = value;
+
+						if( "filter" == name )
+							filter = value;
+					}
+
+					if( tokenValue::typeFloat == ( *it )->type() ) {
+						if( "filterwidth" == name ) {
+							swidth = ( ( float* ) ( *it )->data() )[ 0 ];
+							twidth = ( ( float* ) ( *it )->data() )[ 1 ];
+						}
+
+						if( "fov" == name )
+							fov = *( float* )( *it )->data();
+					}
+				}
+			}
+
+			const char *ribFilter = ribFilterName( filter );
+
+			ribStream& out( *currentState->out );
+			out.request( "MakeCubeFaceEnvironment" );
+			for( unsigned i = 0; i < 6; i++ )
+				out.put( face[ i ] );
+			out.put( mapname );
+			out.put( fov );
+			out.put( ribFilter ? ribFilter : "gaussian" );
+			out.put( swidth );
+			out.put( twidth );
+		}
+		currentState->tokenValueCache.clear();
+	}
+
+	void ueberManRibRenderer::archiveRecord( const string& type, const string& record ) {
+		if( "verbatim" == type )
+			currentState->out->verbatim( record );
+		else
+			currentState->out->comment( record, "structure" == type );
+	}
+
+
+	// Private methods --------------------------------------------------------
+
+
+	/** Writes the request name and the "type" "name" pair of an
+	 *  Attribute or Option call.
+	 *  Names without a "type:" prefix go into the "user" namespace and get
+	 *  typeName prepended unless they are declared inline already.
+	 */
+	void ueberManRibRenderer::typedRequest( const char *request, const string& typedname, const string& typeName ) {
+		currentState->out->request( request );
+
+		string::size_type pos = typedname.find( ":" );
+		if( string::npos == pos ) {
+			currentState->out->put( "user" );
+			if( string::npos == typedname.find( typeName ) )
+				currentState->out->put( typeName + " " + typedname );
+			else
+				currentState->out->put( typedname );
+		} else {
+			string type( typedname.substr( 0, pos ) );
+			if( "dicing" == type )
+				type = "dice";
+			currentState->out->put( type );
+			currentState->out->put( typedname.substr( pos + 1 ) );
+		}
+	}
+
+	void ueberManRibRenderer::putBasis( const string& interp ) {
+		const char *basis = NULL;
+		int step = 1;
+		if( ( "bspline" == interp ) || ( "b-spline" == interp ) ) {
+			basis = "b-spline";
+		} else
+		if( "bezier" == interp ) {
+			basis = "bezier";
+			step = 3;
+		} else
+		if( "catmull-rom" == interp ) {
+			basis = "catmull-rom";
+		}
+
+		if( basis ) {
+			currentState->out->request( "Basis" );
+			currentState->out->put( basis );
+			currentState->out->put( step );
+			currentState->out->put( basis );
+			currentState->out->put( step );
+		}
+	}
+
+
+	// state subclass ---------------------------------------------------------
+
+
+	ueberManRibRenderer::state::state()
+	:
+		// Number of current Ri call's motion sample
+		sampleCount( -1 ),
+
+		// Total number of samples in current motion block
+		numSamples( 1 ),
+
+		inWorldBlock( false ),
+		secondaryDisplay( false )
+	{
+	}
+
+	string ueberManRibRenderer::state::getTokenAsString( const tokenValue& aTokenValue ) {
+		string typeName( aTokenValue.typeAsString() );
+		if( typeName.empty() )
+			return aTokenValue.name();
+		return typeName + " " + aTokenValue.name();
+	}
+
+	string ueberManRibRenderer::state::getTokenAsClassifiedString( const tokenValue& aTokenValue ) {
+		string tokenValueStr;
+
+		switch( aTokenValue.storage() ) {
+			case tokenValue::storageConstant:
+				tokenValueStr = "constant ";
+				break;
+			case tokenValue::storagePerPiece:
+				tokenValueStr = "uniform ";
+				break;
+			case tokenValue::storageLinear:
+				tokenValueStr = "varying ";
+				break;
+			case tokenValue::storageVertex:
+				tokenValueStr = "vertex ";
+				break;
+			case tokenValue::storageFaceVarying:
+				tokenValueStr = "facevarying ";
+				break;
+			case tokenValue::storageFaceVertex:
+				tokenValueStr = "facevertex ";
+				break;
+			case tokenValue::storageUndefined:
+			default:
+				tokenValueStr = "";
+		};
+
+		return tokenValueStr + getTokenAsString( aTokenValue );
+	}
+
+	void ueberManRibRenderer::state::putPrimitiveParameters() {
+		for( vector< tokenValue::tokenValuePtr >::const_iterator it = tokenValueCache.begin(); it < tokenValueCache.end(); it++ )
+			out->put( getTokenAsClassifiedString( **it ), **it );
+	}
+
+	void ueberManRibRenderer::state::putShaderParameters() {
+		for( vector< tokenValue::tokenValuePtr >::const_iterator it = tokenValueCache.begin(); it < tokenValueCache.end(); it++ )
+			out->put( getTokenAsString( **it ), **it );
+	}
+
+	/** Checks if we need to open a MotionBegin block.
+	 *
+	 *  See ueberManRiRenderer::state::checkStartMotion().
+	 */
+	void ueberManRibRenderer::state::checkStartMotion() {
+		if( sampleCount == numSamples ) {
+			out->request( "MotionBegin" );
+			out->put( motionSamples );
+
+			// make sure we don't emit another MotionBegin call if the API's
+			// user forgets to close the current one
+			++numSamples;
+		}
+	}
+
+	void ueberManRibRenderer::state::checkEndMotion() {
+		--sampleCount;
+		// Close a motion block when the counter reaches zero
+		if( !sampleCount ) {
+			out->request( "MotionEnd" );
+		}
+		// We're outside of a motion block
+		else if( 0 > sampleCount ) {
+			sampleCount = -1;
+		}
+	}
+
+
+	// ribStream subclass -----------------------------------------------------
+
+
+	ueberManRibRenderer::ribStream::ribStream( const string& filename, bool useBinary, bool useCompression, unsigned numThreads, size_t parallelThreshold )
+	:	outBuffer( outBufferSize ),
+		out( NULL ),
+		binary( useBinary ),
+		lineStart( true ),
+		threads( numThreads ),
+		threshold( parallelThreshold )
+	{
+		// Renderers read gzipped RIB transparently, so the name stays the same
+		if( useCompression ) {
+			gzipBuffer = boost::shared_ptr< gzipStreamBuffer >( new gzipStreamBuffer( filename ) );
+			if( gzipBuffer->is_open() )
+				out = gzipBuffer.get();
+		} else {
+			// The buffer has to be set before the file is opened
+			fileBuffer.pubsetbuf( &outBuffer[ 0 ], outBuffer.size() );
+			if( fileBuffer.open( filename.c_str(), ios::out | ios::trunc | ios::binary ) )
+				out = &fileBuffer;
+		}
+	}
+
+	ueberManRibRenderer::ribStream::~ribStream() {
+		close();
+	}
+
+	bool ueberManRibRenderer::ribStream::is_open() const {
+		return NULL != out;
+	}
+
+	void ueberManRibRenderer::ribStream::close() {
+		if( out ) {
+			if( !lineStart )
+				out->sputc( '\n' );
+			out->pubsync();
+			out = NULL;
+		}
+		gzipBuffer.reset();
+		if( fileBuffer.is_open() )
+			fileBuffer.close();
+	}
+
+	void ueberManRibRenderer::ribStream::request( const char *name ) {
+		if( !out )
+			return;
+
+		if( binary ) {
+			map< string, unsigned char >::iterator it = requestCodes.find( name );
+			if( requestCodes.end() != it ) {
+				out->sputc( ( char )ribRequest );
+				out->sputc( ( char )it->second );
+				return;
+			}
+			if( requestCodes.size() < 256 ) {
+				unsigned char code = ( unsigned char )requestCodes.size();
+				requestCodes[ name ] = code;
+				out->sputc( ( char )ribDefineRequest );
+				out->sputc( ( char )code );
+				put( name );
+				out->sputc( ( char )ribRequest );
+				out->sputc( ( char )code );
+				return;
+			}
+			// Out of codes, ASCII requests can be mixed in freely
+			out->sputc( '\n' );
+			out->sputn( name, strlen( name ) );
+			out->sputc( '\n' );
+			return;
+		}
+
+		if( !lineStart )
+			out->sputc( '\n' );
+		out->sputn( name, strlen( name ) );
+		lineStart = false;
+	}
+
+	void ueberManRibRenderer::ribStream::comment( const string& text, bool structure ) {
+		if( !out )
+			return;
+
+		if( !lineStart || binary )
+			out->sputc( '\n' );
+		out->sputn( structure ? "##" : "#", structure ? 2 : 1 );
+		out->sputn( text.data(), text.length() );
+		out->sputc( '\n' );
+		lineStart = true;
+	}
+
+	void ueberManRibRenderer::ribStream::verbatim( const string& text ) {
+		if( !out )
+			return;
+
+		if( !lineStart || binary )
+			out->sputc( '\n' );
+		out->sputn( text.data(), text.length() );
+		out->sputc( '\n' );
+		lineStart = true;
+	}
+
+	void ueberManRibRenderer::ribStream::separate() {
+		if( !binary )
+			out->sputc( ' ' );
+	}
+
+	void ueberManRibRenderer::ribStream::put( const int value ) {
+		if( !out )
+			return;
+
+		if( binary ) {
+			putBinaryInt( value );
+		} else {
+			char tmp[ numberFormatSize ];
+			separate();
+			out->sputn( tmp, formatInt( value, tmp ) );
+		}
+	}
+
+	void ueberManRibRenderer::ribStream::put( const float value ) {
+		if( !out )
+			return;
+
+		if( binary ) {
+			out->sputc( ( char )ribFloat );
+			putBigEndian( out, floatBits( value ), 4 );
+		} else {
+			char tmp[ numberFormatSize ];
+			separate();
+			out->sputn( tmp, formatFloat( value, tmp ) );
+		}
+	}
+
+	void ueberManRibRenderer::ribStream::put( const char *value ) {
+		put( string( value ) );
+	}
+
+	void ueberManRibRenderer::ribStream::put( const string& value ) {
+		if( !out )
+			return;
+
+		if( binary ) {
+			if( value.length() < 16 )
+				out->sputc( ( char )( ribShortString + value.length() ) );
+			else
+				putBinaryLength( ribString, value.length() );
+			out->sputn( value.data(), value.length() );
+		} else {
+			separate();
+			out->sputc( '"' );
+			for( string::const_iterator it = value.begin(); it < value.end(); it++ ) {
+				switch( *it ) {
+					case '"':
+					case '\\':
+						out->sputc( '\\' );
+						out->sputc( *it );
+						break;
+					case '\n':
+						out->sputn( "\\n", 2 );
+						break;
+					default:
+						out->sputc( *it );
+				}
+			}
+			out->sputc( '"' );
+		}
+	}
+
+	void ueberManRibRenderer::ribStream::put( const float *values, size_t size ) {
+		if( !out )
+			return;
+
+		if( binary ) {
+			putBinaryLength( ribFloatArray, size );
+			// Swap into big endian order a block at a time
+			char block[ ribBlockSize * 4 ];
+			for( size_t i = 0; i < size; i += ribBlockSize ) {
+				size_t n = min( ribBlockSize, size - i );
+				char *dest = block;
+				for( size_t j = 0; j < n; j++ ) {
+					unsigned bits = floatBits( values[ i + j ] );
+					*dest++ = ( char )( bits >> 24 );
+					*dest++ = ( char )( bits >> 16 );
+					*dest++ = ( char )( bits >> 8 );
+					*dest++ = ( char )bits;
+				}
+				out->sputn( block, n * 4 );
+			}
+		} else {
+			separate();
+			out->sputc( '[' );
+			putAscii( values, size );
+			out->sputc( ']' );
+		}
+	}
+
+	void ueberManRibRenderer::ribStream::put( const int *values, size_t size ) {
+		if( !out )
+			return;
+
+		if( binary ) {
+			// There is no encoding for integer arrays
+			out->sputc( '[' );
+			for( size_t i = 0; i < size; i++ )
+				putBinaryInt( values[ i ] );
+			out->sputc( ']' );
+		} else {
+			separate();
+			out->sputc( '[' );
+			putAscii( values, size );
+			out->sputc( ']' );
+		}
+	}
+
+	void ueberManRibRenderer::ribStream::put( const vector< float >& values ) {
+		put( values.empty() ? NULL : &values[ 0 ], values.size() );
+	}
+
+	void ueberManRibRenderer::ribStream::put( const vector< int >& values ) {
+		put( values.empty() ? NULL : &values[ 0 ], values.size() );
+	}
+
+	void ueberManRibRenderer::ribStream::put( const vector< string >& values ) {
+		if( !out )
+			return;
+
+		separate();
+		out->sputc( '[' );
+		for( vector< string >::const_iterator it = values.begin(); it < values.end(); it++ )
+			put( *it );
+		separate();
+		out->sputc( ']' );
+	}
+
+	void ueberManRibRenderer::ribStream::put( const string& token, const tokenValue& aTokenValue ) {
+		put( token );
+		switch( aTokenValue.type() ) {
+			case tokenValue::typeString:
+				put( vector< string >( 1, string( ( const char* )aTokenValue.data() ) ) );
+				break;
+			case tokenValue::typeInteger:
+			case tokenValue::typeBoolean:
+				put( ( const int* )aTokenValue.data(), aTokenValue.byteSize() / sizeof( int ) );
+				break;
+			default:
+				put( ( const float* )aTokenValue.data(), aTokenValue.byteSize() / sizeof( float ) );
+		}
+	}
+
+	void ueberManRibRenderer::ribStream::putBinaryInt( int value ) {
+		unsigned char bytes;
+		if( ( -0x80 <= value ) && ( value < 0x80 ) )
+			bytes = 1;
+		else if( ( -0x8000 <= value ) && ( value < 0x8000 ) )
+			bytes = 2;
+		else if( ( -0x800000 <= value ) && ( value < 0x800000 ) )
+			bytes = 3;
+		else
+			bytes = 4;
+		out->sputc( ( char )( ribInteger + bytes - 1 ) );
+		putBigEndian( out, ( unsigned )value, bytes );
+	}
+
+	void ueberManRibRenderer::ribStream::putBinaryLength( unsigned char code, size_t length ) {
+		unsigned char bytes = numBytes( ( unsigned )length );
+		out->sputc( ( char )( code + bytes - 1 ) );
+		putBigEndian( out, ( unsigned )length, bytes );
+	}
+
+	/** Formats values space separated.
+	 *  Big arrays are split into one chunk per thread which are formatted
+	 *  concurrently and then written in order.
+	 */
+	template< class T > void ueberManRibRenderer::ribStream::putAscii( const T *values, size_t size ) {
+		if( ( 1 < threads ) && ( threshold <= size ) ) {
+			size_t chunkSize = ( size + threads - 1 ) / threads;
+			vector< string > chunks( threads );
+			boost::thread_group formatters;
+			for( unsigned i = 1; i < threads; i++ ) {
+				size_t begin = i * chunkSize;
+				if( begin < size )
+					formatters.create_thread( boost::bind( &formatChunk< T >, values + begin, min( chunkSize, size - begin ), &chunks[ i ] ) );
+			}
+			// This thread does the first chunk
+			formatChunk( values, min( chunkSize, size ), &chunks[ 0 ] );
+			formatters.join_all();
+
+			for( unsigned i = 0; i < threads; i++ ) {
+				if( !chunks[ i ].empty() ) {
+					if( i )
+						out->sputc( ' ' );
+					out->sputn( chunks[ i ].data(), chunks[ i ].length() );
+				}
+			}
+		} else {
+			for( size_t i = 0; i < size; i += ribBlockSize ) {
+				formatBuffer.clear();
+				if( i )
+					formatBuffer += ' ';
+				formatValues( values + i, min( ribBlockSize, size - i ), formatBuffer );
+				out->sputn( formatBuffer.data(), formatBuffer.length() );
+			}
+		}
+	}
+}
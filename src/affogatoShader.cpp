@@ -40,12 +40,18 @@
 
 // Standard headers
 #include <cctype>
+#include <fstream>
+#include <map>
 #include <math.h>
+#include <set>
+#include <sstream>
 #include <string>
+#include <vector>
 
 // Boost headers
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <boost/tokenizer.hpp>
 
 // XSI headers
@@ -53,15 +59,20 @@
 #include <xsi_argument.h>
 #include <xsi_command.h>
 #include <xsi_context.h>
+#include <xsi_geometry.h>
 #include <xsi_kinematics.h>
 #include <xsi_model.h>
+#include <xsi_point.h>
 #include <xsi_ppglayout.h>
+#include <xsi_primitive.h>
 #include <xsi_selection.h>
+#include <xsi_vector3.h>
 
 // Affogato headers
 #include "affogato.hpp"
 #include "affogatoGlobals.hpp"
 #include "affogatoHelpers.hpp"
+#include "affogatoPropertyIndex.hpp"
 #include "affogatoRenderer.hpp"
 #include "affogatoShader.hpp"
 #include "affogatoWorker.hpp"
@@ -77,6 +88,279 @@ namespace affogato {
 	using namespace boost;
 	using namespace std;
 
+	// Scene geometry hash of the current export, see sceneGeometryHash()
+	static vector< float > geometryHashTimes;
+	static string geometryHash;
+
+	/** Hashes everything about the scene's geometry that changes what a
+	 *  shadow map sees: visibility, transforms & point positions of all
+	 *  geometric objects at the given times. All lights of a frame share
+	 *  the result.
+	 */
+	static string sceneGeometryHash( const vector< float >& times ) {
+		if( !geometryHash.empty() && ( geometryHashTimes == times ) )
+			return geometryHash;
+
+		Application app;
+		Model sceneRoot( app.GetActiveSceneRoot() );
+
+		const CString types[] = { siPolyMeshType, siSrfMeshPrimType, siCrvListPrimType, siHairKeyword, siCloudPrimType, siSpherePrimType };
+
+		contentHash hash;
+		for( unsigned t = 0; t < sizeof( types ) / sizeof( CString ); t++ ) {
+			CRefArray objects( sceneRoot.FindChildren( L"", types[ t ], CStringArray() ) );
+			for( long i = 0; i < objects.GetCount(); i++ ) {
+				X3DObject obj( objects[ i ] );
+				hash.add( CStringToString( obj.GetFullName() ) );
+				if( !isVisible( obj ) )
+					continue;
+
+				Primitive prim( obj.GetActivePrimitive() );
+				for( vector< float >::const_iterator time = times.begin(); time < times.end(); time++ ) {
+					const vector< float >& matrix( CMatrix4ToFloat( obj.GetKinematics().GetGlobal().GetTransform( *time ).GetMatrix4() ) );
+					hash.add( &matrix[ 0 ], matrix.size() * sizeof( float ) );
+
+					if( siSpherePrimType == types[ t ] ) {
+						hash.add( ( float )prim.GetParameterValue( L"radius", *time ) );
+					} else {
+						CVector3Array points( Geometry( prim.GetGeometry( *time ) ).GetPoints().GetPositionArray() );
+						for( long p = 0; p < points.GetCount(); p++ ) {
+							hash.add( ( float )points[ p ].GetX() );
+							hash.add( ( float )points[ p ].GetY() );
+							hash.add( ( float )points[ p ].GetZ() );
+						}
+					}
+				}
+			}
+		}
+
+		geometryHashTimes = times;
+		geometryHash = hash.str();
+
+		return geometryHash;
+	}
+
+	// Scene shading hash of the current export, see sceneShadingHash()
+	static float shadingHashTime;
+	static string shadingHash;
+
+	/** Hashes what changes how the scene is shaded: the transforms of
+	 *  all lights and the values of all shader & Affogato properties
+	 *  in the scene, including the ones applied to groups.
+	 */
+	static string sceneShadingHash( float time ) {
+		if( !shadingHash.empty() && ( shadingHashTime == time ) )
+			return shadingHash;
+
+		Application app;
+		Model sceneRoot( app.GetActiveSceneRoot() );
+
+		CRefArray items( sceneRoot.FindChildren( L"", CString(), CStringArray() ) );
+		items += sceneRoot.GetGroups();
+
+		contentHash hash;
+		for( long i = 0; i < items.GetCount(); i++ ) {
+			SceneItem item( items[ i ] );
+			hash.add( CStringToString( item.GetFullName() ) );
+
+			if( siLightPrimType == item.GetType() ) {
+				const vector< float >& matrix( CMatrix4ToFloat( X3DObject( item ).GetKinematics().GetGlobal().GetTransform( time ).GetMatrix4() ) );
+				hash.add( &matrix[ 0 ], matrix.size() * sizeof( float ) );
+			}
+
+			CRefArray props( item.GetProperties() );
+			for( long j = 0; j < props.GetCount(); j++ ) {
+				Property prop( props[ j ] );
+				if( shader::isShader( prop ) || isAffogatoProperty( prop ) ) {
+					CParameterRefArray params( prop.GetParameters() );
+					for( long k = 0; k < params.GetCount(); k++ )
+						hash.add( CStringToString( Parameter( params[ k ] ).GetScriptName() + L"=" + Parameter( params[ k ] ).GetValue( time ).GetAsText() ) );
+				}
+			}
+		}
+
+		shadingHashTime = time;
+		shadingHash = hash.str();
+
+		return shadingHash;
+	}
+
+	// Generated maps by the hash of what they depend on
+	struct mapEntry {
+		string fileName;
+		string indexFile;
+		bool pending; // Rendered by a task of this export, which nothing else can depend on
+		bool rendered; // The stamp is that of the map rendered from the dependencies,
+					   // otherwise it's the one the file had when the map was scheduled
+		long time;
+		long size;
+	};
+	static map< string, mapEntry > generatedMaps;
+	static map< string, string > generatedMapDependencies; // The other way round, by file name
+	static set< string > loadedMapIndices;
+	static set< string > staleMapIndices; // Indices with lines that were superseded since they were written
+
+	// Modification time & size of a file; -1 for both if it doesn't exist
+	static void mapStamp( const string& fileName, long& time, long& size ) {
+		time = size = -1;
+		try {
+			if( filesystem::exists( fileName ) ) {
+				time = ( long )filesystem::last_write_time( fileName );
+				size = ( long )filesystem::file_size( fileName );
+			}
+		} catch( ... ) {
+			time = size = -1;
+		}
+	}
+
+	// Forgets the map written to fileName, if any
+	static void forgetMap( const string& fileName ) {
+		map< string, string >::iterator it( generatedMapDependencies.find( fileName ) );
+		if( generatedMapDependencies.end() != it ) {
+			staleMapIndices.insert( generatedMaps[ it->second ].indexFile );
+			generatedMaps.erase( it->second );
+			generatedMapDependencies.erase( it );
+		}
+	}
+
+	static mapEntry& rememberMap( const string& indexFile, const string& dependencies, const string& fileName ) {
+		forgetMap( fileName );
+		map< string, mapEntry >::iterator it( generatedMaps.find( dependencies ) );
+		if( generatedMaps.end() != it ) {
+			staleMapIndices.insert( it->second.indexFile );
+			generatedMapDependencies.erase( it->second.fileName );
+		}
+		mapEntry& entry( generatedMaps[ dependencies ] );
+		entry.fileName = fileName;
+		entry.indexFile = indexFile;
+		entry.pending = false;
+		entry.rendered = false;
+		entry.time = entry.size = -1;
+		generatedMapDependencies[ fileName ] = dependencies;
+		return entry;
+	}
+
+	static void writeMapEntry( ostream& out, const string& dependencies, const mapEntry& entry ) {
+		out << dependencies << ' ' << ( entry.rendered ? 'R' : 'S' ) << ' ' << entry.time << ' ' << entry.size << ' ' << entry.fileName << '\n';
+	}
+
+	/* Checks whether a map is (still) what was rendered from its dependencies.
+	 * A scheduled map counts as rendered once its file changed after it was
+	 * scheduled. If the render never ran, the file is missing or still the
+	 * old one. A rendered map is only valid while its file stays untouched.
+	 */
+	static bool validMap( mapEntry& entry ) {
+		long time, size;
+		mapStamp( entry.fileName, time, size );
+		if( -1 == time )
+			return false;
+		if( !entry.rendered ) {
+			if( ( time == entry.time ) && ( size == entry.size ) )
+				return false;
+			entry.rendered = true;
+			entry.time = time;
+			entry.size = size;
+			staleMapIndices.insert( entry.indexFile );
+			return true;
+		}
+		return ( time == entry.time ) && ( size == entry.size );
+	}
+
+	// Rewrites an index with just the entries that are still valid
+	static void writeMapIndex( const string& indexFile ) {
+		ofstream out( indexFile.c_str() );
+		for( map< string, mapEntry >::const_iterator it = generatedMaps.begin(); it != generatedMaps.end(); it++ )
+			if( indexFile == it->second.indexFile )
+				writeMapEntry( out, it->first, it->second );
+		staleMapIndices.erase( indexFile );
+	}
+
+	// Each map directory keeps an index of the maps rendered into it, so they can be reused by later runs
+	static string mapIndex( const filesystem::path& dir ) {
+		const string indexFile( ( dir / "affogatoMaps.txt" ).native_file_string() );
+		if( loadedMapIndices.end() == loadedMapIndices.find( indexFile ) ) {
+			loadedMapIndices.insert( indexFile );
+			ifstream in( indexFile.c_str() );
+			string line;
+			while( getline( in, line ) ) {
+				istringstream fields( line );
+				string dependencies, state, fileName;
+				long time, size;
+				if( !( fields >> dependencies >> state >> time >> size ) || ( ( "R" != state ) && ( "S" != state ) ) ) {
+					// Written by an older version, without a stamp to check the map against
+					staleMapIndices.insert( indexFile );
+					continue;
+				}
+				fields.get(); // Separator; file names may contain blanks
+				getline( fields, fileName );
+				if( fileName.empty() )
+					continue;
+				// Later lines supersede earlier ones for the same map
+				mapEntry& entry( rememberMap( indexFile, dependencies, fileName ) );
+				entry.rendered = ( "R" == state );
+				entry.time = time;
+				entry.size = size;
+			}
+			in.close();
+			// Drop maps that have been deleted or replaced since
+			vector< string > invalid;
+			for( map< string, string >::const_iterator it = generatedMapDependencies.begin(); it != generatedMapDependencies.end(); it++ ) {
+				mapEntry& entry( generatedMaps[ it->second ] );
+				if( ( indexFile == entry.indexFile ) && entry.rendered && !validMap( entry ) )
+					invalid.push_back( it->first );
+			}
+			for( vector< string >::const_iterator it = invalid.begin(); it < invalid.end(); it++ )
+				forgetMap( *it );
+			if( staleMapIndices.end() != staleMapIndices.find( indexFile ) )
+				writeMapIndex( indexFile );
+		}
+		return indexFile;
+	}
+
+	/* Returns the file of a map with the given dependencies or an empty string.
+	 * Only maps that were verifiably rendered from these dependencies are
+	 * returned. A map rendered by a task of this export can't be used, as the
+	 * job has no way to make another task wait for it.
+	 */
+	static string findMap( const filesystem::path& dir, const string& dependencies ) {
+		mapIndex( dir );
+		map< string, mapEntry >::iterator it( generatedMaps.find( dependencies ) );
+		if( ( generatedMaps.end() == it ) || it->second.pending || !validMap( it->second ) )
+			return string();
+		return it->second.fileName;
+	}
+
+	/* Registers a map a task of this export is going to render. The index
+	 * remembers the stamp the file has now; the entry only becomes usable
+	 * once the file changed, i.e. the render actually ran.
+	 */
+	static void addMap( const filesystem::path& dir, const string& dependencies, const string& fileName ) {
+		const string indexFile( mapIndex( dir ) );
+		mapEntry& entry( rememberMap( indexFile, dependencies, fileName ) );
+		entry.pending = true;
+		mapStamp( fileName, entry.time, entry.size );
+		ofstream out( indexFile.c_str(), ios::app );
+		writeMapEntry( out, dependencies, entry );
+	}
+
+	// Forgets what the map at fileName depended on, as a task of this export
+	// is going to render it without checking
+	static void overwriteMap( const filesystem::path& dir, const string& fileName ) {
+		mapIndex( dir );
+		forgetMap( fileName );
+	}
+
+	void shader::clearMapDependencies() {
+		geometryHash.clear();
+		geometryHashTimes.clear();
+		shadingHash.clear();
+		for( map< string, mapEntry >::iterator it = generatedMaps.begin(); it != generatedMaps.end(); it++ )
+			it->second.pending = false;
+		// Compact the indices the last export appended superseded entries to
+		while( !staleMapIndices.empty() )
+			writeMapIndex( *staleMapIndices.begin() );
+	}
+
 	shader::shader()
 	:	type( shaderUndefined ),
 		displacementSphere( 0 ),
@@ -191,6 +475,9 @@ namespace affogato {
 				}
 			}
 
+			// Keeps the compiled templates of string parameters
+			const propertyIndex::parameterVector& parameters( propertyIndex::parameters( aShader ) );
+
 			for( tokenizer::iterator it = tokens.begin(); it != tokens.end(); it++ ) {
 				switch( atoi( ( *( it++ ) ).c_str() ) ) {
 					case 1: // float
@@ -204,7 +491,11 @@ namespace affogato {
 						tokenValuePtrArray.push_back( shared_ptr< tokenValue>( new tokenValue( color, 3, *it, tokenValue::storageUndefined, tokenValue::typeColor ) ) );
 						break;
 					case 7: { // string
-						string cleanedValue, value( parseString( CStringToString( ( CString )aShader.GetParameterValue( stringToCString( *it ) ) ) ) );
+						const string rawValue( CStringToString( ( CString )aShader.GetParameterValue( stringToCString( *it ) ) ) );
+						propertyIndex::parameterVector::const_iterator parameter( parameters.begin() );
+						while( ( parameter < parameters.end() ) && ( *it != parameter->originalName ) )
+							parameter++;
+						string cleanedValue, value( ( parameter < parameters.end() ) ? parameter->expand( rawValue ) : parseString( rawValue ) );
 						cleanedValue = value;
 						replace_all( cleanedValue, " ", "" );
 
@@ -313,7 +604,55 @@ namespace affogato {
 									}
 									shadowMapSourceName		+= ext;
 
-									if( g.data.shadow.shadow ) {
+									bool generate( g.data.shadow.shadow );
+									if( generate && ( mapGenLazy == mapGeneration ) ) {
+										// Everything that goes into the shadow camera block, plus the geometry the map sees
+										vector< float > cameraTimes( g.motionBlur.lightBlur ? getMotionSamples( g.motionBlur.transformMotionSamples ) : vector< float >( 1, ( float )g.animation.time ) );
+										vector< float > geometryTimes( g.motionBlur.shadowMapBlur ? getMotionSamples( g.motionBlur.transformMotionSamples ) : vector< float >( 1, ( float )g.animation.time ) );
+
+										contentHash hash;
+										hash.add( CStringToString( camera.GetFullName() ) + ext );
+										hash.add( CStringToString( aShader.GetParameterValue( L"__category" ) ) );
+										hash.add( CStringToString( light.GetParameterValue( L"ShadowMapRes" ).GetAsText() ) );
+										hash.add( CStringToString( light.GetParameterValue( L"ShadowMapDetailSamples" ).GetAsText() ) );
+										hash.add( CStringToString( light.GetParameterValue( L"ShadowMapDetailAccuracy" ).GetAsText() ) );
+										for( unsigned i = 0; i < ( unsigned )affogatoProps.GetCount(); i++ ) {
+											CParameterRefArray params( Property( affogatoProps[ i ] ).GetParameters() );
+											for( long j = 0; j < params.GetCount(); j++ )
+												hash.add( CStringToString( Parameter( params[ j ] ).GetScriptName() + L"=" + Parameter( params[ j ] ).GetValue().GetAsText() ) );
+										}
+										const char *cameraParams[] = { "proj", "orthoheight", "near", "far", "fov" };
+										for( unsigned i = 0; i < sizeof( cameraParams ) / sizeof( char* ); i++ )
+											hash.add( ( float )camera.GetParameterValue( stringToCString( cameraParams[ i ] ), g.animation.time ) );
+										for( vector< float >::const_iterator time = cameraTimes.begin(); time < cameraTimes.end(); time++ ) {
+											const vector< float >& matrix( CMatrix4ToFloat( camera.GetKinematics().GetGlobal().GetTransform( *time ).GetMatrix4() ) );
+											hash.add( &matrix[ 0 ], matrix.size() * sizeof( float ) );
+										}
+										hash.add( g.shading.rate );
+										hash.add( g.rays.subSurface.rate );
+										hash.add( ( float )g.rays.irradiance.samples );
+										hash.add( ( float )g.rays.irradiance.shadingRate );
+										hash.add( g.motionBlur.shutterOpen );
+										hash.add( g.motionBlur.shutterClose );
+										hash.add( g.motionBlur.shutterEfficiency );
+										hash.add( sceneGeometryHash( geometryTimes ) );
+										// Caster shaders, e.g. displacement bounds & opacity
+										hash.add( sceneShadingHash( g.animation.time ) );
+
+										const string dependencies( hash.str() );
+										const string existing( findMap( shadowDir, dependencies ) );
+										if( !existing.empty() ) {
+											message( L"Reusing shadow map '" + stringToCString( existing ) + L"', nothing it depends on changed", messageInfo );
+											shadowMapSourceName = existing;
+											generate = false;
+										} else {
+											addMap( shadowDir, dependencies, shadowMapSourceName );
+										}
+									} else if( generate ) {
+										overwriteMap( shadowDir, shadowMapSourceName );
+									}
+
+									if( generate ) {
 
 										bm.beginBlock( blockManager::blockShadowScene, true, shadowName );
 
@@ -506,9 +845,80 @@ namespace affogato {
 										Property prop( props[ i ] );
 										if( CString( L"AffogatoEnvironmentMapGenerator" ) == prop.GetType() ) {
 											if( isVisible( object ) ) {
+												string dependencies, existing;
+												if( ( bool )prop.GetParameterValue( L"ReuseUnchanged" ) ) {
+													// Everything that goes into the face blocks, plus the scene the map sees
+													contentHash hash;
+													hash.add( CStringToString( object.GetFullName() ) + ext );
+													CParameterRefArray params( prop.GetParameters() );
+													for( long j = 0; j < params.GetCount(); j++ )
+														hash.add( CStringToString( Parameter( params[ j ] ).GetScriptName() + L"=" + Parameter( params[ j ] ).GetValue( g.animation.time ).GetAsText() ) );
+													// The faces are rendered with the motion blur shutter, so
+													// the scene has to be compared at every sample it sees
+													vector< float > geometryTimes( 1, ( float )g.animation.time );
+													if( 1 < g.motionBlur.transformMotionSamples ) {
+														const vector< float >& times( getMotionSamples( g.motionBlur.transformMotionSamples ) );
+														geometryTimes.insert( geometryTimes.end(), times.begin(), times.end() );
+													}
+													if( g.motionBlur.geometryBlur && ( 1 < g.motionBlur.deformMotionSamples ) ) {
+														const vector< float >& times( getMotionSamples( g.motionBlur.deformMotionSamples ) );
+														geometryTimes.insert( geometryTimes.end(), times.begin(), times.end() );
+													}
+													for( vector< float >::const_iterator time = geometryTimes.begin(); time < geometryTimes.end(); time++ ) {
+														const vector< float >& matrix( CMatrix4ToFloat( object.GetKinematics().GetGlobal().GetTransform( *time ).GetMatrix4() ) );
+														hash.add( &matrix[ 0 ], matrix.size() * sizeof( float ) );
+													}
+													hash.add( g.shading.rate );
+													hash.add( g.shading.smooth ? 1.0f : 0.0f );
+													hash.add( ( float )g.shading.hair );
+													hash.add( g.reyes.opacityThreshold );
+													hash.add( g.rays.enable ? ( float )g.rays.trace.depth : -1.0f );
+													hash.add( ( float )g.rays.irradiance.samples );
+													hash.add( ( float )g.rays.irradiance.shadingRate );
+													hash.add( g.rays.subSurface.rate );
+													hash.add( g.rays.trace.bias );
+													hash.add( g.rays.trace.motion ? 1.0f : 0.0f );
+													hash.add( g.rays.trace.displacements ? 1.0f : 0.0f );
+													hash.add( g.reyes.motionFactor );
+													hash.add( g.reyes.focusFactor );
+													hash.add( g.reyes.jitter ? 1.0f : 0.0f );
+													hash.add( g.reyes.extremeMotionDepthOfField ? 1.0f : 0.0f );
+													hash.add( g.motionBlur.shutterOpen );
+													hash.add( g.motionBlur.shutterClose );
+													hash.add( g.motionBlur.shutterEfficiency );
+													hash.add( g.motionBlur.shutterOffset );
+													hash.add( ( float )g.motionBlur.shutterConfiguration );
+													hash.add( sceneGeometryHash( geometryTimes ) );
+													hash.add( sceneShadingHash( ( float )g.animation.time ) );
+
+													// Only a map an earlier export rendered will do; nothing can make
+													// this frame wait for another frame's face and conversion jobs
+													dependencies = hash.str();
+													existing = findMap( envDir, dependencies );
+												}
+
+												if( !existing.empty() ) {
+													message( L"Reusing environment map '" + stringToCString( existing ) + L"', nothing it depends on changed", messageInfo );
+													value = existing;
+													break;
+												}
+
+												if( !dependencies.empty() )
+													addMap( envDir, dependencies, envMapSourceName );
+												else
+													overwriteMap( envDir, envMapSourceName );
+
+												// The block converting the faces into an environment map is begun
+												// first, so the face renders end up as its independent sub jobs
+												envName = objectName + ".environment";
+												string envMapWriteNameGlobal( getCacheFilePath( envDir / ( g.name.baseName + "." + envName + ".####" ), g.directories.caching.mapWrite ).native_file_string() + ext );
+
+												bm.beginBlock( blockManager::blockMapScene, true, envName );
+
+												context envCtx( bm.currentContext() );
+
 												vector< string > mapFace;
 												vector< string > paramName;
-												taskList mapFaceTasks;
 												for( unsigned camera = 0; camera < 6; camera++ ) {
 
 													switch( camera ) {
@@ -647,13 +1057,7 @@ namespace affogato {
 													bm.endBlock( ctx, 200 );
 												}
 
-												// Create data file to convert texture
-												envName = objectName + ".environment";
-												string envMapWriteNameGlobal( getCacheFilePath( envDir / jobNameGlobal, g.directories.caching.mapWrite ).native_file_string() );
-
-												bm.beginBlock( blockManager::blockMapScene, true, envName );
-
-												context ctx( bm.currentContext() );
+												bm.switchBlock( envCtx );
 
 												for( unsigned i = 0; i < 6; i++ ) {
 													theRenderer.parameter( paramName[ i ], ( string )mapFace[ i ] );
@@ -665,7 +1069,7 @@ namespace affogato {
 
 												bm.addMapRenderIoToCurrentBlock( envMapWriteNameGlobal, envMapSourceName );
 
-												bm.endBlock( ctx, 101 );
+												bm.endBlock( envCtx, 101 );
 
 												value = envMapSourceName;
 											}
@@ -725,6 +1129,26 @@ namespace affogato {
 		return type;
 	}
 
+	string shader::signature() const {
+		if( !isValid() )
+			return string();
+
+		string sig( ( const char* )&type, sizeof( type ) );
+		sig.append( ( const char* )&displacementSphere, sizeof( displacementSphere ) );
+		sig += name;
+		sig += '\0';
+		sig += displacementSpace;
+		sig += '\0';
+		for( tokenValue::tokenValuePtrVector::const_iterator it = tokenValuePtrArray.begin(); it < tokenValuePtrArray.end(); it++ ) {
+			const string parameterSig( ( *it )->signature() );
+			const size_t parameterSize( parameterSig.size() );
+			sig.append( ( const char* )&parameterSize, sizeof( parameterSize ) );
+			sig += parameterSig;
+		}
+
+		return sig;
+	}
+
 	void shader::write( const string &aHandle ) {
 		if( isValid() ) {
 			globals& g = const_cast< globals& >( globals::access() );
@@ -805,12 +1229,237 @@ using namespace std;
 
 
 
-bool findAndSetSloShader( string& shaderFile ) {
+// Everything AffogatoCreateShader needs to know about a compiled shader
+struct sloArgument {
+	string			name;
+	int				type;			// SLO_TYPE
+	unsigned		arrayLength;	// 0 for non-arrays
+	vector< float >	defaults;		// All elements, 1 float per scalar, 3 per triple, 16 per matrix
+	vector< string >defaultStrings;	// All elements, for strings
+};
+
+struct sloShader {
+	int						type;	// SLO_TYPE
+	time_t					modified;
+	vector< sloArgument >	arguments;
+};
+
+// Shaders parsed this session, by file. Loaded from & saved to sloCacheFile().
+static map< string, sloShader > sloCache;
+static bool sloCacheLoaded( false );
+
+// Empty if there is no private directory to keep it in
+static string sloCacheFile() {
+	const string dir( privateDirectory() );
+	if( dir.empty() )
+		return string();
+	return dir + "/affogatoShaderCache.txt";
+}
+
+/* The file has one block per shader:
+ *   <modified> <type> <number of arguments> <file>
+ * followed by one line per argument:
+ *   <type> <array length> <number of floats> <floats...> <number of strings> <name>
+ * followed by one line per string default.
+ * New shaders are appended, later blocks supersede earlier ones for the
+ * same file.
+ */
+static void writeSloEntry( ostream& out, const string& file, const sloShader& entry ) {
+	out.precision( 9 );
+	out << entry.modified << ' ' << entry.type << ' ' << entry.arguments.size() << ' ' << file << '\n';
+	for( vector< sloArgument >::const_iterator arg = entry.arguments.begin(); arg < entry.arguments.end(); arg++ ) {
+		out << arg->type << ' ' << arg->arrayLength << ' ' << arg->defaults.size();
+		for( vector< float >::const_iterator f = arg->defaults.begin(); f < arg->defaults.end(); f++ )
+			out << ' ' << *f;
+		out << ' ' << arg->defaultStrings.size() << ' ' << arg->name << '\n';
+		for( vector< string >::const_iterator str = arg->defaultStrings.begin(); str < arg->defaultStrings.end(); str++ )
+			out << *str << '\n';
+	}
+}
+
+// Replaces the file with one block per shader
+static void saveSloCache() {
+	const string cacheFile( sloCacheFile() );
+	if( cacheFile.empty() )
+		return;
+	ostringstream out;
+	for( map< string, sloShader >::const_iterator it = sloCache.begin(); it != sloCache.end(); it++ )
+		writeSloEntry( out, it->first, it->second );
+	writePrivateFile( cacheFile, out.str() );
+}
+
+static void appendSloCache( const string& file, const sloShader& entry ) {
+	const string cacheFile( sloCacheFile() );
+	if( cacheFile.empty() )
+		return;
+	if( !isPrivateFile( cacheFile ) ) { // Not there yet
+		saveSloCache();
+		return;
+	}
+	// One write, so blocks of concurrent sessions don't interleave
+	ostringstream block;
+	writeSloEntry( block, file, entry );
+	ofstream out( cacheFile.c_str(), ios::app );
+	out << block.str() << flush;
+}
+
+static void loadSloCache() {
+	sloCacheLoaded = true;
+
+	const string cacheFile( sloCacheFile() );
+	if( cacheFile.empty() || !isPrivateFile( cacheFile ) )
+		return;
+
+	// Superseded or broken blocks get the file compacted
+	bool compact( false );
+
+	ifstream in( cacheFile.c_str() );
+	string line;
+	while( getline( in, line ) ) {
+		istringstream header( line );
+		sloShader entry;
+		unsigned numArguments;
+		string file;
+		if( !( header >> entry.modified >> entry.type >> numArguments ) || !getline( header >> ws, file ) ) {
+			compact = true;
+			break;
+		}
+
+		bool valid( true );
+		for( unsigned i = 0; valid && ( i < numArguments ); i++ ) {
+			sloArgument argument;
+			unsigned numFloats, numStrings;
+			valid = false;
+			if( !getline( in, line ) )
+				break;
+			istringstream arg( line );
+			if( !( arg >> argument.type >> argument.arrayLength >> numFloats ) )
+				break;
+			argument.defaults.resize( numFloats );
+			for( unsigned j = 0; j < numFloats; j++ )
+				arg >> argument.defaults[ j ];
+			if( !( arg >> numStrings ) || !getline( arg >> ws, argument.name ) )
+				break;
+			argument.defaultStrings.resize( numStrings );
+			unsigned j = 0;
+			while( ( j < numStrings ) && getline( in, argument.defaultStrings[ j ] ) )
+				j++;
+			if( j < numStrings )
+				break;
+			entry.arguments.push_back( argument );
+			valid = true;
+		}
+		if( !valid ) {
+			compact = true;
+			break;
+		}
+
+		if( sloCache.end() != sloCache.find( file ) )
+			compact = true;
+		sloCache[ file ] = entry;
+	}
+	in.close();
+
+	if( compact )
+		saveSloCache();
+}
+
+// Returns the resolved file name if the shader exists, with or without the .sdl extension
+static bool sloShaderExists( const string& shaderFile, string& resolved ) {
+	try {
+		if( filesystem::exists( shaderFile ) && !filesystem::is_directory( shaderFile ) ) {
+			resolved = shaderFile;
+			return true;
+		}
+		if( filesystem::exists( shaderFile + ".sdl" ) ) {
+			resolved = shaderFile + ".sdl";
+			return true;
+		}
+	} catch( ... ) {
+	}
+	return false;
+}
+
+/** Returns the parsed shader, from the cache if the file didn't change
+ *  since it was parsed last. Only calls the Slo_* API on a cache miss.
+ */
+static const sloShader* getSloShader( const string& shaderFile ) {
+	if( !sloCacheLoaded )
+		loadSloCache();
+
+	time_t modified( 0 );
+	try {
+		modified = filesystem::last_write_time( shaderFile );
+	} catch( ... ) {
+	}
+
+	map< string, sloShader >::iterator it( sloCache.find( shaderFile ) );
+	if( ( sloCache.end() != it ) && ( it->second.modified == modified ) )
+		return &it->second;
+
+	if( Slo_SetShader( shaderFile.c_str() ) )
+		return NULL;
+
+	sloShader& entry( sloCache[ shaderFile ] );
+	entry.type = Slo_GetType();
+	entry.modified = modified;
+	entry.arguments.clear();
+
+	for( int j = 1; j < Slo_GetNArgs() + 1; j++ ) {
+		SLO_VISSYMDEF *parameter = Slo_GetArgById( j );
+		if( !parameter || !parameter->svd_valisvalid || ( SLO_STOR_OUTPUTPARAMETER == parameter->svd_storage ) )
+			continue;
+
+		sloArgument argument;
+		argument.name = parameter->svd_name;
+		argument.type = parameter->svd_type;
+		argument.arrayLength = parameter->svd_arraylen;
+
+		int num_elements = argument.arrayLength == 0 ? 1 : argument.arrayLength;
+		for( int k = 0; k < num_elements; k++ ) {
+			SLO_VISSYMDEF *elem = Slo_GetArrayArgElement( parameter, k );
+			if( !elem )
+				continue;
+
+			switch( parameter->svd_type ) {
+				case SLO_TYPE_SCALAR:
+					argument.defaults.push_back( *elem->svd_default.scalarval );
+					break;
+				case SLO_TYPE_POINT:
+				case SLO_TYPE_VECTOR:
+				case SLO_TYPE_NORMAL:
+				case SLO_TYPE_COLOR:
+					argument.defaults.push_back( elem->svd_default.pointval->xval );
+					argument.defaults.push_back( elem->svd_default.pointval->yval );
+					argument.defaults.push_back( elem->svd_default.pointval->zval );
+					break;
+				case SLO_TYPE_MATRIX:
+					argument.defaults.insert( argument.defaults.end(), elem->svd_default.matrixval, elem->svd_default.matrixval + 16 );
+					break;
+				case SLO_TYPE_STRING:
+					argument.defaultStrings.push_back( elem->svd_default.stringval );
+					break;
+				default:
+					break;
+			}
+		}
+		entry.arguments.push_back( argument );
+	}
+	Slo_EndShader();
+
+	appendSloCache( shaderFile, entry );
+
+	return &entry;
+}
+
+// Finds the shader along the search paths. Sets shaderFile to the full file name.
+bool findSloShader( string& shaderFile ) {
 	Application app;
 
 	string shaderNameStr( shaderFile );
 
-	int found( !Slo_SetShader( shaderFile.c_str() ) );
+	string resolved;
+	bool found( sloShaderExists( shaderFile, resolved ) );
 
 	if( !found ) {
 		Property affogatoGlobals;
@@ -838,7 +1487,7 @@ bool findAndSetSloShader( string& shaderFile ) {
 
 				string shaderNameStr( path + shaderFile );
 
-				if( !Slo_SetShader( shaderNameStr.c_str() ) ) {
+				if( sloShaderExists( shaderNameStr, resolved ) ) {
 					found = true;
 					break;
 				}
@@ -866,7 +1515,7 @@ bool findAndSetSloShader( string& shaderFile ) {
 
 				string shaderNameStr( path + shaderFile );
 
-				if( !Slo_SetShader( shaderNameStr.c_str() ) ) {
+				if( sloShaderExists( shaderNameStr, resolved ) ) {
 					found = true;
 					break;
 				}
@@ -894,7 +1543,7 @@ bool findAndSetSloShader( string& shaderFile ) {
 
 				string shaderNameStr( path + shaderFile );
 
-				if( !Slo_SetShader( shaderNameStr.c_str() ) ) {
+				if( sloShaderExists( shaderNameStr, resolved ) ) {
 					found = true;
 					break;
 				}
@@ -902,9 +1551,10 @@ bool findAndSetSloShader( string& shaderFile ) {
 		}
 	}
 
-	shaderFile = shaderNameStr;
+	if( found )
+		shaderFile = resolved;
 
-	return found != 0;
+	return found;
 }
 
 XSIPLUGINCALLBACK CStatus AffogatoCreateShader_Init( const XSI::CRef &in_context ) {
@@ -951,7 +1601,9 @@ XSIPLUGINCALLBACK CStatus AffogatoCreateShader_Execute( const CRef &inContext )
 		return CStatus::Fail;
 	}
 
-	if( findAndSetSloShader( shaderFile ) ) {
+	string sloFile( shaderFile );
+	const sloShader *slo( findSloShader( sloFile ) ? getSloShader( sloFile ) : NULL );
+	if( slo ) {
 
 		SceneItem object;
 		object = SceneItem( CRef( args[ 1 ] ) );
@@ -988,7 +1640,7 @@ XSIPLUGINCALLBACK CStatus AffogatoCreateShader_Execute( const CRef &inContext )
 		}
 
 		// Find the shader type
-		SLO_TYPE shaderType = Slo_GetType();
+		int shaderType = slo->type;
 		CString shaderTypeName;
 		shader::shaderType numShaderType;
 		switch( shaderType ) {
@@ -1080,81 +1732,63 @@ XSIPLUGINCALLBACK CStatus AffogatoCreateShader_Execute( const CRef &inContext )
 		oLayout.AddGroup( L"RenderMan " + shaderTypeName + L" Shader", true );
 
 		CString paramString;
-		for( int j = 1; j < Slo_GetNArgs() + 1; j++ ) {
-			SLO_VISSYMDEF *parameter = Slo_GetArgById( j );
-			if( !parameter || !parameter->svd_valisvalid )
+		for( vector< sloArgument >::const_iterator parameter = slo->arguments.begin(); parameter < slo->arguments.end(); parameter++ ) {
+			// We don't handle arrays yet
+			if( parameter->arrayLength || ( parameter->defaults.empty() && parameter->defaultStrings.empty() ) )
 				continue;
 
-			CString paramName = charToCString( parameter->svd_name );
-			//CString const char *detail = Slo_DetailtoStr( parameter->svd_detail );
-
-			//const char *type = Slo_TypetoStr( parameter->svd_type );
-			unsigned arraylen = parameter->svd_arraylen;
+			CString paramName = stringToCString( parameter->name );
 
-			Parameter subParam;
-			if( SLO_STOR_OUTPUTPARAMETER != parameter->svd_storage ) {
-
-				int caps = siAnimatable | siPersistable;
-
-				int num_elements = arraylen == 0 ? 1 : arraylen;
-				for( int k = 0; k < num_elements; k++ ) {
-					SLO_VISSYMDEF *elem = Slo_GetArrayArgElement( parameter, k );
-					unsigned arraylen = parameter->svd_arraylen;
-
-					if( !elem || arraylen ) // we don't handle arrays yet
-						continue;
+			int caps = siAnimatable | siPersistable;
 
-					switch( parameter->svd_type ) {
-						case SLO_TYPE_SCALAR:
-							if( ( CString( L"__nonspecular" ) == paramName ) || ( CString( L"__nondiffuse" ) == paramName ) ) {
-								prop.AddParameter(	paramName, CValue::siFloat, caps,
-													L"", L"", *elem->svd_default.scalarval, 0.0f, 1.0f, 0.0f, 1.0f, param );
-							} else {
-								prop.AddParameter(	paramName, CValue::siFloat, caps,
-													L"", L"", *elem->svd_default.scalarval, param );
-								item = oLayout.AddItem( paramName, paramName );
-								item.PutLabelMinPixels( LABEL_WIDTH_WIDE );
-							}
-
-							paramString += L"1;" + paramName + L";";
+			switch( parameter->type ) {
+				case SLO_TYPE_SCALAR:
+					if( ( CString( L"__nonspecular" ) == paramName ) || ( CString( L"__nondiffuse" ) == paramName ) ) {
+						prop.AddParameter(	paramName, CValue::siFloat, caps,
+											L"", L"", parameter->defaults[ 0 ], 0.0f, 1.0f, 0.0f, 1.0f, param );
+					} else {
+						prop.AddParameter(	paramName, CValue::siFloat, caps,
+											L"", L"", parameter->defaults[ 0 ], param );
+						item = oLayout.AddItem( paramName, paramName );
+						item.PutLabelMinPixels( LABEL_WIDTH_WIDE );
+					}
 
-							break;
-						case SLO_TYPE_COLOR: {
+					paramString += L"1;" + paramName + L";";
 
-							prop.AddParameter( paramName + L"R", CValue::siDouble, caps,
-												L"", L"", elem->svd_default.pointval->xval, param );
-							prop.AddParameter( paramName + L"G", CValue::siDouble, caps,
-												L"", L"", elem->svd_default.pointval->yval, param );
-							prop.AddParameter( paramName + L"B", CValue::siDouble, caps,
-												L"", L"", elem->svd_default.pointval->zval, param );
+					break;
+				case SLO_TYPE_COLOR: {
 
-							item = oLayout.AddColor( paramName + L"R", paramName );
+					prop.AddParameter( paramName + L"R", CValue::siDouble, caps,
+										L"", L"", ( double )parameter->defaults[ 0 ], param );
+					prop.AddParameter( paramName + L"G", CValue::siDouble, caps,
+										L"", L"", ( double )parameter->defaults[ 1 ], param );
+					prop.AddParameter( paramName + L"B", CValue::siDouble, caps,
+										L"", L"", ( double )parameter->defaults[ 2 ], param );
 
-							paramString += L"5;" + paramName + L";";
+					item = oLayout.AddColor( paramName + L"R", paramName );
 
+					paramString += L"5;" + paramName + L";";
 
-							break;
-						}
-						case SLO_TYPE_STRING:
-							prop.AddParameter(	paramName, CValue::siString, siPersistable,
-												L"", L"", charToCString( elem->svd_default.stringval ), param );
-							if( CString( L"__category" ) != paramName ) {
-								item = oLayout.AddItem( paramName, paramName, siControlFilePath );
-								item.PutAttribute( siUIOpenFile, true );
-								item.PutAttribute( siUIFileFilter, L"Mip-Mapped TIFF Textures (*.tdl)|*.tdl|TIFF Textures (*.tif)|*.tif|All Files (*.*)|*.*||" );
-								item.PutLabelMinPixels( LABEL_WIDTH_WIDE );
-								//item = oLayout.AddItem( paramName, paramName );
-							}
 
-							paramString += L"7;" + paramName + L";";
-							break;
-						default:
-							break;
-					}
+					break;
 				}
+				case SLO_TYPE_STRING:
+					prop.AddParameter(	paramName, CValue::siString, siPersistable,
+										L"", L"", stringToCString( parameter->defaultStrings[ 0 ] ), param );
+					if( CString( L"__category" ) != paramName ) {
+						item = oLayout.AddItem( paramName, paramName, siControlFilePath );
+						item.PutAttribute( siUIOpenFile, true );
+						item.PutAttribute( siUIFileFilter, L"Mip-Mapped TIFF Textures (*.tdl)|*.tdl|TIFF Textures (*.tif)|*.tif|All Files (*.*)|*.*||" );
+						item.PutLabelMinPixels( LABEL_WIDTH_WIDE );
+						//item = oLayout.AddItem( paramName, paramName );
+					}
+
+					paramString += L"7;" + paramName + L";";
+					break;
+				default:
+					break;
 			}
 		}
-		Slo_EndShader();
 
 		prop.AddParameter(	__AFFOGATO_SHADER_PARAMS, CValue::siString, siReadOnly | siPersistable | siNotInspectable,
 							L"", L"", paramString, param );
@@ -1226,7 +1860,7 @@ XSIPLUGINCALLBACK CStatus AffogatoReloadShader_Execute( const CRef &inContext )
 		if( shaderFile.empty() )
 			shaderFile = object.GetParameterValue( "" )
 
-		if( !findAndSetSloShader( shaderFile ) ) {
+		if( !findSloShader( shaderFile ) ) {
 			app.LogMessage( L"AffogatoCreateShader: Unable to open shader '" + CString( args[ 0 ] ) + L"'. Exiting.", siErrorMsg );
 			return CStatus::MemberNotFound;
 		}
@@ -44,16 +44,15 @@
 #include <boost/algorithm/string/case_conv.hpp>
 
 // XSI headers
-#include <xsi_application.h>
 #include <xsi_group.h>
 #include <xsi_kinematics.h>
 #include <xsi_kinematicstate.h>
-#include <xsi_model.h>
 #include <xsi_sceneitem.h>
 
 // Affogato headers
 #include "affogatoGlobals.hpp"
 #include "affogatoHelpers.hpp"
+#include "affogatoPropertyIndex.hpp"
 #include "affogatoSphereData.hpp"
 #include "affogatoRenderer.hpp"
 
@@ -65,55 +64,23 @@ namespace affogato {
 	using namespace std;
 
 	CRefArray getGroupMembers( CString groupName ) {
-		Application app;
-		Model sceneRoot( app.GetActiveSceneRoot() );
-		CRefArray objects( sceneRoot.FindChildren( CString(), siSpherePrimType, CStringArray() ) );
+		const CRefArray& objects( propertyIndex::spheres() );
 		CRefArray members;
 
 		for( unsigned i = 0; i < ( unsigned )objects.GetCount(); i++ ) {
 			X3DObject x( objects[ i ] );
-			if( isVisible( x ) ) {
-				CRefArray owners( x.GetOwners() );
-				CRefArray groups;
-				owners.Filter( siGroup, CStringArray(), CString(), groups );
-				for( unsigned j = 0; j < ( unsigned )groups.GetCount(); j++ ) {
-					if( groupName == Group( groups[ j ] ).GetFullName() ) {
-						members.Add( objects[ i ] );
-					}
+			CRefArray owners( x.GetOwners() );
+			CRefArray groups;
+			owners.Filter( siGroup, CStringArray(), CString(), groups );
+			for( unsigned j = 0; j < ( unsigned )groups.GetCount(); j++ ) {
+				if( groupName == Group( groups[ j ] ).GetFullName() ) {
+					members.Add( objects[ i ] );
 				}
 			}
 		}
 		return members;
 	}
 
-	CRefArray filterForBlobbies( const long id ) {
-		CRefArray blobs;
-
-		Application app;
-
-		Model sceneRoot = app.GetActiveSceneRoot();
-		CRefArray spheres( sceneRoot.FindChildren( CString(), siSpherePrimType, CStringArray() ) );
-
-		for( unsigned i = 0; i < ( unsigned )spheres.GetCount(); i++ ) {
-			X3DObject x( spheres[ i ] );
-			if( isVisible( x ) ) {
-				CRefArray props( x.GetProperties() );
-				for( unsigned property = 0; property < ( unsigned )props.GetCount(); property++ ) {
-					Property prop( props[ property ] );
-					if( isAffogatoProperty( prop ) ) {
-						CValue blobbyId( prop.GetParameterValue( L"blobbyid" ) );
-						long sphereId( blobbyId );
-						if( !blobbyId.IsEmpty() && ( sphereId == id ) ) {
-							blobs.Add( spheres[ i ] );
-						}
-					}
-				}
-			}
-		}
-
-		return blobs;
-	}
-
 
 	sphereData::sphereData( const X3DObject &sphere, double atTime ) {
 		globals& g = const_cast< globals& >( globals::access() );
@@ -129,11 +96,12 @@ namespace affogato {
 		CRefArray newMembers;
 
 		// We find all properties
-		CRefArray props( sphere.GetProperties() );
+		const propertyIndex& index( propertyIndex::access( sphere ) );
+		const CRefArray& props( index.properties() );
 		for( unsigned property = 0; property < ( unsigned )props.GetCount(); property++ ) {
 
 			Property prop( props[ property ] );
-			if( isAffogatoProperty( prop ) ) {
+			if( index.isAffogato( property ) ) {
 				CValue blobbyId( prop.GetParameterValue( L"blobbyid" ) );
 				long id( blobbyId );
 
@@ -143,9 +111,7 @@ namespace affogato {
 
 						rType = renderTypeBlobby;
 
-						CRefArray members( filterForBlobbies( id ) );
-
-						newMembers += members;
+						newMembers += propertyIndex::blobbyMembers( id );
 					}
 				}
 			}
@@ -221,11 +187,12 @@ namespace affogato {
 		map< string, int > blobSet;
 
 		// We find all properties
-		CRefArray props( sphere.GetProperties() );
-		for( unsigned property = 0; property < props.GetCount(); property++ ) {
+		const propertyIndex& index( propertyIndex::access( sphere ) );
+		const CRefArray& props( index.properties() );
+		for( unsigned property = 0; property < ( unsigned )props.GetCount(); property++ ) {
 			Property prop( props[ property ] );
 			// Is this a blobby sphere?
-			if( isAffogatoProperty( prop ) && ( bool )prop.GetParameterValue( L"blobby" ) ) {
+			if( index.isAffogato( property ) && ( bool )prop.GetParameterValue( L"blobby" ) ) {
 				CRefArray owners( prop.GetOwners() );
 				CRefArray groups;
 				owners.Filter( siGroup, CStringArray(), CString(), groups );
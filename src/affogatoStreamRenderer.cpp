@@ -0,0 +1,1344 @@
+/** Binary command stream renderer.
+ *
+ *  Calls are encoded into an in-memory buffer per scene that gets
+ *  appended to that scene's file before any write would grow it
+ *  beyond flushSize and when the scene ends. Switching scenes just
+ *  switches buffers, so every file replays on its own.
+ *
+ *  Lossy encodings are only used if decoding the values again, the
+ *  same way replay() does, lands within the tolerance.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ *
+ *  @par Disclaimer:
+ *  Rising Sun Pictures Pty. Ltd., hereby disclaims all copyright
+ *  interest in the plugin 'Affogato' (a plugin to translate 3D
+ *  scenes to a 3D renderer) written by Moritz Moeller.
+ *  @par
+ *  Any one who uses this code does so completely at their own risk.
+ *  Rising Sun Pictures doesn't warrant that this code does anything
+ *  at all but if it does something and you don't like it, then we
+ *  are not responsible.
+ *  @par
+ *  Have a nice day!
+ */
+
+// Standard headers
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// XSI headers
+#ifdef __XSI_PLUGIN
+	#include <xsi_application.h>
+#endif
+
+// Affogato headers
+#include "affogatoStreamRenderer.hpp"
+#ifdef __XSI_PLUGIN
+#include "affogatoHelpers.hpp"
+#endif
+
+#ifndef __XSI_PLUGIN
+#define debugMessage(a)
+#endif
+
+#define STREAMMAGIC "UMCS"
+#define STREAMVERSION 3
+
+
+namespace ueberMan {
+
+	using namespace std;
+	using namespace affogato;
+
+
+	// Float encodings --------------------------------------------------------
+
+
+	namespace {
+
+		// Used for both encoding & decoding so the two always agree
+		inline float fixedToFloat( const float offset, const float scale, const unsigned code, const float reference ) {
+			return reference + ( offset + ( float )code * scale );
+		}
+
+		inline bool isFloatType( const tokenValue::parameterType type ) {
+			switch( type ) {
+				case tokenValue::typeFloat:
+				case tokenValue::typeColor:
+				case tokenValue::typePoint:
+				case tokenValue::typeHomogenousPoint:
+				case tokenValue::typeVector:
+				case tokenValue::typeNormal:
+				case tokenValue::typeMatrix:
+					return true;
+				default:
+					return false;
+			}
+		}
+	}
+
+
+	// Stream decoding --------------------------------------------------------
+
+
+	class ueberManStreamRenderer::reader {
+		public:
+			reader( const vector< char >& theBuffer ) : buffer( theBuffer ), pos( 0 ) {}
+
+			bool atEnd() const {
+				return pos >= buffer.size();
+			}
+
+			const char* raw( size_t numBytes ) {
+				if( buffer.size() < pos + numBytes )
+					throw( runtime_error( "UeberManStream: Unexpected end of command stream" ) );
+				const char* ptr = &buffer[ pos ];
+				pos += numBytes;
+				return ptr;
+			}
+
+			template< typename T > T get() {
+				T value;
+				memcpy( &value, raw( sizeof( T ) ), sizeof( T ) );
+				return value;
+			}
+
+			// Written with a fixed width, see put()
+			bool getBool() {
+				return 0 != get< unsigned char >();
+			}
+
+			context getContext() {
+				return ( context )get< int >();
+			}
+
+			string getString() {
+				unsigned size = get< unsigned >();
+				return size ? string( raw( size ), size ) : string();
+			}
+
+			template< typename T > vector< T > getArray() {
+				unsigned size = get< unsigned >();
+				vector< T > values( size );
+				if( size )
+					memcpy( &values[ 0 ], raw( size * sizeof( T ) ), size * sizeof( T ) );
+				return values;
+			}
+
+			vector< string > getStringArray() {
+				unsigned size = get< unsigned >();
+				vector< string > values( size );
+				for( unsigned i = 0; i < size; i++ )
+					values[ i ] = getString();
+				return values;
+			}
+
+			vector< float > getEncodedFloats( encodingType encoding ) {
+				unsigned size = get< unsigned >();
+				vector< float > values( size );
+
+				switch( encoding ) {
+					case encodingFixed:
+					case encodingDelta: {
+						float offset = get< float >();
+						float scale = get< float >();
+						unsigned char bytes = get< unsigned char >();
+						if( ( encodingDelta == encoding ) && ( lastPoints.size() != size ) )
+							throw( runtime_error( "UeberManStream: Point deltas without matching points" ) );
+						for( unsigned i = 0; i < size; i++ ) {
+							unsigned code = ( 1 == bytes ) ? get< unsigned char >() : get< unsigned short >();
+							values[ i ] = fixedToFloat( offset, scale, code, ( encodingDelta == encoding ) ? lastPoints[ i ] : 0 );
+						}
+						break;
+					}
+					default:
+						throw( runtime_error( "UeberManStream: Unknown encoding" ) );
+				}
+				return values;
+			}
+
+			tokenValue getTokenValue() {
+				string name( getString() );
+				tokenValue::storageClass storage = ( tokenValue::storageClass )get< int >();
+				tokenValue::parameterType type = ( tokenValue::parameterType )get< int >();
+				encodingType encoding = ( encodingType )get< unsigned char >();
+
+				if( encodingRaw != encoding ) {
+					vector< float > values( getEncodedFloats( encoding ) );
+					if( "P" == name )
+						lastPoints = values;
+					return tokenValue( values.empty() ? NULL : &values[ 0 ], values.size(), name, storage, type );
+				}
+
+				unsigned numBytes = get< unsigned >();
+				const char *data = raw( numBytes );
+
+				switch( type ) {
+					case tokenValue::typeFloat:
+					case tokenValue::typeColor:
+					case tokenValue::typePoint:
+					case tokenValue::typeHomogenousPoint:
+					case tokenValue::typeVector:
+					case tokenValue::typeNormal:
+					case tokenValue::typeMatrix: {
+						vector< float > values( numBytes / sizeof( float ) );
+						if( !values.empty() )
+							memcpy( &values[ 0 ], data, values.size() * sizeof( float ) );
+						if( "P" == name )
+							lastPoints = values;
+						return tokenValue( values.empty() ? NULL : &values[ 0 ], values.size(), name, storage, type );
+					}
+					case tokenValue::typeBoolean:
+					case tokenValue::typeInteger: {
+						// Booleans are stored as ints too
+						vector< int > values( numBytes / sizeof( int ) );
+						if( !values.empty() )
+							memcpy( &values[ 0 ], data, values.size() * sizeof( int ) );
+						tokenValue result( values.empty() ? NULL : &values[ 0 ], values.size(), name, storage );
+						result.setType( type );
+						return result;
+					}
+					case tokenValue::typeString: {
+						// The terminating zero was recorded too
+						tokenValue result( string( data, numBytes ? numBytes - 1 : 0 ), name );
+						result.setClass( storage );
+						return result;
+					}
+					default:
+						return tokenValue( name, storage, type );
+				}
+			}
+
+			vector< tokenValue > getTokenValueArray() {
+				unsigned size = get< unsigned >();
+				vector< tokenValue > values;
+				values.reserve( size );
+				for( unsigned i = 0; i < size; i++ )
+					values.push_back( getTokenValue() );
+				return values;
+			}
+
+		private:
+			const vector< char >& buffer;
+			size_t pos;
+			vector< float > lastPoints; // Reference for encodingDelta
+	};
+
+
+	// Public methods ---------------------------------------------------------
+
+
+	ueberManStreamRenderer::ueberManStreamRenderer()
+	:	contextCounter( 0 ),
+		currentContext( contextUndefined ),
+		motionSamples( 0 )
+	{
+		debugMessage( L"UeberManStream: Creating instance" );
+	}
+
+	ueberManStreamRenderer::~ueberManStreamRenderer() {
+		for( map< context, shared_ptr< sceneStream > >::iterator it( scenes.begin() ); it != scenes.end(); it++ ) {
+			current = it->second;
+			flush();
+			current->outStream.close();
+		}
+	}
+
+	const ueberManStreamRenderer& ueberManStreamRenderer::accessRenderer() {
+		// Singleton instance of the renderer
+		static ueberManStreamRenderer theRenderer;
+		return theRenderer;
+	}
+
+	void ueberManStreamRenderer::replay( const string& filename, ueberMan& target ) {
+		ifstream inStream( filename.c_str(), ios::in | ios::binary );
+		if( !inStream.is_open() )
+			throw( runtime_error( "UeberManStream: Could not open '" + filename + "'" ) );
+
+		inStream.seekg( 0, ios::end );
+		vector< char > stream( ( size_t )inStream.tellg() );
+		inStream.seekg( 0, ios::beg );
+		if( !stream.empty() )
+			inStream.read( &stream[ 0 ], stream.size() );
+		inStream.close();
+
+		reader r( stream );
+
+		if( string( r.raw( 4 ), 4 ) != STREAMMAGIC )
+			throw( runtime_error( "UeberManStream: '" + filename + "' is not a command stream" ) );
+		if( STREAMVERSION != r.get< int >() )
+			throw( runtime_error( "UeberManStream: '" + filename + "' was written by an incompatible version" ) );
+
+		// Maps the recorded contexts to the ones the target gives us
+		map< context, context > contextMap;
+
+		while( !r.atEnd() ) {
+			opCode op = ( opCode )r.get< unsigned char >();
+			switch( op ) {
+				case opBeginScene: {
+					context ctx = r.getContext();
+					string destination( r.getString() );
+					bool useBinary = r.getBool();
+					bool useCompression = r.getBool();
+					contextMap[ ctx ] = target.beginScene( destination, useBinary, useCompression );
+					break;
+				}
+				case opSwitchScene:
+					target.switchScene( contextMap[ r.getContext() ] );
+					break;
+				case opEndScene: {
+					context ctx = r.getContext();
+					target.endScene( contextMap[ ctx ] );
+					contextMap.erase( ctx );
+					break;
+				}
+				case opInput:
+					target.input( r.getString() );
+					break;
+				case opInputBound: {
+					string filename( r.getString() );
+					vector< float > bound( r.getArray< float >() );
+					target.input( filename, &bound[ 0 ] );
+					break;
+				}
+				case opCamera: {
+					cameraHandle cameraid( r.getString() );
+					target.camera( cameraid );
+					break;
+				}
+				case opOutput: {
+					string name( r.getString() );
+					string format( r.getString() );
+					string dataname( r.getString() );
+					target.output( name, format, dataname, r.getString() );
+					break;
+				}
+				case opWorld:
+					target.world();
+					break;
+				case opRender:
+					target.render( r.getString() );
+					break;
+				case opMotion:
+					target.motion( r.getArray< float >() );
+					break;
+				case opParameterArray:
+					target.parameter( r.getTokenValueArray() );
+					break;
+				case opParameter:
+					target.parameter( r.getTokenValue() );
+					break;
+				case opParameterString: {
+					string typedname( r.getString() );
+					target.parameter( typedname, r.getString() );
+					break;
+				}
+				case opParameterFloat: {
+					string typedname( r.getString() );
+					target.parameter( typedname, r.get< float >() );
+					break;
+				}
+				case opParameterInt: {
+					string typedname( r.getString() );
+					target.parameter( typedname, r.get< int >() );
+					break;
+				}
+				case opParameterBool: {
+					string typedname( r.getString() );
+					target.parameter( typedname, r.getBool() );
+					break;
+				}
+				case opVariableArray:
+					target.variable( r.getTokenValueArray() );
+					break;
+				case opVariable:
+					target.variable( r.getTokenValue() );
+					break;
+				case opVariableString: {
+					string typedname( r.getString() );
+					target.variable( typedname, r.getString() );
+					break;
+				}
+				case opVariableFloat: {
+					string typedname( r.getString() );
+					target.variable( typedname, r.get< float >() );
+					break;
+				}
+				case opVariableInt: {
+					string typedname( r.getString() );
+					target.variable( typedname, r.get< int >() );
+					break;
+				}
+				case opVariableBool: {
+					string typedname( r.getString() );
+					target.variable( typedname, r.getBool() );
+					break;
+				}
+				case opAttribute:
+					target.attribute( r.getTokenValue() );
+					break;
+				case opAttributeString: {
+					string typedname( r.getString() );
+					target.attribute( typedname, r.getString() );
+					break;
+				}
+				case opAttributeFloat: {
+					string typedname( r.getString() );
+					target.attribute( typedname, r.get< float >() );
+					break;
+				}
+				case opAttributeInt: {
+					string typedname( r.getString() );
+					target.attribute( typedname, r.get< int >() );
+					break;
+				}
+				case opAttributeBool: {
+					string typedname( r.getString() );
+					target.attribute( typedname, r.getBool() );
+					break;
+				}
+				case opPushAttributes:
+					target.pushAttributes();
+					break;
+				case opPopAttributes:
+					target.popAttributes();
+					break;
+				case opOption:
+					target.option( r.getTokenValue() );
+					break;
+				case opOptionString: {
+					string typedname( r.getString() );
+					target.option( typedname, r.getString() );
+					break;
+				}
+				case opOptionFloat: {
+					string typedname( r.getString() );
+					target.option( typedname, r.get< float >() );
+					break;
+				}
+				case opOptionInt: {
+					string typedname( r.getString() );
+					target.option( typedname, r.get< int >() );
+					break;
+				}
+				case opOptionBool: {
+					string typedname( r.getString() );
+					target.option( typedname, r.getBool() );
+					break;
+				}
+				case opPushSpace:
+					target.pushSpace();
+					break;
+				case opPopSpace:
+					target.popSpace();
+					break;
+				case opSpace:
+					target.space( r.getArray< float >() );
+					break;
+				case opSpaceNamed:
+					target.space( spaceHandle( r.getString() ) );
+					break;
+				case opNameSpace: {
+					spaceHandle spacename( r.getString() );
+					target.nameSpace( spacename );
+					break;
+				}
+				case opAppendSpace:
+					target.appendSpace( r.getArray< float >() );
+					break;
+				case opTranslate: {
+					float x = r.get< float >();
+					float y = r.get< float >();
+					float z = r.get< float >();
+					target.translate( x, y, z );
+					break;
+				}
+				case opRotate: {
+					float angle = r.get< float >();
+					float x = r.get< float >();
+					float y = r.get< float >();
+					float z = r.get< float >();
+					target.rotate( angle, x, y, z );
+					break;
+				}
+				case opScale: {
+					float x = r.get< float >();
+					float y = r.get< float >();
+					float z = r.get< float >();
+					target.scale( x, y, z );
+					break;
+				}
+				case opShaderTreeBegin: {
+					shaderHandle treeid( r.getString() );
+					target.shaderTreeBegin( treeid );
+					break;
+				}
+				case opShaderTreeEnd:
+					target.shaderTreeEnd();
+					break;
+				case opShaderTree:
+					target.shaderTree( r.getString() );
+					break;
+				case opConnectShaders: {
+					shaderHandle srcId( r.getString() );
+					string srcName( r.getString() );
+					shaderHandle destId( r.getString() );
+					string destName( r.getString() );
+					shaderHandle nodeid( r.getString() );
+					target.connectShaders( srcId, srcName, destId, destName, nodeid );
+					break;
+				}
+				case opShader: {
+					string shadertype( r.getString() );
+					string shadername( r.getString() );
+					shaderHandle shaderid( r.getString() );
+					target.shader( shadertype, shadername, shaderid );
+					break;
+				}
+				case opLight: {
+					string shadername( r.getString() );
+					lightHandle lightid( r.getString() );
+					target.light( shadername, lightid );
+					break;
+				}
+				case opSwitchLight: {
+					lightHandle lightid( r.getString() );
+					target.switchLight( lightid, r.getBool() );
+					break;
+				}
+				case opBeginLook: {
+					lookHandle lookid( r.getString() );
+					target.beginLook( lookid );
+					break;
+				}
+				case opEndLook:
+					target.endLook();
+					break;
+				case opNameLook: {
+					lookHandle lookid( r.getString() );
+					target.nameLook( lookid );
+					break;
+				}
+				case opLook:
+					target.look( r.getString() );
+					break;
+				case opAppendLook:
+					target.appendLook( r.getString() );
+					break;
+				case opBeginObject: {
+					objectHandle instanceid( r.getString() );
+					target.beginObject( instanceid );
+					break;
+				}
+				case opEndObject:
+					target.endObject();
+					break;
+				case opLoadObject:
+					target.loadObject( r.getString() );
+					break;
+				case opPoints: {
+					string type( r.getString() );
+					int numPoints = r.get< int >();
+					primitiveHandle identifier( r.getString() );
+					target.points( type, numPoints, identifier );
+					break;
+				}
+				case opCurves: {
+					string interp( r.getString() );
+					int numCurves = r.get< int >();
+					int numVertsPerCurve = r.get< int >();
+					bool closed = r.getBool();
+					primitiveHandle identifier( r.getString() );
+					target.curves( interp, numCurves, numVertsPerCurve, closed, identifier );
+					break;
+				}
+				case opCurvesArray: {
+					string interp( r.getString() );
+					int numCurves = r.get< int >();
+					vector< int > numVertsPerCurve( r.getArray< int >() );
+					bool closed = r.getBool();
+					primitiveHandle identifier( r.getString() );
+					target.curves( interp, numCurves, numVertsPerCurve, closed, identifier );
+					break;
+				}
+				case opNuCurves: {
+					int numCurves = r.get< int >();
+					vector< int > numVertsPerCurve( r.getArray< int >() );
+					vector< int > order( r.getArray< int >() );
+					vector< float > knot( r.getArray< float >() );
+					vector< float > min( r.getArray< float >() );
+					vector< float > max( r.getArray< float >() );
+					primitiveHandle identifier( r.getString() );
+					target.curves( numCurves, numVertsPerCurve, order, knot, min, max, identifier );
+					break;
+				}
+				case opPatch: {
+					string interp( r.getString() );
+					int nu = r.get< int >();
+					int nv = r.get< int >();
+					primitiveHandle identifier( r.getString() );
+					target.patch( interp, nu, nv, identifier );
+					break;
+				}
+				case opNuPatch: {
+					int nu = r.get< int >();
+					int uorder = r.get< int >();
+					vector< float > uknot( r.getArray< float >() );
+					float umin = r.get< float >();
+					float umax = r.get< float >();
+					int nv = r.get< int >();
+					int vorder = r.get< int >();
+					vector< float > vknot( r.getArray< float >() );
+					float vmin = r.get< float >();
+					float vmax = r.get< float >();
+					primitiveHandle identifier( r.getString() );
+					target.patch( nu, uorder, &uknot[ 0 ], umin, umax, nv, vorder, &vknot[ 0 ], vmin, vmax, identifier );
+					break;
+				}
+				case opMesh: {
+					string interp( r.getString() );
+					vector< int > nverts( r.getArray< int >() );
+					vector< int > verts( r.getArray< int >() );
+					bool interpolateBoundary = r.getBool();
+					primitiveHandle identifier( r.getString() );
+					if( !nverts.empty() && !verts.empty() )
+						target.mesh( interp, nverts.size(), &nverts[ 0 ], &verts[ 0 ], interpolateBoundary, identifier );
+					break;
+				}
+				case opSphere: {
+					float radius = r.get< float >();
+					float zmin = r.get< float >();
+					float zmax = r.get< float >();
+					float thetamax = r.get< float >();
+					primitiveHandle identifier( r.getString() );
+					target.sphere( radius, zmin, zmax, thetamax, identifier );
+					break;
+				}
+				case opBlobby: {
+					int numLeafs = r.get< int >();
+					vector< int > code( r.getArray< int >() );
+					vector< float > floatData( r.getArray< float >() );
+					vector< string > stringData( r.getStringArray() );
+					primitiveHandle identifier( r.getString() );
+					target.blobby( numLeafs, code, floatData, stringData, identifier );
+					break;
+				}
+				case opMakeMap:
+					target.makeMap( r.getString() );
+					break;
+				case opArchiveRecord: {
+					string type( r.getString() );
+					target.archiveRecord( type, r.getString() );
+					break;
+				}
+				default:
+					throw( runtime_error( "UeberManStream: Unknown opcode in '" + filename + "'" ) );
+			}
+		}
+	}
+
+	context ueberManStreamRenderer::beginScene( const string& destination, bool useBinary, bool useCompression ) {
+		debugMessage( L"UeberManStream: BeginScene" );
+
+		// Every scene is a data file of its own and gets its own stream
+		string file = destination + ".ums";
+		shared_ptr< sceneStream > scene( new sceneStream );
+		scene->outStream.open( file.c_str(), ios::out | ios::binary | ios::trunc );
+		if( !scene->outStream.is_open() )
+			throw( runtime_error( "UeberManStream: Could not open '" + file + "' for writing" ) );
+		scene->outStream.write( STREAMMAGIC, 4 );
+
+		currentContext = ++contextCounter;
+		scenes[ currentContext ] = scene;
+		current = scene;
+
+		put( ( int )STREAMVERSION );
+		put( opBeginScene );
+		put( currentContext );
+		put( destination );
+		put( useBinary );
+		put( useCompression );
+		return currentContext;
+	}
+
+	void ueberManStreamRenderer::switchScene( context ctx ) {
+		// Nothing to record -- the calls go to the stream of that scene
+		currentContext = ctx;
+		map< context, shared_ptr< sceneStream > >::iterator it( scenes.find( ctx ) );
+		if( scenes.end() == it )
+			current.reset();
+		else
+			current = it->second;
+	}
+
+	context ueberManStreamRenderer::currentScene() {
+		return currentContext;
+	}
+
+	void ueberManStreamRenderer::endScene( context ctx ) {
+		debugMessage( L"UeberManStream: EndScene" );
+
+		if( contextUndefined == ctx )
+			ctx = currentContext;
+
+		map< context, shared_ptr< sceneStream > >::iterator it( scenes.find( ctx ) );
+		if( scenes.end() == it )
+			return;
+
+		current = it->second;
+		put( opEndScene );
+		put( ctx );
+		flush();
+		current->outStream.close();
+		scenes.erase( it );
+
+		// Calls after this go nowhere until the next switch or scene
+		current.reset();
+		currentContext = contextUndefined;
+	}
+
+	void ueberManStreamRenderer::input( const string& filename ) {
+		put( opInput );
+		put( filename );
+	}
+
+	void ueberManStreamRenderer::input( const string& filename, const float *bound ) {
+		put( opInputBound );
+		put( filename );
+		put( bound, 6 );
+	}
+
+	void ueberManStreamRenderer::camera( cameraHandle& cameraid ) {
+		put( opCamera );
+		put( cameraid );
+	}
+
+	void ueberManStreamRenderer::output( const string& name, const string& format, const string& dataname, const cameraHandle& cameraid ) {
+		put( opOutput );
+		put( name );
+		put( format );
+		put( dataname );
+		put( cameraid );
+	}
+
+	void ueberManStreamRenderer::world() {
+		put( opWorld );
+	}
+
+	void ueberManStreamRenderer::render( const cameraHandle& cameraid ) {
+		put( opRender );
+		put( cameraid );
+	}
+
+	void ueberManStreamRenderer::motion( const vector< float >& times ) {
+		put( opMotion );
+		put( times );
+		motionSamples = times.size();
+		motionPoints.clear();
+	}
+
+	void ueberManStreamRenderer::parameter( const vector< tokenValue > &tokenValueArray ) {
+		put( opParameterArray );
+		put( tokenValueArray );
+	}
+
+	void ueberManStreamRenderer::parameter( const tokenValue &aTokenValue ) {
+		put( opParameter );
+		put( aTokenValue );
+	}
+
+	void ueberManStreamRenderer::parameter( const string& typedname, const string& value ) {
+		put( opParameterString );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::parameter( const string& typedname, const float value ) {
+		put( opParameterFloat );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::parameter( const string& typedname, const int value ) {
+		put( opParameterInt );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::parameter( const string& typedname, const bool value ) {
+		put( opParameterBool );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::variable( const vector< tokenValue > &tokenValueArray ) {
+		put( opVariableArray );
+		put( tokenValueArray );
+	}
+
+	void ueberManStreamRenderer::variable( const tokenValue &aTokenValue ) {
+		put( opVariable );
+		put( aTokenValue );
+	}
+
+	void ueberManStreamRenderer::variable( const string& typedname, const string& value ) {
+		put( opVariableString );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::variable( const string& typedname, const float value ) {
+		put( opVariableFloat );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::variable( const string& typedname, const int value ) {
+		put( opVariableInt );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::variable( const string& typedname, const bool value ) {
+		put( opVariableBool );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::attribute( const tokenValue &aTokenValue ) {
+		put( opAttribute );
+		put( aTokenValue );
+	}
+
+	void ueberManStreamRenderer::attribute( const string& typedname, const string& value ) {
+		put( opAttributeString );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::attribute( const string& typedname, const float value ) {
+		put( opAttributeFloat );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::attribute( const string& typedname, const int value ) {
+		put( opAttributeInt );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::attribute( const string& typedname, const bool value ) {
+		put( opAttributeBool );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::pushAttributes() {
+		put( opPushAttributes );
+	}
+
+	void ueberManStreamRenderer::popAttributes() {
+		put( opPopAttributes );
+	}
+
+	void ueberManStreamRenderer::option( const tokenValue &aTokenValue ) {
+		put( opOption );
+		put( aTokenValue );
+	}
+
+	void ueberManStreamRenderer::option( const string& typedname, const string& value ) {
+		put( opOptionString );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::option( const string& typedname, const float value ) {
+		put( opOptionFloat );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::option( const string& typedname, const int value ) {
+		put( opOptionInt );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::option( const string& typedname, const bool value ) {
+		put( opOptionBool );
+		put( typedname );
+		put( value );
+	}
+
+	void ueberManStreamRenderer::pushSpace() {
+		put( opPushSpace );
+	}
+
+	void ueberManStreamRenderer::popSpace() {
+		put( opPopSpace );
+	}
+
+	void ueberManStreamRenderer::space( const vector< float >& matrix ) {
+		put( opSpace );
+		put( matrix );
+	}
+
+	void ueberManStreamRenderer::space( const spaceHandle &spacename ) {
+		put( opSpaceNamed );
+		put( spacename );
+	}
+
+	void ueberManStreamRenderer::nameSpace( spaceHandle& spacename ) {
+		put( opNameSpace );
+		put( spacename );
+	}
+
+	void ueberManStreamRenderer::appendSpace( const vector< float >& matrix ) {
+		put( opAppendSpace );
+		put( matrix );
+	}
+
+	void ueberManStreamRenderer::translate( const float x, const float y, const float z ) {
+		put( opTranslate );
+		put( x );
+		put( y );
+		put( z );
+	}
+
+	void ueberManStreamRenderer::rotate( const float angle, const float x, const float y, const float z ) {
+		put( opRotate );
+		put( angle );
+		put( x );
+		put( y );
+		put( z );
+	}
+
+	void ueberManStreamRenderer::scale( const float x, const float y, const float z ) {
+		put( opScale );
+		put( x );
+		put( y );
+		put( z );
+	}
+
+	void ueberManStreamRenderer::shaderTreeBegin( shaderHandle& treeid ) {
+		put( opShaderTreeBegin );
+		put( treeid );
+	}
+
+	void ueberManStreamRenderer::shaderTreeEnd() {
+		put( opShaderTreeEnd );
+	}
+
+	void ueberManStreamRenderer::shaderTree( const string& treeid ) {
+		put( opShaderTree );
+		put( treeid );
+	}
+
+	void ueberManStreamRenderer::connectShaders( const shaderHandle& srcId, const string& srcName, const shaderHandle& destId, const string& destName, shaderHandle& nodeid ) {
+		put( opConnectShaders );
+		put( srcId );
+		put( srcName );
+		put( destId );
+		put( destName );
+		put( nodeid );
+	}
+
+	void ueberManStreamRenderer::shader( const string& shadertype, const string& shadername, shaderHandle &shaderid ) {
+		put( opShader );
+		put( shadertype );
+		put( shadername );
+		put( shaderid );
+	}
+
+	void ueberManStreamRenderer::light( const string& shadername, lightHandle& lightid ) {
+		put( opLight );
+		put( shadername );
+		put( lightid );
+	}
+
+	void ueberManStreamRenderer::switchLight( const lightHandle& lightid, const bool on ) {
+		put( opSwitchLight );
+		put( lightid );
+		put( on );
+	}
+
+	void ueberManStreamRenderer::beginLook( lookHandle& lookid ) {
+		put( opBeginLook );
+		put( lookid );
+	}
+
+	void ueberManStreamRenderer::endLook() {
+		put( opEndLook );
+	}
+
+	void ueberManStreamRenderer::nameLook( lookHandle& lookid ) {
+		put( opNameLook );
+		put( lookid );
+	}
+
+	void ueberManStreamRenderer::look( const lookHandle& lookid ) {
+		put( opLook );
+		put( lookid );
+	}
+
+	void ueberManStreamRenderer::appendLook( const lookHandle& lookid ) {
+		put( opAppendLook );
+		put( lookid );
+	}
+
+	void ueberManStreamRenderer::beginObject( objectHandle& instanceid ) {
+		put( opBeginObject );
+		put( instanceid );
+	}
+
+	void ueberManStreamRenderer::endObject() {
+		put( opEndObject );
+	}
+
+	void ueberManStreamRenderer::loadObject( const objectHandle& instanceid ) {
+		put( opLoadObject );
+		put( instanceid );
+	}
+
+	void ueberManStreamRenderer::points( const string& type, const int numPoints, primitiveHandle& identifier ) {
+		put( opPoints );
+		put( type );
+		put( numPoints );
+		put( identifier );
+		endPrimitive();
+	}
+
+	void ueberManStreamRenderer::curves( const string& interp, const int numCurves, const int numVertsPerCurve, const bool closed, primitiveHandle& identifier ) {
+		put( opCurves );
+		put( interp );
+		put( numCurves );
+		put( numVertsPerCurve );
+		put( closed );
+		put( identifier );
+		endPrimitive();
+	}
+
+	void ueberManStreamRenderer::curves( const string& interp, const int numCurves, const vector< int >& numVertsPerCurve, const bool closed, primitiveHandle& identifier ) {
+		put( opCurvesArray );
+		put( interp );
+		put( numCurves );
+		put( numVertsPerCurve );
+		put( closed );
+		put( identifier );
+		endPrimitive();
+	}
+
+	void ueberManStreamRenderer::curves( const int numCurves, const vector< int >& numVertsPerCurve, const vector< int >& order, const vector< float >& knot, const vector< float >& min, const vector< float >& max, primitiveHandle& identifier ) {
+		put( opNuCurves );
+		put( numCurves );
+		put( numVertsPerCurve );
+		put( order );
+		put( knot );
+		put( min );
+		put( max );
+		put( identifier );
+		endPrimitive();
+	}
+
+	void ueberManStreamRenderer::patch( const string& interp, const int nu, const int nv, primitiveHandle& identifier ) {
+		put( opPatch );
+		put( interp );
+		put( nu );
+		put( nv );
+		put( identifier );
+		endPrimitive();
+	}
+
+	void ueberManStreamRenderer::patch(	const int nu, const int uorder, const float *uknot, const float umin, const float umax,
+										const int nv, const int vorder, const float *vknot, const float vmin, const float vmax, primitiveHandle& identifier ) {
+		put( opNuPatch );
+		put( nu );
+		put( uorder );
+		put( uknot, nu + uorder );
+		put( umin );
+		put( umax );
+		put( nv );
+		put( vorder );
+		put( vknot, nv + vorder );
+		put( vmin );
+		put( vmax );
+		put( identifier );
+		endPrimitive();
+	}
+
+	void ueberManStreamRenderer::mesh( const string& interp, const int nfaces, const int *nverts, const int *verts, const bool interpolateBoundary, primitiveHandle& identifier ) {
+		unsigned numVerts = 0;
+		for( int i = 0; i < nfaces; i++ )
+			numVerts += nverts[ i ];
+
+		put( opMesh );
+		put( interp );
+		put( nverts, nfaces );
+		put( verts, numVerts );
+		put( interpolateBoundary );
+		put( identifier );
+		endPrimitive();
+	}
+
+	void ueberManStreamRenderer::sphere( const float radius, const float zmin, const float zmax, const float thetamax, primitiveHandle& identifier ) {
+		put( opSphere );
+		put( radius );
+		put( zmin );
+		put( zmax );
+		put( thetamax );
+		put( identifier );
+		endPrimitive();
+	}
+
+	void ueberManStreamRenderer::sphere( const float radius, primitiveHandle& identifier ) {
+		sphere( radius, -radius, radius, 360, identifier );
+	}
+
+	void ueberManStreamRenderer::blobby( const int numLeafs, const vector< int >& code, const vector< float >& floatData, const vector< string >& stringData, primitiveHandle& identifier ) {
+		put( opBlobby );
+		put( numLeafs );
+		put( code );
+		put( floatData );
+		put( stringData );
+		put( identifier );
+		endPrimitive();
+	}
+
+	void ueberManStreamRenderer::makeMap( const string& type ) {
+		put( opMakeMap );
+		put( type );
+	}
+
+	void ueberManStreamRenderer::archiveRecord( const string& type, const string& record ) {
+		put( opArchiveRecord );
+		put( type );
+		put( record );
+	}
+
+
+	// Private methods --------------------------------------------------------
+
+
+	void ueberManStreamRenderer::put( opCode op ) {
+		char code = ( char )op;
+		append( &code, sizeof( char ) );
+	}
+
+	void ueberManStreamRenderer::put( encodingType encoding ) {
+		unsigned char code = ( unsigned char )encoding;
+		append( &code, sizeof( unsigned char ) );
+	}
+
+	void ueberManStreamRenderer::put( const int value ) {
+		append( &value, sizeof( int ) );
+	}
+
+	// The width of long & bool differs between compilers, so these get
+	// written with a fixed one. Streams from 32 and 64 bit hosts can be
+	// replayed on either.
+	void ueberManStreamRenderer::put( const context value ) {
+		int fixed = ( int )value;
+		append( &fixed, sizeof( int ) );
+	}
+
+	void ueberManStreamRenderer::put( const float value ) {
+		append( &value, sizeof( float ) );
+	}
+
+	void ueberManStreamRenderer::put( const bool value ) {
+		unsigned char fixed = value ? 1 : 0;
+		append( &fixed, sizeof( unsigned char ) );
+	}
+
+	void ueberManStreamRenderer::put( const string& value ) {
+		unsigned size = value.length();
+		append( &size, sizeof( unsigned ) );
+		if( size )
+			append( value.data(), size );
+	}
+
+	void ueberManStreamRenderer::put( const float *values, unsigned size ) {
+		append( &size, sizeof( unsigned ) );
+		if( size )
+			append( values, size * sizeof( *values ) );
+	}
+
+	void ueberManStreamRenderer::put( const int *values, unsigned size ) {
+		append( &size, sizeof( unsigned ) );
+		if( size )
+			append( values, size * sizeof( *values ) );
+	}
+
+	void ueberManStreamRenderer::put( const vector< float >& values ) {
+		put( values.empty() ? NULL : &values[ 0 ], values.size() );
+	}
+
+	void ueberManStreamRenderer::put( const vector< int >& values ) {
+		put( values.empty() ? NULL : &values[ 0 ], values.size() );
+	}
+
+	void ueberManStreamRenderer::put( const vector< string >& values ) {
+		unsigned size = values.size();
+		append( &size, sizeof( unsigned ) );
+		for( vector< string >::const_iterator it = values.begin(); it < values.end(); it++ )
+			put( *it );
+	}
+
+	void ueberManStreamRenderer::put( const tokenValue& aTokenValue ) {
+		put( aTokenValue.name() );
+		put( ( int )aTokenValue.storage() );
+		put( ( int )aTokenValue.type() );
+
+		unsigned numBytes = aTokenValue.valid() ? aTokenValue.byteSize() : 0;
+		// Deltas only pay off between the samples of a motion block
+		const bool points( "P" == aTokenValue.name() );
+		const bool keepPoints( points && motionSamples );
+
+		if( isFloatType( aTokenValue.type() ) && numBytes && ( 0 < aTokenValue.tolerance() ) ) {
+			const float *values = ( const float* )aTokenValue.data();
+			unsigned size = numBytes / sizeof( float );
+			const float *reference = ( keepPoints && ( motionPoints.size() == size ) ) ? &motionPoints[ 0 ] : NULL;
+			const float tolerance = aTokenValue.tolerance();
+
+			// Smallest encodings first
+			vector< float > decoded;
+			if( ( reference && (	putFixed( encodingDelta, values, size, reference, tolerance, 1, decoded ) ||
+									putFixed( encodingDelta, values, size, reference, tolerance, 2, decoded ) ) ) ||
+				putFixed( encodingFixed, values, size, NULL, tolerance, 1, decoded ) ||
+				putFixed( encodingFixed, values, size, NULL, tolerance, 2, decoded ) )
+			{
+				if( keepPoints )
+					motionPoints.swap( decoded );
+				else
+				if( points )
+					motionPoints.clear();
+				return;
+			}
+		}
+
+		put( encodingRaw );
+		append( &numBytes, sizeof( unsigned ) );
+		if( numBytes )
+			append( aTokenValue.data(), numBytes );
+
+		if( keepPoints && isFloatType( aTokenValue.type() ) )
+			motionPoints.assign( ( const float* )aTokenValue.data(), ( const float* )aTokenValue.data() + numBytes / sizeof( float ) );
+		else
+		if( points )
+			motionPoints.clear();
+	}
+
+	void ueberManStreamRenderer::put( const vector< tokenValue >& tokenValueArray ) {
+		unsigned size = tokenValueArray.size();
+		append( &size, sizeof( unsigned ) );
+		for( vector< tokenValue >::const_iterator it = tokenValueArray.begin(); it < tokenValueArray.end(); it++ )
+			put( *it );
+	}
+
+	/** Stores the values as fixed point numbers with 'bytes' bytes each,
+	 *  spread over the range of the values, or of their differences to
+	 *  reference.
+	 *  Doesn't write anything and returns false if that isn't precise
+	 *  enough.
+	 */
+	bool ueberManStreamRenderer::putFixed( encodingType encoding, const float *values, unsigned size, const float *reference,
+											float tolerance, unsigned char bytes, vector< float >& decoded ) {
+		const unsigned levels = ( 1 == bytes ) ? 0xff : 0xffff;
+
+		float minimum = values[ 0 ] - ( reference ? reference[ 0 ] : 0 );
+		float maximum = minimum;
+		for( unsigned i = 1; i < size; i++ ) {
+			float value = values[ i ] - ( reference ? reference[ i ] : 0 );
+			if( value < minimum )
+				minimum = value;
+			if( value > maximum )
+				maximum = value;
+		}
+
+		const float offset = minimum;
+		const float scale = ( maximum - minimum ) / levels;
+		if( !( 0 <= scale ) ) // NaNs
+			return false;
+
+		vector< unsigned short > codes( size );
+		decoded.resize( size );
+		for( unsigned i = 0; i < size; i++ ) {
+			const float base = reference ? reference[ i ] : 0;
+			double code = scale ? floor( ( values[ i ] - base - offset ) / scale + 0.5 ) : 0;
+			codes[ i ] = ( unsigned short )( ( code < 0 ) ? 0 : ( ( code > levels ) ? levels : code ) );
+			decoded[ i ] = fixedToFloat( offset, scale, codes[ i ], base );
+			if( !( fabs( decoded[ i ] - values[ i ] ) <= tolerance ) )
+				return false;
+		}
+
+		put( encoding );
+		append( &size, sizeof( unsigned ) );
+		put( offset );
+		put( scale );
+		append( &bytes, sizeof( unsigned char ) );
+		if( 1 == bytes ) {
+			vector< unsigned char > narrowCodes( codes.begin(), codes.end() );
+			append( &narrowCodes[ 0 ], size );
+		} else {
+			append( &codes[ 0 ], size * sizeof( unsigned short ) );
+		}
+		return true;
+	}
+
+	void ueberManStreamRenderer::endPrimitive() {
+		if( motionSamples && !--motionSamples )
+			motionPoints.clear();
+	}
+
+	void ueberManStreamRenderer::append( const void* data, size_t size ) {
+		if( !current )
+			return;
+
+		vector< char >& buffer( current->buffer );
+		if( flushSize < buffer.size() + size )
+			flush();
+
+		if( flushSize < size ) {
+			// Too big to be worth buffering -- goes straight to the file
+			current->outStream.write( ( const char* )data, size );
+		} else {
+			buffer.insert( buffer.end(), ( const char* )data, ( const char* )data + size );
+		}
+	}
+
+	void ueberManStreamRenderer::flush() {
+		if( current && !current->buffer.empty() ) {
+			current->outStream.write( &current->buffer[ 0 ], current->buffer.size() );
+			current->buffer.clear();
+		}
+	}
+}
@@ -70,6 +70,7 @@ namespace affogato {
 	tokenValue::tokenValue() {
 		ADEBUGPRINTF( L"Entering Default Constructor" );
 		_size		= 0;
+		_tolerance	= 0;
 		_type		= tokenValue::typeUndefined;
 		_storClass	= tokenValue::storageUndefined;
 		ADEBUGPRINTF( L"Leaving Default Constructor" );
@@ -78,21 +79,28 @@ namespace affogato {
 	tokenValue::tokenValue( const size_t theSize, const parameterType theType ) {
 		_type = theType;
 		_size = theSize;
+		_tolerance = 0;
 		size_t multiplier;
 		switch( _type ) {
 			case typeFloat:
 			case typeInteger:
 			case typeString:
 				multiplier = 1;
+				break;
 			case typePoint:
 			case typeColor:
 			case typeVector:
 			case typeNormal:
 				multiplier = 3;
+				break;
 			case typeHomogenousPoint:
-				multiplier = 14;
+				multiplier = 4;
+				break;
 			case typeMatrix:
 				multiplier = 16;
+				break;
+			default:
+				multiplier = 1;
 		}
 		_size *= multiplier;
 		switch( _type ) {
@@ -123,6 +131,7 @@ namespace affogato {
 		setClass( src._storClass );
 		setType( src._type );
 		_size = src._size;
+		_tolerance = src._tolerance;
 		/*if( size ) {
 			size_t multiplier;
 			switch( type ) {
@@ -162,6 +171,7 @@ namespace affogato {
 		_name = src._name;
 		setType( src._type );
 		_size = src._size;
+		_tolerance = src._tolerance;
 		/*if( size ) {
 			size_t multiplier;
 			switch( type ) {
@@ -201,6 +211,7 @@ namespace affogato {
 		const storageClass theClass,
 		const parameterType theType )
 	{
+		_tolerance = 0;
 		setClass( theClass );
 		setType ( theType );
 		setName( theName );
@@ -214,6 +225,7 @@ namespace affogato {
 		const parameterType theType )
 	{
 		ADEBUGPRINTF( L"Entering 4 Param Constructor" );
+		_tolerance = 0;
 		setClass( theClass );
 		setType ( theType );
 		setData( floats );
@@ -228,6 +240,7 @@ namespace affogato {
 		const parameterType theType )
 	{
 		ADEBUGPRINTF( L"Entering 4 Param Constructor" );
+		_tolerance = 0;
 		setClass( theClass );
 		setType ( theType );
 		setData( doubles );
@@ -242,6 +255,7 @@ namespace affogato {
 		const parameterType theType )
 	{
 		ADEBUGPRINTF( L"Entering 4 Param Constructor" );
+		_tolerance = 0;
 		setClass( theClass );
 		setType ( theType );
 		setData( longs );
@@ -256,6 +270,7 @@ namespace affogato {
 		const parameterType theType )
 	{
 		ADEBUGPRINTF( L"Entering 4 Param Constructor" );
+		_tolerance = 0;
 		setClass( theClass );
 		setType ( theType );
 		setData( vertices );
@@ -270,6 +285,7 @@ namespace affogato {
 		const parameterType theType )
 	{
 		ADEBUGPRINTF( L"Entering 4 Param Constructor" );
+		_tolerance = 0;
 		setClass( theClass );
 		setType ( theType );
 		setData( vertices );
@@ -284,6 +300,7 @@ namespace affogato {
 		const parameterType theType )
 	{
 		ADEBUGPRINTF( L"Entering 4 Param Constructor" );
+		_tolerance = 0;
 		setClass( theClass );
 		setType ( theType );
 		setData( vertices );
@@ -297,6 +314,7 @@ namespace affogato {
 		const string& theName )
 	{
 		ADEBUGPRINTF( L"Entering 2 Param String Constructor" );
+		_tolerance = 0;
 		setClass( storageConstant );
 		setType( typeString );
 		setData( value );
@@ -308,6 +326,7 @@ namespace affogato {
 		const float value,
 		const string& theName )
 	{
+		_tolerance = 0;
 		setClass( storageConstant );
 		setType( typeFloat );
 		setData( value );
@@ -318,6 +337,7 @@ namespace affogato {
 		const int value,
 		const string& theName )
 	{
+		_tolerance = 0;
 		setClass( storageConstant );
 		setType( typeInteger );
 		setData( value );
@@ -332,6 +352,7 @@ namespace affogato {
 		const parameterType theType )
 	{
 		ADEBUGPRINTF( L"Entering 3 Param Float Constructor" );
+		_tolerance = 0;
 		setClass( theClass );
 		setType( theType );
 		setData( values, theSize );
@@ -346,6 +367,7 @@ namespace affogato {
 		const storageClass theClass )
 	{
 		ADEBUGPRINTF( L"Entering 3 Param Int Constructor" );
+		_tolerance = 0;
 		setClass( theClass );
 		setType( typeInteger );
 		setData( values, theSize );
@@ -361,6 +383,7 @@ namespace affogato {
 		const parameterType theType )
 	{
 		ADEBUGPRINTF( L"Entering 3 Param shared_ptr Float Constructor for " + stringToCString( theName ) );
+		_tolerance = 0;
 		setClass( theClass );
 		setType( theType );
 		setData( values, theSize );
@@ -375,6 +398,7 @@ namespace affogato {
 		const storageClass theClass )
 	{
 		ADEBUGPRINTF( L"Entering 3 Param shared_ptr Int Constructor " + stringToCString( theName ) );
+		_tolerance = 0;
 		setClass( theClass );
 		setType( typeInteger );
 		setData( values, theSize );
@@ -453,6 +477,10 @@ namespace affogato {
 		memcpy( ( char* )_data.get(), value.c_str(), _size );
 	}
 
+	void tokenValue::setTolerance( const float theTolerance ) {
+		_tolerance = theTolerance;
+	}
+
 #ifdef __XSI_PLUGIN
 	void tokenValue::setData( const CFloatArray &floats ) {
 		ADEBUGPRINTF( L"Start Copying CFloatArray data" );
@@ -587,6 +615,10 @@ namespace affogato {
 		return _name;
 	}
 
+	float tokenValue::tolerance() const {
+		return _tolerance;
+	}
+
 	tokenValue::storageClass tokenValue::storage() const {
 		return _storClass;
 	}
@@ -672,6 +704,16 @@ namespace affogato {
 		return retStr.str();
 	}
 
+	string tokenValue::signature() const {
+		string sig( _name );
+		sig += '\0';
+		const int header[ 3 ] = { _type, _storClass, ( int )_size };
+		sig.append( ( const char* )header, sizeof( header ) );
+		if( _data )
+			sig.append( ( const char* )_data.get(), byteSize() );
+		return sig;
+	}
+
 	size_t tokenValue::size() const {
 		switch( _type ) {
 			case typeFloat:
@@ -739,12 +781,14 @@ namespace affogato {
 				multiplier = sizeof( float );
 				break;
 			case typeInteger:
+			case typeBoolean:
 				multiplier = sizeof( int );
 				break;
 			case typeString:
 				multiplier = sizeof( char );
 				break;
 			case typeUndefined:
+			default:
 				multiplier = 0;
 		}
 		return multiplier;
@@ -98,11 +98,14 @@
 #include "affogatoHelpers.hpp"
 #include "affogatoNode.hpp"
 #include "affogatoPolyMeshData.hpp"
+#include "affogatoPropertyIndex.hpp"
 #include "affogatoRenderer.hpp"
-//#include "affogatoDummyRenderer.hpp"
+#include "affogatoDummyRenderer.hpp"
+#include "affogatoRibRenderer.hpp"
 #include "affogatoRiRenderer.hpp"
 #include "affogatoXmlRenderer.hpp"
 #include "affogatoShader.hpp"
+#include "affogatoStreamRenderer.hpp"
 #include "affogatoWorker.hpp"
 
 
@@ -323,7 +326,7 @@ namespace affogato {
 							ctx = theRenderer.beginScene( getCacheFilePath( fileName, g.directories.caching.dataWrite ).native_file_string(), g.data.binary, g.data.compress );
 
 						string version( string( "Builder Affogato " ) + AFFOGATOVERSION );
-						RiArchiveRecord( RI_STRUCTURE, const_cast< RtString >( version.c_str() ) );
+						theRenderer.archiveRecord( "structure", version );
 
 						theRenderer.option( "searchpath:shader", g.searchPath.shader );
 						theRenderer.option( "searchpath:texture", g.searchPath.texture );
@@ -435,7 +438,7 @@ namespace affogato {
 	void blockManager::addMapRenderIoToCurrentBlock( const string& from, const string& to ) {
 		const globals& g( globals::access() );
 		//block& currentBlock( *blockPtrTracker[ internalContext ] );
-		if( blockPtrTracker.end() == blockPtrTracker.find( internalContext ) ) {
+		if( blockPtrTracker.end() == blockPtrTracker.find( activeContext ) ) {
 			debugMessage( L"No active block to add task to" );
 			throw( out_of_range( "Can't end unknown block" ) );
 		} else
@@ -457,7 +460,7 @@ namespace affogato {
 	void blockManager::addImageRenderIoToCurrentBlock( const string& from, const string& to ) {
 		const globals& g( globals::access() );
 		//block& currentBlock( *blockPtrTracker[ internalContext ] );
-		if( blockPtrTracker.end() == blockPtrTracker.find( internalContext ) ) {
+		if( blockPtrTracker.end() == blockPtrTracker.find( activeContext ) ) {
 			debugMessage( L"No active block to add task to" );
 			throw( out_of_range( "Can't end unknown block" ) );
 		} else
@@ -781,9 +784,7 @@ namespace affogato {
 				}
 			}
 
-			Application app;
-			Model sceneRoot = app.GetActiveSceneRoot();
-			CRefArray objects = sceneRoot.FindChildren( L"__options*", siNullPrimType, CStringArray() );
+			const CRefArray& objects( findChildren( L"__options*", siNullPrimType ) );
 			if( objects.GetCount() ) {
 				if( isVisible( objects[ 0 ] ) ) {
 					debugMessage( L"Found global option null." );
@@ -795,11 +796,11 @@ namespace affogato {
 					for( int i = 0; i < affogatoProps.GetCount(); i++ ) {
 						Property prop( affogatoProps[ i ] );
 
-						CParameterRefArray params( prop.GetParameters() );
+						const propertyIndex::parameterVector& params( propertyIndex::parameters( prop ) );
 
-						for( int p = 0; p < params.GetCount(); p++ ) {
-							Parameter param( params[ p ] );
-							string paramName = CStringToString( param.GetName() );
+						for( propertyIndex::parameterVector::const_iterator it( params.begin() ); it < params.end(); it++ ) {
+							Parameter param( it->parameter );
+							string paramName( it->originalName );
 
 							replace_first( paramName, string( "_" ), string( ":" ) );
 
@@ -823,7 +824,7 @@ namespace affogato {
 								case CValue::siString:
 								case CValue::siWStr:
 									debugMessage(L"Adding: int " + stringToCString( paramName ) );
-									theRenderer.option( paramName, parseString( CStringToString( value ) ) );
+									theRenderer.option( paramName, it->expand( CStringToString( value ) ) );
 									break;
 								// Todo: Array support!!!
 							}
@@ -868,8 +869,7 @@ namespace affogato {
 
 			X3DObject camera( sceneRoot.FindChild( stringToCString( g.camera.cameraName ), siCameraPrimType, CStringArray() ) );
 			if( !camera.IsValid() ) {
-				CRefArray cameras( sceneRoot.FindChildren( L"", siCameraPrimType, CStringArray() ) );
-				camera = cameras[ 0 ];
+				camera = findChildren( L"", siCameraPrimType )[ 0 ];
 			}
 
 			//for( long i = 0; i < cameras.GetCount(); i++ ) {
@@ -1074,9 +1074,7 @@ namespace affogato {
 		debugMessage( L"Global Attributes" );
 
 		if( g.data.sections.world ) {
-			Application app;
-			Model sceneRoot = app.GetActiveSceneRoot();
-			CRefArray objects = sceneRoot.FindChildren( L"__attributes*", siNullPrimType, CStringArray() );
+			const CRefArray& objects( findChildren( L"__attributes*", siNullPrimType ) );
 			if( objects.GetCount() ) {
 				debugMessage( L"Found global attribute null." );
 
@@ -1089,11 +1087,11 @@ namespace affogato {
 
 						Property prop( affogatoProps[ i ] );
 
-						CParameterRefArray params = prop.GetParameters();
+						const propertyIndex::parameterVector& params( propertyIndex::parameters( prop ) );
 
-						for( int p = 0; p < params.GetCount(); p++ ) {
-							Parameter param( params[ p ] );
-							string paramName = CStringToString( param.GetName() );
+						for( propertyIndex::parameterVector::const_iterator it( params.begin() ); it < params.end(); it++ ) {
+							Parameter param( it->parameter );
+							string paramName( it->originalName );
 
 							replace_first( paramName, string( "_" ), string( ":" ) );
 
@@ -1117,7 +1115,7 @@ namespace affogato {
 								case CValue::siString:
 								case CValue::siWStr:
 									debugMessage(L"Adding: int " + stringToCString( paramName ) );
-									theRenderer.attribute( paramName, parseString( CStringToString( value ) ) );
+									theRenderer.attribute( paramName, it->expand( CStringToString( value ) ) );
 									break;
 								// Todo: Array support!!!
 							}
@@ -1164,8 +1162,7 @@ namespace affogato {
 			Application app;
 
 			Model sceneRoot = app.GetActiveSceneRoot();
-			CRefArray objects;
-			objectList.Filter( siNullPrimType, CStringArray(), CString(), objects );
+			const CRefArray& objects( filter( objectList, siNullPrimType ) );
 
 			for( long i = 0; i < objects.GetCount(); i++ ) {
 
@@ -1187,8 +1184,7 @@ namespace affogato {
 
 			X3DObject camera( sceneRoot.FindChild( stringToCString( g.camera.cameraName ), siCameraPrimType, CStringArray() ) );
 			if( !camera.IsValid() ) {
-				CRefArray cameras( sceneRoot.FindChildren( L"", siCameraPrimType, CStringArray() ) );
-				camera = cameras[ 0 ];
+				camera = findChildren( L"", siCameraPrimType )[ 0 ];
 			}
 
 
@@ -1228,8 +1224,7 @@ namespace affogato {
 			Application app;
 
 			Model sceneRoot = app.GetActiveSceneRoot();
-			CRefArray objects;
-			objectList.Filter( siNullPrimType, CStringArray(), CString(), objects );
+			const CRefArray& objects( filter( objectList, siNullPrimType ) );
 
 			for( unsigned  i = 0; i < ( unsigned )objects.GetCount(); i++ ) {
 
@@ -1485,8 +1480,7 @@ namespace affogato {
 			// Filter lights
 
 			Model sceneRoot = app.GetActiveSceneRoot();
-			CRefArray objects;
-			objectList.Filter( siLightPrimType, CStringArray(), CString(), objects );
+			const CRefArray& objects( filter( objectList, siLightPrimType ) );
 
 			for( long i = 0; i < objects.GetCount(); i++ ) {
 
@@ -1567,11 +1561,11 @@ namespace affogato {
 						Property prop( props[ k ] );
 
 						if( isAffogatoProperty( prop ) ) {
-							CParameterRefArray params( prop.GetParameters() );
+							const propertyIndex::parameterVector& params( propertyIndex::parameters( prop ) );
 
-							for( int p = 0; p < params.GetCount(); p++ ) {
-								Parameter param( params[ p ] );
-								string paramName( CStringToString( param.GetName() ) );
+							for( propertyIndex::parameterVector::const_iterator it( params.begin() ); it < params.end(); it++ ) {
+								Parameter param( it->parameter );
+								string paramName( it->originalName );
 
 								replace_first( paramName, string( "_" ), string( ":" ) );
 								string userParamName( paramName );
@@ -1605,7 +1599,7 @@ namespace affogato {
 										case CValue::siString:
 										case CValue::siWStr:
 											debugMessage(L"Adding: string " + stringToCString( userParamName ) );
-											theRenderer.attribute( userParamName, parseString( CStringToString( value ) ) );
+											theRenderer.attribute( userParamName, it->expand( CStringToString( value ) ) );
 											break;
 										// Todo: Array support!!!
 									}
@@ -1685,8 +1679,7 @@ namespace affogato {
 			Application app;
 
 			if( g.camera.backPlane ) {
-				Model sceneRoot = app.GetActiveSceneRoot();
-				CRefArray objects = sceneRoot.FindChildren( L"__backplane", siNullPrimType, CStringArray() );
+				const CRefArray& objects( findChildren( L"__backplane", siNullPrimType ) );
 
 				if( objects.GetCount() ) {
 					debugMessage( L"Found backplane null." );
@@ -1727,8 +1720,7 @@ namespace affogato {
 			}
 
 			if( g.camera.frontPlane ) {
-				Model sceneRoot = app.GetActiveSceneRoot();
-				CRefArray objects = sceneRoot.FindChildren( L"__frontplane", siNullPrimType, CStringArray() );
+				const CRefArray& objects( findChildren( L"__frontplane", siNullPrimType ) );
 
 				if( objects.GetCount() ) {
 					debugMessage( L"Found frontplane null." );
@@ -1787,25 +1779,7 @@ namespace affogato {
 			frontAndBackPlane();
 			nulls( objectList );
 
-			CRefArray objects;
-			CRefArray found;
-			objectList.Filter( siPolyMeshType,    CStringArray(), CString(), found );
-			objects += found;
-			found.Clear();
-			objectList.Filter( siSrfMeshPrimType, CStringArray(), CString(), found );
-			objects += found;
-			found.Clear();
-			objectList.Filter( siCrvListPrimType, CStringArray(), CString(), found );
-			objects += found;
-			found.Clear();
-			objectList.Filter( siHairKeyword,     CStringArray(), CString(), found );
-			objects += found;
-			found.Clear();
-			objectList.Filter( siCloudPrimType,   CStringArray(), CString(), found );
-			objects += found;
-			found.Clear();
-			objectList.Filter( siSpherePrimType,  CStringArray(), CString(), found );
-			objects += found;
+			const CRefArray& objects( geometryObjects( objectList ) );
 
 			//message( L"Found " + CValue( objects.GetCount() ).GetAsText() + L" objects", messageError );
 
@@ -1904,19 +1878,82 @@ namespace affogato {
 	}
 
 
+	const ueberMan::ueberMan& worker::getRibRenderer() {
+		globals& g( const_cast< globals& >( globals::access() ) );
+
+		// Rendering directly needs the renderer library
+		if( g.data.nativeWriter && !g.data.directToRenderer )
+			return ueberManRibRenderer::accessRenderer();
+		else
+			return ueberManRiRenderer::accessRenderer();
+	}
+
+	void worker::clearTraversalCache() {
+		childrenCache.clear();
+		filterCache.clear();
+	}
+
+	const CRefArray& worker::findChildren( const CString& name, const CString& type ) {
+		const pair< string, string > key( CStringToString( name ), CStringToString( type ) );
+		map< pair< string, string >, CRefArray >::iterator it( childrenCache.find( key ) );
+		if( childrenCache.end() == it ) {
+			Application app;
+			Model sceneRoot( app.GetActiveSceneRoot() );
+			it = childrenCache.insert( make_pair( key, sceneRoot.FindChildren( name, type, CStringArray() ) ) ).first;
+		}
+		return it->second;
+	}
+
+	// Object lists are passed around by reference for the whole export, so
+	// their address identifies them
+	const CRefArray& worker::filter( const CRefArray& objectList, const CString& type ) {
+		const pair< const CRefArray*, string > key( &objectList, CStringToString( type ) );
+		map< pair< const CRefArray*, string >, CRefArray >::iterator it( filterCache.find( key ) );
+		if( filterCache.end() == it ) {
+			it = filterCache.insert( make_pair( key, CRefArray() ) ).first;
+			objectList.Filter( type, CStringArray(), CString(), it->second );
+		}
+		return it->second;
+	}
+
+	const CRefArray& worker::geometryObjects( const CRefArray& objectList ) {
+		const pair< const CRefArray*, string > key( &objectList, string( "__geometry" ) );
+		map< pair< const CRefArray*, string >, CRefArray >::iterator it( filterCache.find( key ) );
+		if( filterCache.end() == it ) {
+			it = filterCache.insert( make_pair( key, CRefArray() ) ).first;
+			CRefArray& objects( it->second );
+			objects += filter( objectList, siPolyMeshType );
+			objects += filter( objectList, siSrfMeshPrimType );
+			objects += filter( objectList, siCrvListPrimType );
+			objects += filter( objectList, siHairKeyword );
+			objects += filter( objectList, siCloudPrimType );
+			objects += filter( objectList, siSpherePrimType );
+		}
+		return it->second;
+	}
+
 	void worker::archive( const CRefArray &objectList, const string &destination ) {
 
 		Application app;
 
 		ueberManInterface theRenderer;
 
+		globals& g( const_cast< globals& >( globals::access() ) );
+
+		clearTraversalCache();
+		propertyIndex::clear();
+		shader::clearMapDependencies();
+
 #ifndef DEBUG
-		theRenderer.registerRenderer( ueberManRiRenderer::accessRenderer() );
-		//theRenderer.registerRenderer( ueberManXmlRenderer::accessRenderer() );
+		const ueberMan::ueberMan& ribRenderer( getRibRenderer() );
+		theRenderer.registerRenderer( ribRenderer );
+		// The XML is only for looking at, so it mustn't slow down the RIB
+		if( g.feedback.xmlDebug )
+			theRenderer.registerRenderer( ueberManXmlRenderer::accessRenderer(), true );
+		if( g.data.commandStream )
+			theRenderer.registerRenderer( ueberManStreamRenderer::accessRenderer() );
 #endif
 
-		globals& g( const_cast< globals& >( globals::access() ) );
-
 		g.animation.time = g.animation.times[ 0 ];
 		g.data.shadow.shadow = false;
 		g.data.granularity = globals::data::granularitySubFrame;
@@ -1946,8 +1983,11 @@ namespace affogato {
 			masterHora.printTimes();
 
 #ifndef DEBUG
-		theRenderer.unregisterRenderer( ueberManRiRenderer::accessRenderer() );
-		//theRenderer.unregisterRenderer( ueberManXmlRenderer::accessRenderer() );
+		theRenderer.unregisterRenderer( ribRenderer );
+		if( g.feedback.xmlDebug )
+			theRenderer.unregisterRenderer( ueberManXmlRenderer::accessRenderer() );
+		if( g.data.commandStream )
+			theRenderer.unregisterRenderer( ueberManStreamRenderer::accessRenderer() );
 #endif
 	}
 
@@ -2075,25 +2115,53 @@ namespace affogato {
 		}
 	}
 
+	void worker::replay( const string& streamFile ) {
+		try {
+			// Streams carry their own data file names, so the native RIB
+			// writer is all we need to turn them into RIB again
+			ueberManRibRenderer& ribRenderer( const_cast< ueberManRibRenderer& >( ueberManRibRenderer::accessRenderer() ) );
+			ueberManStreamRenderer::replay( streamFile, ribRenderer );
+		}
+		catch( runtime_error& err ) {
+			message( stringToCString( err.what() ), messageError );
+			message( L"Aborting", messageError );
+		}
+	}
+
 	void worker::scene( const CRefArray &objectList ) {
+		clearTraversalCache();
+		propertyIndex::clear();
+		shader::clearMapDependencies();
+
 		try {
 			Application app;
 
 			ueberManInterface theRenderer;
 
-#ifdef DEBUG
-//			shared_ptr< ueberManDummyRenderer > dummy = shared_ptr< ueberManDummyRenderer >( new ueberManDummyRenderer );
-//			theRenderer.registerRenderer( dummy->accessRenderer() );
-			theRenderer.registerRenderer( ueberManRiRenderer::accessRenderer() );
-#else
-			//shared_ptr< ueberManRiRenderer > delight = shared_ptr< ueberManRiRenderer >( new ueberManRiRenderer );
-			theRenderer.registerRenderer( ueberManRiRenderer::accessRenderer() );
-#endif
+			globals& g( const_cast< globals& >( globals::access() ) );
 
-			//theRenderer.registerRenderer( ueberManXmlRenderer::accessRenderer() );
-			//theRenderer.registerRenderer( ueberManGelatoRenderer::accessRenderer() );
+			// In statistics only mode nothing but the dummy renderer gets
+			// to see the scene and no jobs are run
+			bool statisticsOnly = ( globals::feedback::statisticsOnly == g.feedback.statistics );
+			ueberManDummyRenderer& statistics( const_cast< ueberManDummyRenderer& >( ueberManDummyRenderer::accessRenderer() ) );
+
+			const ueberMan::ueberMan& ribRenderer( getRibRenderer() );
+			if( !statisticsOnly ) {
+				//shared_ptr< ueberManRiRenderer > delight = shared_ptr< ueberManRiRenderer >( new ueberManRiRenderer );
+				theRenderer.registerRenderer( ribRenderer );
+				if( g.data.commandStream )
+					theRenderer.registerRenderer( ueberManStreamRenderer::accessRenderer() );
+				// The XML is only for looking at, so it mustn't slow down the RIB
+				if( g.feedback.xmlDebug )
+					theRenderer.registerRenderer( ueberManXmlRenderer::accessRenderer(), true );
+			}
 
-			globals& g( const_cast< globals& >( globals::access() ) );
+			if( globals::feedback::statisticsOff != g.feedback.statistics ) {
+				statistics.reset();
+				theRenderer.registerRenderer( statistics );
+			}
+
+			//theRenderer.registerRenderer( ueberManGelatoRenderer::accessRenderer() );
 
 			blockManager& bm( const_cast< blockManager& >( blockManager::access() ) ); // Real instance
 			bm.reset();
@@ -2101,9 +2169,8 @@ namespace affogato {
 
 			bm.jobPtrStack.push_back( shared_ptr< job >( new job() ) );
 
-			Model sceneRoot = app.GetActiveSceneRoot();
-			CRefArray allSpaces( sceneRoot.FindChildren( CString(), siNullPrimType,  CStringArray() ) );
-			CRefArray allLights( sceneRoot.FindChildren( CString(), siLightPrimType, CStringArray() ) );
+			const CRefArray& allSpaces( findChildren( CString(), siNullPrimType ) );
+			const CRefArray& allLights( findChildren( CString(), siLightPrimType ) );
 
 			timeStats masterHora;
 
@@ -2216,7 +2283,8 @@ namespace affogato {
 					bar.Increment();
 				}
 
-				bm.processJobChunk( frameCounter, chunkNo );
+				if( !statisticsOnly )
+					bm.processJobChunk( frameCounter, chunkNo );
 
 				masterHora.takeTime( "Jobs" );
 
@@ -2233,16 +2301,24 @@ namespace affogato {
 
 			masterHora.takeTime( "Scene" );
 
-			bm.processJob( chunkNo );
+			if( !statisticsOnly )
+				bm.processJob( chunkNo );
 
 			debugMessage( L"All done");
 
-#ifdef DEBUG
-//			theRenderer.unregisterRenderer( dummy->accessRenderer() );
-			theRenderer.unregisterRenderer( ueberManRiRenderer::accessRenderer() );
-#else
-			theRenderer.unregisterRenderer( ueberManRiRenderer::accessRenderer() );
-#endif
+			if( globals::feedback::statisticsOff != g.feedback.statistics ) {
+				statistics.printStatistics();
+				theRenderer.unregisterRenderer( statistics );
+			}
+
+			if( !statisticsOnly ) {
+				theRenderer.unregisterRenderer( ribRenderer );
+				if( g.data.commandStream )
+					theRenderer.unregisterRenderer( ueberManStreamRenderer::accessRenderer() );
+				// Waits for the queue to write out what's left
+				if( g.feedback.xmlDebug )
+					theRenderer.unregisterRenderer( ueberManXmlRenderer::accessRenderer() );
+			}
 			debugMessage( L"Done" );
 
 			bm.reset();
@@ -53,6 +53,7 @@
 
 // Affogato headers
 #include "affogatoIndentHelper.hpp"
+#include "affogatoNumberFormat.hpp"
 #include "affogatoXmlRenderer.hpp"
 #ifdef __XSI_PLUGIN
 #include "affogatoHelpers.hpp"
@@ -72,7 +73,14 @@ namespace ueberMan {
 	// Public methods ---------------------------------------------------------
 
 
-	ueberManXmlRenderer::ueberManXmlRenderer() {
+	ueberManXmlRenderer::ueberManXmlRenderer()
+	:	outBuffer( outBufferSize ),
+		outStream( NULL ),
+		arrayThreshold( defaultArrayThreshold ),
+		useBase64( false ),
+		useBlobs( false ),
+		blobOffset( 0 )
+	{
 		debugMessage( L"UeberManXml: Creating instance" );
 		// Number of current Ri call's motion sample
 		sampleCount = -1;
@@ -85,6 +93,15 @@ namespace ueberMan {
 		inWorldBlock = false;
 	}
 
+	ueberManXmlRenderer::~ueberManXmlRenderer() {
+		outStream.flush();
+		gzipBuffer.reset();
+		if( fileBuffer.is_open() )
+			fileBuffer.close();
+		if( blobStream.is_open() )
+			blobStream.close();
+	}
+
 	/**-
 	 * Starts a new scene.
 	 * It returns a context handle that can be used to switch to direct calls
@@ -100,10 +117,26 @@ namespace ueberMan {
 				string file = destination + ".xml";
 
 				debugMessage( L"UeberManXml: BeginScene1" );
-				outStream.open( file.c_str(), ofstream::out );
+				if( useCompression ) {
+					gzipBuffer = boost::shared_ptr< gzipStreamBuffer >( new gzipStreamBuffer( file + ".gz" ) );
+					outStream.rdbuf( gzipBuffer.get() );
+				} else {
+					// The buffer has to be set before the file is opened
+					fileBuffer.pubsetbuf( &outBuffer[ 0 ], outBuffer.size() );
+					fileBuffer.open( file.c_str(), ios::out | ios::trunc );
+					outStream.rdbuf( &fileBuffer );
+				}
+				outStream.clear();
 				dso = false;
 
-				outStream << "<?xml version=\"1.0\"?>" << endl;
+				useBase64 = useBinary;
+				blobName = file + ".blob";
+				blobOffset = 0;
+				// The options of the last scene don't carry over
+				arrayThreshold = defaultArrayThreshold;
+				useBlobs = false;
+
+				outStream << "<?xml version=\"1.0\"?>\n";
 
 				size_t pos = destination.rfind( "/" );
 				string strippedDestination;
@@ -114,7 +147,7 @@ namespace ueberMan {
 
 				debugMessage( L"UeberManXml: BeginScene2" );
 				outStream << indent++;
-				outStream << "<scene version=\"1.0\" title=\"" << strippedDestination << "\">" << endl;
+				outStream << "<scene version=\"1.0\" title=\"" << strippedDestination << "\">\n";
 
 				debugMessage( L"UeberManXml: Creating Graphics State" );
 			}
@@ -131,6 +164,7 @@ namespace ueberMan {
 		++currentContext;
 		graphicsState[ currentContext ] = boost::shared_ptr< state >( new state );
 		graphicsState[ currentContext ]->push( boost::shared_ptr< xmlLook >( new xmlLook ) );
+		currentState = graphicsState[ currentContext ].get();
 
 		debugMessage( L"UeberManXml: Done BeginScene" );
 		return currentContext;
@@ -138,6 +172,9 @@ namespace ueberMan {
 
 	void ueberManXmlRenderer::switchScene( context ctx ) {
 		currentContext = ctx;
+		map< context, boost::shared_ptr< state > >::iterator it = graphicsState.find( ctx );
+		if( graphicsState.end() != it )
+			currentState = it->second.get();
 	}
 
 	context	ueberManXmlRenderer::currentScene() {
@@ -151,8 +188,15 @@ namespace ueberMan {
 		if( !graphicsState.empty() ) {
 			currentState = graphicsState.rbegin()->second.get();
 		} else {
-			outStream << --indent << "</scene>" << endl;
-			outStream.close();
+			outStream << --indent << "</scene>\n";
+			outStream.flush();
+			gzipBuffer.reset();
+			if( fileBuffer.is_open() )
+				fileBuffer.close();
+			outStream.rdbuf( NULL );
+			if( blobStream.is_open() )
+				blobStream.close();
+			currentContext = 0;
 		}
 	}
 
@@ -191,12 +235,13 @@ namespace ueberMan {
 	void ueberManXmlRenderer::render( const cameraHandle &cameraname ) {
 	}
 
-	void ueberManXmlRenderer::motion( int ntimes, const float *times ) {
+	void ueberManXmlRenderer::motion( const vector< float >& times ) {
 		debugMessage( L"UeberManXml: Motion" );
 
+		short ntimes = ( short )( MAXMOTIONSAMPLES < times.size() ? MAXMOTIONSAMPLES : times.size() );
 		sampleCount = ntimes;
 		numSamples = ntimes;
-		memcpy( motionSamples, times, ntimes * sizeof( float ) );
+		copy( times.begin(), times.begin() + ntimes, motionSamples );
 	}
 
 	void ueberManXmlRenderer::parameter( const vector< tokenValue > &tokenValueArray ) {
@@ -286,6 +331,17 @@ namespace ueberMan {
 		checkEndMotion();
 	}
 
+	void ueberManXmlRenderer::option( const string& typedname, const int value ) {
+		if( "xml:arraythreshold" == typedname )
+			arrayThreshold = ( unsigned )( 0 > value ? 0 : value );
+		else if( "xml:blobs" == typedname )
+			useBlobs = ( 0 != value );
+	}
+
+	void ueberManXmlRenderer::option( const string& typedname, const bool value ) {
+		option( typedname, ( int )value );
+	}
+
 	bool ueberManXmlRenderer::getAttribute( const string& typedname, float &value ) {
 
 		return false;
@@ -373,7 +429,7 @@ namespace ueberMan {
 	void ueberManXmlRenderer::beginLook( lookHandle& id ) {
 
 		debugMessage( L"UeberManXml: BeginLook" );
-		outStream << indent++ << "<look id=\"" << id << "\">" << endl;
+		outStream << indent++ << "<look id=\"" << id << "\">\n";
 //		dumpAttributeTokenValues();
 
 	}
@@ -381,16 +437,16 @@ namespace ueberMan {
 	void ueberManXmlRenderer::endLook() {
 
 		debugMessage( L"UeberManXml: EndLook" );
-		outStream << --indent << "</look>" << endl;
+		outStream << --indent << "</look>\n";
 
 	}
 
 	void ueberManXmlRenderer::look( const lookHandle& id ) {
-		outStream << "<lookInstance>" << id << "</lookInstance>" << endl;
+		outStream << indent << "<lookInstance>" << id << "</lookInstance>\n";
 	}
 
 	void ueberManXmlRenderer::appendLook( const lookHandle& id ) {
-		outStream << "<appendedLookInstance>" << id << "</appendedLookInstance>" << endl;
+		outStream << indent << "<appendedLookInstance>" << id << "</appendedLookInstance>\n";
 	}
 
 	void ueberManXmlRenderer::shader( const string& shadertype, const string& shadername, shaderHandle& shaderid ) {
@@ -447,7 +503,7 @@ namespace ueberMan {
 
 		checkStartMotion();
 
-		outStream << indent << "<lightswitch id=\"" << lightid << "\">" << ( on ? "on" : "off" ) << "</lightswitch>" << endl;
+		outStream << indent << "<lightswitch id=\"" << lightid << "\">" << ( on ? "on" : "off" ) << "</lightswitch>\n";
 
 		checkEndMotion();
 
@@ -517,11 +573,29 @@ namespace ueberMan {
 			//string newId = writeLook( primitiveid );
 
 
-			outStream << indent++ << "<primitive id=\"" << identifier << "\">" << endl;
+			outStream << indent++ << "<primitive id=\"" << identifier << "\" type=\"mesh\" interpolation=\"" << interp << "\">\n";
 			//outStream << indent << "<lookInstance>" << newId << "</lookInstance>" << endl;
-			outStream << --indent << "</primitive>" << endl;
 
-			//doPrimitive();
+			size_t numVerts = 0;
+			for( int i = 0; i < nfaces; i++ )
+				numVerts += nverts[ i ];
+
+			outStream << indent << "<nverts size=\"" << nfaces << "\"";
+			writeArrayData( nverts, nfaces, false );
+			outStream << "</nverts>\n";
+			outStream << indent << "<verts size=\"" << numVerts << "\"";
+			writeArrayData( verts, numVerts, false );
+			outStream << "</verts>\n";
+
+			for( vector< boost::shared_ptr< tokenValue > >::iterator it = tokenValueCache.begin(); it < tokenValueCache.end(); it++ ) {
+				outStream << indent << "<parameter " << getTokenAsClassifiedString( *( *it ) );
+				writeData( *( *it ) );
+				outStream << "</parameter>\n";
+			}
+
+			outStream << --indent << "</primitive>\n";
+
+			doPrimitive();
 		}
 
 		checkEndMotion();
@@ -553,53 +627,128 @@ namespace ueberMan {
 
 	string ueberManXmlRenderer::getTokenAsString( const tokenValue &aTokenValue ) {
 
-		stringstream attrib;
-		attrib << "name=\"" << aTokenValue.name() << "\"";
-		attrib << " type=\"" << aTokenValue.typeAsString() << "\"";
+		string attrib( "name=\"" );
+		attrib += aTokenValue.name();
+		attrib += "\" type=\"";
+		attrib += aTokenValue.typeAsString();
+		attrib += "\"";
 
 		size_t size = aTokenValue.size();
-		if( ( 1 < size ) && ( tokenValue::typeString != aTokenValue.type() ) )
-			attrib << " size=\"" << size << "\"";
+		if( ( 1 < size ) && ( tokenValue::typeString != aTokenValue.type() ) ) {
+			char tmp[ numberFormatSize ];
+			attrib += " size=\"";
+			attrib.append( tmp, formatInt( ( int )size, tmp ) );
+			attrib += "\"";
+		}
 
-		return attrib.str();
+		return attrib;
 	}
 
 	string ueberManXmlRenderer::getTokenAsClassifiedString( const tokenValue &aTokenValue ) {
 
-		std::stringstream attrib;
-		attrib << "name=\"" << aTokenValue.name() << "\"";
-
-		attrib << " class=\"";
+		string attrib( "name=\"" );
+		attrib += aTokenValue.name();
+		attrib += "\" class=\"";
 
 		switch( aTokenValue.storage() ) {
 			case tokenValue::storageConstant:
-				attrib << "constant ";
+				attrib += "constant";
 				break;
 			case tokenValue::storagePerPiece:
-				attrib << "uniform ";
+				attrib += "uniform";
 				break;
 			case tokenValue::storageLinear:      // varying
-				attrib << "varying ";
+				attrib += "varying";
 				break;
 			case tokenValue::storageVertex:
-				attrib << "vertex ";
+				attrib += "vertex";
 				break;
 			case tokenValue::storageFaceVarying: // Needs to be translated into linear for Gelato
-				attrib << "facevarying ";
+				attrib += "facevarying";
 				break;
 			case tokenValue::storageFaceVertex:  // Currently unsupported in Gelato
-				attrib << "facevertex ";
+				attrib += "facevertex";
 				break;
 		};
-		attrib << "\"";
 
-		attrib << " type=\"" << aTokenValue.typeAsString() << "\"";
+		attrib += "\" type=\"";
+		attrib += aTokenValue.typeAsString();
+		attrib += "\"";
 
 		size_t size = aTokenValue.size();
-		if( ( 1 < size ) && ( tokenValue::typeString != aTokenValue.type() ) )
-			attrib << " size=\"" << size << "\"";
+		if( ( 1 < size ) && ( tokenValue::typeString != aTokenValue.type() ) ) {
+			char tmp[ numberFormatSize ];
+			attrib += " size=\"";
+			attrib.append( tmp, formatInt( ( int )size, tmp ) );
+			attrib += "\"";
+		}
 
-		return attrib.str();
+		return attrib;
+	}
+
+	/** Finishes an element's start tag and writes the value of the given
+	 *  token.
+	 *  Expects the element's start tag to be open, so encoding attributes
+	 *  can still be added.
+	 */
+	void ueberManXmlRenderer::writeData( const tokenValue &aTokenValue ) {
+		switch( aTokenValue.type() ) {
+			case tokenValue::typeFloat:
+			case tokenValue::typeColor:
+			case tokenValue::typePoint:
+			case tokenValue::typeHomogenousPoint:
+			case tokenValue::typeVector:
+			case tokenValue::typeNormal:
+			case tokenValue::typeMatrix:
+				writeArrayData( aTokenValue.data(), aTokenValue.valid() ? aTokenValue.byteSize() / sizeof( float ) : 0, true );
+				break;
+			case tokenValue::typeInteger:
+				writeArrayData( aTokenValue.data(), aTokenValue.valid() ? aTokenValue.byteSize() / sizeof( int ) : 0, false );
+				break;
+			case tokenValue::typeString:
+				outStream << '>';
+				if( aTokenValue.valid() )
+					outStream << ( const char* )aTokenValue.data();
+				break;
+			default:
+				outStream << '>';
+		}
+	}
+
+	/** Finishes an element's start tag and writes a numeric array.
+	 *  Arrays above the threshold go out base64 encoded or into the blob
+	 *  file if requested; everything else as plain text.
+	 */
+	void ueberManXmlRenderer::writeArrayData( const void *data, size_t numValues, bool isFloat ) {
+		size_t numBytes = numValues * ( isFloat ? sizeof( float ) : sizeof( int ) );
+
+		if( ( arrayThreshold < numValues ) && useBlobs ) {
+			if( !blobStream.is_open() ) {
+				blobStream.open( blobName.c_str(), ios::out | ios::binary | ios::trunc );
+				blobOffset = 0;
+			}
+			if( blobStream.is_open() ) {
+				size_t pos = blobName.find_last_of( "/\\" );
+				outStream << " blob=\"" << ( string::npos != pos ? blobName.substr( pos + 1 ) : blobName )
+						  << "\" offset=\"" << blobOffset << "\" bytes=\"" << numBytes << "\">";
+				blobStream.write( ( const char* )data, numBytes );
+				blobOffset += numBytes;
+				return;
+			}
+		}
+
+		formatBuffer.clear();
+		if( ( arrayThreshold < numValues ) && useBase64 ) {
+			outStream << " encoding=\"base64\">";
+			encodeBase64( data, numBytes, formatBuffer );
+		} else {
+			outStream << '>';
+			if( isFloat )
+				formatFloats( ( const float* )data, numValues, formatBuffer );
+			else
+				formatInts( ( const int* )data, numValues, formatBuffer );
+		}
+		outStream.write( formatBuffer.data(), formatBuffer.size() );
 	}
 
 
@@ -611,6 +760,10 @@ namespace ueberMan {
 	 *  reasons.
 	 */
 	bool ueberManXmlRenderer::checkStartMotion() {
+		// Outside a motion block every call is written
+		if( 0 > sampleCount )
+			return true;
+
 		if( sampleCount == numSamples ) {
 			debugMessage( L"UeberManXml: MotionBegin" );
 
@@ -716,18 +869,13 @@ namespace ueberMan {
 				break;
 		}
 
-		x.outStream << "\">" << endl;
+		x.outStream << "\">\n";
 		for( vector< boost::shared_ptr< tokenValue > >::iterator it = tokenValueArray.begin(); it < tokenValueArray.end(); it++ ) {
-			x.outStream << x.indent << "<parameter " << x.getTokenAsString( *( *it ) ) << ">";
-
-			if( ( 1 < ( *it )->size() ) && ( tokenValue::typeString != ( *it )->type() ) )
-				x.outStream << endl << x.indent + 1 << ( *it )->dataAsString() << endl << x.indent;
-			else
-				x.outStream << ( *it )->dataAsString();
-
-			x.outStream << "</parameter>" << endl;
+			x.outStream << x.indent << "<parameter " << x.getTokenAsString( *( *it ) );
+			x.writeData( *( *it ) );
+			x.outStream << "</parameter>\n";
 		}
-		x.outStream << --x.indent << "</shader>" << endl;
+		x.outStream << --x.indent << "</shader>\n";
 	}
 
 }
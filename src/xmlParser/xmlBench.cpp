@@ -0,0 +1,186 @@
+/**
+ ****************************************************************************
+ * <P> xmlBench.cpp - compares the tree (DOM) and the streaming (SAX) parsers
+ * on large XML files </P>
+ *
+ * Usage: xmlBench [-r repeats] [file.xml ...]
+ *
+ * Without any file, a job script for a long sequence and a globals file,
+ * shaped like the ones Affogato writes, are generated and used instead.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ****************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "xmlParser.h"
+
+// Counts what the streaming parser reports
+struct countingHandler : public XMLSAXHandler
+{
+    long nElement, nAttribute, nText;
+    countingHandler(): nElement(0), nAttribute(0), nText(0) {};
+    void startElement(XMLStringView name, int isDeclaration) { nElement++; }
+    void attribute(XMLStringView name, XMLStringView value) { nAttribute++; }
+    void text(XMLStringView text) { nText++; }
+};
+
+// Counts the same things in a tree
+static void countTree(XMLNode x, long *nElement, long *nAttribute, long *nText)
+{
+    int i,n=x.nChildNode();
+    *nAttribute+=x.nAttribute();
+    *nText+=x.nText();
+    for (i=0; i<n; i++)
+    {
+        (*nElement)++;
+        countTree(x.getChildNode(i),nElement,nAttribute,nText);
+    }
+}
+
+static long fileSize(const char *filename)
+{
+    FILE *f=fopen(filename,"rb");
+    if (!f) return -1;
+    fseek(f,0,SEEK_END);
+    long l=ftell(f);
+    fclose(f);
+    return l;
+}
+
+// A job script with one task per frame, see affogato::job::writeXML()
+static void writeJobScript(const char *filename, int nFrames)
+{
+    FILE *f=fopen(filename,"w");
+    fprintf(f,"<?xml version=\"1.0\"?>\n");
+    fprintf(f,"<jobscript title=\"bench\" type=\"render\" version=\"1.0.1\">\n");
+    fprintf(f,"\t<subtasks>\n");
+    for (int i=1; i<=nFrames; i++)
+    {
+        fprintf(f,"\t\t<task title=\"bench.%04i\">\n",i);
+        fprintf(f,"\t\t\t<subtasks>\n");
+        for (int j=0; j<4; j++)
+        {
+            fprintf(f,"\t\t\t\t<task title=\"bench.shadow%i.%04i\">\n",j,i);
+            fprintf(f,"\t\t\t\t\t<commands>\n");
+            fprintf(f,"\t\t\t\t\t\t<command cpus=\"2\">renderdl -p:2 /jobs/bench/data/bench.shadow%i.%04i.rib</command>\n",j,i);
+            fprintf(f,"\t\t\t\t\t</commands>\n");
+            fprintf(f,"\t\t\t\t</task>\n");
+        }
+        fprintf(f,"\t\t\t</subtasks>\n");
+        fprintf(f,"\t\t\t<commands>\n");
+        fprintf(f,"\t\t\t\t<command cpus=\"2\">renderdl -p:2 /jobs/bench/data/bench.%04i.rib</command>\n",i);
+        fprintf(f,"\t\t\t</commands>\n");
+        fprintf(f,"\t\t\t<cleanup>\n");
+        fprintf(f,"\t\t\t\t<command cpus=\"2\">rm /jobs/bench/data/bench.%04i.rib</command>\n",i);
+        fprintf(f,"\t\t\t</cleanup>\n");
+        fprintf(f,"\t\t</task>\n");
+    }
+    fprintf(f,"\t</subtasks>\n");
+    fprintf(f,"</jobscript>\n");
+    fclose(f);
+}
+
+// A globals file with many passes, see affogato::globals::scan()
+static void writeGlobals(const char *filename, int nPasses)
+{
+    FILE *f=fopen(filename,"w");
+    fprintf(f,"<?xml version=\"1.0\"?>\n");
+    fprintf(f,"<PMML version=\"3.0\">\n");
+    fprintf(f,"\t<!-- generated by xmlBench -->\n");
+    fprintf(f,"\t<frames startFrame=\"1\" endFrame=\"2000\" frameStep=\"1\" />\n");
+    fprintf(f,"\t<file resolutionX=\"2048\" resolutionY=\"1556\" pixelAspect=\"1\" baseName=\"bench\" />\n");
+    fprintf(f,"\t<directories base=\"/jobs/bench\" image=\"images\" map=\"maps\" data=\"data\" temp=\"tmp\" />\n");
+    fprintf(f,"\t<searchPaths shader=\"@:/shaders:&amp;\" texture=\"@:/textures\" archive=\"@\" procedural=\"@\" />\n");
+    fprintf(f,"\t<passes>\n");
+    for (int i=0; i<nPasses; i++)
+        fprintf(f,"\t\t<pass name=\"aov%i\" format=\"exr\" type=\"color\" filter=\"gaussian\" filterX=\"2\" filterY=\"2\" quantize=\"float\" dither=\"0.5\" />\n",i);
+    fprintf(f,"\t</passes>\n");
+    fprintf(f,"</PMML>\n");
+    fclose(f);
+}
+
+static double seconds(clock_t start) { return (double)(clock()-start)/CLOCKS_PER_SEC; }
+
+static int bench(const char *filename, int nRepeats)
+{
+    long size=fileSize(filename);
+    if (size<0)
+    {
+        printf("Can't open '%s'.\n",filename);
+        return 1;
+    }
+    double mb=size/(1024.0*1024.0);
+    printf("%s (%.2f MB, %i repeats):\n",filename,mb,nRepeats);
+
+    long nElement=0, nAttribute=0, nText=0;
+    XMLResults results;
+    clock_t start=clock();
+    for (int i=0; i<nRepeats; i++)
+    {
+        XMLNode x=XMLNode::parseFile(filename,NULL,&results);
+        if (results.error!=eXMLErrorNone)
+        {
+            printf("  DOM: %s at line %i, column %i\n",XMLNode::getError(results.error),results.nLine,results.nColumn);
+            return 1;
+        }
+        nElement=nAttribute=nText=0;
+        countTree(x,&nElement,&nAttribute,&nText);
+    }
+    double t=seconds(start)/nRepeats;
+    printf("  DOM: %8.2f ms  %7.1f MB/s  (%li elements, %li attributes, %li texts)\n",t*1000.0,t>0?mb/t:0.0,nElement,nAttribute,nText);
+
+    countingHandler handler;
+    start=clock();
+    for (int i=0; i<nRepeats; i++)
+    {
+        handler=countingHandler();
+        if (parseSAXFile(filename,&handler,&results)!=eXMLErrorNone)
+        {
+            printf("  SAX: %s at line %i, column %i\n",XMLNode::getError(results.error),results.nLine,results.nColumn);
+            return 1;
+        }
+    }
+    t=seconds(start)/nRepeats;
+    printf("  SAX: %8.2f ms  %7.1f MB/s  (%li elements, %li attributes, %li texts)\n",t*1000.0,t>0?mb/t:0.0,handler.nElement,handler.nAttribute,handler.nText);
+
+    if ((handler.nElement!=nElement)||(handler.nAttribute!=nAttribute))
+    {
+        printf("  Parsers disagree!\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int nRepeats=5, i=1, failed=0;
+    if ((argc>2)&&(strcmp(argv[1],"-r")==0)) { nRepeats=atoi(argv[2]); i=3; }
+    if (nRepeats<1) nRepeats=1;
+
+    if (i>=argc)
+    {
+        writeJobScript("benchJob.xml",20000);
+        writeGlobals("benchGlobals.xml",2000);
+        failed|=bench("benchJob.xml",nRepeats);
+        failed|=bench("benchGlobals.xml",nRepeats);
+    } else
+        for (; i<argc; i++) failed|=bench(argv[i],nRepeats);
+
+    return failed;
+}
@@ -94,6 +94,17 @@ typedef struct ClearTag
     LPCTSTR lpszClose;
 } ClearTag;
 
+// Clear (unformatted) tags known to both the tree and the streaming parser
+static struct ClearTag clearTags[] =
+{
+    {    _T("<![CDATA["),    _T("]]>")       },
+    {    _T("<PRE>"),        _T("</PRE>")    },
+    {    _T("<Script>"),     _T("</Script>") },
+    {    _T("<!--"),         _T("-->")       },
+    {    _T("<!DOCTYPE"),    _T(">")         },
+    {    NULL,               NULL            }
+};
+
 // Main structure used for parsing XML
 typedef struct XML
 {
@@ -1187,21 +1198,12 @@ XMLNode XMLNode::parseString(LPCTSTR lpszXML, LPCTSTR tag, XMLResults *pResults)
         }
         return emptyXMLNode;
     }
-    static struct ClearTag tags[] =
-    {
-        {    _T("<![CDATA["),    _T("]]>")       },
-        {    _T("<PRE>"),        _T("</PRE>")    },
-        {    _T("<Script>"),     _T("</Script>") },
-        {    _T("<!--"),         _T("-->")       },
-        {    _T("<!DOCTYPE"),    _T(">")         },
-        {    NULL,               NULL            }
-    };
     enum XMLError error;
     XMLNode xnode(NULL,NULL,FALSE);
     struct XML xml={ NULL, 0, eXMLErrorNone, NULL, 0, NULL, 0, TRUE , NULL};
 
     xml.lpXML = lpszXML;
-    xml.pClrTags = tags;
+    xml.pClrTags = clearTags;
 
     // Create header element
     xnode.ParseXMLElement(&xml);
@@ -1254,19 +1256,13 @@ XMLNode XMLNode::parseString(LPCTSTR lpszXML, LPCTSTR tag, XMLResults *pResults)
     return xnode;
 }
 
-XMLNode XMLNode::parseFile(const char *filename, LPCTSTR tag, XMLResults *pResults)
+// private:
+// Load a whole file into a new allocated, zero-terminated string (=NULL if
+// the file cannot be opened). Unicode files are converted on windows.
+static LPTSTR readXMLFile(const char *filename)
 {
     FILE *f=fopen(filename,"rb");
-    if (f==NULL)
-    {
-        if (pResults)
-        {
-            pResults->error=eXMLErrorFileNotFound;
-            pResults->nLine=0;
-            pResults->nColumn=0;
-        }
-        return emptyXMLNode;
-    }
+    if (f==NULL) return NULL;
     fseek(f,0,SEEK_END);
     int l=ftell(f);
     fseek(f,0,SEEK_SET);
@@ -1307,7 +1303,23 @@ XMLNode XMLNode::parseFile(const char *filename, LPCTSTR tag, XMLResults *pResul
     }
 #endif
 #endif
-    XMLNode x=parseString((LPTSTR)buf,tag,pResults);
+    return (LPTSTR)buf;
+}
+
+XMLNode XMLNode::parseFile(const char *filename, LPCTSTR tag, XMLResults *pResults)
+{
+    LPTSTR buf=readXMLFile(filename);
+    if (buf==NULL)
+    {
+        if (pResults)
+        {
+            pResults->error=eXMLErrorFileNotFound;
+            pResults->nLine=0;
+            pResults->nColumn=0;
+        }
+        return emptyXMLNode;
+    }
+    XMLNode x=parseString(buf,tag,pResults);
     free(buf);
     return x;
 }
@@ -1831,3 +1843,281 @@ char         XMLNode::isDeclaration(     ) { if (!d) return 0;                 r
 char         XMLNode::isEmpty      (     ) { return (d==NULL); }
 int          XMLNode::nElement     (     ) { if (!d) return 0; return d->nChild+d->nText+d->nClear+d->nAttribute; }
 
+char XMLStringView::isEmpty() const { return (lpszStart==NULL)||(cbLength==0); }
+
+char XMLStringView::equals(LPCTSTR s) const
+{
+    if ((!lpszStart)||(!s)) return (!lpszStart)&&(!s);
+    return ((int)_tcslen(s)==cbLength)&&(_tcsnicmp(lpszStart,s,cbLength)==0);
+}
+
+LPTSTR XMLStringView::decode() const { return fromXMLString(lpszStart,cbLength); }
+
+static inline XMLStringView makeStringView(LPCTSTR lpszStart, int cbLength)
+{
+    XMLStringView v={ lpszStart, cbLength };
+    return v;
+}
+
+static inline char sameStringView(const XMLStringView &a, const XMLStringView &b)
+{
+    return (a.cbLength==b.cbLength)&&(_tcsnicmp(a.lpszStart,b.lpszStart,a.cbLength)==0);
+}
+
+// Report the text found since lpszText (if any) up to lpszEnd.
+static void flushSAXText(XMLSAXHandler *pHandler, LPCTSTR *lpszText, LPCTSTR lpszEnd)
+{
+    if (!*lpszText) return;
+    int cbText=(int)(lpszEnd-*lpszText);
+    FindEndOfText(*lpszText, &cbText);
+    pHandler->text(makeStringView(*lpszText,cbText));
+    *lpszText=NULL;
+}
+
+// Parse an XML string in one go and report its contents to a XMLSAXHandler.
+// This follows the same grammar as "ParseXMLElement" but without recursion:
+// the names of the open elements are kept on a small stack instead.
+XMLError parseSAXString(LPCTSTR lpszXML, XMLSAXHandler *pHandler, XMLResults *pResults)
+{
+    if ((!lpszXML)||(!pHandler))
+    {
+        if (pResults)
+        {
+            pResults->error=eXMLErrorNoElements;
+            pResults->nLine=0;
+            pResults->nColumn=0;
+        }
+        return eXMLErrorNoElements;
+    }
+
+    struct XML xml={ NULL, 0, eXMLErrorNone, NULL, 0, NULL, 0, TRUE , NULL};
+    xml.lpXML = lpszXML;
+    xml.pClrTags = clearTags;
+
+    XMLStringView *pOpen=NULL;      // stack of open elements
+    int nOpen=0, nOpenMax=0;
+    XMLStringView name={ NULL, 0 }, attribName={ NULL, 0 };
+    XMLStringView noValue={ NULL, 0 };
+    int cbToken;
+    enum TokenTypeTag type;
+    NextToken token;
+    LPCTSTR lpszText = NULL;
+    LPCTSTR lpszTemp;
+    int nDeclaration=FALSE;
+    enum Status status = eOutsideTag;
+    enum Attrib attrib = eAttribName;
+
+    while (xml.error==eXMLErrorNone)
+    {
+        // Obtain the next token; at the end of the string we are done
+        token = GetNextToken(&xml, &cbToken, &type);
+        if (type == eTokenError) break;
+
+        if (status == eOutsideTag)
+        {
+            switch(type)
+            {
+            // Text: remember where it starts, it is reported at the next tag
+            case eTokenText:
+            case eTokenQuotedText:
+            case eTokenEquals:
+                if (!lpszText) lpszText = token.pStr;
+                break;
+
+            // Start tag '<' or declaration '<?'
+            case eTokenTagStart:
+            case eTokenDeclaration:
+                flushSAXText(pHandler, &lpszText, token.pStr);
+                nDeclaration = type == eTokenDeclaration;
+
+                token = GetNextToken(&xml, &cbToken, &type);
+                if (type != eTokenText)
+                {
+                    xml.error = eXMLErrorMissingTagName;
+                    break;
+                }
+                name = makeStringView(token.pStr, cbToken);
+                pHandler->startElement(name, nDeclaration);
+                status = eInsideTag;
+                attrib = eAttribName;
+                break;
+
+            // End tag '</'
+            case eTokenTagEnd:
+                flushSAXText(pHandler, &lpszText, token.pStr);
+
+                token = GetNextToken(&xml, &cbToken, &type);
+                if (type != eTokenText)
+                {
+                    xml.error = eXMLErrorMissingEndTagName;
+                    break;
+                }
+                name = makeStringView(token.pStr, cbToken);
+
+                token = GetNextToken(&xml, &cbToken, &type);
+                if (type != eTokenCloseTag)
+                {
+                    xml.error = eXMLErrorMissingEndTagName;
+                    break;
+                }
+
+                // Like the tree parser, an end tag also closes all elements
+                // opened after the one it matches
+                {
+                    int n=nOpen;
+                    while (n && !sameStringView(pOpen[n-1], name)) n--;
+                    if (!n)
+                    {
+                        xml.error = eXMLErrorUnmatchedEndTag;
+                        break;
+                    }
+                    while (nOpen>=n) pHandler->endElement(pOpen[--nOpen]);
+                }
+                break;
+
+            // Clear (unformatted) tag, e.g. a comment
+            case eTokenClear:
+                flushSAXText(pHandler, &lpszText, token.pStr);
+
+                lpszTemp = &xml.lpXML[xml.nIndex];
+                {
+                    LPCTSTR lpszEnd = _tcsstr(lpszTemp, token.pClr->lpszClose);
+                    if (!lpszEnd)
+                    {
+                        xml.error = eXMLErrorUnmatchedEndTag;
+                        break;
+                    }
+                    pHandler->clear(makeStringView(lpszTemp, (int)(lpszEnd-lpszTemp)), token.pClr->lpszOpen, token.pClr->lpszClose);
+                    xml.nIndex += (int)(lpszEnd-lpszTemp) + (int)_tcslen(token.pClr->lpszClose);
+                }
+                break;
+
+            // Errors...
+            case eTokenCloseTag:          /* '>'         */
+            case eTokenShortHandClose:    /* '/>'        */
+                xml.error = eXMLErrorUnexpectedToken;
+                break;
+            default:
+                break;
+            }
+        } else
+        {
+            // Inside a tag: attributes, then '>' or '/>'
+            switch(attrib)
+            {
+            case eAttribName:
+                switch(type)
+                {
+                case eTokenText:
+                    attribName = makeStringView(token.pStr, cbToken);
+                    attrib = eAttribEquals;
+                    break;
+                case eTokenCloseTag:
+                case eTokenShortHandClose:
+                    break;
+                default:
+                    xml.error = eXMLErrorUnexpectedToken;
+                    break;
+                }
+                break;
+
+            case eAttribEquals:
+                switch(type)
+                {
+                // An attribute without value, followed by the next one
+                case eTokenText:
+                    pHandler->attribute(attribName, noValue);
+                    attribName = makeStringView(token.pStr, cbToken);
+                    break;
+                case eTokenCloseTag:
+                case eTokenShortHandClose:
+                    // Remove the closing '?' of a declaration
+                    if (nDeclaration && (attribName.lpszStart[attribName.cbLength-1] == _T('?')))
+                        attribName.cbLength--;
+                    if (attribName.cbLength)
+                        pHandler->attribute(attribName, noValue);
+                    break;
+                case eTokenEquals:
+                    attrib = eAttribValue;
+                    break;
+                default:
+                    xml.error = eXMLErrorUnexpectedToken;
+                    break;
+                }
+                break;
+
+            case eAttribValue:
+                switch(type)
+                {
+                case eTokenText:
+                case eTokenQuotedText:
+                    if (nDeclaration && (token.pStr[cbToken-1] == _T('?')))
+                        cbToken--;
+                    if (type == eTokenQuotedText)
+                        { token.pStr++; cbToken-=2; }
+                    if (attribName.cbLength)
+                        pHandler->attribute(attribName, makeStringView(token.pStr, cbToken));
+                    attrib = eAttribName;
+                    break;
+                default:
+                    xml.error = eXMLErrorUnexpectedToken;
+                    break;
+                }
+                break;
+            }
+
+            // End of the tag: declarations & '<a/>' have no contents,
+            // anything else becomes the innermost open element
+            if ((xml.error == eXMLErrorNone) && ((type == eTokenCloseTag) || (type == eTokenShortHandClose)))
+            {
+                if (nDeclaration || (type == eTokenShortHandClose))
+                {
+                    pHandler->endElement(name);
+                } else
+                {
+                    if (nOpen == nOpenMax)
+                    {
+                        nOpenMax = nOpenMax ? nOpenMax*2 : 16;
+                        pOpen = (XMLStringView*)realloc(pOpen, nOpenMax*sizeof(XMLStringView));
+                    }
+                    pOpen[nOpen++] = name;
+                }
+                status = eOutsideTag;
+                attrib = eAttribName;
+            }
+        }
+    }
+
+    // Close whatever is still open (the tree parser accepts this too)
+    if (xml.error == eXMLErrorNone)
+        while (nOpen) pHandler->endElement(pOpen[--nOpen]);
+    free(pOpen);
+
+    if (pResults)
+    {
+        pResults->error = xml.error;
+        pResults->nLine = 0;
+        pResults->nColumn = 0;
+        if (xml.error != eXMLErrorNone)
+            CountLinesAndColumns(xml.lpXML, xml.nIndex, pResults);
+    }
+    return xml.error;
+}
+
+XMLError parseSAXFile(const char *filename, XMLSAXHandler *pHandler, XMLResults *pResults)
+{
+    LPTSTR buf=readXMLFile(filename);
+    if (buf==NULL)
+    {
+        if (pResults)
+        {
+            pResults->error=eXMLErrorFileNotFound;
+            pResults->nLine=0;
+            pResults->nColumn=0;
+        }
+        return eXMLErrorFileNotFound;
+    }
+    XMLError error=parseSAXString(buf,pHandler,pResults);
+    free(buf);
+    return error;
+}
@@ -251,4 +251,42 @@ LPTSTR toXMLString(LPTSTR dest,LPCTSTR source);
 // duplicate (copy in a new allocated buffer) the source string
 LPTSTR stringDup(LPCTSTR source, int cbData=0);
 
+// Streaming (SAX) parsing
+// -----------------------
+// The functions "parseSAXString" and "parseSAXFile" do not build any XMLNode tree.
+// They walk the XML document once and report everything they find to a
+// XMLSAXHandler. Nothing is allocated for names, values or text: these are given
+// as XMLStringView's that point directly inside the buffer being parsed. A view
+// is only valid during the callback, is NOT zero-terminated and still contains
+// the escape sequences (&amp;, &lt;, ...). Use "decode" to get a normal string.
+
+typedef struct XMLStringView
+{
+    LPCTSTR lpszStart;  // first character (=NULL for an attribute without value)
+    int     cbLength;   // number of characters
+
+    char isEmpty() const;                                  // no characters?
+    char equals(LPCTSTR s) const;                          // case insensitive compare with a C string
+    LPTSTR decode() const;                                 // new allocated string with escape sequences
+                                                           //     replaced (free it yourself)
+} XMLStringView;
+
+// Derive from this structure and overwrite the callbacks you need.
+// Declarations ('<?xml ... ?>') and short hand tags ('<a/>') get an "endElement"
+// right after their attributes. At the end of the document, "endElement" is
+// called for all elements that are still open. The "clear" callback receives
+// comments, CDATA sections, etc.
+typedef struct XMLSAXHandler
+{
+    virtual ~XMLSAXHandler() {};
+    virtual void startElement(XMLStringView name, int isDeclaration) {};
+    virtual void attribute(XMLStringView name, XMLStringView value) {};
+    virtual void endElement(XMLStringView name) {};
+    virtual void text(XMLStringView text) {};
+    virtual void clear(XMLStringView value, LPCTSTR lpszOpen, LPCTSTR lpszClose) {};
+} XMLSAXHandler;
+
+XMLError parseSAXString(LPCTSTR lpszXML, XMLSAXHandler *pHandler, XMLResults *pResults=NULL);
+XMLError parseSAXFile(const char *filename, XMLSAXHandler *pHandler, XMLResults *pResults=NULL);
+
 #endif
@@ -0,0 +1,119 @@
+/** Test for the locale independent number formatting.
+ *
+ *  Formats floats spread over the whole range and checks that each
+ *  one reads back as the very same float and isn't longer than the
+ *  shortest '%.<n>g' that does. Includes values whose rounding carries
+ *  over into the next decade, like 9.96, which must not affect the
+ *  longer attempts that follow -- or the result reads '09.96'.
+ *
+ *  Build & run with 'make test'. Returns non-zero on failure.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ */
+
+
+// Standard headers
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Affogato headers
+#include "affogatoNumberFormat.hpp"
+
+
+using namespace std;
+using namespace affogato;
+
+
+namespace {
+
+	// Returns false and complains if value doesn't survive formatting
+	bool check( float value ) {
+		char buffer[ numberFormatSize ];
+		size_t length = formatFloat( value, buffer );
+		string formatted( buffer, length );
+
+		if( ( float )strtod( formatted.c_str(), NULL ) != value ) {
+			cerr << "affogatoNumberFormatTest: " << formatted << " doesn't read back as the float it came from" << endl;
+			return false;
+		}
+
+		// A leading zero is only allowed right before the point of a value below one
+		const size_t first = ( '-' == formatted[ 0 ] ) ? 1 : 0;
+		if( ( '0' == formatted[ first ] ) && ( first + 1 < formatted.size() ) &&
+			( ( '.' != formatted[ first + 1 ] ) || ( string::npos != formatted.find( 'e' ) ) ) )
+		{
+			cerr << "affogatoNumberFormatTest: " << formatted << " has a stray leading zero" << endl;
+			return false;
+		}
+
+		// Count the significant digits printf needs at least
+		int precision;
+		for( precision = 1; precision < 9; precision++ ) {
+			char reference[ numberFormatSize ];
+			sprintf( reference, "%.*g", precision, value );
+			if( ( float )strtod( reference, NULL ) == value )
+				break;
+		}
+		size_t significant = 0;
+		bool leading = true;
+		for( string::const_iterator it = formatted.begin(); ( it < formatted.end() ) && ( 'e' != *it ); it++ ) {
+			if( ( '1' <= *it ) && ( '9' >= *it ) )
+				leading = false;
+			if( !leading && ( '0' <= *it ) && ( '9' >= *it ) )
+				++significant;
+		}
+		// Integers may be written with trailing zeros instead of an exponent
+		if( ( ( float )( int )value != value ) && ( significant > ( size_t )precision ) ) {
+			cerr << "affogatoNumberFormatTest: " << formatted << " has more than " << precision << " significant digits" << endl;
+			return false;
+		}
+
+		return true;
+	}
+}
+
+
+int main( int argc, char *argv[] ) {
+	// Roundings that carry over into the next decade
+	const float carries[] = { 9.96f, 0.0996f, 99.96f, 9.9999e-5f, 0.995f, 999999.4f, 9.5f, 0.95f };
+	for( size_t i = 0; i < sizeof( carries ) / sizeof( float ); i++ ) {
+		if( !check( carries[ i ] ) || !check( -carries[ i ] ) )
+			return 1;
+	}
+
+	// Every 9973rd float from the smallest normal one up to the largest
+	for( unsigned bits = 0x00800000; bits < 0x7f800000; bits += 9973 ) {
+		float value;
+		memcpy( &value, &bits, sizeof( float ) );
+		if( !check( value ) )
+			return 1;
+	}
+
+	cout << "affogatoNumberFormatTest: passed" << endl;
+	return 0;
+}
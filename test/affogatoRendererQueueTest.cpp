@@ -0,0 +1,157 @@
+/** Test for the asynchronous renderer queue.
+ *
+ *  Feeds more calls than the queue holds through ueberManQueue into a
+ *  renderer that logs what it sees and checks that they arrive in
+ *  order and with the contexts the renderer handed out. A call that
+ *  throws on the worker thread must be reported by the next flush()
+ *  without stopping the calls after it.
+ *
+ *  Build & run with 'make test'. Returns non-zero on failure.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ */
+
+
+// Standard headers
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// Affogato headers
+#include "affogatoRendererQueue.hpp"
+
+
+using namespace std;
+using namespace affogato;
+using namespace ueberMan;
+
+
+namespace {
+
+	// Writes one line per call it gets to see; hands out contexts
+	// starting at 100 so mapping errors show
+	class logRenderer : public ueberMan::ueberMan {
+		public:
+			logRenderer() : contextCounter( 100 ) {}
+
+			context beginScene( const string& destination, bool useBinary, bool useCompression ) {
+				log << "beginScene " << destination << " " << ( contextCounter + 1 ) << "\n";
+				return ++contextCounter;
+			}
+
+			void switchScene( context ctx ) {
+				log << "switchScene " << ctx << "\n";
+			}
+
+			void endScene( context ctx ) {
+				log << "endScene " << ctx << "\n";
+			}
+
+			void attribute( const string& typedname, const int value ) {
+				if( "int fail" == typedname )
+					throw( runtime_error( "Failing on purpose" ) );
+				log << "attribute " << typedname << " " << value << "\n";
+			}
+
+			bool getAttribute( const string& typedname, int &value ) {
+				value = ( int )log.str().size();
+				return true;
+			}
+
+			void translate( const float x, const float y, const float z ) {
+				log << "translate " << x << " " << y << " " << z << "\n";
+			}
+
+			ostringstream log;
+
+		private:
+			context contextCounter;
+	};
+
+	// Issues the test calls; 'queue' is called through the base class
+	// like ueberManInterface does
+	void calls( ueberMan::ueberMan& renderer, int& logSize ) {
+		context outer = renderer.beginScene( "outer" );
+		context inner = renderer.beginScene( "inner" );
+
+		// More than ueberManQueue::maxPending calls so record() has to wait
+		for( int i = 0; i < 100000; i++ )
+			renderer.translate( ( float )i, 0, 1 );
+
+		renderer.switchScene( outer );
+		renderer.attribute( "int before", 1 );
+		renderer.switchScene( inner );
+		renderer.endScene( inner );
+
+		// Needs an answer and so has to see everything recorded before it
+		renderer.getAttribute( "int logsize", logSize );
+
+		try {
+			renderer.attribute( "int fail", 2 );
+		}
+		catch( runtime_error& ) {
+			// Direct calls fail right away, the queue reports on flush()
+		}
+		renderer.attribute( "int after", 3 );
+
+		renderer.endScene( outer );
+	}
+}
+
+
+int main( int argc, char *argv[] ) {
+	logRenderer expected;
+	int expectedLogSize = 0;
+	calls( expected, expectedLogSize );
+
+	logRenderer target;
+	int queuedLogSize = 0;
+	bool firstFlush, secondFlush;
+	{
+		ueberManQueue queue( target );
+		calls( queue, queuedLogSize );
+		firstFlush = queue.flush(); // Error from the worker thread
+		secondFlush = queue.flush(); // Error was consumed
+	}
+
+	// The failing call throws before logging in either case
+	string expectedLog( expected.log.str() );
+	if( expectedLog != target.log.str() ) {
+		cerr << "affogatoRendererQueueTest: queued calls differ from direct ones" << endl;
+		return 1;
+	}
+	if( expectedLogSize != queuedLogSize ) {
+		cerr << "affogatoRendererQueueTest: getAttribute() didn't wait for the queue" << endl;
+		return 1;
+	}
+	if( firstFlush || !secondFlush ) {
+		cerr << "affogatoRendererQueueTest: error on the worker thread not reported once" << endl;
+		return 1;
+	}
+
+	cout << "affogatoRendererQueueTest: passed" << endl;
+	return 0;
+}
@@ -0,0 +1,300 @@
+/** Round trip test for the binary command stream renderer.
+ *
+ *  Records a small scene through ueberManStreamRenderer, replays the
+ *  resulting stream into a renderer that logs what it sees and checks
+ *  that every call arrives unaltered. The scene carries a primitive
+ *  variable bigger than the stream's flush size so the file must grow
+ *  before the scene ends.
+ *  A second scene records variables with a tolerance and checks that
+ *  they come back within it and take up less space. Last, two scenes
+ *  are recorded interleaved and each file must replay only its own
+ *  calls.
+ *
+ *  Build & run with 'make test'. Returns non-zero on failure.
+ *
+ *  @file
+ *
+ *  @par License:
+ *  Copyright (C) 2006 Rising Sun Pictures Pty. Ltd.
+ *  @par
+ *  This plugin is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later
+ *  version.
+ *  @par
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *  @par
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA or point your web browser to
+ *	http://www.gnu.org/licenses/lgpl.txt.
+ *
+ *  @author Moritz Moeller (moritz.moeller@rsp.com.au)
+ */
+
+
+// Standard headers
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Affogato headers
+#include "affogatoStreamRenderer.hpp"
+
+
+using namespace std;
+using namespace affogato;
+using namespace ueberMan;
+
+
+namespace {
+
+	// Writes one line per call it gets to see
+	class logRenderer : public ueberMan::ueberMan {
+		public:
+			logRenderer() : contextCounter( 0 ) {}
+
+			context beginScene( const string& destination, bool useBinary, bool useCompression ) {
+				log << "beginScene " << destination << " " << useBinary << " " << useCompression << "\n";
+				return ++contextCounter;
+			}
+
+			void endScene( context ctx ) {
+				log << "endScene " << ctx << "\n";
+			}
+
+			void attribute( const string& typedname, const float value ) {
+				log << "attribute " << typedname << " " << value << "\n";
+			}
+
+			void variable( const tokenValue& aTokenValue ) {
+				log << "variable " << aTokenValue.signature().size() << " " << hash( aTokenValue.signature() ) << "\n";
+			}
+
+			void translate( const float x, const float y, const float z ) {
+				log << "translate " << x << " " << y << " " << z << "\n";
+			}
+
+			void mesh( const string& interp, const int nfaces, const int *nverts, const int *verts, const bool interpolateBoundary, primitiveHandle &identifier ) {
+				int numVerts = 0;
+				for( int i = 0; i < nfaces; i++ )
+					numVerts += nverts[ i ];
+				log << "mesh " << interp << " " << nfaces << " " << interpolateBoundary << " " << identifier;
+				for( int i = 0; i < numVerts; i++ )
+					log << " " << verts[ i ];
+				log << "\n";
+			}
+
+			ostringstream log;
+
+		private:
+			static unsigned long hash( const string& bytes ) {
+				unsigned long h = 5381;
+				for( string::const_iterator it = bytes.begin(); it < bytes.end(); it++ )
+					h = h * 33 + ( unsigned char )*it;
+				return h;
+			}
+
+			context contextCounter;
+	};
+
+	// Issues the test scene on the given renderer
+	void scene( ueberMan::ueberMan& renderer, const string& destination, const vector< float >& points, bool checkFlush ) {
+		context ctx = renderer.beginScene( destination, true, false );
+		renderer.translate( 1, 2.5f, -3 );
+		renderer.attribute( "float displacementbound", 0.25f );
+
+		renderer.variable( tokenValue( &points[ 0 ], points.size(), "P", tokenValue::storageVertex, tokenValue::typePoint ) );
+
+		int flags[] = { 1, 0, 1 };
+		tokenValue booleans( flags, 3, "visible", tokenValue::storageUniform );
+		booleans.setType( tokenValue::typeBoolean );
+		renderer.variable( booleans );
+
+		if( checkFlush ) {
+			// The points don't fit into the buffer and have to be on disk already
+			ifstream file( ( destination + ".ums" ).c_str(), ios::in | ios::binary | ios::ate );
+			if( ( size_t )file.tellg() < points.size() * sizeof( float ) )
+				throw( runtime_error( "Stream not flushed before the end of the scene" ) );
+		}
+
+		int nverts[] = { 4, 3 };
+		int verts[] = { 0, 1, 2, 3, 1, 4, 2 };
+		primitiveHandle identifier( "mesh" );
+		renderer.mesh( "linear", 2, nverts, verts, false, identifier );
+
+		renderer.endScene( ctx );
+	}
+
+	// Records two scenes that are open at the same time
+	void interleavedScenes( ueberMan::ueberMan& renderer, const string& first, const string& second ) {
+		context firstCtx = renderer.beginScene( first );
+		renderer.translate( 1, 0, 0 );
+		context secondCtx = renderer.beginScene( second );
+		renderer.translate( 2, 0, 0 );
+		renderer.switchScene( firstCtx );
+		renderer.translate( 3, 0, 0 );
+		renderer.endScene( firstCtx );
+		renderer.switchScene( secondCtx );
+		renderer.translate( 4, 0, 0 );
+		renderer.endScene( secondCtx );
+	}
+
+	// Keeps the values of every variable it gets to see
+	class captureRenderer : public ueberMan::ueberMan {
+		public:
+			context beginScene( const string& destination, bool useBinary, bool useCompression ) {
+				return 1;
+			}
+
+			void variable( const tokenValue& aTokenValue ) {
+				const float *first = ( const float* )aTokenValue.data();
+				values.push_back( vector< float >( first, first + aTokenValue.byteSize() / sizeof( float ) ) );
+			}
+
+			vector< vector< float > > values;
+	};
+
+	// Records colors and two motion samples of points with a tolerance
+	void encodingScene( const string& destination, const vector< vector< float > >& values, float tolerance ) {
+		ueberManStreamRenderer recorder;
+		context ctx = recorder.beginScene( destination, true, false );
+
+		tokenValue colors( &values[ 0 ][ 0 ], values[ 0 ].size(), "Cs", tokenValue::storageVertex, tokenValue::typeColor );
+		colors.setTolerance( tolerance );
+		recorder.variable( colors );
+
+		vector< float > times( 2 );
+		times[ 1 ] = 1;
+		recorder.motion( times );
+		for( int i = 1; i < 3; i++ ) {
+			tokenValue points( &values[ i ][ 0 ], values[ i ].size(), "P", tokenValue::storageVertex, tokenValue::typePoint );
+			points.setTolerance( tolerance );
+			recorder.variable( points );
+			primitiveHandle identifier( "particles" );
+			recorder.points( "sphere", values[ i ].size() / 3, identifier );
+		}
+
+		recorder.endScene( ctx );
+	}
+}
+
+
+int main( int argc, char *argv[] ) {
+	string destination( "affogatoStreamRendererTest" );
+
+	// 8MB of points -- twice the size the stream buffers in memory
+	vector< float > points( 2 * 1024 * 1024 );
+	for( size_t i = 0; i < points.size(); i++ )
+		points[ i ] = ( float )i * 0.5f;
+
+	try {
+		logRenderer expected;
+		scene( expected, destination, points, false );
+
+		{
+			ueberManStreamRenderer recorder;
+			scene( recorder, destination, points, true );
+		}
+
+		logRenderer replayed;
+		ueberManStreamRenderer::replay( destination + ".ums", replayed );
+		remove( ( destination + ".ums" ).c_str() );
+
+		if( expected.log.str() != replayed.log.str() ) {
+			cerr << "Replayed calls differ.\nExpected:\n" << expected.log.str() << "Got:\n" << replayed.log.str();
+			return 1;
+		}
+	}
+	catch( runtime_error& err ) {
+		cerr << err.what() << endl;
+		remove( ( destination + ".ums" ).c_str() );
+		return 1;
+	}
+
+	// Colors in [0, 1] fit 8 bits, points spread over ~1000 units need 16 bits
+	// and the second sample only moves a little, so 8 bit deltas suffice
+	const float tolerance = 0.01f;
+	vector< vector< float > > values( 3, vector< float >( 3000 ) );
+	for( size_t i = 0; i < values[ 0 ].size(); i++ ) {
+		values[ 0 ][ i ] = ( float )( i % 100 ) / 99.0f;
+		values[ 1 ][ i ] = ( float )i * 0.37f - 500.0f;
+		values[ 2 ][ i ] = values[ 1 ][ i ] + ( float )( i % 7 ) * 0.01f;
+	}
+
+	try {
+		encodingScene( destination, values, tolerance );
+
+		ifstream file( ( destination + ".ums" ).c_str(), ios::in | ios::binary | ios::ate );
+		size_t fileSize = ( size_t )file.tellg();
+		file.close();
+
+		captureRenderer replayed;
+		ueberManStreamRenderer::replay( destination + ".ums", replayed );
+		remove( ( destination + ".ums" ).c_str() );
+
+		// 1 + 2 + 1 bytes per value plus headers
+		if( 14000 < fileSize ) {
+			cerr << "Encoded stream too big: " << fileSize << " bytes" << endl;
+			return 1;
+		}
+		if( replayed.values.size() != values.size() ) {
+			cerr << "Replayed " << replayed.values.size() << " variables instead of " << values.size() << endl;
+			return 1;
+		}
+		for( size_t v = 0; v < values.size(); v++ ) {
+			if( replayed.values[ v ].size() != values[ v ].size() ) {
+				cerr << "Variable " << v << " has the wrong size" << endl;
+				return 1;
+			}
+			for( size_t i = 0; i < values[ v ].size(); i++ ) {
+				if( !( fabs( replayed.values[ v ][ i ] - values[ v ][ i ] ) <= tolerance ) ) {
+					cerr << "Variable " << v << " is off by " << fabs( replayed.values[ v ][ i ] - values[ v ][ i ] ) << " at " << i << endl;
+					return 1;
+				}
+			}
+		}
+	}
+	catch( runtime_error& err ) {
+		cerr << err.what() << endl;
+		remove( ( destination + ".ums" ).c_str() );
+		return 1;
+	}
+
+	try {
+		string first( destination + "First" ), second( destination + "Second" );
+		{
+			ueberManStreamRenderer recorder;
+			interleavedScenes( recorder, first, second );
+		}
+
+		logRenderer firstReplayed, secondReplayed;
+		ueberManStreamRenderer::replay( first + ".ums", firstReplayed );
+		ueberManStreamRenderer::replay( second + ".ums", secondReplayed );
+		remove( ( first + ".ums" ).c_str() );
+		remove( ( second + ".ums" ).c_str() );
+
+		string firstExpected( "beginScene " + first + " 0 0\ntranslate 1 0 0\ntranslate 3 0 0\nendScene 1\n" );
+		string secondExpected( "beginScene " + second + " 0 0\ntranslate 2 0 0\ntranslate 4 0 0\nendScene 1\n" );
+		if( ( firstExpected != firstReplayed.log.str() ) || ( secondExpected != secondReplayed.log.str() ) ) {
+			cerr << "Interleaved scenes got mixed up:\n" << firstReplayed.log.str() << secondReplayed.log.str();
+			return 1;
+		}
+	}
+	catch( runtime_error& err ) {
+		cerr << err.what() << endl;
+		return 1;
+	}
+
+	cout << "affogatoStreamRendererTest: passed" << endl;
+	return 0;
+}